@@ -20,7 +20,7 @@ typedef enum NodeType {
 typedef struct BTreeNodeBase {
     NodeType type;       
     int numKeys;         // the number of keys currently stored
-    int pageNum;         // the page number on disk
+    PageNumber pageNum;  // the page number on disk
 } BTreeNodeBase;
 
 // leaf node structure
@@ -28,31 +28,31 @@ typedef struct BTreeLeafNode {
     BTreeNodeBase base;  // shared part
     Value *keys;         // key array
     RID *rids;           // the record pointer corresponding to each key
-    int nextLeaf;        // the page number of the next leaf node 
+    PageNumber nextLeaf; // the page number of the next leaf node 
 } BTreeLeafNode;
 
 // inner node structure
 typedef struct BTreeInternalNode {
     BTreeNodeBase base;  // shared part
     Value *keys;         // key array
-    int *children;       // child node page number array
+    PageNumber *children; // child node page number array
 } BTreeInternalNode;
 
 typedef struct BTreeMgmtData {
     BM_BufferPool *bm;   // buffer manager
     BM_PageHandle *page; // current page handle
-    int rootPage;        // root node page number
+    PageNumber rootPage; // root node page number
     int numNodes;        // total num of node
     int numEntries;      // total num of key
     int order;           // order
 } BTreeMgmtData;
 typedef struct ScanMgmtData {
-    int currentPage;  
+    PageNumber currentPage;
     int keyIndex;     //  key index in the current leaf page
     bool end;          // whether the scan has ended
 } ScanMgmtData;
 
-BTreeLeafNode *createLeafNode(int pageNum, int order) {
+BTreeLeafNode *createLeafNode(PageNumber pageNum, int order) {
     BTreeLeafNode *leaf = (BTreeLeafNode *)malloc(sizeof(BTreeLeafNode));
     leaf->base.type = NODE_LEAF;
     leaf->base.numKeys = 0;
@@ -63,13 +63,13 @@ BTreeLeafNode *createLeafNode(int pageNum, int order) {
     return leaf;
 }
 
-BTreeInternalNode *createInternalNode(int pageNum, int order) {
+BTreeInternalNode *createInternalNode(PageNumber pageNum, int order) {
     BTreeInternalNode *node = (BTreeInternalNode *)malloc(sizeof(BTreeInternalNode));
     node->base.type = NODE_INTERNAL;
     node->base.numKeys = 0;
     node->base.pageNum = pageNum;
     node->keys = calloc(order + 1, sizeof(Value));     //  +1
-    node->children = calloc(order + 2, sizeof(int));   //  +2 (the number of children is 1 more than the key)
+    node->children = calloc(order + 2, sizeof(PageNumber));   //  +2 (the number of children is 1 more than the key)
     return node;
 }
 
@@ -100,14 +100,22 @@ Page Number Content
 
 */
 RC createBtree (char *idxId, DataType keyType, int n) {
+    // an index on default-size pages; a "mem:" idxId keeps it in memory,
+    // a "ts:<tablespace>#<index>" idxId puts it into a tablespace next to its table
+    return createBtreeWithPageSize(idxId, keyType, n, PAGE_SIZE);
+}
+
+RC createBtreeWithPageSize (char *idxId, DataType keyType, int n, int pageSize) {
     // TODO: create page file, initialize root node, store metadata
+    // every node takes one page of pageSize bytes, so larger pages fit a larger order n;
+    // node pages carry a checksum trailer like table pages
     SM_FileHandle fh;
     BM_BufferPool *bm = (BM_BufferPool *) malloc(sizeof(BM_BufferPool));
     BM_PageHandle *page = (BM_PageHandle *) malloc(sizeof(BM_PageHandle));
     RC rc;
 
     // create new page file
-    rc = createPageFile(idxId);
+    rc = createPageFileWithOptions(idxId, pageSize, SM_PAGE_CHECKSUMS);
     if (rc != RC_OK) return rc;
 
     rc = openPageFile(idxId, &fh);
@@ -143,7 +151,7 @@ RC createBtree (char *idxId, DataType keyType, int n) {
     //BTreeLeafNode *root = createLeafNode(1, n);
     //memcpy(page->data, root, sizeof(BTreeLeafNode));
 
-    memset(page->data, 0, PAGE_SIZE);  // clear 
+    memset(page->data, 0, getPoolPageSize(bm));  // clear 
     printf("createBtree: bm=%p page=%p rootPage=%d\n", bm, page, 1);
 
     markDirty(bm, page);
@@ -175,10 +183,11 @@ RC openBtree (BTreeHandle **tree, char *idxId) {
     rc = pinPage(bm, page, 0);
     if (rc != RC_OK) return rc;
 
-    int keyType, order, rootPage, numNodes, numEntries;
-    sscanf(page->data, "%d %d %d %d %d", &keyType, &order, &rootPage, &numNodes, &numEntries);
+    int keyType, order, numNodes, numEntries;
+    PageNumber rootPage;
+    sscanf(page->data, "%d %d %lld %d %d", &keyType, &order, &rootPage, &numNodes, &numEntries);
     
-    printf("openBtree: bm=%p page=%p rootPage(from file)=%d\n", bm, page, rootPage);
+    printf("openBtree: bm=%p page=%p rootPage(from file)=%lld\n", bm, page, rootPage);
 
     // constructing BTreeHandle and Management Structure
     BTreeHandle *newTree = (BTreeHandle *) malloc(sizeof(BTreeHandle));
@@ -257,7 +266,7 @@ RC findKey(BTreeHandle *tree, Value *key, RID *result) {
     BTreeMgmtData *mgmt = (BTreeMgmtData *)tree->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
     BM_PageHandle page;
-    int currentPage = mgmt->rootPage;
+    PageNumber currentPage = mgmt->rootPage;
 
     while (true) {
         pinPage(bm, &page, currentPage);
@@ -268,19 +277,20 @@ RC findKey(BTreeHandle *tree, Value *key, RID *result) {
         offset += sizeof(NodeType);
 
         if (type == NODE_LEAF) {
-            int numKeys, nextLeaf;
+            int numKeys;
+            PageNumber nextLeaf;
             memcpy(&numKeys, page.data + offset, sizeof(int));
             offset += sizeof(int);
-            memcpy(&nextLeaf, page.data + offset, sizeof(int));
-            offset += sizeof(int);
+            memcpy(&nextLeaf, page.data + offset, sizeof(PageNumber));
+            offset += sizeof(PageNumber);
 
             for (int i = 0; i < numKeys; i++) {
                 int keyVal;
                 RID rid;
                 memcpy(&keyVal, page.data + offset, sizeof(int));
                 offset += sizeof(int);
-                memcpy(&rid.page, page.data + offset, sizeof(int));
-                offset += sizeof(int);
+                memcpy(&rid.page, page.data + offset, sizeof(PageNumber));
+                offset += sizeof(PageNumber);
                 memcpy(&rid.slot, page.data + offset, sizeof(int));
                 offset += sizeof(int);
 
@@ -304,10 +314,10 @@ RC findKey(BTreeHandle *tree, Value *key, RID *result) {
                 offset += sizeof(int);
             }
 
-            int *children = calloc(numKeys + 1, sizeof(int));
+            PageNumber *children = calloc(numKeys + 1, sizeof(PageNumber));
             for (int i = 0; i <= numKeys; i++) {
-                memcpy(&children[i], page.data + offset, sizeof(int));
-                offset += sizeof(int);
+                memcpy(&children[i], page.data + offset, sizeof(PageNumber));
+                offset += sizeof(PageNumber);
             }
 
             int i;
@@ -325,13 +335,13 @@ RC findKey(BTreeHandle *tree, Value *key, RID *result) {
 }
 
 static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
-                    Value *promoteKey, int *newLeafPageNum)
+                    Value *promoteKey, PageNumber *newLeafPageNum)
 {
     BTreeMgmtData *mgmt = (BTreeMgmtData *)tree->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
     int order = mgmt->order;
 
-    printf("[splitLeaf] page=%d, numKeys(before)=%d\n", leaf->base.pageNum, leaf->base.numKeys);
+    printf("[splitLeaf] page=%lld, numKeys(before)=%d\n", leaf->base.pageNum, leaf->base.numKeys);
 
     //  collect all key/rid
     int totalKeys = leaf->base.numKeys + 1;
@@ -378,7 +388,11 @@ static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
     int split = (totalKeys + 1) / 2;
 
     //  create new leaf 
-    int newPage = ++mgmt->numNodes;
+    // take a page from the index file's free list (or a fresh one at the end)
+    PageNumber newPage;
+    RC rc = allocPoolPage(mgmt->bm, &newPage);
+    if (rc != RC_OK) return rc;
+    mgmt->numNodes++;
     *newLeafPageNum = newPage;
     BTreeLeafNode *newLeaf = createLeafNode(newPage, order);
 
@@ -394,7 +408,7 @@ static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
         newLeaf->rids[i] = tempRids[split + i];
     }
 
-    int oldNext = leaf->nextLeaf;
+    PageNumber oldNext = leaf->nextLeaf;
 
     // determine the minimum key of the next leaf (if it exists)
     int nextMinKey = INT_MAX;
@@ -407,7 +421,7 @@ static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
             int numKeys_next;
             memcpy(&numKeys_next, ph_next.data + sizeof(NodeType), sizeof(int));
             if (numKeys_next > 0) {
-                int offset_next = sizeof(NodeType) + sizeof(int) + sizeof(int);
+                int offset_next = sizeof(NodeType) + sizeof(int) + sizeof(PageNumber);
                 memcpy(&nextMinKey, ph_next.data + offset_next, sizeof(int));
             }
         }
@@ -429,12 +443,12 @@ static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
     promoteKey->dt = DT_INT;
     promoteKey->v.intV = newLeaf->keys[0].v.intV;
 
-    printf("[splitLeaf] left=%d keys=", leaf->base.pageNum);
+    printf("[splitLeaf] left=%lld keys=", leaf->base.pageNum);
     for (int i = 0; i < leaf->base.numKeys; i++) printf("%d ", leaf->keys[i].v.intV);
-    printf(" | next=%d\n", leaf->nextLeaf);
-    printf("[splitLeaf] right=%d keys=", newLeaf->base.pageNum);
+    printf(" | next=%lld\n", leaf->nextLeaf);
+    printf("[splitLeaf] right=%lld keys=", newLeaf->base.pageNum);
     for (int i = 0; i < newLeaf->base.numKeys; i++) printf("%d ", newLeaf->keys[i].v.intV);
-    printf(" | next=%d\n", newLeaf->nextLeaf);
+    printf(" | next=%lld\n", newLeaf->nextLeaf);
 
     //  serializly write back to disk (order: NodeType → numKeys → nextLeaf)
     BM_PageHandle ph;
@@ -443,15 +457,15 @@ static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
 
     // wirte leaf
     pinPage(bm, &ph, leaf->base.pageNum);
-    memset(ph.data, 0, PAGE_SIZE);
+    memset(ph.data, 0, getPoolPageSize(bm));
     offset = 0;
     memcpy(ph.data + offset, &type, sizeof(NodeType)); offset += sizeof(NodeType);
     memcpy(ph.data + offset, &leaf->base.numKeys, sizeof(int)); offset += sizeof(int);
-    memcpy(ph.data + offset, &leaf->nextLeaf, sizeof(int)); offset += sizeof(int);
+    memcpy(ph.data + offset, &leaf->nextLeaf, sizeof(PageNumber)); offset += sizeof(PageNumber);
     for (int i = 0; i < leaf->base.numKeys; i++) {
         int keyVal = leaf->keys[i].v.intV;
         memcpy(ph.data + offset, &keyVal, sizeof(int)); offset += sizeof(int);
-        memcpy(ph.data + offset, &leaf->rids[i].page, sizeof(int)); offset += sizeof(int);
+        memcpy(ph.data + offset, &leaf->rids[i].page, sizeof(PageNumber)); offset += sizeof(PageNumber);
         memcpy(ph.data + offset, &leaf->rids[i].slot, sizeof(int)); offset += sizeof(int);
     }
     markDirty(bm, &ph);
@@ -459,15 +473,15 @@ static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
 
     // write right
     pinPage(bm, &ph, newLeaf->base.pageNum);
-    memset(ph.data, 0, PAGE_SIZE);
+    memset(ph.data, 0, getPoolPageSize(bm));
     offset = 0;
     memcpy(ph.data + offset, &type, sizeof(NodeType)); offset += sizeof(NodeType);
     memcpy(ph.data + offset, &newLeaf->base.numKeys, sizeof(int)); offset += sizeof(int);
-    memcpy(ph.data + offset, &newLeaf->nextLeaf, sizeof(int)); offset += sizeof(int);
+    memcpy(ph.data + offset, &newLeaf->nextLeaf, sizeof(PageNumber)); offset += sizeof(PageNumber);
     for (int i = 0; i < newLeaf->base.numKeys; i++) {
         int keyVal = newLeaf->keys[i].v.intV;
         memcpy(ph.data + offset, &keyVal, sizeof(int)); offset += sizeof(int);
-        memcpy(ph.data + offset, &newLeaf->rids[i].page, sizeof(int)); offset += sizeof(int);
+        memcpy(ph.data + offset, &newLeaf->rids[i].page, sizeof(PageNumber)); offset += sizeof(PageNumber);
         memcpy(ph.data + offset, &newLeaf->rids[i].slot, sizeof(int)); offset += sizeof(int);
     }
     markDirty(bm, &ph);
@@ -476,7 +490,7 @@ static RC splitLeaf(BTreeHandle *tree, BTreeLeafNode *leaf, Value *key, RID rid,
 //  fix isolated tail node: if newLeaf is the last
 if (newLeaf->nextLeaf == -1) {
     BM_PageHandle ph_scan;
-    int curPage = mgmt->rootPage;
+    PageNumber curPage = mgmt->rootPage;
 
     //  find the leftmost leaf node
     while (true) {
@@ -493,14 +507,14 @@ if (newLeaf->nextLeaf == -1) {
         memcpy(&numKeys, ph_scan.data + sizeof(NodeType), sizeof(int));
 
         // get the first child node
-        int firstChild;
-        memcpy(&firstChild, ph_scan.data + sizeof(NodeType) + sizeof(int) + numKeys * sizeof(int), sizeof(int));
+        PageNumber firstChild;
+        memcpy(&firstChild, ph_scan.data + sizeof(NodeType) + sizeof(int) + numKeys * sizeof(int), sizeof(PageNumber));
         unpinPage(bm, &ph_scan);
         curPage = firstChild;
     }
 
     //  start from the leftmost leaf and follow nextLeaf to find the last leaf
-    int lastLeaf = curPage;
+    PageNumber lastLeaf = curPage;
     while (true) {
         pinPage(bm, &ph_scan, lastLeaf);
         NodeType t;
@@ -511,15 +525,15 @@ if (newLeaf->nextLeaf == -1) {
             break;
         }
 
-        int nextLeaf;
-        memcpy(&nextLeaf, ph_scan.data + sizeof(NodeType) + sizeof(int), sizeof(int));
+        PageNumber nextLeaf;
+        memcpy(&nextLeaf, ph_scan.data + sizeof(NodeType) + sizeof(int), sizeof(PageNumber));
 
         if (nextLeaf == -1) {
             //  found the last leaf
             if (lastLeaf != newPage) {
-                memcpy(ph_scan.data + sizeof(NodeType) + sizeof(int), &newPage, sizeof(int));
+                memcpy(ph_scan.data + sizeof(NodeType) + sizeof(int), &newPage, sizeof(PageNumber));
                 markDirty(bm, &ph_scan);
-                printf("[splitLeaf-fix] Updated last leaf %d → next=%d\n", lastLeaf, newPage);
+                printf("[splitLeaf-fix] Updated last leaf %lld → next=%lld\n", lastLeaf, newPage);
             }
             unpinPage(bm, &ph_scan);
             break;
@@ -529,8 +543,8 @@ if (newLeaf->nextLeaf == -1) {
         lastLeaf = nextLeaf;
     }
 }
-    printf("[splitLeaf-debug] leaf %d nextLeaf=%d\n", leaf->base.pageNum, leaf->nextLeaf);
-    printf("[splitLeaf-debug] newLeaf %d nextLeaf=%d\n", newLeaf->base.pageNum, newLeaf->nextLeaf);
+    printf("[splitLeaf-debug] leaf %lld nextLeaf=%lld\n", leaf->base.pageNum, leaf->nextLeaf);
+    printf("[splitLeaf-debug] newLeaf %lld nextLeaf=%lld\n", newLeaf->base.pageNum, newLeaf->nextLeaf);
 
     free(tempKeys);
     free(tempRids);
@@ -542,14 +556,14 @@ if (newLeaf->nextLeaf == -1) {
 
 
 static RC splitInternalNode(BTreeHandle *tree, BTreeInternalNode *node, 
-                            Value promoteKeyFromChild, int rightChildPage,
-                            Value *promoteKey, int *newRightPage) {
+                            Value promoteKeyFromChild, PageNumber rightChildPage,
+                            Value *promoteKey, PageNumber *newRightPage) {
     BTreeMgmtData *mgmt = (BTreeMgmtData *)tree->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
     int order = mgmt->order;
 
     Value *tempKeys = calloc(order + 1, sizeof(Value));
-    int *tempChildren = calloc(order + 2, sizeof(int));
+    PageNumber *tempChildren = calloc(order + 2, sizeof(PageNumber));
 
     for (int i = 0; i < node->base.numKeys; i++)
         tempKeys[i] = node->keys[i];
@@ -569,7 +583,10 @@ static RC splitInternalNode(BTreeHandle *tree, BTreeInternalNode *node,
     int split = (order + 1) / 2;
 
     // create a new internal node
-    int newPage = ++mgmt->numNodes;
+    PageNumber newPage;
+    RC rc = allocPoolPage(mgmt->bm, &newPage);
+    if (rc != RC_OK) return rc;
+    mgmt->numNodes++;
     *newRightPage = newPage;
 
     BTreeInternalNode *newInternal = createInternalNode(newPage, order);
@@ -595,7 +612,7 @@ static RC splitInternalNode(BTreeHandle *tree, BTreeInternalNode *node,
     // write back to disk
     BM_PageHandle page;
     pinPage(bm, &page, node->base.pageNum);
-    memset(page.data, 0, PAGE_SIZE);
+    memset(page.data, 0, getPoolPageSize(bm));
     memcpy(page.data, &node->base.type, sizeof(NodeType));
     memcpy(page.data + sizeof(NodeType), &node->base.numKeys, sizeof(int));
     int offset = sizeof(NodeType) + sizeof(int);
@@ -604,14 +621,14 @@ static RC splitInternalNode(BTreeHandle *tree, BTreeInternalNode *node,
         offset += sizeof(int);
     }
     for (int j = 0; j <= node->base.numKeys; j++) {
-        memcpy(page.data + offset, &node->children[j], sizeof(int));
-        offset += sizeof(int);
+        memcpy(page.data + offset, &node->children[j], sizeof(PageNumber));
+        offset += sizeof(PageNumber);
     }
     markDirty(bm, &page);
     unpinPage(bm, &page);
 
     pinPage(bm, &page, newInternal->base.pageNum);
-    memset(page.data, 0, PAGE_SIZE);
+    memset(page.data, 0, getPoolPageSize(bm));
     memcpy(page.data, &newInternal->base.type, sizeof(NodeType));
     memcpy(page.data + sizeof(NodeType), &newInternal->base.numKeys, sizeof(int));
     offset = sizeof(NodeType) + sizeof(int);
@@ -620,8 +637,8 @@ static RC splitInternalNode(BTreeHandle *tree, BTreeInternalNode *node,
         offset += sizeof(int);
     }
     for (int j = 0; j <= newInternal->base.numKeys; j++) {
-        memcpy(page.data + offset, &newInternal->children[j], sizeof(int));
-        offset += sizeof(int);
+        memcpy(page.data + offset, &newInternal->children[j], sizeof(PageNumber));
+        offset += sizeof(PageNumber);
     }
     markDirty(bm, &page);
     unpinPage(bm, &page);
@@ -637,28 +654,29 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
     BTreeMgmtData *mgmt = (BTreeMgmtData *)tree->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
     BM_PageHandle *page = malloc(sizeof(BM_PageHandle));
-    printf("insertKey: bm=%p page=%p rootPage=%d numEntries=%d\n",
+    printf("insertKey: bm=%p page=%p rootPage=%lld numEntries=%d\n",
         mgmt->bm, mgmt->page, mgmt->rootPage, mgmt->numEntries);
 
 
     //  when the root is empty, create the first leaf
     if (mgmt->numEntries == 0) {
-        printf("DEBUG: rootPage=%d (creating first leaf)\n", mgmt->rootPage);
+        printf("DEBUG: rootPage=%lld (creating first leaf)\n", mgmt->rootPage);
 
         pinPage(bm, page, mgmt->rootPage);
 
         // write empty leaves serially
         NodeType type = NODE_LEAF;
         int numKeys = 1;
-        int nextLeaf = -1;
-        memset(page->data, 0, PAGE_SIZE);
+        PageNumber nextLeaf = -1;
+        memset(page->data, 0, getPoolPageSize(bm));
 
         int offset = 0;
         memcpy(page->data + offset, &type, sizeof(NodeType)); offset += sizeof(NodeType);
         memcpy(page->data + offset, &numKeys, sizeof(int)); offset += sizeof(int);
-        memcpy(page->data + offset, &nextLeaf, sizeof(int)); offset += sizeof(int);
+        memcpy(page->data + offset, &nextLeaf, sizeof(PageNumber)); offset += sizeof(PageNumber);
         memcpy(page->data + offset, &key->v.intV, sizeof(int)); offset += sizeof(int);
-        memcpy(page->data + offset, &rid, sizeof(RID));
+        memcpy(page->data + offset, &rid.page, sizeof(PageNumber)); offset += sizeof(PageNumber);
+        memcpy(page->data + offset, &rid.slot, sizeof(int));
 
         markDirty(bm, page);
         unpinPage(bm, page);
@@ -684,12 +702,13 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
         printf("Root is leaf\n");
 
         //  deserialize leaf node header
-        int numKeys, nextLeaf;
+        int numKeys;
+        PageNumber nextLeaf;
         int offset = sizeof(NodeType);
         memcpy(&numKeys, page->data + offset, sizeof(int)); offset += sizeof(int);
-        memcpy(&nextLeaf, page->data + offset, sizeof(int)); offset += sizeof(int);
+        memcpy(&nextLeaf, page->data + offset, sizeof(PageNumber)); offset += sizeof(PageNumber);
 
-        printf("numKeys=%d, nextLeaf=%d\n", numKeys, nextLeaf);
+        printf("numKeys=%d, nextLeaf=%lld\n", numKeys, nextLeaf);
 
         //  Mmnually construct the leaf structure
         BTreeLeafNode leaf;
@@ -706,7 +725,8 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
         for (int i = 0; i < numKeys; i++) {
             memcpy(&leaf.keys[i].v.intV, page->data + offset, sizeof(int)); offset += sizeof(int);
             leaf.keys[i].dt = DT_INT;
-            memcpy(&leaf.rids[i], page->data + offset, sizeof(RID)); offset += sizeof(RID);
+            memcpy(&leaf.rids[i].page, page->data + offset, sizeof(PageNumber)); offset += sizeof(PageNumber);
+            memcpy(&leaf.rids[i].slot, page->data + offset, sizeof(int)); offset += sizeof(int);
         }
 
         // （B）determine whether it is full
@@ -736,14 +756,15 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             leaf.base.numKeys++;
 
             //  write back to disk
-            memset(page->data, 0, PAGE_SIZE);
+            memset(page->data, 0, getPoolPageSize(bm));
             int offset = 0;
             memcpy(page->data + offset, &leaf.base.type, sizeof(NodeType)); offset += sizeof(NodeType);
             memcpy(page->data + offset, &leaf.base.numKeys, sizeof(int)); offset += sizeof(int);
-            memcpy(page->data + offset, &leaf.nextLeaf, sizeof(int)); offset += sizeof(int);
+            memcpy(page->data + offset, &leaf.nextLeaf, sizeof(PageNumber)); offset += sizeof(PageNumber);
             for (int i = 0; i < leaf.base.numKeys; i++) {
                 memcpy(page->data + offset, &tempKeys[i].v.intV, sizeof(int)); offset += sizeof(int);
-                memcpy(page->data + offset, &tempRids[i], sizeof(RID)); offset += sizeof(RID);
+                memcpy(page->data + offset, &tempRids[i].page, sizeof(PageNumber)); offset += sizeof(PageNumber);
+                memcpy(page->data + offset, &tempRids[i].slot, sizeof(int)); offset += sizeof(int);
             }
 
             markDirty(bm, page);
@@ -760,12 +781,16 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
         } else {
             // leaf node is full -> split
             Value promoteKey;
-            int newLeafPage;
+            PageNumber newLeafPage;
             leaf.base.pageNum = mgmt->rootPage; 
+            unpinPage(bm, page); // splitLeaf rewrites the root leaf through its own pin
             splitLeaf(tree, &leaf, key, rid, &promoteKey, &newLeafPage);
 
             // create new root
-            int rootPage = ++mgmt->numNodes;
+            PageNumber rootPage;
+            RC rc = allocPoolPage(bm, &rootPage);
+            if (rc != RC_OK) return rc;
+            mgmt->numNodes++;
             BTreeInternalNode *root = createInternalNode(rootPage, mgmt->order);
             root->base.numKeys = 1;
             root->keys[0] = promoteKey;
@@ -777,7 +802,7 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             pinPage(bm, &rootPg, rootPage);
 
             int offset = 0;
-            memset(rootPg.data, 0, PAGE_SIZE);
+            memset(rootPg.data, 0, getPoolPageSize(bm));
             memcpy(rootPg.data + offset, &root->base.type, sizeof(NodeType)); offset += sizeof(NodeType);
             memcpy(rootPg.data + offset, &root->base.numKeys, sizeof(int)); offset += sizeof(int);
 
@@ -786,8 +811,8 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
                 offset += sizeof(int);
             }
             for (int i = 0; i <= root->base.numKeys; i++) {
-                memcpy(rootPg.data + offset, &root->children[i], sizeof(int));
-                offset += sizeof(int);
+                memcpy(rootPg.data + offset, &root->children[i], sizeof(PageNumber));
+                offset += sizeof(PageNumber);
             }
 
             markDirty(bm, &rootPg);
@@ -796,7 +821,7 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             mgmt->rootPage = rootPage;
             mgmt->numEntries++;
 
-            printf("[insertKey] Created new root page=%d (promoteKey=%d)\n",
+            printf("[insertKey] Created new root page=%lld (promoteKey=%d)\n",
                 rootPage, promoteKey.v.intV);
             return RC_OK;
         }
@@ -815,7 +840,7 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
         node.base.type = type;
         node.base.pageNum = mgmt->rootPage;
         node.keys = calloc(mgmt->order + 1, sizeof(Value));
-        node.children = calloc(mgmt->order + 2, sizeof(int));
+        node.children = calloc(mgmt->order + 2, sizeof(PageNumber));
 
         for (int i = 0; i < node.base.numKeys; i++) {
             memcpy(&node.keys[i].v.intV, page->data + offset, sizeof(int));
@@ -823,9 +848,10 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             offset += sizeof(int);
         }
         for (int i = 0; i <= node.base.numKeys; i++) {
-            memcpy(&node.children[i], page->data + offset, sizeof(int));
-            offset += sizeof(int);
+            memcpy(&node.children[i], page->data + offset, sizeof(PageNumber));
+            offset += sizeof(PageNumber);
         }
+        unpinPage(bm, page); // pinned again below if the node changes
 
         //  find the child node to insert
         int i;
@@ -833,7 +859,7 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             if (key->v.intV < node.keys[i].v.intV)
                 break;
         }
-        int targetPage = node.children[i];
+        PageNumber targetPage = node.children[i];
 
         //  open the target leaf page
         BM_PageHandle leafPg;
@@ -844,7 +870,7 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
         offset = 0;
         memcpy(&leaf.base.type, leafPg.data + offset, sizeof(NodeType)); offset += sizeof(NodeType);
         memcpy(&leaf.base.numKeys, leafPg.data + offset, sizeof(int)); offset += sizeof(int);
-        memcpy(&leaf.nextLeaf, leafPg.data + offset, sizeof(int)); offset += sizeof(int);
+        memcpy(&leaf.nextLeaf, leafPg.data + offset, sizeof(PageNumber)); offset += sizeof(PageNumber);
 
         leaf.base.pageNum = targetPage;
         leaf.keys = calloc(mgmt->order, sizeof(Value));
@@ -854,8 +880,10 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             memcpy(&leaf.keys[j].v.intV, leafPg.data + offset, sizeof(int));
             leaf.keys[j].dt = DT_INT;
             offset += sizeof(int);
-            memcpy(&leaf.rids[j], leafPg.data + offset, sizeof(RID));
-            offset += sizeof(RID);
+            memcpy(&leaf.rids[j].page, leafPg.data + offset, sizeof(PageNumber));
+            offset += sizeof(PageNumber);
+            memcpy(&leaf.rids[j].slot, leafPg.data + offset, sizeof(int));
+            offset += sizeof(int);
         }
 
         //  determine whether it is full
@@ -872,14 +900,15 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             leaf.base.numKeys++;
 
             // write back to the disk
-            memset(leafPg.data, 0, PAGE_SIZE);
+            memset(leafPg.data, 0, getPoolPageSize(bm));
             offset = 0;
             memcpy(leafPg.data + offset, &leaf.base.type, sizeof(NodeType)); offset += sizeof(NodeType);
             memcpy(leafPg.data + offset, &leaf.base.numKeys, sizeof(int)); offset += sizeof(int);
-            memcpy(leafPg.data + offset, &leaf.nextLeaf, sizeof(int)); offset += sizeof(int);
+            memcpy(leafPg.data + offset, &leaf.nextLeaf, sizeof(PageNumber)); offset += sizeof(PageNumber);
             for (int j = 0; j < leaf.base.numKeys; j++) {
                 memcpy(leafPg.data + offset, &leaf.keys[j].v.intV, sizeof(int)); offset += sizeof(int);
-                memcpy(leafPg.data + offset, &leaf.rids[j], sizeof(RID)); offset += sizeof(RID);
+                memcpy(leafPg.data + offset, &leaf.rids[j].page, sizeof(PageNumber)); offset += sizeof(PageNumber);
+                memcpy(leafPg.data + offset, &leaf.rids[j].slot, sizeof(int)); offset += sizeof(int);
             }
             markDirty(bm, &leafPg);
             unpinPage(bm, &leafPg);
@@ -889,7 +918,8 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
 
         //  ortherwise split leaf
         Value promoteKey;
-        int newLeafPage;
+        PageNumber newLeafPage;
+        unpinPage(bm, &leafPg);
         splitLeaf(tree, &leaf, key, rid, &promoteKey, &newLeafPage);
 
         //  insert promoteKey into the internal node (insert in order)
@@ -905,7 +935,7 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
 
         //  write back to internal nodes
         pinPage(bm, page, node.base.pageNum);
-        memset(page->data, 0, PAGE_SIZE);
+        memset(page->data, 0, getPoolPageSize(bm));
         offset = 0;
         memcpy(page->data + offset, &node.base.type, sizeof(NodeType)); offset += sizeof(NodeType);
         memcpy(page->data + offset, &node.base.numKeys, sizeof(int)); offset += sizeof(int);
@@ -913,7 +943,7 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
             memcpy(page->data + offset, &node.keys[i].v.intV, sizeof(int)); offset += sizeof(int);
         }
         for (int i = 0; i <= node.base.numKeys; i++) {
-            memcpy(page->data + offset, &node.children[i], sizeof(int)); offset += sizeof(int);
+            memcpy(page->data + offset, &node.children[i], sizeof(PageNumber)); offset += sizeof(PageNumber);
         }
         markDirty(bm, page);
         unpinPage(bm, page);
@@ -925,11 +955,108 @@ RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
 }
 
 
+/*
+   remove an emptied (non-root) leaf from the tree and give its page back to
+   the index file: the left neighbour under the same parent takes over the
+   nextLeaf link, the parent drops the child and its separator key, and a
+   root left with a single child is replaced by that child.
+   a leftmost child below a non-root parent keeps its page, since its
+   predecessor in the leaf chain lives under a different parent.
+*/
+static RC removeEmptyLeaf(BTreeHandle *tree, PageNumber leafPage, PageNumber nextLeaf,
+                          PageNumber parentPage, int childIdx)
+{
+    BTreeMgmtData *mgmt = (BTreeMgmtData *)tree->mgmtData;
+    BM_BufferPool *bm = mgmt->bm;
+    BM_PageHandle ph;
+    RC rc;
+
+    if (childIdx == 0 && parentPage != mgmt->rootPage)
+        return RC_OK;
+
+    rc = pinPage(bm, &ph, parentPage);
+    if (rc != RC_OK) return rc;
+
+    int offset = sizeof(NodeType);
+    int numKeys;
+    memcpy(&numKeys, ph.data + offset, sizeof(int)); offset += sizeof(int);
+
+    int *keys = calloc(numKeys + 1, sizeof(int));
+    PageNumber *children = calloc(numKeys + 2, sizeof(PageNumber));
+    for (int i = 0; i < numKeys; i++) {
+        memcpy(&keys[i], ph.data + offset, sizeof(int)); offset += sizeof(int);
+    }
+    for (int i = 0; i <= numKeys; i++) {
+        memcpy(&children[i], ph.data + offset, sizeof(PageNumber)); offset += sizeof(PageNumber);
+    }
+
+    // relink the left neighbour past the removed leaf
+    if (childIdx > 0) {
+        BM_PageHandle left;
+        rc = pinPage(bm, &left, children[childIdx - 1]);
+        if (rc != RC_OK) {
+            unpinPage(bm, &ph);
+            free(keys);
+            free(children);
+            return rc;
+        }
+        memcpy(left.data + sizeof(NodeType) + sizeof(int), &nextLeaf, sizeof(PageNumber));
+        markDirty(bm, &left);
+        unpinPage(bm, &left);
+    }
+
+    // drop the child and the separator next to it
+    int keyIdx = (childIdx > 0) ? childIdx - 1 : 0;
+    for (int i = keyIdx; i < numKeys - 1; i++)
+        keys[i] = keys[i + 1];
+    for (int i = childIdx; i < numKeys; i++)
+        children[i] = children[i + 1];
+    numKeys--;
+
+    PageNumber freedRoot = -1;
+    if (numKeys == 0 && parentPage == mgmt->rootPage) {
+        // the remaining child becomes the new root
+        freedRoot = parentPage;
+        mgmt->rootPage = children[0];
+    } else {
+        memset(ph.data, 0, getPoolPageSize(bm));
+        NodeType type = NODE_INTERNAL;
+        offset = 0;
+        memcpy(ph.data + offset, &type, sizeof(NodeType)); offset += sizeof(NodeType);
+        memcpy(ph.data + offset, &numKeys, sizeof(int)); offset += sizeof(int);
+        for (int i = 0; i < numKeys; i++) {
+            memcpy(ph.data + offset, &keys[i], sizeof(int)); offset += sizeof(int);
+        }
+        for (int i = 0; i <= numKeys; i++) {
+            memcpy(ph.data + offset, &children[i], sizeof(PageNumber)); offset += sizeof(PageNumber);
+        }
+        markDirty(bm, &ph);
+    }
+    unpinPage(bm, &ph);
+    free(keys);
+    free(children);
+
+    rc = freePoolPage(bm, leafPage);
+    if (rc != RC_OK) return rc;
+    mgmt->numNodes--;
+
+    if (freedRoot != -1) {
+        rc = freePoolPage(bm, freedRoot);
+        if (rc != RC_OK) return rc;
+        mgmt->numNodes--;
+    }
+
+    return RC_OK;
+}
+
+
 RC deleteKey(BTreeHandle *tree, Value *key) {
     BTreeMgmtData *mgmt = (BTreeMgmtData *)tree->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
     BM_PageHandle page;
-    int currentPage = mgmt->rootPage;
+    PageNumber currentPage = mgmt->rootPage;
+    PageNumber parentPage = -1; // internal node we came from, and which child we took
+    int childIdx = 0;
 
     // traverse to the leaf node
     while (true) {
@@ -941,11 +1068,12 @@ RC deleteKey(BTreeHandle *tree, Value *key) {
         offset += sizeof(NodeType);
 
         if (type == NODE_LEAF) {
-            int numKeys, nextLeaf;
+            int numKeys;
+            PageNumber nextLeaf;
             memcpy(&numKeys, page.data + offset, sizeof(int));
             offset += sizeof(int);
-            memcpy(&nextLeaf, page.data + offset, sizeof(int));
-            offset += sizeof(int);
+            memcpy(&nextLeaf, page.data + offset, sizeof(PageNumber));
+            offset += sizeof(PageNumber);
 
             // find target key
             int found = -1;
@@ -956,7 +1084,7 @@ RC deleteKey(BTreeHandle *tree, Value *key) {
                     found = i;
                 }
                 // skip key + RID(both are int)
-                offset += sizeof(int) + 2 * sizeof(int);
+                offset += sizeof(int) + sizeof(PageNumber) + sizeof(int);
             }
 
             if (found == -1) {
@@ -965,24 +1093,24 @@ RC deleteKey(BTreeHandle *tree, Value *key) {
             }
 
             // delete: Re-copy all key-value pairs except found
-            offset = sizeof(NodeType) + 2 * sizeof(int);
-            char temp[PAGE_SIZE];
-            memset(temp, 0, PAGE_SIZE);
+            offset = sizeof(NodeType) + sizeof(int) + sizeof(PageNumber);
+            int pageSize = getPoolPageSize(bm);
+            char *temp = (char *) calloc(1, pageSize);
             NodeType nodeType = NODE_LEAF;
             memcpy(temp, &nodeType, sizeof(NodeType));
             int newNumKeys = numKeys - 1;
             memcpy(temp + sizeof(NodeType), &newNumKeys, sizeof(int));
-            memcpy(temp + sizeof(NodeType) + sizeof(int), &nextLeaf, sizeof(int));
+            memcpy(temp + sizeof(NodeType) + sizeof(int), &nextLeaf, sizeof(PageNumber));
 
-            int writeOffset = sizeof(NodeType) + 2 * sizeof(int);
-            int readOffset = sizeof(NodeType) + 2 * sizeof(int);
+            int writeOffset = sizeof(NodeType) + sizeof(int) + sizeof(PageNumber);
+            int readOffset = sizeof(NodeType) + sizeof(int) + sizeof(PageNumber);
             for (int i = 0; i < numKeys; i++) {
                 int keyVal;
                 RID rid;
                 memcpy(&keyVal, page.data + readOffset, sizeof(int));
                 readOffset += sizeof(int);
-                memcpy(&rid.page, page.data + readOffset, sizeof(int));
-                readOffset += sizeof(int);
+                memcpy(&rid.page, page.data + readOffset, sizeof(PageNumber));
+                readOffset += sizeof(PageNumber);
                 memcpy(&rid.slot, page.data + readOffset, sizeof(int));
                 readOffset += sizeof(int);
 
@@ -991,21 +1119,28 @@ RC deleteKey(BTreeHandle *tree, Value *key) {
 
                 memcpy(temp + writeOffset, &keyVal, sizeof(int));
                 writeOffset += sizeof(int);
-                memcpy(temp + writeOffset, &rid.page, sizeof(int));
-                writeOffset += sizeof(int);
+                memcpy(temp + writeOffset, &rid.page, sizeof(PageNumber));
+                writeOffset += sizeof(PageNumber);
                 memcpy(temp + writeOffset, &rid.slot, sizeof(int));
                 writeOffset += sizeof(int);
             }
 
             // write back
-            memcpy(page.data, temp, PAGE_SIZE);
+            memcpy(page.data, temp, pageSize);
+            free(temp);
             markDirty(bm, &page);
             unpinPage(bm, &page);
-            forceFlushPool(bm);
 
             mgmt->numEntries--;
-            printf("[deleteKey] Deleted key=%d from leaf page=%d\n",
+            printf("[deleteKey] Deleted key=%d from leaf page=%lld\n",
                    key->v.intV, currentPage);
+
+            // an empty leaf below the root is unlinked and its page reused
+            if (newNumKeys == 0 && parentPage != -1) {
+                RC rc = removeEmptyLeaf(tree, currentPage, nextLeaf, parentPage, childIdx);
+                if (rc != RC_OK) return rc;
+            }
+            forceFlushPool(bm);
             return RC_OK;
         } else {
             // internal node
@@ -1019,10 +1154,10 @@ RC deleteKey(BTreeHandle *tree, Value *key) {
                 offset += sizeof(int);
             }
 
-            int *children = calloc(numKeys + 1, sizeof(int));
+            PageNumber *children = calloc(numKeys + 1, sizeof(PageNumber));
             for (int i = 0; i <= numKeys; i++) {
-                memcpy(&children[i], page.data + offset, sizeof(int));
-                offset += sizeof(int);
+                memcpy(&children[i], page.data + offset, sizeof(PageNumber));
+                offset += sizeof(PageNumber);
             }
 
             int i;
@@ -1030,6 +1165,8 @@ RC deleteKey(BTreeHandle *tree, Value *key) {
                 if (key->v.intV < keys[i])
                     break;
             }
+            parentPage = currentPage;
+            childIdx = i;
             currentPage = children[i];
 
             free(keys);
@@ -1047,7 +1184,7 @@ RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle) {
     BTreeMgmtData *mgmt = (BTreeMgmtData *) tree->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
     BM_PageHandle page;
-    int currentPage = mgmt->rootPage;
+    PageNumber currentPage = mgmt->rootPage;
 
     // go straight down to the leftmost leaf
     while (true) {
@@ -1063,8 +1200,8 @@ RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle) {
 
         // calculate the offset of the first child node
         int offset = sizeof(NodeType) + sizeof(int) + numKeys * sizeof(int);
-        int firstChild;
-        memcpy(&firstChild, page.data + offset, sizeof(int));
+        PageNumber firstChild;
+        memcpy(&firstChild, page.data + offset, sizeof(PageNumber));
 
         unpinPage(bm, &page);
         currentPage = firstChild;
@@ -1082,7 +1219,7 @@ RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle) {
 
     unpinPage(bm, &page);
 
-    printf("Opened tree scan (start leaf=%d).\n", currentPage);
+    printf("Opened tree scan (start leaf=%lld).\n", currentPage);
 
     *handle = sc;
     return RC_OK;
@@ -1107,7 +1244,7 @@ RC nextEntry(BT_ScanHandle *handle, RID *result)
     NodeType type;
     memcpy(&type, page.data + offset, sizeof(NodeType)); offset += sizeof(NodeType);
     if (type != NODE_LEAF) {
-        printf("[nextEntry ERROR] page %d is not leaf\n", scan->currentPage);
+        printf("[nextEntry ERROR] page %lld is not leaf\n", scan->currentPage);
         unpinPage(bm, &page);
         return -1;
     }
@@ -1115,8 +1252,8 @@ RC nextEntry(BT_ScanHandle *handle, RID *result)
     int numKeys;
     memcpy(&numKeys, page.data + offset, sizeof(int)); offset += sizeof(int);
 
-    int nextLeaf;
-    memcpy(&nextLeaf, page.data + offset, sizeof(int)); offset += sizeof(int);
+    PageNumber nextLeaf;
+    memcpy(&nextLeaf, page.data + offset, sizeof(PageNumber)); offset += sizeof(PageNumber);
 
     //  ++ before each entry, so that the 0th key can be read when keyIndex = -1
     scan->keyIndex++;
@@ -1137,14 +1274,14 @@ RC nextEntry(BT_ScanHandle *handle, RID *result)
         return nextEntry(handle, result);
     }
 
-    // each entry = key(4B) + page(4B) + slot(4B)
-    int entryOffset = offset + scan->keyIndex * (sizeof(int) + sizeof(int) + sizeof(int));
+    // each entry = key(4B) + page(8B) + slot(4B)
+    int entryOffset = offset + scan->keyIndex * (sizeof(int) + sizeof(PageNumber) + sizeof(int));
     int keyVal;
     memcpy(&keyVal, page.data + entryOffset, sizeof(int)); entryOffset += sizeof(int);
-    memcpy(&result->page, page.data + entryOffset, sizeof(int)); entryOffset += sizeof(int);
+    memcpy(&result->page, page.data + entryOffset, sizeof(PageNumber)); entryOffset += sizeof(PageNumber);
     memcpy(&result->slot, page.data + entryOffset, sizeof(int));
 
-    printf("[SCAN] page=%d keyIndex=%d key=%d rid=(%d,%d)\n",
+    printf("[SCAN] page=%lld keyIndex=%d key=%d rid=(%lld,%d)\n",
            scan->currentPage, scan->keyIndex, keyVal, result->page, result->slot);
 
     unpinPage(bm, &page);
@@ -1166,7 +1303,7 @@ RC closeTreeScan(BT_ScanHandle *handle)
 #define INDENT_STEP 4
 
 //  auxiliary recursive function,
-static void printNode(BTreeHandle *tree, int pageNum, int depth, char *result) {
+static void printNode(BTreeHandle *tree, PageNumber pageNum, int depth, char *result) {
     BTreeMgmtData *mgmt = (BTreeMgmtData *)tree->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
     BM_PageHandle ph;
@@ -1184,11 +1321,12 @@ static void printNode(BTreeHandle *tree, int pageNum, int depth, char *result) {
 
     char buf[256];
     if (type == NODE_LEAF) {
-        int numKeys, nextLeaf;
+        int numKeys;
+        PageNumber nextLeaf;
         memcpy(&numKeys, ph.data + offset, sizeof(int)); offset += sizeof(int);
-        memcpy(&nextLeaf, ph.data + offset, sizeof(int)); offset += sizeof(int);
+        memcpy(&nextLeaf, ph.data + offset, sizeof(PageNumber)); offset += sizeof(PageNumber);
 
-        sprintf(buf, "LEAF(page=%d,next=%d): [", pageNum, nextLeaf);
+        sprintf(buf, "LEAF(page=%lld,next=%lld): [", pageNum, nextLeaf);
         strcat(result, buf);
 
         for (int i = 0; i < numKeys; i++) {
@@ -1196,12 +1334,12 @@ static void printNode(BTreeHandle *tree, int pageNum, int depth, char *result) {
             RID rid;
             memcpy(&key, ph.data + offset, sizeof(int));
             offset += sizeof(int);
-            memcpy(&rid.page, ph.data + offset, sizeof(int));
-            offset += sizeof(int);
+            memcpy(&rid.page, ph.data + offset, sizeof(PageNumber));
+            offset += sizeof(PageNumber);
             memcpy(&rid.slot, ph.data + offset, sizeof(int));
             offset += sizeof(int);
 
-            sprintf(buf, "%d(rid=%d,%d)", key, rid.page, rid.slot);
+            sprintf(buf, "%d(rid=%lld,%d)", key, rid.page, rid.slot);
             strcat(result, buf);
             if (i != numKeys - 1) strcat(result, ",");
         }
@@ -1211,7 +1349,7 @@ static void printNode(BTreeHandle *tree, int pageNum, int depth, char *result) {
     } else {
         int numKeys;
         memcpy(&numKeys, ph.data + offset, sizeof(int)); offset += sizeof(int);
-        sprintf(buf, "INTERNAL(page=%d): [", pageNum);
+        sprintf(buf, "INTERNAL(page=%lld): [", pageNum);
         strcat(result, buf);
 
         int *keys = calloc(numKeys, sizeof(int));
@@ -1226,8 +1364,8 @@ static void printNode(BTreeHandle *tree, int pageNum, int depth, char *result) {
 
         int *children = calloc(numKeys + 1, sizeof(int));
         for (int i = 0; i <= numKeys; i++) {
-            memcpy(&children[i], ph.data + offset, sizeof(int));
-            offset += sizeof(int);
+            memcpy(&children[i], ph.data + offset, sizeof(PageNumber));
+            offset += sizeof(PageNumber);
         }
 
         //  recursively print child nodes
@@ -10,6 +10,12 @@
 #define RC_PINNED_PAGES_IN_BUFFER 400
 #define RC_BUFFER_POOL_NOT_INIT 5 
 
+#define LRU_K_DEFAULT 2      // K of RS_LRU_K unless stratData says otherwise
+#define LFU_MAX_FREQ 32      // RS_LFU counts stop here
+#define LFU_AGING_PERIOD 8   // RS_LFU halves every count after this many accesses per frame
+#define ARC_T1 0             // RS_ARC lists (Frame.ref): pages seen once lately
+#define ARC_T2 1             // and pages seen at least twice
+
 static long long globalLRUCounter = 0;
 
 // Frame represents one page frame in the buffer pool
@@ -18,39 +24,558 @@ typedef struct Frame {
     char *data;           // pointer to the actual data
     bool dirty;           // dirty flag
     int fixCount;         // how many clients are using this page
-    int ref;              // used for LRU counter
+    int ref;              // access count for LFU, ARC_T1 or ARC_T2 for ARC
     int refBit;           // used for CLOCK
+    bool readAhead;       // loaded by read-ahead and not pinned since
+    bool loading;         // a read-ahead read into the frame is in flight (io); it holds one fixCount meanwhile
+    SM_AsyncRequest io;   // that read
+    int hashNext;         // next frame in the same page table bucket, -1 at the end
+    bool spare;           // empty and on the pool's list of spare frames
+    int prev, next;       // neighbours in the RS_LRU, RS_LFU or RS_ARC list, -1 at the ends
+    struct BM_Ring *ring; // ring the frame belongs to (openPoolRing), NULL for a regular frame
+    int ringSlot;         // its slot in that ring
 } Frame;
 
+/*
+    Access rings (openPoolRing): a bulk scan or load pins its pages through
+    a ring and recycles the ring's few frames, one after the other, instead
+    of pushing the pool's working set out page by page. Ring frames are
+    pool frames, found through the page table like any other, but they are
+    outside the replacement order: no strategy picks them as victims and
+    accesses through the ring do not count as uses. A regular pinPage of a
+    page in a ring frame takes the frame out of the ring.
+*/
+struct BM_Ring {
+    int size;             // frames the ring holds at most
+    int *frames;          // its frames, -1 for a slot not filled yet
+    int hand;             // next slot to recycle
+};
+
 // PoolMgmtData stores various information required for the entire buffer pool to be maintained during runtime
 typedef struct PoolMgmtData {
     Frame *frames;        // point to array of frames
+    int *pageTable;       // page number hash -> first frame of the bucket, -1 if none
+    int tableMask;        // page table buckets - 1 (a power of two)
+    int *spareFrames;     // stack of empty frames, taken before any victim
+    int numSpare;
+    int *loadingFrames;   // frames with a read-ahead read in flight (Frame.loading)
+    int numLoading;
     int numReadIO;        // number of pages read from disk
     int numWriteIO;       // number of pages written to disk
+    int numSyncIO;        // fdatasync calls the page file's sync policy issued for the pool
+    long long syncMark;   // storage manager sync count when the page file was acquired
     int nextVictim;       // index used for FIFO replacement
     int clockHand;        // index used for CLOCK replacement
+    int lruHead, lruTail; // RS_LRU: frames holding pages, least recently used first
     void *strategyData;   // store stratData
+    SM_FileHandle *file;  // the pool's page file, open for the pool's lifetime
+    bool mapped;          // "mapped frames" mode: frames point into the file's mapping
+    int pageSize;         // page size of the page file, every frame holds this many bytes
+    int pageDataSize;     // bytes of a frame the pool's users own (the rest is the checksum trailer)
+    int readAheadMax;     // read-ahead window limit in pages, 0 = read-ahead off (setPoolReadAhead)
+    int raWindow;         // pages loaded by the last read-ahead, 0 = access not sequential
+    PageNumber raLast;    // page of the last pinPage call
+    PageNumber raNext;    // first page past the last read-ahead window
+    int numReadAheadIO;   // pages loaded by read-ahead
+    int numReadAheadHits; // read-ahead pages pinned before they were evicted
+    int numReadAheadWasted; // read-ahead pages evicted without ever being pinned
 } PoolMgmtData;
 
 typedef struct LRUKData {
-    int K;                     // K value
-    long long **histories;     // 2D array [numPages][K], Each frame's access history
+    int K;                     // K value (stratData, LRU_K_DEFAULT without)
+    long long **histories;     // 2D array [numPages][K], Each frame's access history, most recent first
     int *historyCount;         // Number of valid accesses recorded for each frame
+    int *heap;                 // frames holding pages, the next victim on top (lrukBefore)
+    int *heapPos;              // index of each frame in heap, -1 if it is not there
+    int heapSize;
+    int *held;                 // pinned frames taken off the heap while looking for a victim
 } LRUKData;
 
+typedef struct LFUData {
+    int head[LFU_MAX_FREQ + 1];    // frames by access count (Frame.ref), least recently counted first
+    int tail[LFU_MAX_FREQ + 1];
+    int accesses;                  // hits since the counts were last halved
+} LFUData;
+
+/*
+    RS_ARC (adaptive replacement cache): T1 holds the pages seen once lately,
+    T2 the pages seen at least twice, and the ghost lists B1 and B2 the page
+    numbers recently evicted from T1 and T2. A miss on a page in B1 means T1
+    was too small, so p, the number of frames T1 should get, grows; a miss
+    on a page in B2 shrinks it. A scan only passes through T1 and cannot
+    push T2's pages out unless p says so. Ghosts are Frames without data,
+    so the list helpers and pageBucket serve them as well.
+*/
+typedef struct ARCData {
+    int p;                          // target size of T1, 0 .. numPages
+    int head[2], tail[2], size[2];  // T1 and T2 (ARC_T1, ARC_T2), least recently used first
+    Frame *ghosts;                  // 2 * numPages of them; ref is ARC_T1 for B1, ARC_T2 for B2
+    int ghostHead[2], ghostTail[2], ghostSize[2];
+    int *ghostTable;                // page number hash -> first ghost of the bucket, -1 if none
+    int *freeGhosts;                // stack of unused ghosts
+    int numFree;
+} ARCData;
+
+/*
+    Replacement order, kept up to date on every access so a victim is found
+    without looking at every frame: RS_LRU keeps a recency list, RS_LFU one
+    list per access count, RS_LRU_K a heap on the access history, RS_ARC
+    its T1 and T2 recency lists.
+    Only frames holding a page are in there (empty ones are spare frames);
+    chooseVictim takes the first unpinned frame in that order, so it steps
+    over pinned frames but never over the rest of the pool.
+*/
+static void listAppend(Frame *frames, int *head, int *tail, int idx) {
+    frames[idx].prev = *tail;
+    frames[idx].next = -1;
+    if (*tail >= 0) {
+        frames[*tail].next = idx;
+    } else {
+        *head = idx;
+    }
+    *tail = idx;
+}
+
+static void listRemove(Frame *frames, int *head, int *tail, int idx) {
+    if (frames[idx].prev >= 0) {
+        frames[frames[idx].prev].next = frames[idx].next;
+    } else {
+        *head = frames[idx].next;
+    }
+    if (frames[idx].next >= 0) {
+        frames[frames[idx].next].prev = frames[idx].prev;
+    } else {
+        *tail = frames[idx].prev;
+    }
+    frames[idx].prev = -1;
+    frames[idx].next = -1;
+}
+
+/*
+    LRU-K order: frames with K or more accesses go first, the one with the
+    largest backward K-distance (oldest K-th most recent access) first;
+    frames seen fewer than K times only when there are no others, least
+    recently used first.
+*/
+static bool lrukBefore(LRUKData *data, int a, int b) {
+    bool hotA = data->historyCount[a] >= data->K;
+    bool hotB = data->historyCount[b] >= data->K;
+    if (hotA != hotB) {
+        return hotA;
+    }
+    int j = hotA ? data->K - 1 : 0;
+    return data->histories[a][j] < data->histories[b][j];
+}
+
+static void heapSwap(LRUKData *data, int i, int j) {
+    int a = data->heap[i];
+    data->heap[i] = data->heap[j];
+    data->heap[j] = a;
+    data->heapPos[data->heap[i]] = i;
+    data->heapPos[data->heap[j]] = j;
+}
+
+/* restore the heap order around position i */
+static void heapFix(LRUKData *data, int i) {
+    while (i > 0 && lrukBefore(data, data->heap[i], data->heap[(i - 1) / 2])) {
+        heapSwap(data, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    while (true) {
+        int first = i;
+        int left = 2 * i + 1;
+        if (left < data->heapSize && lrukBefore(data, data->heap[left], data->heap[first])) first = left;
+        if (left + 1 < data->heapSize && lrukBefore(data, data->heap[left + 1], data->heap[first])) first = left + 1;
+        if (first == i) {
+            break;
+        }
+        heapSwap(data, i, first);
+        i = first;
+    }
+}
+
+static void heapInsert(LRUKData *data, int idx) {
+    data->heap[data->heapSize] = idx;
+    data->heapPos[idx] = data->heapSize++;
+    heapFix(data, data->heapPos[idx]);
+}
+
+static void heapRemove(LRUKData *data, int idx) {
+    int pos = data->heapPos[idx];
+    int last = data->heap[--data->heapSize];
+    data->heapPos[idx] = -1;
+    if (pos < data->heapSize) {
+        data->heap[pos] = last;
+        data->heapPos[last] = pos;
+        heapFix(data, pos);
+    }
+}
+
+/* note an access to the page in frame idx */
+static void lrukRecord(LRUKData *data, int idx) {
+    long long *history = data->histories[idx];
+    for (int j = data->K - 1; j > 0; j--) {
+        history[j] = history[j - 1];
+    }
+    history[0] = ++globalLRUCounter;
+    if (data->historyCount[idx] < data->K) {
+        data->historyCount[idx]++;
+    }
+}
+
+/* halve every LFU count, so pages that were hot long ago make way for the ones hot now */
+static void lfuAge(PoolMgmtData *mgmt, LFUData *data) {
+    // lower counts first: a frame moves down once and is not seen again
+    for (int f = 2; f <= LFU_MAX_FREQ; f++) {
+        while (data->head[f] >= 0) {
+            int idx = data->head[f];
+            listRemove(mgmt->frames, &data->head[f], &data->tail[f], idx);
+            mgmt->frames[idx].ref = f / 2;
+            listAppend(mgmt->frames, &data->head[f / 2], &data->tail[f / 2], idx);
+        }
+    }
+    data->accesses = 0;
+}
+
+static int pageBucket(PoolMgmtData *mgmt, PageNumber pageNum);
+
+static int arcLookupGhost(PoolMgmtData *mgmt, ARCData *data, PageNumber pageNum) {
+    int g = data->ghostTable[pageBucket(mgmt, pageNum)];
+    while (g >= 0 && data->ghosts[g].pageNum != pageNum) {
+        g = data->ghosts[g].hashNext;
+    }
+    return g;
+}
+
+static void arcDropGhost(PoolMgmtData *mgmt, ARCData *data, int g) {
+    Frame *ghost = &data->ghosts[g];
+    listRemove(data->ghosts, &data->ghostHead[ghost->ref], &data->ghostTail[ghost->ref], g);
+    data->ghostSize[ghost->ref]--;
+    int *link = &data->ghostTable[pageBucket(mgmt, ghost->pageNum)];
+    while (*link != g) {
+        link = &data->ghosts[*link].hashNext;
+    }
+    *link = ghost->hashNext;
+    ghost->pageNum = NO_PAGE;
+    data->freeGhosts[data->numFree++] = g;
+}
+
+/* remember a page evicted from T1 (list ARC_T1) in B1, from T2 in B2 */
+static void arcAddGhost(PoolMgmtData *mgmt, ARCData *data, int list, PageNumber pageNum) {
+    // arcTrim leaves at most 2 * numPages - 1 pages in all four lists before an eviction
+    int g = data->freeGhosts[--data->numFree];
+    Frame *ghost = &data->ghosts[g];
+    int bucket = pageBucket(mgmt, pageNum);
+    ghost->pageNum = pageNum;
+    ghost->ref = list;
+    ghost->hashNext = data->ghostTable[bucket];
+    data->ghostTable[bucket] = g;
+    listAppend(data->ghosts, &data->ghostHead[list], &data->ghostTail[list], g);
+    data->ghostSize[list]++;
+}
+
+/* at most numPages pages in T1 and B1 together, and 2 * numPages in all four lists */
+static void arcTrim(BM_BufferPool *const bm, PoolMgmtData *mgmt, ARCData *data) {
+    while (data->ghostSize[ARC_T1] > 0 && data->size[ARC_T1] + data->ghostSize[ARC_T1] > bm->numPages) {
+        arcDropGhost(mgmt, data, data->ghostHead[ARC_T1]);
+    }
+    while (data->size[ARC_T1] + data->size[ARC_T2] + data->ghostSize[ARC_T1] + data->ghostSize[ARC_T2]
+           > 2 * bm->numPages) {
+        arcDropGhost(mgmt, data, data->ghostHead[data->ghostSize[ARC_T2] > 0 ? ARC_T2 : ARC_T1]);
+    }
+}
+
+/*
+    A miss on pageNum: a ghost in B1 moves p up, one in B2 down, by the
+    ratio of the ghost list sizes (at least one). Returns the ghost's list,
+    -1 if the page has no ghost.
+*/
+static int arcAdapt(BM_BufferPool *const bm, PoolMgmtData *mgmt, ARCData *data, PageNumber pageNum) {
+    int g = arcLookupGhost(mgmt, data, pageNum);
+    if (g < 0) {
+        return -1;
+    }
+    int b1 = data->ghostSize[ARC_T1];
+    int b2 = data->ghostSize[ARC_T2];
+    if (data->ghosts[g].ref == ARC_T1) {
+        data->p += b2 > b1 ? b2 / b1 : 1;
+        if (data->p > bm->numPages) data->p = bm->numPages;
+    } else {
+        data->p -= b1 > b2 ? b1 / b2 : 1;
+        if (data->p < 0) data->p = 0;
+    }
+    return data->ghosts[g].ref;
+}
+
+/*
+    ARC's victim: the least recently used page of T1 while T1 is larger than
+    p (or as large, for a page coming back from B2), of T2 otherwise. Pinned
+    frames are stepped over, into the other list if need be.
+*/
+static int arcVictim(PoolMgmtData *mgmt, ARCData *data, int ghostList) {
+    int t1 = data->size[ARC_T1];
+    int first = (t1 > 0 && (t1 > data->p || (ghostList == ARC_T2 && t1 == data->p))) ? ARC_T1 : ARC_T2;
+    for (int n = 0; n < 2; n++) {
+        int list = n == 0 ? first : 1 - first;
+        for (int i = data->head[list]; i >= 0; i = mgmt->frames[i].next) {
+            if (mgmt->frames[i].fixCount == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+/* a page was just put into frame idx */
+static void linkFrame(BM_BufferPool *const bm, PoolMgmtData *mgmt, int idx) {
+    if (bm->strategy == RS_LRU) {
+        listAppend(mgmt->frames, &mgmt->lruHead, &mgmt->lruTail, idx);
+    } else if (bm->strategy == RS_LFU) {
+        LFUData *data = (LFUData *) mgmt->strategyData;
+        mgmt->frames[idx].ref = 1;
+        listAppend(mgmt->frames, &data->head[1], &data->tail[1], idx);
+    } else if (bm->strategy == RS_LRU_K) {
+        LRUKData *data = (LRUKData *) mgmt->strategyData;
+        data->historyCount[idx] = 0;
+        lrukRecord(data, idx);
+        heapInsert(data, idx);
+    } else if (bm->strategy == RS_ARC) {
+        // back from B1 or B2 means seen before: straight into T2
+        ARCData *data = (ARCData *) mgmt->strategyData;
+        int list = ARC_T1;
+        int g = arcLookupGhost(mgmt, data, mgmt->frames[idx].pageNum);
+        if (g >= 0) {
+            arcDropGhost(mgmt, data, g);
+            list = ARC_T2;
+        }
+        mgmt->frames[idx].ref = list;
+        listAppend(mgmt->frames, &data->head[list], &data->tail[list], idx);
+        data->size[list]++;
+        arcTrim(bm, mgmt, data);
+    }
+}
+
+/* the page in frame idx leaves it; evicted if another page takes the frame */
+static void unlinkFrame(BM_BufferPool *const bm, PoolMgmtData *mgmt, int idx, bool evicted) {
+    if (bm->strategy == RS_LRU) {
+        listRemove(mgmt->frames, &mgmt->lruHead, &mgmt->lruTail, idx);
+    } else if (bm->strategy == RS_LFU) {
+        LFUData *data = (LFUData *) mgmt->strategyData;
+        int f = mgmt->frames[idx].ref;
+        listRemove(mgmt->frames, &data->head[f], &data->tail[f], idx);
+    } else if (bm->strategy == RS_LRU_K) {
+        heapRemove((LRUKData *) mgmt->strategyData, idx);
+    } else if (bm->strategy == RS_ARC) {
+        ARCData *data = (ARCData *) mgmt->strategyData;
+        int list = mgmt->frames[idx].ref;
+        listRemove(mgmt->frames, &data->head[list], &data->tail[list], idx);
+        data->size[list]--;
+        if (evicted) {
+            arcAddGhost(mgmt, data, list, mgmt->frames[idx].pageNum);
+        }
+    }
+}
+
+/* the page in frame idx was pinned again */
+static void touchFrame(BM_BufferPool *const bm, PoolMgmtData *mgmt, int idx) {
+    if (bm->strategy == RS_LRU) { // most recently used goes to the end
+        listRemove(mgmt->frames, &mgmt->lruHead, &mgmt->lruTail, idx);
+        listAppend(mgmt->frames, &mgmt->lruHead, &mgmt->lruTail, idx);
+    }
+    else if (bm->strategy == RS_CLOCK) { // CLOCK strategy, when a page is pinned, the ref should always be 1
+        mgmt->frames[idx].refBit = 1; // Set reference bit
+    }
+    else if (bm->strategy == RS_LFU) { // one list up, to the end of it
+        LFUData *data = (LFUData *) mgmt->strategyData;
+        int f = mgmt->frames[idx].ref;
+        listRemove(mgmt->frames, &data->head[f], &data->tail[f], idx);
+        if (f < LFU_MAX_FREQ) f++;
+        mgmt->frames[idx].ref = f;
+        listAppend(mgmt->frames, &data->head[f], &data->tail[f], idx);
+        if (++data->accesses >= LFU_AGING_PERIOD * bm->numPages) {
+            lfuAge(mgmt, data);
+        }
+    }
+    else if (bm->strategy == RS_LRU_K) {
+        LRUKData *data = (LRUKData *) mgmt->strategyData;
+        lrukRecord(data, idx);
+        heapFix(data, data->heapPos[idx]);
+    }
+    else if (bm->strategy == RS_ARC) { // seen again: from T1 or T2 to the end of T2
+        ARCData *data = (ARCData *) mgmt->strategyData;
+        int list = mgmt->frames[idx].ref;
+        listRemove(mgmt->frames, &data->head[list], &data->tail[list], idx);
+        data->size[list]--;
+        mgmt->frames[idx].ref = ARC_T2;
+        listAppend(mgmt->frames, &data->head[ARC_T2], &data->tail[ARC_T2], idx);
+        data->size[ARC_T2]++;
+    }
+}
+
+/*
+    Page table: which frame holds a page, without looking at every frame.
+    Buckets chain their frames through Frame.hashNext; a page is in at most
+    one frame. Every change of a frame's page goes through setFramePage,
+    which also keeps the stack of empty frames and takes the old page out
+    of the replacement order.
+*/
+static int pageBucket(PoolMgmtData *mgmt, PageNumber pageNum) {
+    // Fibonacci hashing, so strided page numbers spread over the buckets
+    return (int) (((unsigned long long) pageNum * 0x9E3779B97F4A7C15ULL) >> 32) & mgmt->tableMask;
+}
+
+static int lookupFrame(PoolMgmtData *mgmt, PageNumber pageNum) {
+    int i = mgmt->pageTable[pageBucket(mgmt, pageNum)];
+    while (i >= 0 && mgmt->frames[i].pageNum != pageNum) {
+        i = mgmt->frames[i].hashNext;
+    }
+    return i;
+}
+
+/* the frame of the page in a handle: the one pinPage put there if it still holds the page */
+static int handleFrame(BM_BufferPool *const bm, PoolMgmtData *mgmt, BM_PageHandle *const page) {
+    if (page->frame >= 0 && page->frame < bm->numPages && page->pageNum != NO_PAGE
+        && mgmt->frames[page->frame].pageNum == page->pageNum) {
+        return page->frame;
+    }
+    return lookupFrame(mgmt, page->pageNum);
+}
+
+/* take frame idx out of its ring, if it is in one */
+static void ringRelease(PoolMgmtData *mgmt, int idx) {
+    Frame *frame = &mgmt->frames[idx];
+    if (frame->ring != NULL) {
+        frame->ring->frames[frame->ringSlot] = -1;
+        frame->ring = NULL;
+        frame->ringSlot = -1;
+    }
+}
+
+/* put frame idx into an empty slot of ring; it stays a regular frame if the ring is full */
+static void ringAttach(PoolMgmtData *mgmt, BM_Ring *ring, int idx) {
+    for (int slot = 0; slot < ring->size; slot++) {
+        if (ring->frames[slot] < 0) {
+            ring->frames[slot] = idx;
+            mgmt->frames[idx].ring = ring;
+            mgmt->frames[idx].ringSlot = slot;
+            return;
+        }
+    }
+}
+
+static void setFramePage(BM_BufferPool *const bm, PoolMgmtData *mgmt, int idx, PageNumber pageNum) {
+    Frame *frame = &mgmt->frames[idx];
+    if (frame->pageNum == pageNum) {
+        if (pageNum == NO_PAGE && !frame->spare) {
+            frame->spare = true;
+            mgmt->spareFrames[mgmt->numSpare++] = idx;
+        }
+        return;
+    }
+    if (frame->pageNum != NO_PAGE) {
+        if (frame->ring == NULL) {  // ring frames are not in the replacement order
+            unlinkFrame(bm, mgmt, idx, pageNum != NO_PAGE);
+        }
+        int *link = &mgmt->pageTable[pageBucket(mgmt, frame->pageNum)];
+        while (*link != idx) {
+            link = &mgmt->frames[*link].hashNext;
+        }
+        *link = frame->hashNext;
+    }
+    frame->pageNum = pageNum;
+    frame->hashNext = -1;
+    if (pageNum != NO_PAGE) {
+        int bucket = pageBucket(mgmt, pageNum);
+        frame->hashNext = mgmt->pageTable[bucket];
+        mgmt->pageTable[bucket] = idx;
+    } else if (!frame->spare) {
+        ringRelease(mgmt, idx);
+        frame->spare = true;
+        mgmt->spareFrames[mgmt->numSpare++] = idx;
+    }
+}
+
+/*
+    Page file access for the pool. The pool opens its page file once, in
+    initBufferPool (with O_DIRECT for a direct pool, mapped in "mapped frames"
+    mode, where frames point straight into the mapping), and keeps the handle
+    until shutdownBufferPool, so an I/O costs no open, header read and close,
+    and the page count is the one in that handle. Writes follow the page
+    file's sync policy; the syncs issued between acquire and release are
+    counted in numSyncIO.
+*/
+static SM_FileHandle *acquirePoolFile(BM_BufferPool *const bm) {
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    mgmt->syncMark = getSyncCount();
+    return mgmt->file;
+}
+
+static void releasePoolFile(BM_BufferPool *const bm) {
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    mgmt->numSyncIO += (int) (getSyncCount() - mgmt->syncMark);
+}
+
+/*
+    Read-ahead reads stay in flight on the pool's page file after the pin
+    that started them returned. A loading frame holds a fixCount of its own
+    until its read is collected here, so no victim search can hand out its
+    buffer; pinPage collects the one read of the page it pins, misses collect
+    the reads that are done, and flush and shutdown wait for all of them.
+    A read that failed leaves its frame empty, pinPage reads the page itself.
+*/
+static bool finishRead(BM_BufferPool *const bm, PoolMgmtData *mgmt, int idx, bool wait) {
+    Frame *frame = &mgmt->frames[idx];
+    if (!frame->loading) {
+        return true;
+    }
+    if (!wait && !pollAsyncIO(&frame->io)) {
+        return false;
+    }
+    RC rc = waitAsyncIO(&frame->io);
+    frame->loading = false;
+    frame->fixCount--;
+    for (int n = 0; n < mgmt->numLoading; n++) {
+        if (mgmt->loadingFrames[n] == idx) {
+            mgmt->loadingFrames[n] = mgmt->loadingFrames[--mgmt->numLoading];
+            break;
+        }
+    }
+    if (rc != RC_OK) {
+        // counted when submitted; the page never arrived
+        mgmt->numReadIO--;
+        mgmt->numReadAheadIO--;
+        frame->readAhead = false;
+        setFramePage(bm, mgmt, idx, NO_PAGE);
+        frame->dirty = false;
+    }
+    return true;
+}
+
+/* collect the read-ahead reads that are done, or with wait all of them */
+static void reapReads(BM_BufferPool *const bm, PoolMgmtData *mgmt, bool wait) {
+    // finishRead moves the last entry into the one it removes: walk backwards
+    for (int n = mgmt->numLoading - 1; n >= 0; n--) {
+        if (n < mgmt->numLoading) {
+            finishRead(bm, mgmt, mgmt->loadingFrames[n], wait);
+        }
+    }
+}
+
 /*Pool Handling*/ 
 
-RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
-                  const int numPages, ReplacementStrategy strategy,
-                  void *stratData) {
+/* initBufferPool and its variants; openFile opens the page file the way the pool keeps it */
+static RC initPool(BM_BufferPool *const bm, const char *const pageFileName,
+                   const int numPages, ReplacementStrategy strategy, void *stratData,
+                   RC (*openFile) (char *, SM_FileHandle *)) {
     /*
       Initialize a buffer pool for an existing page file.
 
+      Open the page file and keep it open.
       Allocate memory for PoolMgmtData and attach it to bm->mgmtData.
       Allocate an array of frames (numPages size).
       Initialize each frame:
           - pageNum = NO_PAGE (means empty)
-          - allocate memory for data
+          - allocate memory for data (page aligned, so O_DIRECT can use it as is)
           - dirty = false
           - fixCount = 0
           - ref = 0 (for replacement strategies later)
@@ -58,17 +583,24 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
       Set bm->pageFile, bm->numPages, bm->strategy.
      */
 
-    // test the input file if existing
-    SM_FileHandle fh;
-    RC rc = openPageFile((char *) pageFileName, &fh);
+    // open the input file for the pool's lifetime, and learn its page size
+    SM_FileHandle *fh = (SM_FileHandle *) malloc(sizeof(SM_FileHandle));
+    if (fh == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = openFile((char *) pageFileName, fh);
     if (rc != RC_OK) {
+        free(fh);
         return rc;  // return error
     }
-    closePageFile(&fh);
+    int pageSize = getPageSize(fh);
+    int pageDataSize = getPageDataSize(fh);
 
     // allocate memory for management data
     PoolMgmtData *mgmt = (PoolMgmtData *) malloc(sizeof(PoolMgmtData));
     if (mgmt == NULL) {
+        closePageFile(fh);
+        free(fh);
         return RC_WRITE_FAILED;     // failed
     }
 
@@ -76,32 +608,90 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
     mgmt->frames = (Frame *) malloc(sizeof(Frame) * numPages);
     if (mgmt->frames == NULL) { // allocate failed, to aviod leaky, we release mgmt and return error 
         free(mgmt);
+        closePageFile(fh);
+        free(fh);
+        return RC_WRITE_FAILED;
+    }
+
+    // page table with at least two buckets per frame, and every frame spare
+    int buckets = 2;
+    while (buckets < 2 * numPages) {
+        buckets *= 2;
+    }
+    mgmt->pageTable = (int *) malloc(sizeof(int) * buckets);
+    mgmt->spareFrames = (int *) malloc(sizeof(int) * (numPages > 0 ? numPages : 1));
+    mgmt->loadingFrames = (int *) malloc(sizeof(int) * (numPages > 0 ? numPages : 1));
+    if (mgmt->pageTable == NULL || mgmt->spareFrames == NULL || mgmt->loadingFrames == NULL) {
+        free(mgmt->pageTable);
+        free(mgmt->spareFrames);
+        free(mgmt->loadingFrames);
+        free(mgmt->frames);
+        free(mgmt);
+        closePageFile(fh);
+        free(fh);
         return RC_WRITE_FAILED;
     }
+    for (int b = 0; b < buckets; b++) {
+        mgmt->pageTable[b] = -1;
+    }
+    mgmt->tableMask = buckets - 1;
+    mgmt->numSpare = 0;
+    mgmt->numLoading = 0;
 
     // initialize frames
     for (int i = 0; i < numPages; i++) {
         mgmt->frames[i].pageNum = NO_PAGE;
-        mgmt->frames[i].data = (char *) malloc(PAGE_SIZE);
+        mgmt->frames[i].data = allocPageBufferSized(pageSize);
         mgmt->frames[i].dirty = false;
         mgmt->frames[i].fixCount = 0;
-        mgmt->frames[i].ref = 0; // counter for LRU
+        mgmt->frames[i].ref = 0; // counter for LFU
         mgmt->frames[i].refBit = 0;  
+        mgmt->frames[i].readAhead = false;
+        mgmt->frames[i].loading = false;
+        mgmt->frames[i].hashNext = -1;
+        mgmt->frames[i].spare = true;
+        mgmt->frames[i].prev = -1;
+        mgmt->frames[i].next = -1;
+        mgmt->frames[i].ring = NULL;
+        mgmt->frames[i].ringSlot = -1;
+    }
+    // spare frames are taken from the top, frame 0 first
+    for (int i = numPages - 1; i >= 0; i--) {
+        mgmt->spareFrames[mgmt->numSpare++] = i;
     }
 
     // initialize counters
     mgmt->numReadIO = 0;
     mgmt->numWriteIO = 0;
+    mgmt->numSyncIO = 0;
     mgmt->nextVictim = 0; // FIFO pointer
     mgmt->clockHand = 0; // CLOCK pointer
+    mgmt->lruHead = -1;
+    mgmt->lruTail = -1;
     mgmt->strategyData = stratData;
+    mgmt->file = fh;
+    mgmt->mapped = false;
+    mgmt->pageSize = pageSize;
+    mgmt->pageDataSize = pageDataSize;
+    mgmt->readAheadMax = 0;
+    mgmt->raWindow = 0;
+    mgmt->raLast = NO_PAGE;
+    mgmt->raNext = 0;
+    mgmt->numReadAheadIO = 0;
+    mgmt->numReadAheadHits = 0;
+    mgmt->numReadAheadWasted = 0;
     if (strategy == RS_LRU_K) {
         LRUKData *data = malloc(sizeof(LRUKData));
-        data->K = 2; // set K = 2
+        // stratData points to K, if given
+        data->K = (stratData != NULL && *(int *) stratData > 0) ? *(int *) stratData : LRU_K_DEFAULT;
 
         // initialize and allocate memory
         data->histories = malloc(sizeof(long long*) * numPages);
         data->historyCount = malloc(sizeof(int) * numPages);
+        data->heap = malloc(sizeof(int) * numPages);
+        data->heapPos = malloc(sizeof(int) * numPages);
+        data->held = malloc(sizeof(int) * numPages);
+        data->heapSize = 0;
 
         for (int i = 0; i < numPages; i++) {
             data->histories[i] = malloc(sizeof(long long) * data->K);
@@ -109,8 +699,40 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
                 data->histories[i][j] = -1;  
             }
             data->historyCount[i] = 0;
+            data->heapPos[i] = -1;
         }
 
+        mgmt->strategyData = data;
+    } else if (strategy == RS_ARC) {
+        ARCData *data = malloc(sizeof(ARCData));
+        data->ghosts = malloc(sizeof(Frame) * 2 * (numPages > 0 ? numPages : 1));
+        data->ghostTable = malloc(sizeof(int) * buckets);
+        data->freeGhosts = malloc(sizeof(int) * 2 * (numPages > 0 ? numPages : 1));
+        data->p = 0;
+        data->numFree = 0;
+        for (int l = ARC_T1; l <= ARC_T2; l++) {
+            data->head[l] = data->tail[l] = -1;
+            data->ghostHead[l] = data->ghostTail[l] = -1;
+            data->size[l] = data->ghostSize[l] = 0;
+        }
+        for (int b = 0; b < buckets; b++) {
+            data->ghostTable[b] = -1;
+        }
+        for (int g = 2 * numPages - 1; g >= 0; g--) {
+            data->ghosts[g].pageNum = NO_PAGE;
+            data->ghosts[g].hashNext = -1;
+            data->ghosts[g].prev = -1;
+            data->ghosts[g].next = -1;
+            data->freeGhosts[data->numFree++] = g;
+        }
+        mgmt->strategyData = data;
+    } else if (strategy == RS_LFU) {
+        LFUData *data = malloc(sizeof(LFUData));
+        for (int f = 0; f <= LFU_MAX_FREQ; f++) {
+            data->head[f] = -1;
+            data->tail[f] = -1;
+        }
+        data->accesses = 0;
         mgmt->strategyData = data;
     }
 
@@ -123,6 +745,50 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
     return RC_OK;
 }
 
+RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
+                  const int numPages, ReplacementStrategy strategy,
+                  void *stratData) {
+    return initPool(bm, pageFileName, numPages, strategy, stratData, openPageFile);
+}
+
+RC initBufferPoolMapped(BM_BufferPool *const bm, const char *const pageFileName, 
+                        const int numPages, ReplacementStrategy strategy,
+                        void *stratData) {
+    /*
+      Same as initBufferPool, but in "mapped frames" mode:
+      the page file is opened with openPageFileMapped,
+      frames own no memory of their own and point straight into the mapping.
+      A miss costs no read copy and a write-back costs no write copy,
+      the kernel page cache acts as the buffer.
+    */
+    RC rc = initPool(bm, pageFileName, numPages, strategy, stratData, openPageFileMapped);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    // frames will borrow pages from the mapping
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    for (int i = 0; i < numPages; i++) {
+        freePageBuffer(mgmt->frames[i].data);
+        mgmt->frames[i].data = NULL;
+    }
+    mgmt->mapped = true;
+
+    return RC_OK;
+}
+
+RC initBufferPoolDirect(BM_BufferPool *const bm, const char *const pageFileName, 
+                        const int numPages, ReplacementStrategy strategy,
+                        void *stratData) {
+    /*
+      Same as initBufferPool, but the page file is opened with O_DIRECT for every
+      read and write-back. Frames are page aligned, so transfers go straight
+      between the frames and the device and the page is cached only once, in the
+      pool, instead of in the pool and the kernel page cache.
+    */
+    return initPool(bm, pageFileName, numPages, strategy, stratData, openPageFileDirect);
+}
+
 // Shut down a buffer pool and free all resources
 RC shutdownBufferPool(BM_BufferPool *const bm) {
     /*
@@ -130,28 +796,68 @@ RC shutdownBufferPool(BM_BufferPool *const bm) {
       Write all dirty pages back to disk
       Release all memory
       Clean up BM_BufferPool
+      A failed write-back or final sync is returned, the pool is released anyway
     */
 
+    // check whether it is initialized
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT; 
+    }
+
     // get the management data structure 
     PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
 
-    //  flush all dirty pages back to disk 
-    SM_FileHandle fh;
-    RC rc = openPageFile(bm->pageFile, &fh); 
-    if (rc != RC_OK) {
-        return rc;
-    }
+    // no read may still be filling a frame that is about to be freed
+    reapReads(bm, mgmt, true);
 
+    //  flush all dirty pages back to disk 
+    SM_FileHandle *fh = acquirePoolFile(bm);
+
+    // write the dirty pages back to the page file, all in one writeBlockList call
+    // (a doublewrite file then takes them as one batch, not one sync per page);
+    // the pool goes away either way, the first failure is what it returns
+    RC rc = RC_OK;
+    PageNumber *pageNums = (PageNumber *) malloc(sizeof(PageNumber) * bm->numPages);
+    SM_PageHandle *pages = (SM_PageHandle *) malloc(sizeof(SM_PageHandle) * bm->numPages);
+    int *frameIdx = (int *) malloc(sizeof(int) * bm->numPages);
+    bool batch = pageNums != NULL && pages != NULL && frameIdx != NULL;
+    int count = 0;
     for (int i = 0; i < bm->numPages; i++) {
         if (mgmt->frames[i].dirty == true) {
-            // write the dirty page back to the page file
-            writeBlock(mgmt->frames[i].pageNum, &fh, mgmt->frames[i].data);
-            mgmt->numWriteIO++;
-            mgmt->frames[i].dirty = false; 
+            if (!batch) {
+                if (writeBlock(mgmt->frames[i].pageNum, fh, mgmt->frames[i].data) != RC_OK) {
+                    if (rc == RC_OK) rc = RC_WRITE_FAILED;
+                    continue;
+                }
+                mgmt->numWriteIO++;
+                mgmt->frames[i].dirty = false;
+            } else {
+                pageNums[count] = mgmt->frames[i].pageNum;
+                pages[count] = mgmt->frames[i].data;
+                frameIdx[count] = i;
+                count++;
+            }
+        }
+    }
+    if (count > 0) {
+        if (writeBlockList(pageNums, count, fh, pages) == RC_OK) {
+            for (int i = 0; i < count; i++) {
+                mgmt->numWriteIO++;
+                mgmt->frames[frameIdx[i]].dirty = false;
+            }
+        } else if (rc == RC_OK) {
+            rc = RC_WRITE_FAILED;
         }
     }
+    free(pageNums);
+    free(pages);
+    free(frameIdx);
 
-    closePageFile(&fh);
+    RC closed = closePageFile(fh);      // may sync, depending on the policy
+    if (rc == RC_OK) {
+        rc = closed;
+    }
+    releasePoolFile(bm);
     
     // if the strategy is LRU_K and pointer strategyData isn't null, free the struct LRUKData
     if (bm->strategy == RS_LRU_K && mgmt->strategyData != NULL) {
@@ -161,14 +867,32 @@ RC shutdownBufferPool(BM_BufferPool *const bm) {
         }
         free(data->histories);
         free(data->historyCount);
+        free(data->heap);
+        free(data->heapPos);
+        free(data->held);
+        free(data);
+    } else if (bm->strategy == RS_ARC) {
+        ARCData *data = (ARCData *) mgmt->strategyData;
+        free(data->ghosts);
+        free(data->ghostTable);
+        free(data->freeGhosts);
         free(data);
+    } else if (bm->strategy == RS_LFU) {
+        free(mgmt->strategyData);
     }
 
     //  free all allocated memory
-    for (int i = 0; i < bm->numPages; i++) {
-        free(mgmt->frames[i].data);  // relese the data in the  frame
+    // (mapped frames borrowed their pages from the mapping, closing the file released them)
+    free(fh);
+    if (!mgmt->mapped) {
+        for (int i = 0; i < bm->numPages; i++) {
+            freePageBuffer(mgmt->frames[i].data);  // relese the data in the  frame
+        }
     }
     free(mgmt->frames);   // release frames 
+    free(mgmt->pageTable);
+    free(mgmt->spareFrames);
+    free(mgmt->loadingFrames);
     free(mgmt);           // release the management data
 
     //  clean up the buffer pool struct 
@@ -177,14 +901,16 @@ RC shutdownBufferPool(BM_BufferPool *const bm) {
     bm->numPages = 0;
     bm->strategy = 0;
 
-    return RC_OK;
+    return rc;
 }
 
 RC forceFlushPool(BM_BufferPool *const bm) {
     /*
       look through all frames in the buffer pool
       for every frame that is dirty and not pinned (fixCount == 0),
-      writes the page back to disk, increments the write I/O counter and resets the dirty flag
+      writes the page back to disk, increments the write I/O counter and resets the dirty flag.
+      All such pages go out in one writeBlockList call, so every run of
+      consecutive page numbers costs a single pwritev.
     */
 
     // check whether it is initialized
@@ -193,40 +919,53 @@ RC forceFlushPool(BM_BufferPool *const bm) {
     }
     // get the management structure
     PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    reapReads(bm, mgmt, true);      // read-ahead in flight finishes first
+
+    PageNumber *pageNums = (PageNumber *) malloc(sizeof(PageNumber) * bm->numPages);
+    SM_PageHandle *pages = (SM_PageHandle *) malloc(sizeof(SM_PageHandle) * bm->numPages);
+    int *frameIdx = (int *) malloc(sizeof(int) * bm->numPages);
+    if (pageNums == NULL || pages == NULL || frameIdx == NULL) {
+        free(pageNums);
+        free(pages);
+        free(frameIdx);
+        return RC_WRITE_FAILED;
+    }
 
-    // for loop all the frame
+    // for loop all the frame, collect the dirty and unpinned ones
+    int count = 0;
     for (int i = 0; i < bm->numPages; i++) {
         Frame *frame = &mgmt->frames[i];
+        if (frame->pageNum != NO_PAGE && frame->dirty && frame->fixCount == 0) {
+            pageNums[count] = frame->pageNum;
+            pages[count] = frame->data;
+            frameIdx[count] = i;
+            count++;
+        }
+    }
 
-        if (frame->pageNum != NO_PAGE){
-            // for the dirty and unpinned frame
-            if ( frame->dirty && frame->fixCount == 0) {
-                
-                // wirte back using writeBlock
-                //RC rc = writeBlock(frame->pageNum, (SM_FileHandle *) bm->mgmtData, frame->data);
-                SM_FileHandle fh;
-                RC rc = openPageFile(bm->pageFile, &fh);
-                if (rc != RC_OK) {
-                    return rc;
-                }                
-                rc = writeBlock(frame->pageNum, &fh, frame->data);
-                closePageFile(&fh);
-
-                if (rc != RC_OK) {
-                    return RC_WRITE_FAILED; 
-                }
-
-                // update I/O counter 
-                mgmt->numWriteIO++;
-
-                // clear the dirty flag
-                frame->dirty = false;
-            }
+    RC rc = RC_OK;
+    if (count > 0) {
+        // wirte back in one batch
+        SM_FileHandle *fh = acquirePoolFile(bm);
+        rc = writeBlockList(pageNums, count, fh, pages);
+        releasePoolFile(bm);
+        if (rc != RC_OK) {
+            rc = RC_WRITE_FAILED;
         }
+    }
 
+    if (rc == RC_OK) {
+        for (int i = 0; i < count; i++) {
+            // update I/O counter and clear the dirty flag
+            mgmt->numWriteIO++;
+            mgmt->frames[frameIdx[i]].dirty = false;
+        }
     }
 
-    return RC_OK;
+    free(pageNums);
+    free(pages);
+    free(frameIdx);
+    return rc;
 }
 
 /*Page Access*/
@@ -237,15 +976,10 @@ RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page) {
     // get the management structure
     PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
 
-    // total number of frame
-    int i = bm->numPages - 1;
-
-    while (i >= 0) {
-        if (mgmt->frames[i].pageNum == page->pageNum) {
-            mgmt->frames[i].dirty = true;   // found the target page then mark it as dirty
-            return RC_OK;
-        }
-        i--;  
+    int i = handleFrame(bm, mgmt, page);
+    if (i >= 0) {
+        mgmt->frames[i].dirty = true;   // found the target page then mark it as dirty
+        return RC_OK;
     }
 
     // did not find return error
@@ -266,19 +1000,10 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page) {
     // get the management structure
     PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
     
-    // total number of frame
-    int i = bm->numPages - 1;
-    
-    while (i >= 0) {
-        if (mgmt->frames[i].pageNum == page->pageNum) {
-            if (mgmt->frames[i].fixCount > 0) {
-                //printf("Unpin page %d at frame %d, fixCount before: %d\n", page->pageNum, i, mgmt->frames[i].fixCount);
-                mgmt->frames[i].fixCount--;
-                //printf("Unpin page %d at frame %d, fixCount after: %d\n", page->pageNum, i, mgmt->frames[i].fixCount);
-                return RC_OK;
-            }
-        }
-        i--;
+    int i = handleFrame(bm, mgmt, page);
+    if (i >= 0 && mgmt->frames[i].fixCount > 0) {
+        mgmt->frames[i].fixCount--;
+        return RC_OK;
     }
 
     return RC_READ_NON_EXISTING_PAGE;
@@ -291,24 +1016,19 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page) {
     */
 
     PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
-    SM_FileHandle fh;
-    RC rc = openPageFile(bm->pageFile, &fh);
-    if (rc != RC_OK) return rc;
-
-    int i = bm->numPages - 1;
-    while (i >= 0) {
-        if (mgmt->frames[i].pageNum == page->pageNum) {
-            // write back to the disk
-            writeBlock(page->pageNum, &fh, mgmt->frames[i].data);
-            mgmt->numWriteIO++;
-            mgmt->frames[i].dirty = false;
-            closePageFile(&fh);
-            return RC_OK;
-        }
-        i--;
+    SM_FileHandle *fh = acquirePoolFile(bm);
+
+    int i = handleFrame(bm, mgmt, page);
+    if (i >= 0) {
+        // write back to the disk
+        writeBlock(page->pageNum, fh, mgmt->frames[i].data);
+        mgmt->numWriteIO++;
+        mgmt->frames[i].dirty = false;
+        releasePoolFile(bm);
+        return RC_OK;
     }
 
-    closePageFile(&fh);
+    releasePoolFile(bm);
     return RC_READ_NON_EXISTING_PAGE; 
 }
 
@@ -322,7 +1042,7 @@ static void printHistories(BM_BufferPool *const bm) {
 
     printf("\n=== Histories Snapshot ===\n");
     for (int i = 0; i < bm->numPages; i++) {
-        printf("Frame %d (page %d): ", i, mgmt->frames[i].pageNum);
+        printf("Frame %d (page %lld): ", i, mgmt->frames[i].pageNum);
         for (int j = 0; j < K; j++) {
             printf("%lld ", data->histories[i][j]);
         }
@@ -333,71 +1053,25 @@ static void printHistories(BM_BufferPool *const bm) {
 */
 
 
-// Pin a page into the buffer pool
-RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
-            const PageNumber pageNum) {
-                
-    // check whether it is initialized                
-    if (bm == NULL || bm->mgmtData == NULL) {
-        return RC_BUFFER_POOL_NOT_INIT;
-    }
-
-    if (pageNum < 0) { // check pageNum
-        return RC_READ_NON_EXISTING_PAGE; 
-    }
-    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
-
-    //if page is already in buffer
-    int i = bm->numPages - 1;   
-    while (i >= 0) {
-        if (mgmt->frames[i].pageNum == pageNum) {
-            mgmt->frames[i].fixCount++;
-            page->pageNum = pageNum;
-            page->data = mgmt->frames[i].data;
-            
-            if (bm->strategy == RS_LRU) { // LRU strategy, count and see the time node of the call
-                mgmt->frames[i].ref = globalLRUCounter++;
-            }
-            else if (bm->strategy == RS_CLOCK) { // CLOCK strategy, when a page is pinned, the ref should always be 1
-                mgmt->frames[i].refBit = 1; // Set reference bit
-            }
-            else if (bm->strategy == RS_LFU) { // Least frequently used strategy
-                mgmt->frames[i].ref++; // each time a page is found in the buffer, its frequency count is incremented by 1.
-            }                
-            else if (bm->strategy == RS_LRU_K) {
-                LRUKData *data = (LRUKData *)mgmt->strategyData;
-                int K = data->K;
-                int idx = i; 
-                globalLRUCounter++;
-
-                if (data->historyCount[idx] < K) {
-                    // not filled yet, add more directly
-                    data->histories[idx][data->historyCount[idx]] = globalLRUCounter;
-                    data->historyCount[idx]++;
-                } else {
-                    // alreday filled, left shift
-                    for (int j = 0; j < K - 1; j++) {
-                        data->histories[idx][j] = data->histories[idx][j + 1];
-                    }
-                    data->histories[idx][K - 1] = globalLRUCounter;
-                }
+/*
+    Pick the frame that receives a page which is not in the pool yet:
+    an empty frame if there is one, otherwise the victim of the pool's
+    replacement strategy. Pinned frames (fixCount > 0) and ring frames
+    are never chosen. pageNum is the page the frame is for.
+*/
+static RC chooseVictim (BM_BufferPool *const bm, PoolMgmtData *mgmt, PageNumber pageNum, int *victimOut) {
+    int victim = -1;
 
-                //printHistories(bm);
-            }
-            return RC_OK;
-        }
-        i--; 
+    // ARC learns from every miss, whether or not it costs an eviction
+    int ghostList = -1;
+    if (bm->strategy == RS_ARC) {
+        ghostList = arcAdapt(bm, mgmt, (ARCData *) mgmt->strategyData, pageNum);
     }
 
-    // if page not in buffer, choose a victim frame
-    int victim = -1;
-
-    // prioritize finding empty frames
-    for (int j = 0; j < bm->numPages; j++) {
-        if (mgmt->frames[j].pageNum == NO_PAGE) {
-            victim = j;
-            break;
-        }
+    // prioritize empty frames; they stay empty (and off the spare stack) until a page is set
+    if (mgmt->numSpare > 0) {
+        victim = mgmt->spareFrames[--mgmt->numSpare];
+        mgmt->frames[victim].spare = false;
     }
 
     if (victim == -1) {
@@ -407,7 +1081,8 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
                 RS_LRU = 1,
                 RS_CLOCK = 2,
                 RS_LFU = 3,
-                RS_LRU_K = 4  
+                RS_LRU_K = 4,
+                RS_ARC = 5
             */
             case RS_FIFO: {
                 int start = mgmt->nextVictim;
@@ -417,7 +1092,7 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
                 for (int j = 0; j < bm->numPages; j++) {
                     int idx = (start + j) % bm->numPages;
 
-                    if (mgmt->frames[idx].fixCount == 0) {
+                    if (mgmt->frames[idx].fixCount == 0 && mgmt->frames[idx].ring == NULL) {
                         victim = idx;
                         mgmt->nextVictim = (idx + 1) % bm->numPages; // update next victim pointer
                         found = 1;
@@ -432,31 +1107,26 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
             }
 
 
-            case RS_LRU:{
-
-                int victimIndex = -1;
-                int minRef = __INT_MAX__;
-
-                int i = 0;
-                while (i < bm->numPages) {
-                    if (mgmt->frames[i].fixCount == 0) { // if the page is pinned, we can't repalce it 
-                        if (mgmt->frames[i].ref < minRef) { // find the least resntly used
-                            minRef = mgmt->frames[i].ref;
-                            victimIndex = i;
-                        }
-                    }
-                    i++;
+            case RS_LRU: {
+                // the least recently used frame that is not pinned
+                int i = mgmt->lruHead;
+                while (i >= 0 && mgmt->frames[i].fixCount > 0) {
+                    i = mgmt->frames[i].next;
                 }
-
-                if (victimIndex == -1) {
+                if (i < 0) {
                     return RC_PINNED_PAGES_IN_BUFFER;  // failed to find 
                 }
-                victim = victimIndex;
+                victim = i;
                 break;
             }
 
             case RS_CLOCK: {
+                // two full sweeps clear every refBit, so more than that means all frames are pinned
+                int steps = 0;
                 while (true) {
+                    if (steps++ > 2 * bm->numPages) {
+                        return RC_PINNED_PAGES_IN_BUFFER;
+                    }
                     /*
                     If the page is pinned, skip it.
                     If refBit == 1, clear it to zero which means the second chance.
@@ -464,7 +1134,7 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
                     */
                     Frame *candidate = &mgmt->frames[mgmt->clockHand]; // is the frame pointed to by the current pointer
 
-                    if (candidate->fixCount == 0) {
+                    if (candidate->fixCount == 0 && candidate->ring == NULL) {
                         if (candidate->refBit == 0) {
                             victim = mgmt->clockHand;
                             mgmt->clockHand = (mgmt->clockHand + 1) % bm->numPages;
@@ -480,137 +1150,667 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
             }
 
             case RS_LFU: {
-                int victimIndex = -1; // this will be the index of the victim when finish
-                int minRef = __INT_MAX__; // Initialize the frequency count of the least frequently used frame with INT_MAX
-            
-                // to select a victim that has least frequent accessing
-                for (int i = 0; i < bm->numPages; i++) {
-                    if (mgmt->frames[i].fixCount == 0) {  // victim must be unpinned frames
-                        if (mgmt->frames[i].ref < minRef) {
-                            minRef = mgmt->frames[i].ref;
-                            victimIndex = i; // i is the index of the chosen victim frame
+                // the unpinned frame with the fewest accesses, the least recently counted of those
+                LFUData *data = (LFUData *) mgmt->strategyData;
+                for (int f = 1; f <= LFU_MAX_FREQ && victim == -1; f++) {
+                    for (int i = data->head[f]; i >= 0; i = mgmt->frames[i].next) {
+                        if (mgmt->frames[i].fixCount == 0) {
+                            victim = i;
+                            break;
                         }
                     }
                 }
-            
-                if (victimIndex == -1) {  // if victimIndex is -1, all the frames pinned. Victim actually not found.
+                if (victim == -1) {  // all the frames pinned
                     return RC_PINNED_PAGES_IN_BUFFER;
                 }
-                
-                victim = victimIndex;
                 break;
             }
 
             case RS_LRU_K: {
+                // pinned frames come off the top of the heap until an unpinned one is there,
+                // then go back on
                 LRUKData *data = (LRUKData *)mgmt->strategyData;
-                int K = data->K;
-
-                int victimIndex = -1;
-                long long oldestKth = LLONG_MAX;
-
-                // to select a victim that has at least K access histories
-                for (int i = 0; i < bm->numPages; i++) {
-                    if (mgmt->frames[i].fixCount == 0) { // only consider unpinned frames
-                        if (data->historyCount[i] >= K) {
-                            // use the oldest one among last K accesses
-                            long long kth = data->histories[i][K - 1];
-                            if (kth < oldestKth) {
-                                oldestKth = kth;
-                                victimIndex = i;
-                            }
-                        }
-                    }
+                int numHeld = 0;
+                while (data->heapSize > 0 && mgmt->frames[data->heap[0]].fixCount > 0) {
+                    data->held[numHeld++] = data->heap[0];
+                    heapRemove(data, data->heap[0]);
                 }
-
-                // if no frame has >= K accesses, use the most recent access
-                if (victimIndex == -1) {
-                    for (int i = 0; i < bm->numPages; i++) {
-                        if (mgmt->frames[i].fixCount == 0 && data->historyCount[i] > 0) {
-                            long long last = data->histories[i][data->historyCount[i] - 1];
-                            if (last < oldestKth) {
-                                oldestKth = last;
-                                victimIndex = i;
-                            }
-                        }
-                    }
+                if (data->heapSize > 0) {
+                    victim = data->heap[0];
+                }
+                while (numHeld > 0) {
+                    heapInsert(data, data->held[--numHeld]);
                 }
 
                 // if still no victim found, it means all frames are pinned
-                if (victimIndex == -1) {
+                if (victim == -1) {
                     return RC_PINNED_PAGES_IN_BUFFER;
                 }
-
-                victim = victimIndex;
                 break;
             }
             
+            case RS_ARC: {
+                victim = arcVictim(mgmt, (ARCData *) mgmt->strategyData, ghostList);
+                if (victim == -1) {
+                    return RC_PINNED_PAGES_IN_BUFFER;
+                }
+                break;
+            }
+
             default:
                 return RC_WRITE_FAILED;  // the strategy is not involved
         }
     }
+
+    *victimOut = victim;
+    return RC_OK;
+}
+
+/*
+    The frame for a page missed through ring (NULL for none): once the ring
+    has all its frames, the next unpinned one of them; otherwise, or when
+    they are all pinned, chooseVictim's. Frames of rings are only taken from
+    them when every other frame is pinned.
+*/
+static RC takeFrame (BM_BufferPool *const bm, PoolMgmtData *mgmt, PageNumber pageNum,
+                     BM_Ring *ring, int *victimOut) {
+    if (ring != NULL) {
+        for (int n = 0; n < ring->size; n++) {
+            int idx = ring->frames[ring->hand];
+            if (idx < 0) {
+                break;      // not full yet
+            }
+            ring->hand = (ring->hand + 1) % ring->size;
+            if (mgmt->frames[idx].fixCount == 0) {
+                *victimOut = idx;
+                return RC_OK;
+            }
+        }
+    }
+
+    RC rc = chooseVictim(bm, mgmt, pageNum, victimOut);
+    if (rc == RC_PINNED_PAGES_IN_BUFFER) {
+        for (int i = 0; i < bm->numPages; i++) {
+            if (mgmt->frames[i].ring != NULL && mgmt->frames[i].fixCount == 0) {
+                *victimOut = i;
+                return RC_OK;
+            }
+        }
+    }
+    return rc;
+}
+
+/*
+    Bookkeeping for a page that was just loaded into frame idx:
+    reset the frame and seed the replacement strategy's metadata.
+    A page loaded through ring stays in the ring, outside that order.
+*/
+static void admitPage (BM_BufferPool *const bm, PoolMgmtData *mgmt, int idx,
+                       PageNumber pageNum, int fixCount, BM_Ring *ring) {
+    if (mgmt->frames[idx].readAhead) {
+        mgmt->numReadAheadWasted++;     // replaced before anybody asked for it
+        mgmt->frames[idx].readAhead = false;
+    }
+    setFramePage(bm, mgmt, idx, pageNum);
+    mgmt->frames[idx].dirty = false;
+    mgmt->frames[idx].fixCount = fixCount;
+    if (bm->strategy == RS_CLOCK) { // CLOCK strategy
+        mgmt->frames[idx].refBit = 0;
+    }
+    if (pageNum != NO_PAGE && mgmt->frames[idx].ring != ring) {
+        ringRelease(mgmt, idx);     // a ring frame taken for another ring or a regular page
+        if (ring != NULL) {
+            ringAttach(mgmt, ring, idx);
+        }
+    }
+    if (pageNum != NO_PAGE && mgmt->frames[idx].ring == NULL) {
+        linkFrame(bm, mgmt, idx);   // LRU, LFU, LRU-K and ARC: first access to the new page
+    }
+}
+
+static RC loadPages (BM_BufferPool *const bm, const PageNumber startPage, const int count,
+                     bool speculative, BM_Ring *ring);
+
+/*
+    Read-ahead (setPoolReadAhead). Every pinPage feeds the pool's access
+    pattern: pinning the page after the previous one (or skipping ahead
+    inside the window already loaded) makes the access sequential, pinning
+    the same page again changes nothing, anything else ends the sequence.
+    Two sequential pins load the next SM_READAHEAD_MIN_PAGES pages, unpinned,
+    with one batch of asynchronous reads (loadPages) that the pin does not
+    wait for (see finishRead); when the reader enters the last window
+    loaded, the next window is loaded, twice as large, up to readAheadMax
+    and never more than numPages - 1 frames.
+    Read-ahead failures are ignored, pinPage reads the page itself then.
+    A scan through a ring reads ahead into the ring, one window short of it.
+*/
+static void readAhead (BM_BufferPool *const bm, PoolMgmtData *mgmt, PageNumber pageNum, BM_Ring *ring) {
+    PageNumber last = mgmt->raLast;
+    mgmt->raLast = pageNum;
+    if (mgmt->readAheadMax == 0 || mgmt->mapped || pageNum == last) {
+        return;
+    }
+    if (last == NO_PAGE || (pageNum != last + 1 && !(mgmt->raWindow > 0 && pageNum > last && pageNum < mgmt->raNext))) {
+        mgmt->raWindow = 0;
+        return;
+    }
+    if (mgmt->raWindow > 0 && pageNum < mgmt->raNext - mgmt->raWindow) {
+        return;     // still short of the last window
+    }
+
+    int window = mgmt->raWindow == 0 ? SM_READAHEAD_MIN_PAGES : 2 * mgmt->raWindow;
+    if (window > mgmt->readAheadMax) window = mgmt->readAheadMax;
+    if (window > bm->numPages - 1) window = bm->numPages - 1;
+    if (ring != NULL && window > ring->size - 1) window = ring->size - 1;
+    if (window <= 0) {
+        return;
+    }
+    PageNumber start = mgmt->raNext > pageNum ? mgmt->raNext : pageNum + 1;
+    loadPages(bm, start, window, true, ring);
+    mgmt->raWindow = window;
+    mgmt->raNext = start + window;
+}
+
+/* pinPage and pinPageRing; ring is NULL for pinPage */
+static RC pinFrame (BM_BufferPool *const bm, BM_PageHandle *const page,
+                    const PageNumber pageNum, BM_Ring *ring) {
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+
+    //if page is already in buffer
+    int i = lookupFrame(mgmt, pageNum);
+    if (i >= 0 && mgmt->frames[i].loading) {
+        // read-ahead is still reading it: wait for that read, not the whole window
+        finishRead(bm, mgmt, i, true);
+        i = lookupFrame(mgmt, pageNum);     // gone if the read failed
+    }
+    if (i >= 0) {
+        mgmt->frames[i].fixCount++;
+        page->pageNum = pageNum;
+        page->data = mgmt->frames[i].data;
+        page->frame = i;
+        if (mgmt->frames[i].readAhead) {
+            mgmt->frames[i].readAhead = false;
+            mgmt->numReadAheadHits++;
+        }
+        
+        if (mgmt->frames[i].ring == NULL) {
+            if (ring == NULL) {
+                touchFrame(bm, mgmt, i);    // bulk accesses do not count as uses
+            }
+        } else if (ring == NULL) {
+            // wanted outside the bulk operation: a regular page from now on
+            ringRelease(mgmt, i);
+            linkFrame(bm, mgmt, i);
+        }
+        readAhead(bm, mgmt, pageNum, ring);
+        return RC_OK;
+    }
+
+    // if page not in buffer, choose a victim frame; frames whose read-ahead
+    // is done can be victims again, and if nothing else is free, wait for the rest
+    reapReads(bm, mgmt, false);
+    int victim = -1;
+    RC victimRc = takeFrame(bm, mgmt, pageNum, ring, &victim);
+    if (victimRc == RC_PINNED_PAGES_IN_BUFFER && mgmt->numLoading > 0) {
+        reapReads(bm, mgmt, true);
+        victimRc = takeFrame(bm, mgmt, pageNum, ring, &victim);
+    }
+    if (victimRc != RC_OK) {
+        return victimRc;
+    }
+
     // dirty pages modified by users need to be written back to disk
     if (mgmt->frames[victim].dirty == true) {
-        SM_FileHandle fh;
-        openPageFile(bm->pageFile, &fh);
-        writeBlock(mgmt->frames[victim].pageNum, &fh, mgmt->frames[victim].data);
-        mgmt->numWriteIO++;
-        closePageFile(&fh);
+        SM_FileHandle *fh = acquirePoolFile(bm);
+        if (isDoublewriteEnabled(fh)) {
+            // a doublewrite file syncs once per batch: take every dirty page that can go along
+            releasePoolFile(bm);
+            forceFlushPool(bm);
+        } else {
+            writeBlock(mgmt->frames[victim].pageNum, fh, mgmt->frames[victim].data);
+            mgmt->numWriteIO++;
+            releasePoolFile(bm);
+        }
     }
 
     //  ensure file has enough pages before reading 
-    SM_FileHandle fh;
-    openPageFile(bm->pageFile, &fh);
-    if (pageNum >= fh.totalNumPages) {
-        RC rc = ensureCapacity(pageNum + 1, &fh);
+    RC rc;
+    SM_FileHandle *fh = acquirePoolFile(bm);
+    if (pageNum >= fh->totalNumPages) {
+        rc = ensureCapacity(pageNum + 1, fh);
         if (rc != RC_OK) {
-            closePageFile(&fh);
+            releasePoolFile(bm);
+            setFramePage(bm, mgmt, victim, mgmt->frames[victim].pageNum);   // an empty victim goes back to the spares
             return rc;
         }
     }
     
-    // read new page into victim frame
-    RC rc = readBlock(pageNum, &fh, mgmt->frames[victim].data);
-    closePageFile(&fh);
-    if (rc != RC_OK) return rc;
+    // read new page into victim frame; mapped frames just point at the page
+    if (mgmt->mapped) {
+        rc = getPagePtr(pageNum, fh, &mgmt->frames[victim].data);
+    } else {
+        rc = readBlock(pageNum, fh, mgmt->frames[victim].data);
+    }
+    releasePoolFile(bm);
+    if (rc != RC_OK) {
+        // a failed (e.g. checksum) read may have clobbered the frame, it no longer holds its old page
+        setFramePage(bm, mgmt, victim, NO_PAGE);
+        mgmt->frames[victim].dirty = false;
+        return rc;
+    }
 
     mgmt->numReadIO++;
-    mgmt->frames[victim].pageNum = pageNum;
-    mgmt->frames[victim].dirty = false;
-    mgmt->frames[victim].fixCount = 1;
-    if (bm->strategy == RS_LRU) { // LRU strategy, count and see the time node of the call
-        mgmt->frames[victim].ref = globalLRUCounter++;
-    }
-    else if (bm->strategy == RS_CLOCK) { // CLOCK strategy
-        mgmt->frames[victim].refBit = 0;
-    }  
-    else if (bm->strategy == RS_LFU) { // least frequently used strategy
-        mgmt->frames[victim].ref = 1; // New page starts with reference bit 1
-    }  
-    else if (bm->strategy == RS_LRU_K) {
-        LRUKData *data = (LRUKData *)mgmt->strategyData;
-        int K = data->K;
-        int idx = victim;
+    admitPage(bm, mgmt, victim, pageNum, 1, ring);
 
-        //  clear History
-        for (int j = 0; j < K; j++) {
-            data->histories[idx][j] = -1;
+    // update PageHandle
+    page->pageNum = pageNum;
+    page->data = mgmt->frames[victim].data;
+    page->frame = victim;
+
+    readAhead(bm, mgmt, pageNum, ring);
+    return RC_OK;
+}
+
+// Pin a page into the buffer pool
+RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
+            const PageNumber pageNum) {
+                
+    // check whether it is initialized                
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+
+    if (pageNum < 0) { // check pageNum
+        return RC_READ_NON_EXISTING_PAGE; 
+    }
+    return pinFrame(bm, page, pageNum, NULL);
+}
+
+/* Access Rings */
+
+RC openPoolRing (BM_BufferPool *const bm, const int size, BM_Ring **ring) {
+    /*
+      Start a bulk operation (a scan, a bulk load) that pins its pages with
+      pinPageRing. It recycles at most size frames, and never more than a
+      quarter of the pool (one frame in pools of two or three), so the
+      rest of the pool keeps its pages. Close the ring with closePoolRing
+      before the pool is shut down.
+    */
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+    int frames = size < bm->numPages / 4 ? size : bm->numPages / 4;
+    if (frames < 1) {
+        frames = size > 0 && bm->numPages > 1 ? 1 : 0;  // 0: pinPageRing is pinPage
+    }
+
+    BM_Ring *r = (BM_Ring *) malloc(sizeof(BM_Ring));
+    if (r == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    r->frames = (int *) malloc(sizeof(int) * (frames > 0 ? frames : 1));
+    if (r->frames == NULL) {
+        free(r);
+        return RC_WRITE_FAILED;
+    }
+    for (int slot = 0; slot < frames; slot++) {
+        r->frames[slot] = -1;
+    }
+    r->size = frames;
+    r->hand = 0;
+    *ring = r;
+    return RC_OK;
+}
+
+RC pinPageRing (BM_BufferPool *const bm, BM_PageHandle *const page,
+                const PageNumber pageNum, BM_Ring *ring) {
+    /*
+      pinPage for a bulk operation: a page that is not in the pool is loaded
+      into one of the ring's frames, and a page found in the pool is not
+      counted as used. Unpin it with unpinPage as usual. A NULL ring pins
+      like pinPage.
+    */
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+    if (pageNum < 0) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    return pinFrame(bm, page, pageNum, ring != NULL && ring->size > 0 ? ring : NULL);
+}
+
+RC closePoolRing (BM_BufferPool *const bm, BM_Ring *ring) {
+    /*
+      End the bulk operation: the ring's dirty pages are written back (one
+      writeBlockList) and its frames emptied, so the pool gets them back as
+      spare frames. Frames still pinned keep their pages as regular frames.
+    */
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+    if (ring == NULL) {
+        return RC_OK;
+    }
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    reapReads(bm, mgmt, true);      // ring frames may still be loading
+
+    RC rc = RC_OK;
+    PageNumber *pageNums = (PageNumber *) malloc(sizeof(PageNumber) * (ring->size > 0 ? ring->size : 1));
+    SM_PageHandle *pages = (SM_PageHandle *) malloc(sizeof(SM_PageHandle) * (ring->size > 0 ? ring->size : 1));
+    int count = 0;
+    if (pageNums == NULL || pages == NULL) {
+        rc = RC_WRITE_FAILED;
+    } else {
+        for (int slot = 0; slot < ring->size; slot++) {
+            int idx = ring->frames[slot];
+            if (idx >= 0 && mgmt->frames[idx].dirty && mgmt->frames[idx].fixCount == 0) {
+                pageNums[count] = mgmt->frames[idx].pageNum;
+                pages[count] = mgmt->frames[idx].data;
+                count++;
+            }
         }
-        data->historyCount[idx] = 0;
+        if (count > 0) {
+            SM_FileHandle *fh = acquirePoolFile(bm);
+            rc = writeBlockList(pageNums, count, fh, pages);
+            releasePoolFile(bm);
+            if (rc == RC_OK) {
+                mgmt->numWriteIO += count;
+            }
+        }
+    }
+    free(pageNums);
+    free(pages);
 
-        globalLRUCounter++;
-        // record the first visit to a new page
-        data->histories[idx][0] = globalLRUCounter;
-        data->historyCount[idx] = 1;
+    for (int slot = 0; slot < ring->size; slot++) {
+        int idx = ring->frames[slot];
+        if (idx < 0) {
+            continue;
+        }
+        Frame *frame = &mgmt->frames[idx];
+        if (frame->fixCount > 0 || (frame->dirty && rc != RC_OK)) {
+            // still in use, or not written: keep the page
+            ringRelease(mgmt, idx);
+            linkFrame(bm, mgmt, idx);
+            continue;
+        }
+        if (frame->readAhead) {
+            mgmt->numReadAheadWasted++;
+            frame->readAhead = false;
+        }
+        setFramePage(bm, mgmt, idx, NO_PAGE);
+        frame->dirty = false;
+        if (mgmt->mapped) {
+            frame->data = NULL;     // mapped frames only borrowed the page
+        }
     }
 
-  
-    // update PageHandle
-    page->pageNum = pageNum;
-    page->data = mgmt->frames[victim].data;
+    free(ring->frames);
+    free(ring);
+    return rc;
+}
+
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber startPage, const int count) {
+    /*
+      Bring pages startPage .. startPage+count-1 into the pool without pinning them.
+      Pages already in the pool are skipped; the missing ones are all submitted to
+      the async engine at once (submitReadBlock) so the reads are in flight together,
+      and dirty victims are written back with a single writeBlockList call first.
+      Read-ahead (setPoolReadAhead) loads its windows the same way, without the wait.
+      The batch stops early when the pool runs out of unpinned frames, and it never
+      reads past the end of the file. Mapped pools leave read-ahead to the kernel.
+    */
+    return loadPages(bm, startPage, count, false, NULL);
+}
+
+/*
+    prefetchPages; speculative pages are read-ahead: they are counted and
+    marked as such, and their reads are left in flight (finishRead).
+    Pages are loaded into ring's frames if it is not NULL.
+*/
+static RC loadPages (BM_BufferPool *const bm, const PageNumber startPage, const int count,
+                     bool speculative, BM_Ring *ring) {
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    if (count <= 0 || startPage < 0 || mgmt->mapped) {
+        return RC_OK;
+    }
+
+    RC rc = RC_OK;
+    SM_FileHandle *fh = acquirePoolFile(bm);
+
+    PageNumber end = startPage + count;
+    if (end > fh->totalNumPages) {
+        end = fh->totalNumPages;
+    }
 
+    int numRead = 0;
+    int numDirty = 0;
+    PageNumber *readNums = (PageNumber *) malloc(sizeof(PageNumber) * bm->numPages);
+    SM_PageHandle *readPages = (SM_PageHandle *) malloc(sizeof(SM_PageHandle) * bm->numPages);
+    int *readFrames = (int *) malloc(sizeof(int) * bm->numPages);
+    SM_AsyncRequest *reads = (SM_AsyncRequest *) malloc(sizeof(SM_AsyncRequest) * bm->numPages);
+    PageNumber *dirtyNums = (PageNumber *) malloc(sizeof(PageNumber) * bm->numPages);
+    SM_PageHandle *dirtyPages = (SM_PageHandle *) malloc(sizeof(SM_PageHandle) * bm->numPages);
+    if (readNums == NULL || readPages == NULL || readFrames == NULL || reads == NULL ||
+        dirtyNums == NULL || dirtyPages == NULL) {
+        rc = RC_WRITE_FAILED;
+        goto finally;
+    }
+
+    // read-ahead pages nobody used yet are older than the pages consumed since,
+    // so a new window would evict them first; hold them like pinned frames
+    if (speculative) {
+        for (int i = 0; i < bm->numPages; i++) {
+            if (mgmt->frames[i].readAhead) mgmt->frames[i].fixCount++;
+        }
+    }
+
+    // pick one frame per missing page; chosen frames are pinned for the moment
+    // so the next pick cannot land on them again
+    for (PageNumber p = startPage; p < end; p++) {
+        if (lookupFrame(mgmt, p) >= 0) continue;     // resident
+
+        int victim;
+        if (takeFrame(bm, mgmt, p, ring, &victim) != RC_OK) {
+            break;      // every remaining frame is pinned
+        }
+        Frame *frame = &mgmt->frames[victim];
+        if (frame->dirty) {
+            dirtyNums[numDirty] = frame->pageNum;
+            dirtyPages[numDirty] = frame->data;
+            numDirty++;
+        }
+        frame->fixCount = 1;
+        readNums[numRead] = p;
+        readPages[numRead] = frame->data;
+        readFrames[numRead] = victim;
+        numRead++;
+    }
+
+    if (speculative) {
+        for (int i = 0; i < bm->numPages; i++) {
+            if (mgmt->frames[i].readAhead) mgmt->frames[i].fixCount--;
+        }
+    }
+
+    // dirty victims go back to disk before their frames are reused
+    if (numDirty > 0) {
+        rc = writeBlockList(dirtyNums, numDirty, fh, dirtyPages);
+        if (rc != RC_OK) {
+            // nothing was replaced yet: unpin the chosen frames, they keep their (dirty) pages
+            for (int i = 0; i < numRead; i++) {
+                mgmt->frames[readFrames[i]].fixCount = 0;
+                setFramePage(bm, mgmt, readFrames[i], mgmt->frames[readFrames[i]].pageNum);
+            }
+            goto finally;
+        }
+        mgmt->numWriteIO += numDirty;
+    }
+
+    // put every read in flight before waiting for any of them; read-ahead
+    // reads go into the frames' own requests and are not waited for here
+    int numSubmitted = 0;
+    for (int i = 0; i < numRead && rc == RC_OK; i++) {
+        SM_AsyncRequest *req = speculative ? &mgmt->frames[readFrames[i]].io : &reads[i];
+        rc = submitReadBlock(readNums[i], fh, readPages[i], req);
+        if (rc == RC_OK) numSubmitted++;
+    }
+    if (speculative) {
+        for (int i = 0; i < numRead; i++) {
+            if (i < numSubmitted) {
+                // in the page table at once, held until finishRead collects the read
+                admitPage(bm, mgmt, readFrames[i], readNums[i], 1, ring);
+                mgmt->frames[readFrames[i]].readAhead = true;
+                mgmt->frames[readFrames[i]].loading = true;
+                mgmt->loadingFrames[mgmt->numLoading++] = readFrames[i];
+                mgmt->numReadIO++;
+                mgmt->numReadAheadIO++;
+            } else {
+                admitPage(bm, mgmt, readFrames[i], NO_PAGE, 0, ring);
+            }
+        }
+        goto finally;
+    }
+    RC waitRc = waitAllAsyncIO(reads, numSubmitted);
+
+    for (int i = 0; i < numRead; i++) {
+        if (i < numSubmitted && reads[i].rc == RC_OK) {
+            mgmt->numReadIO++;
+            admitPage(bm, mgmt, readFrames[i], readNums[i], 0, ring);
+        } else {
+            // give the frame back empty rather than with half-loaded content
+            admitPage(bm, mgmt, readFrames[i], NO_PAGE, 0, ring);
+        }
+    }
+    if (rc == RC_OK) {
+        rc = waitRc;
+    }
+
+finally:
+    releasePoolFile(bm);
+    free(readNums);
+    free(readPages);
+    free(readFrames);
+    free(reads);
+    free(dirtyNums);
+    free(dirtyPages);
+    return rc;
+}
+
+/* Page Allocation */
+
+/*
+    Drop the pool's copy of a page without writing it back.
+    Used when the page is freed or handed out fresh, so a stale frame can
+    neither be returned by pinPage nor overwrite the page on disk later.
+*/
+static RC discardPage (BM_BufferPool *const bm, PoolMgmtData *mgmt, PageNumber pageNum) {
+    int i = lookupFrame(mgmt, pageNum);
+    if (i >= 0) {
+        finishRead(bm, mgmt, i, true);
+    }
+    i = lookupFrame(mgmt, pageNum);
+    if (i >= 0) {
+        Frame *frame = &mgmt->frames[i];
+        if (frame->fixCount > 0) {
+            return RC_PINNED_PAGES_IN_BUFFER;
+        }
+        setFramePage(bm, mgmt, i, NO_PAGE);
+        frame->dirty = false;
+        frame->readAhead = false;
+        if (mgmt->mapped) {
+            frame->data = NULL;     // mapped frames only borrowed the page
+        }
+    }
     return RC_OK;
 }
 
+RC allocPoolPage (BM_BufferPool *const bm, PageNumber *pageNum) {
+    /*
+      Get a zero-filled page for new content: a page freed with freePoolPage
+      if there is one, otherwise a new page at the end of the file.
+      The page is not pinned; pin it to fill it.
+    */
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+
+    SM_FileHandle *fh = acquirePoolFile(bm);
+    PageNumber newPage;
+    RC rc = allocatePage(fh, &newPage);
+    releasePoolFile(bm);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    discardPage(bm, mgmt, newPage);
+    *pageNum = newPage;
+    return RC_OK;
+}
+
+RC freePoolPage (BM_BufferPool *const bm, const PageNumber pageNum) {
+    /*
+      Release a page the caller no longer needs. Its frame is dropped (dirty
+      content included) and the page goes on the page file's free list.
+      Fails while the page is pinned.
+    */
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+
+    RC rc = discardPage(bm, mgmt, pageNum);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    SM_FileHandle *fh = acquirePoolFile(bm);
+    rc = deallocatePage(pageNum, fh);
+    releasePoolFile(bm);
+    return rc;
+}
+
+bool isPoolPageFree (BM_BufferPool *const bm, const PageNumber pageNum) {
+    // true if the page is on the free list, i.e. holds no data of its owner
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return false;
+    }
+    SM_FileHandle *fh = acquirePoolFile(bm);
+    bool isFree = isPageFree(pageNum, fh);
+    releasePoolFile(bm);
+    return isFree;
+}
+
+PageNumber getPoolFileSize (BM_BufferPool *const bm) {
+    // number of pages in the pool's page file, free ones included
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return -1;
+    }
+    SM_FileHandle *fh = acquirePoolFile(bm);
+    PageNumber pages = fh->totalNumPages;
+    releasePoolFile(bm);
+    return pages;
+}
+
+int getPoolPageSize (BM_BufferPool *const bm) {
+    // bytes per page (and per frame) of the pool's page file
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return -1;
+    }
+    return ((PoolMgmtData *) bm->mgmtData)->pageSize;
+}
+
+int getPoolPageDataSize (BM_BufferPool *const bm) {
+    // bytes per page the pool's users may fill (see getPageDataSize)
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return -1;
+    }
+    return ((PoolMgmtData *) bm->mgmtData)->pageDataSize;
+}
+
 /* Buffer Manager Interface - Statistics*/
 
 
@@ -658,7 +1858,8 @@ int *getFixCounts (BM_BufferPool *const bm) {
     int *fixCounts = (int *) malloc(sizeof(int) * bm->numPages);
 
     for (int i = 0; i < bm->numPages; i++) {
-        fixCounts[i] = mgmt->frames[i].fixCount; 
+        // a read-ahead read's own hold is no client's pin
+        fixCounts[i] = mgmt->frames[i].fixCount - (mgmt->frames[i].loading ? 1 : 0);
     }
 
     return fixCounts;
@@ -675,3 +1876,42 @@ int getNumWriteIO (BM_BufferPool *const bm) {
     PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
     return mgmt->numWriteIO;
 }
+
+int getNumSyncIO (BM_BufferPool *const bm) {
+    // fdatasync calls issued for this pool's writes (see setSyncPolicy)
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    return mgmt->numSyncIO;
+}
+
+RC setPoolReadAhead (BM_BufferPool *const bm, const int maxPages) {
+    /*
+      Switch read-ahead for sequential pinPage calls on (maxPages > 0, the
+      largest window in pages) or off (0). Off by default, so the frame
+      contents of a pool only ever follow its pinPage calls.
+    */
+    if (bm == NULL || bm->mgmtData == NULL) {
+        return RC_BUFFER_POOL_NOT_INIT;
+    }
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    mgmt->readAheadMax = maxPages > 0 ? maxPages : 0;
+    mgmt->raWindow = 0;
+    return RC_OK;
+}
+
+int getNumReadAheadIO (BM_BufferPool *const bm) {
+    // pages read-ahead loaded into the pool (also counted in getNumReadIO)
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    return mgmt->numReadAheadIO;
+}
+
+int getNumReadAheadHits (BM_BufferPool *const bm) {
+    // read-ahead pages that were pinned before being evicted
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    return mgmt->numReadAheadHits;
+}
+
+int getNumReadAheadWasted (BM_BufferPool *const bm) {
+    // read-ahead pages evicted without ever being pinned
+    PoolMgmtData *mgmt = (PoolMgmtData *) bm->mgmtData;
+    return mgmt->numReadAheadWasted;
+}
@@ -13,11 +13,11 @@ typedef enum ReplacementStrategy {
 	RS_LRU = 1,
 	RS_CLOCK = 2,
 	RS_LFU = 3,
-	RS_LRU_K = 4
+	RS_LRU_K = 4,    // stratData may point to K (an int), NULL for K = 2
+	RS_ARC = 5       // adaptive replacement cache, stratData unused
 } ReplacementStrategy;
 
-// Data Types and Structures
-typedef int PageNumber;
+// Data Types and Structures (PageNumber comes from dt.h)
 #define NO_PAGE -1
 
 typedef struct BM_BufferPool {
@@ -31,6 +31,7 @@ typedef struct BM_BufferPool {
 typedef struct BM_PageHandle {
 	PageNumber pageNum;
 	char *data;
+	int frame; // frame the page was pinned in, set by pinPage
 } BM_PageHandle;
 
 // convenience macros
@@ -44,6 +45,12 @@ typedef struct BM_PageHandle {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		const int numPages, ReplacementStrategy strategy,
 		void *stratData);
+RC initBufferPoolMapped(BM_BufferPool *const bm, const char *const pageFileName, 
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData);
+RC initBufferPoolDirect(BM_BufferPool *const bm, const char *const pageFileName, 
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
 
@@ -53,6 +60,24 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber startPage,
+		const int count);
+RC setPoolReadAhead (BM_BufferPool *const bm, const int maxPages);
+
+// Buffer Manager Interface Access Rings (bulk scans and loads)
+typedef struct BM_Ring BM_Ring;
+RC openPoolRing (BM_BufferPool *const bm, const int size, BM_Ring **ring);
+RC pinPageRing (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const PageNumber pageNum, BM_Ring *ring);
+RC closePoolRing (BM_BufferPool *const bm, BM_Ring *ring);
+
+// Buffer Manager Interface Page Allocation
+RC allocPoolPage (BM_BufferPool *const bm, PageNumber *pageNum);
+RC freePoolPage (BM_BufferPool *const bm, const PageNumber pageNum);
+bool isPoolPageFree (BM_BufferPool *const bm, const PageNumber pageNum);
+PageNumber getPoolFileSize (BM_BufferPool *const bm);
+int getPoolPageSize (BM_BufferPool *const bm);
+int getPoolPageDataSize (BM_BufferPool *const bm);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -60,5 +85,9 @@ bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+int getNumSyncIO (BM_BufferPool *const bm);
+int getNumReadAheadIO (BM_BufferPool *const bm);
+int getNumReadAheadHits (BM_BufferPool *const bm);
+int getNumReadAheadWasted (BM_BufferPool *const bm);
 
 #endif
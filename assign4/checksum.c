@@ -0,0 +1,150 @@
+#include <string.h>
+#include <pthread.h>
+#include "checksum.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__GNUC__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define CRC32C_ARM 1
+#endif
+
+/* reflected Castagnoli polynomial */
+#define CRC32C_POLY 0x82F63B78u
+
+static uint32_t crcTable[8][256];
+static uint32_t (*crcUpdate)(uint32_t crc, const unsigned char *p, size_t len);
+static const char *crcName;
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+/*
+    Slicing-by-8: table k gives the CRC of a byte followed by k zero bytes,
+    so eight table lookups fold in eight bytes at a time.
+*/
+static void buildTables(void) {
+    for (int n = 0; n < 256; n++) {
+        uint32_t c = (uint32_t) n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crcTable[0][n] = c;
+    }
+    for (int n = 0; n < 256; n++) {
+        uint32_t c = crcTable[0][n];
+        for (int k = 1; k < 8; k++) {
+            c = crcTable[0][c & 0xff] ^ (c >> 8);
+            crcTable[k][n] = c;
+        }
+    }
+}
+
+static uint32_t crcSoftware(uint32_t crc, const unsigned char *p, size_t len) {
+    // byte at a time up to an 8-byte boundary
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = crcTable[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        word ^= crc;
+        crc = crcTable[7][word & 0xff] ^ crcTable[6][(word >> 8) & 0xff]
+            ^ crcTable[5][(word >> 16) & 0xff] ^ crcTable[4][(word >> 24) & 0xff]
+            ^ crcTable[3][(word >> 32) & 0xff] ^ crcTable[2][(word >> 40) & 0xff]
+            ^ crcTable[1][(word >> 48) & 0xff] ^ crcTable[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len > 0) {
+        crc = crcTable[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    return crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crcHardware(uint32_t crc, const unsigned char *p, size_t len) {
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t) crc64;
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+    return crc;
+}
+#endif
+
+#ifdef CRC32C_ARM
+__attribute__((target("+crc")))
+static uint32_t crcHardware(uint32_t crc, const unsigned char *p, size_t len) {
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+    return crc;
+}
+#endif
+
+/* pick the implementation once, on first use */
+static void initCrc(void) {
+    buildTables();
+    crcUpdate = crcSoftware;
+    crcName = "slicing-by-8";
+#ifdef CRC32C_X86
+    if (__builtin_cpu_supports("sse4.2")) {
+        crcUpdate = crcHardware;
+        crcName = "sse4.2";
+    }
+#endif
+#ifdef CRC32C_ARM
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        crcUpdate = crcHardware;
+        crcName = "armv8-crc";
+    }
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    pthread_once(&crcOnce, initCrc);
+    return ~crcUpdate(~crc, (const unsigned char *) buf, len);
+}
+
+uint32_t crc32cPortable(uint32_t crc, const void *buf, size_t len) {
+    // always the table version, to cross-check the hardware one
+    pthread_once(&crcOnce, initCrc);
+    return ~crcSoftware(~crc, (const unsigned char *) buf, len);
+}
+
+const char *crc32cImplementation(void) {
+    // "sse4.2", "armv8-crc" or "slicing-by-8"
+    pthread_once(&crcOnce, initCrc);
+    return crcName;
+}
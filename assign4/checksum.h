@@ -0,0 +1,17 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    CRC32C (Castagnoli polynomial, the one iSCSI, ext4 and SQLite's WAL use).
+    crc32c uses the CPU's CRC instructions (SSE4.2 on x86, the ARMv8 CRC
+    extension) when they are there and slicing-by-8 tables otherwise; both give
+    the same result. Pass 0 as crc to start, or a previous result to continue.
+*/
+extern uint32_t crc32c (uint32_t crc, const void *buf, size_t len);
+extern uint32_t crc32cPortable (uint32_t crc, const void *buf, size_t len);
+extern const char *crc32cImplementation (void);
+
+#endif
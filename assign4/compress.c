@@ -0,0 +1,152 @@
+#include <string.h>
+#include <stdint.h>
+#include "compress.h"
+
+/*
+    Stream format: a sequence of
+        token                   high nibble: literal count, low nibble: match length - LZ_MIN_MATCH
+        [255 ... n]             more literal count when the nibble is 15
+        literals
+        offset (2 bytes, LE)    distance back to the match, 1..65535
+        [255 ... n]             more match length when the nibble is 15
+    The last sequence has literals only and ends the stream.
+*/
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+
+static uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash32(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* append a length continuation (the part above 15) */
+static int putLength(unsigned char **op, unsigned char *end, int len) {
+    while (len >= 255) {
+        if (*op >= end) return -1;
+        *(*op)++ = 255;
+        len -= 255;
+    }
+    if (*op >= end) return -1;
+    *(*op)++ = (unsigned char) len;
+    return 0;
+}
+
+/* one sequence: literals [lit, lit + litLen), then a match (matchLen 0 = last sequence) */
+static int putSequence(unsigned char **op, unsigned char *end, const unsigned char *lit, int litLen,
+                       int offset, int matchLen) {
+    unsigned char *token = (*op)++;
+    if (token >= end) return -1;
+    int litNibble = litLen < 15 ? litLen : 15;
+    int matchNibble = 0;
+    if (litLen >= 15 && putLength(op, end, litLen - 15) != 0) return -1;
+    if (end - *op < litLen) return -1;
+    memcpy(*op, lit, (size_t) litLen);
+    *op += litLen;
+
+    if (matchLen > 0) {
+        int extra = matchLen - LZ_MIN_MATCH;
+        matchNibble = extra < 15 ? extra : 15;
+        if (end - *op < 2) return -1;
+        *(*op)++ = (unsigned char) (offset & 0xff);
+        *(*op)++ = (unsigned char) (offset >> 8);
+        if (extra >= 15 && putLength(op, end, extra - 15) != 0) return -1;
+    }
+    *token = (unsigned char) ((litNibble << 4) | matchNibble);
+    return 0;
+}
+
+int lzCompress(const char *src, int srcLen, char *dst, int dstCap) {
+    const unsigned char *in = (const unsigned char *) src;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *end = op + dstCap;
+    int table[1 << LZ_HASH_BITS];
+    memset(table, -1, sizeof(table));
+
+    int ip = 0;
+    int anchor = 0;
+    while (ip + LZ_MIN_MATCH <= srcLen) {
+        uint32_t seq = read32(in + ip);
+        uint32_t h = hash32(seq);
+        int ref = table[h];
+        table[h] = ip;
+        if (ref < 0 || ip - ref > LZ_MAX_OFFSET || read32(in + ref) != seq) {
+            ip++;
+            continue;
+        }
+
+        int len = LZ_MIN_MATCH;
+        while (ip + len < srcLen && in[ref + len] == in[ip + len]) {
+            len++;
+        }
+        if (putSequence(&op, end, in + anchor, ip - anchor, ip - ref, len) != 0) {
+            return 0;
+        }
+        ip += len;
+        anchor = ip;
+    }
+    if (putSequence(&op, end, in + anchor, srcLen - anchor, 0, 0) != 0) {
+        return 0;
+    }
+    return (int) (op - (unsigned char *) dst);
+}
+
+/* read a length continuation, -1 on truncated input */
+static int getLength(const unsigned char **ip, const unsigned char *end) {
+    int len = 0;
+    unsigned char b;
+    do {
+        if (*ip >= end) return -1;
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+int lzDecompress(const char *src, int srcLen, char *dst, int dstLen) {
+    const unsigned char *ip = (const unsigned char *) src;
+    const unsigned char *end = ip + srcLen;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *opEnd = op + dstLen;
+
+    while (ip < end) {
+        unsigned char token = *ip++;
+        int litLen = token >> 4;
+        if (litLen == 15) {
+            int more = getLength(&ip, end);
+            if (more < 0) return -1;
+            litLen += more;
+        }
+        if (end - ip < litLen || opEnd - op < litLen) return -1;
+        memcpy(op, ip, (size_t) litLen);
+        ip += litLen;
+        op += litLen;
+        if (ip == end) {
+            break;      // last sequence: literals only
+        }
+
+        if (end - ip < 2) return -1;
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int matchLen = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15) {
+            int more = getLength(&ip, end);
+            if (more < 0) return -1;
+            matchLen += more;
+        }
+        if (offset == 0 || offset > op - (unsigned char *) dst || opEnd - op < matchLen) return -1;
+
+        // byte by byte: the match may overlap the bytes it produces (runs)
+        const unsigned char *ref = op - offset;
+        for (int i = 0; i < matchLen; i++) {
+            op[i] = ref[i];
+        }
+        op += matchLen;
+    }
+    return op == opEnd ? 0 : -1;
+}
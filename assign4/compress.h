@@ -0,0 +1,21 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+/*
+    Small LZ77 codec for pages, in the spirit of LZ4's block format: a token
+    byte with a literal run length and a match length, the literals, and a
+    16-bit back reference. No entropy coding, so it is cheap enough to run on
+    every page write; long zero runs (padding of wide string attributes,
+    empty slots) shrink to a few bytes.
+*/
+
+// bytes lzCompress may need in the worst case for srcLen input bytes
+#define LZ_BOUND(srcLen) ((srcLen) + (srcLen) / 255 + 16)
+
+/* compress src into dst; returns the compressed length, 0 if it does not fit in dstCap */
+extern int lzCompress (const char *src, int srcLen, char *dst, int dstCap);
+
+/* decompress exactly dstLen bytes; returns 0 on success, -1 if src is malformed */
+extern int lzDecompress (const char *src, int srcLen, char *dst, int dstLen);
+
+#endif
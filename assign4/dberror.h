@@ -4,7 +4,7 @@
 #include "stdio.h"
 
 /* module wide constants */
-#define PAGE_SIZE 4096
+#define PAGE_SIZE 4096     // default page size, each page file records its own
 
 /* return code definitions */
 typedef int RC;
@@ -15,6 +15,18 @@ typedef int RC;
 #define RC_WRITE_FAILED 3
 #define RC_READ_NON_EXISTING_PAGE 4
 
+#define RC_SM_MAP_FAILED 100
+#define RC_SM_NOT_MAPPED 101
+#define RC_SM_INVALID_EXTENT 102
+#define RC_SM_ASYNC_UNAVAILABLE 103
+#define RC_SM_PAGE_ALREADY_FREE 104
+#define RC_SM_UNSUPPORTED_FORMAT 105
+#define RC_SM_INVALID_PAGE_SIZE 106
+#define RC_SM_CHECKSUM_MISMATCH 107
+#define RC_SM_INVALID_SYNC_POLICY 108
+#define RC_SM_INVALID_BACKEND 109
+#define RC_SM_READ_ONLY 110
+
 #define RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE 200
 #define RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN 201
 #define RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN 202
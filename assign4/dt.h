@@ -11,4 +11,7 @@
 #define TRUE true
 #define FALSE false
 
+// page numbers are 64-bit, page files may grow far beyond 2 GB
+typedef long long PageNumber;
+
 #endif // DT_H
@@ -1,3 +1,6 @@
+/* strdup is POSIX, not plain C99 (without this it is implicitly int and truncates pointers) */
+#define _POSIX_C_SOURCE 200809L
+
 #include "record_mgr.h"
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
@@ -19,10 +22,15 @@ Define and manage schemas, which are information about the structure of a table
 */
 
 
+// frames a scan, or insertRecord's search for a free slot, recycles on a table larger than its pool
+#define RM_RING_SIZE 16
+
 // store table management info
 typedef struct TableMgmtData {
     BM_BufferPool *bm;
     int numTuples;
+    int pagesFreed; // bumped whenever deleteRecord hands a page back
+    BM_Ring *insertRing; // insertRecord walks the table through it, once the table outgrows the pool
 } TableMgmtData;
 
 
@@ -34,10 +42,13 @@ typedef struct RM_PageInfo {
 
 // used to record the scanned location
 typedef struct ScanMgmtData {
-    int currentPage;      // current page being scanned
+    PageNumber currentPage; // current page being scanned
     int currentSlot;      // current slot within that page
+    PageNumber lastPage;  // last page of the table file when it was last checked
+    int pagesFreed;       // table's pagesFreed when the current page was entered
     Expr *cond;           // condition expression
     BM_PageHandle ph;     // current page handle
+    BM_Ring *ring;        // pages are pinned through it if the table is larger than the pool, else NULL
 } ScanMgmtData;
 
 
@@ -107,9 +118,15 @@ static Schema *parseSchemaString(char *str) {
 // in rm_serializer.c, MAKE_VARSTRING() calls calloc(100, 0),
 // which allocates zero bytes. this causes a segmentation fault on most systems (glibc >= 2.30).
 // This replacement ensures calloc() always allocates at least 1 byte,
+// and still hands back zeroed memory like the real calloc (the storage manager
+// relies on that for empty pages)
 void *calloc(size_t n, size_t s) {
     if (s == 0) s = 1;          // ensure at least 1 byte per element
-    return malloc(n * s);       // allocate a contiguous block manually
+    void *p = malloc(n * s);    // allocate a contiguous block manually
+    if (p != NULL) {
+        memset(p, 0, n * s);
+    }
+    return p;
 }
 
 
@@ -132,6 +149,30 @@ RC shutdownRecordManager () {
 
 
 RC createTable(char *name, Schema *schema) {
+    // a table on default-size pages; a "mem:" name makes a temporary table that lives in memory,
+    // a "ts:<tablespace>#<table>" name puts it into a tablespace (see createTablespace)
+    return createTableWithPageSize(name, schema, PAGE_SIZE);
+}
+
+
+RC createTableWithPageSize(char *name, Schema *schema, int pageSize) {
+    /*
+    Same as createTable, on pages of pageSize bytes (see createPageFileWithPageSize).
+    Larger pages hold more records each; the size sticks with the table file.
+    Table pages carry a checksum trailer, so a torn or corrupted page is
+    reported by pinPage instead of being read as records.
+    */
+    return createTableWithOptions(name, schema, pageSize, 0);
+}
+
+
+RC createTableWithOptions(char *name, Schema *schema, int pageSize, int options) {
+    /*
+    Same, with extra page file options: SM_PAGE_COMPRESSED keeps the table
+    compressed on disk, which pays off for wide STRING attributes whose
+    padding is mostly zeros; SM_PAGE_SNAPSHOTS lets createSnapshot freeze
+    the table file for a consistent read. The checksum trailer is always on.
+    */
     /*
     debug code
     printf("[DEBUG createTable] schema=%p numAttr=%d\n", schema, schema->numAttr);
@@ -145,7 +186,7 @@ RC createTable(char *name, Schema *schema) {
     }
     */
     RC rc;
-    rc = createPageFile(name);
+    rc = createPageFileWithOptions(name, pageSize, SM_PAGE_CHECKSUMS | options);
     if (rc != RC_OK) return rc;
 
     // initialize the buffer pool
@@ -188,7 +229,7 @@ RC createTable(char *name, Schema *schema) {
     printf("[DEBUG serializedSchema ptr=%p]\n", serializedSchema);
     
     // writing metadata
-    memset(ph.data, 0, PAGE_SIZE);
+    memset(ph.data, 0, getPoolPageSize(&bm));
     sprintf(ph.data, "%d\n%d\n%s\n", numTuples, firstFreePage, serializedSchema);
 
     markDirty(&bm, &ph);
@@ -216,6 +257,8 @@ RC openTable (RM_TableData *rel, char *name) {
         free(ph);
         return rc;
     }
+    // scans walk the table page by page: let the pool read ahead of them
+    setPoolReadAhead(bm, SM_READAHEAD_MAX_PAGES);
 
     // pin the first page
     rc = pinPage(bm, ph, 0);
@@ -264,6 +307,8 @@ RC openTable (RM_TableData *rel, char *name) {
     TableMgmtData *mgmt = (TableMgmtData *) malloc(sizeof(TableMgmtData));
     mgmt->bm = bm;
     mgmt->numTuples = numTuples;
+    mgmt->pagesFreed = 0;
+    mgmt->insertRing = NULL;
     rel->mgmtData = mgmt;
 
     unpinPage(bm, ph);
@@ -280,6 +325,8 @@ RC closeTable (RM_TableData *rel) {
     TableMgmtData *mgmt = (TableMgmtData *) rel->mgmtData;
     BM_BufferPool *bm = mgmt->bm;
 
+    closePoolRing(bm, mgmt->insertRing);
+
     // written the dirty pages
     forceFlushPool(bm);
 
@@ -323,38 +370,45 @@ RC insertRecord (RM_TableData *rel, Record *record) {
 
     int recordSize = getRecordSize(rel->schema);
     int slotSize = recordSize + 1; // one more for tag
-    int recordsPerPage = PAGE_SIZE / slotSize; //  records/page
+    int recordsPerPage = getPoolPageDataSize(bm) / slotSize; //  records/page
    
     // try from page 1, page 0 is metadata
-    int pageNum = 1;
+    PageNumber pageNum = 1;
+    PageNumber numPages = getPoolFileSize(bm);
     RC rc;
 
+    // the search reads every full page: on a table larger than the pool, it does not
+    // get to push out the pages the other operations work on (RM_RING_SIZE)
+    if (mgmt->insertRing == NULL && numPages > bm->numPages) {
+        openPoolRing(bm, RM_RING_SIZE, &mgmt->insertRing);
+    }
+
     while (1) {
         //if (pageNum % 500 == 0)
-        //printf("[insertRecord] currently on page=%d\n", pageNum);
-
-        rc = pinPage(bm, &ph, pageNum);
-        if (rc != RC_OK) { // if page not exists, create new empty page
-            
-            SM_FileHandle fh;
-            openPageFile(rel->name, &fh);
-            ensureCapacity(pageNum + 1, &fh);
-            closePageFile(&fh);
-            rc = pinPage(bm, &ph, pageNum);
-            if (rc != RC_OK) { // check rc to prevent invalid ph.data access
+        //printf("[insertRecord] currently on page=%lld\n", pageNum);
+
+        if (pageNum >= numPages) {
+            // every page is full: reuse a freed page, or append a new (empty) one
+            PageNumber newPage;
+            rc = allocPoolPage(bm, &newPage);
+            if (rc != RC_OK) {
                 return rc;
-            }  
-            //  prevent garbage data
-            memset(ph.data, '0', PAGE_SIZE);
-            markDirty(bm, &ph);
+            }
+            pageNum = newPage;
+            numPages = getPoolFileSize(bm);
+        }
+
+        rc = pinPageRing(bm, &ph, pageNum, mgmt->insertRing);
+        if (rc != RC_OK) { // check rc to prevent invalid ph.data access
+            return rc;
         }
 
         // search for free slot in this page
-        bool found = false;
+        int freeSlot = -1;
         for (int i = 0; i < recordsPerPage; i++) {
             int offset = i * slotSize;
 
-            //printf("[insertRecord] page=%d slot=%d size=%d ", pageNum, i, recordSize);
+            //printf("[insertRecord] page=%lld slot=%d size=%d ", pageNum, i, recordSize);
             //printf("data bytes: ");
             //for (int k = 0; k < recordSize; k++) {
             //    printf("%02X ", (unsigned char)record->data[k]);
@@ -362,23 +416,31 @@ RC insertRecord (RM_TableData *rel, Record *record) {
             //printf("\n");
 
             if (ph.data[offset] == '0' || ph.data[offset] == '\0') { // empty slot
-                ph.data[offset] = '1'; // marked as used
-                memcpy(ph.data + offset+1, record->data, recordSize);
-
-                // set record ID
-                record->id.page = pageNum;
-                record->id.slot = i;
-
-                // mark dirty and unpin
-                markDirty(bm, &ph);
-                unpinPage(bm, &ph);
-                mgmt->numTuples++;
-                found = true;
+                freeSlot = i;
                 break;
             }
         }
+        // a page on the free list only looks empty, it belongs to the storage manager
+        if (freeSlot >= 0 && isPoolPageFree(bm, pageNum)) {
+            freeSlot = -1;
+        }
+
+        if (freeSlot >= 0) {
+            int offset = freeSlot * slotSize;
+            ph.data[offset] = '1'; // marked as used
+            memcpy(ph.data + offset+1, record->data, recordSize);
+
+            // set record ID
+            record->id.page = pageNum;
+            record->id.slot = freeSlot;
+
+            // mark dirty and unpin
+            markDirty(bm, &ph);
+            unpinPage(bm, &ph);
+            mgmt->numTuples++;
+            break; // inserted successfully
+        }
 
-        if (found) break; // inserted successfully
         unpinPage(bm, &ph);
         pageNum++; // move to next page
     }
@@ -407,11 +469,27 @@ RC deleteRecord (RM_TableData *rel, RID id) {
     ph.data[offset] = '0'; // mark as empty
     memset(ph.data + offset + 1, 0, recordSize); // clear record data
 
+    // was it the last record on the page?
+    int recordsPerPage = getPoolPageDataSize(bm) / slotSize;
+    bool pageEmpty = true;
+    for (int i = 0; i < recordsPerPage; i++) {
+        if (ph.data[i * slotSize] == '1') {
+            pageEmpty = false;
+            break;
+        }
+    }
+
     markDirty(bm, &ph);
     unpinPage(bm, &ph);
 
     mgmt->numTuples--;
 
+    // hand an emptied page back to the storage manager, the next insert that
+    // needs a new page reuses it (page 0 is the metadata page)
+    if (pageEmpty && id.page > 0 && freePoolPage(bm, id.page) == RC_OK) {
+        mgmt->pagesFreed++;
+    }
+
     return RC_OK;
 }
 
@@ -430,7 +508,7 @@ RC updateRecord (RM_TableData *rel, Record *record) {
     int slotSize = recordSize + 1;  // containing tag
     int offset = record->id.slot * slotSize;
 
-    if (offset + slotSize > PAGE_SIZE) {
+    if (offset + slotSize > getPoolPageDataSize(bm)) {
         unpinPage(bm, &ph);
         return RC_READ_NON_EXISTING_PAGE;
     }
@@ -467,7 +545,7 @@ RC getRecord (RM_TableData *rel, RID id, Record *record) {
     int offset = id.slot * slotSize;
 
 
-    //printf("[getRecord] page=%d slot=%d size=%d ", id.page, id.slot, recordSize);
+    //printf("[getRecord] page=%lld slot=%d size=%d ", id.page, id.slot, recordSize);
     //printf("data bytes: ");
     //for (int k = 0; k < recordSize; k++) {
     //   printf("%02X ", (unsigned char)record->data[k]);
@@ -475,7 +553,7 @@ RC getRecord (RM_TableData *rel, RID id, Record *record) {
     //printf("\n");
 
     // boundary check
-    if (offset + slotSize > PAGE_SIZE) { // avoid out-of-range access
+    if (offset + slotSize > getPoolPageDataSize(bm)) { // avoid out-of-range access
         unpinPage(bm, &ph); 
         return RC_READ_NON_EXISTING_PAGE;
     }
@@ -485,6 +563,11 @@ RC getRecord (RM_TableData *rel, RID id, Record *record) {
         unpinPage(bm, &ph);
         return RC_READ_NON_EXISTING_PAGE;
     }
+    // a freed page holds free-list bookkeeping, not records
+    if (isPoolPageFree(bm, id.page)) {
+        unpinPage(bm, &ph);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
     
     // copy data into record, skip the 1-byte slot tag
     memcpy(record->data, ph.data + offset+1, recordSize);
@@ -507,12 +590,20 @@ RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
         return RC_RM_UNKOWN_DATATYPE;
 
     // initialize scan structure
+    BM_BufferPool *bm = ((TableMgmtData *) rel->mgmtData)->bm;
     ScanMgmtData *scanData = (ScanMgmtData *) malloc(sizeof(ScanMgmtData));
     scanData->currentPage = 1; // start from page 1 (page 0 is metadata)
     scanData->currentSlot = 0; // start from first slot
+    scanData->lastPage = getPoolFileSize(bm) - 1;
+    scanData->pagesFreed = ((TableMgmtData *) rel->mgmtData)->pagesFreed;
     scanData->cond = cond;
     scanData->ph.pageNum = -1;
     scanData->ph.data = NULL;  
+    // a table larger than the pool would push everything else out of it: scan through a ring
+    scanData->ring = NULL;
+    if (scanData->lastPage + 1 > bm->numPages) {
+        openPoolRing(bm, RM_RING_SIZE, &scanData->ring);
+    }
     scan->rel = rel;
     scan->mgmtData = scanData;
 
@@ -547,16 +638,29 @@ RC next (RM_ScanHandle *scan, Record *record) {
     // calculate the maximum number of records that can be placed on each page
     int recordSize = getRecordSize(schema);
     int slotSize = recordSize + 1;
-    int recordsPerPage = PAGE_SIZE / slotSize;
+    int recordsPerPage = getPoolPageDataSize(bm) / slotSize;
     Value *result = NULL;
     RC rc;
     
-    // preventing infinite loops
-    int totalPages = (tableMgmt->numTuples + recordsPerPage - 1) / recordsPerPage;
-    if (totalPages == 0) totalPages = 1;
+    // the scan ends at the last page of the file (records can sit on any page,
+    // deletes leave holes); pages appended by inserts during the scan are picked up
+    if (scanData->currentPage > scanData->lastPage) {
+        scanData->lastPage = getPoolFileSize(bm) - 1;
+    }
 
-    while (scanData->currentPage <= totalPages) { // page layer
-        rc = pinPage(bm, &scanData->ph, scanData->currentPage);
+    while (scanData->currentPage <= scanData->lastPage) { // page layer
+        // freed pages hold free-list bookkeeping, not records; a page the scan is
+        // in the middle of only needs a second look if a delete freed something
+        if (scanData->currentSlot == 0 || scanData->pagesFreed != tableMgmt->pagesFreed) {
+            scanData->pagesFreed = tableMgmt->pagesFreed;
+            if (isPoolPageFree(bm, scanData->currentPage)) {
+                scanData->currentPage++;
+                scanData->currentSlot = 0;
+                continue;
+            }
+        }
+        // the pool notices the page-by-page walk and reads ahead of it (see openTable)
+        rc = pinPageRing(bm, &scanData->ph, scanData->currentPage, scanData->ring);
         if (rc != RC_OK) return rc;
 
         char *data = scanData->ph.data;
@@ -603,6 +707,7 @@ RC closeScan (RM_ScanHandle *scan) {
 
     if (scanData->ph.data != NULL) // preventing null pointers
         unpinPage(tableMgmt->bm, &scanData->ph);
+    closePoolRing(tableMgmt->bm, scanData->ring);
 
     free(scanData);
     scan->mgmtData = NULL;
@@ -0,0 +1,341 @@
+/* pread/pwrite, fallocate and fdatasync are POSIX/Linux, not plain C99 */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "storage_backend.h"
+#include "tablespace.h"
+#include "stripe.h"
+
+/************************************************************
+ *                    POSIX files                           *
+ ************************************************************/
+static int posixOpen(const char *path, int flags, mode_t mode) {
+    return open(path, flags, mode);
+}
+
+/* fallocate where the file system can preallocate, a plain size change otherwise */
+static int posixExtend(int fd, off_t offset, off_t len) {
+    if (fallocate(fd, 0, offset, len) == 0) {
+        return 0;
+    }
+    if (errno != EOPNOTSUPP && errno != ENOSYS) {
+        return -1;
+    }
+    return ftruncate(fd, offset + len);
+}
+
+static int posixPunch(int fd, off_t offset, off_t len) {
+    return fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len);
+}
+
+const SM_Backend smPosixBackend = {
+    "posix", true,
+    posixOpen, close, pread, pwrite, posixExtend, posixPunch, fdatasync, fstat, unlink, preadv, pwritev, NULL
+};
+
+/************************************************************
+ *                    in-memory files                       *
+ ************************************************************/
+/*
+    A memory file is one growable byte array. Files are found by their full
+    name and stay around after the last close, like a file on a RAM disk,
+    until they are unlinked; an unlinked file lives on while it is open.
+    Descriptors index memFds. memLock guards the name list and the
+    descriptor table, each file's rwlock its bytes: reads share it, writes
+    (which may move the array) take it exclusively.
+*/
+typedef struct MemFile {
+    char *name;          // NULL once unlinked
+    char *data;
+    size_t len;          // file size
+    size_t cap;          // bytes allocated at data
+    int openCount;
+    ino_t ino;           // unique per file, for stat
+    pthread_rwlock_t lock;
+    struct MemFile *next;
+} MemFile;
+
+static MemFile *memFiles = NULL;
+static MemFile **memFds = NULL;
+static int memFdCount = 0;
+static ino_t memNextIno = 1;
+static pthread_mutex_t memLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void memFree(MemFile *file) {
+    pthread_rwlock_destroy(&file->lock);
+    free(file->data);
+    free(file);
+}
+
+static MemFile *memFile(int fd) {
+    MemFile *file = NULL;
+    pthread_mutex_lock(&memLock);
+    if (fd >= 0 && fd < memFdCount) {
+        file = memFds[fd];
+    }
+    pthread_mutex_unlock(&memLock);
+    if (file == NULL) {
+        errno = EBADF;
+    }
+    return file;
+}
+
+/* make the file at least newLen bytes long, zero-filled (write lock held) */
+static int memGrow(MemFile *file, size_t newLen) {
+    if (newLen <= file->len) {
+        return 0;
+    }
+    if (newLen > file->cap) {
+        size_t cap = file->cap > 0 ? file->cap : PAGE_SIZE;
+        while (cap < newLen) cap *= 2;
+        char *data = (char *) realloc(file->data, cap);
+        if (data == NULL) {
+            errno = ENOSPC;
+            return -1;
+        }
+        file->data = data;
+        file->cap = cap;
+    }
+    memset(file->data + file->len, 0, newLen - file->len);
+    file->len = newLen;
+    return 0;
+}
+
+static int memOpen(const char *path, int flags, mode_t mode) {
+    (void) mode;
+    pthread_mutex_lock(&memLock);
+    MemFile *file = memFiles;
+    while (file != NULL && strcmp(file->name, path) != 0) {
+        file = file->next;
+    }
+    if (file == NULL) {
+        if (!(flags & O_CREAT)) {
+            pthread_mutex_unlock(&memLock);
+            errno = ENOENT;
+            return -1;
+        }
+        file = (MemFile *) calloc(1, sizeof(MemFile));
+        if (file == NULL || (file->name = strdup(path)) == NULL) {
+            free(file);
+            pthread_mutex_unlock(&memLock);
+            errno = ENOMEM;
+            return -1;
+        }
+        file->ino = memNextIno++;
+        pthread_rwlock_init(&file->lock, NULL);
+        file->next = memFiles;
+        memFiles = file;
+    }
+
+    int fd = 0;
+    while (fd < memFdCount && memFds[fd] != NULL) {
+        fd++;
+    }
+    if (fd == memFdCount) {
+        int count = memFdCount > 0 ? 2 * memFdCount : 16;
+        MemFile **fds = (MemFile **) realloc(memFds, count * sizeof(MemFile *));
+        if (fds == NULL) {
+            pthread_mutex_unlock(&memLock);
+            errno = EMFILE;
+            return -1;
+        }
+        memset(fds + memFdCount, 0, (count - memFdCount) * sizeof(MemFile *));
+        memFds = fds;
+        memFdCount = count;
+    }
+    memFds[fd] = file;
+    file->openCount++;
+    if (flags & O_TRUNC) {
+        pthread_rwlock_wrlock(&file->lock);
+        file->len = 0;
+        pthread_rwlock_unlock(&file->lock);
+    }
+    pthread_mutex_unlock(&memLock);
+    return fd;
+}
+
+static int memClose(int fd) {
+    pthread_mutex_lock(&memLock);
+    if (fd < 0 || fd >= memFdCount || memFds[fd] == NULL) {
+        pthread_mutex_unlock(&memLock);
+        errno = EBADF;
+        return -1;
+    }
+    MemFile *file = memFds[fd];
+    memFds[fd] = NULL;
+    if (--file->openCount == 0 && file->name == NULL) {
+        memFree(file);
+    }
+    pthread_mutex_unlock(&memLock);
+    return 0;
+}
+
+static ssize_t memPread(int fd, void *buf, size_t len, off_t offset) {
+    MemFile *file = memFile(fd);
+    if (file == NULL) {
+        return -1;
+    }
+    pthread_rwlock_rdlock(&file->lock);
+    size_t n = 0;
+    if ((size_t) offset < file->len) {
+        n = file->len - (size_t) offset < len ? file->len - (size_t) offset : len;
+        memcpy(buf, file->data + offset, n);
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return (ssize_t) n;
+}
+
+static ssize_t memPwrite(int fd, const void *buf, size_t len, off_t offset) {
+    MemFile *file = memFile(fd);
+    if (file == NULL) {
+        return -1;
+    }
+    pthread_rwlock_wrlock(&file->lock);
+    if (memGrow(file, (size_t) offset + len) != 0) {
+        pthread_rwlock_unlock(&file->lock);
+        return -1;
+    }
+    memcpy(file->data + offset, buf, len);
+    pthread_rwlock_unlock(&file->lock);
+    return (ssize_t) len;
+}
+
+static int memExtend(int fd, off_t offset, off_t len) {
+    MemFile *file = memFile(fd);
+    if (file == NULL) {
+        return -1;
+    }
+    pthread_rwlock_wrlock(&file->lock);
+    int res = memGrow(file, (size_t) (offset + len));
+    pthread_rwlock_unlock(&file->lock);
+    return res;
+}
+
+static int memPunch(int fd, off_t offset, off_t len) {
+    MemFile *file = memFile(fd);
+    if (file == NULL) {
+        return -1;
+    }
+    pthread_rwlock_wrlock(&file->lock);
+    size_t end = (size_t) (offset + len) < file->len ? (size_t) (offset + len) : file->len;
+    if ((size_t) offset < end) {
+        memset(file->data + offset, 0, end - (size_t) offset);
+    }
+    pthread_rwlock_unlock(&file->lock);
+    return 0;
+}
+
+static int memSync(int fd) {
+    // nothing below memory to make durable
+    return memFile(fd) != NULL ? 0 : -1;
+}
+
+static int memStat(int fd, struct stat *st) {
+    MemFile *file = memFile(fd);
+    if (file == NULL) {
+        return -1;
+    }
+    memset(st, 0, sizeof(struct stat));
+    pthread_rwlock_rdlock(&file->lock);
+    st->st_ino = file->ino;
+    st->st_mode = S_IFREG | 0644;
+    st->st_nlink = file->name != NULL ? 1 : 0;
+    st->st_size = (off_t) file->len;
+    st->st_blocks = (blkcnt_t) ((file->cap + 511) / 512);
+    pthread_rwlock_unlock(&file->lock);
+    return 0;
+}
+
+static int memUnlink(const char *path) {
+    pthread_mutex_lock(&memLock);
+    MemFile **link = &memFiles;
+    while (*link != NULL && strcmp((*link)->name, path) != 0) {
+        link = &(*link)->next;
+    }
+    MemFile *file = *link;
+    if (file == NULL) {
+        pthread_mutex_unlock(&memLock);
+        errno = ENOENT;
+        return -1;
+    }
+    *link = file->next;
+    free(file->name);
+    file->name = NULL;
+    if (file->openCount == 0) {
+        memFree(file);
+    }
+    pthread_mutex_unlock(&memLock);
+    return 0;
+}
+
+const SM_Backend smMemBackend = {
+    "mem", false,
+    memOpen, memClose, memPread, memPwrite, memExtend, memPunch, memSync, memStat, memUnlink, NULL, NULL, NULL
+};
+
+/************************************************************
+ *                    backend selection                     *
+ ************************************************************/
+static struct {
+    char prefix[32];
+    const SM_Backend *backend;
+} backends[SM_MAX_BACKENDS] = {
+    { SM_MEM_PREFIX, &smMemBackend },
+    { SM_TABLESPACE_PREFIX, &smTablespaceBackend },
+    { SM_STRIPE_PREFIX, &smStripeBackend }
+};
+static int numBackends = 3;
+static pthread_mutex_t backendsLock = PTHREAD_MUTEX_INITIALIZER;
+
+RC registerStorageBackend(const char *prefix, const SM_Backend *backend) {
+    /*
+        Files whose name starts with prefix are opened, created and destroyed
+        through backend from now on (the whole name is passed to it). A prefix
+        registered before is pointed at the new backend. Files already open
+        keep the backend they were opened with.
+    */
+    if (prefix == NULL || prefix[0] == '\0' || strlen(prefix) >= sizeof(backends[0].prefix) || backend == NULL
+        || backend->open == NULL || backend->close == NULL || backend->pread == NULL || backend->pwrite == NULL
+        || backend->extend == NULL || backend->punch == NULL || backend->sync == NULL || backend->stat == NULL
+        || backend->unlink == NULL) {
+        return RC_SM_INVALID_BACKEND;
+    }
+    RC rc = RC_OK;
+    pthread_mutex_lock(&backendsLock);
+    int i = 0;
+    while (i < numBackends && strcmp(backends[i].prefix, prefix) != 0) {
+        i++;
+    }
+    if (i < numBackends) {
+        backends[i].backend = backend;
+    } else if (numBackends < SM_MAX_BACKENDS) {
+        strcpy(backends[numBackends].prefix, prefix);
+        backends[numBackends].backend = backend;
+        numBackends++;
+    } else {
+        rc = RC_SM_INVALID_BACKEND;
+    }
+    pthread_mutex_unlock(&backendsLock);
+    return rc;
+}
+
+const SM_Backend *getStorageBackend(const char *fileName) {
+    // the backend with the longest prefix of fileName, POSIX files if none matches
+    const SM_Backend *backend = &smPosixBackend;
+    size_t matched = 0;
+    pthread_mutex_lock(&backendsLock);
+    for (int i = 0; i < numBackends; i++) {
+        size_t len = strlen(backends[i].prefix);
+        if (len > matched && strncmp(fileName, backends[i].prefix, len) == 0) {
+            backend = backends[i].backend;
+            matched = len;
+        }
+    }
+    pthread_mutex_unlock(&backendsLock);
+    return backend;
+}
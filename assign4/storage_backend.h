@@ -0,0 +1,50 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "dberror.h"
+#include "dt.h"
+
+/*
+    Storage backends: where the bytes of a page file live. The storage manager
+    does all file I/O through one of these tables, picked per file by the
+    prefix of its name ("mem:temp1" lives in memory, plain names on disk).
+    Every call behaves like the POSIX call it is named after: a descriptor or
+    0 on success, -1 with errno set on failure. st_dev/st_ino from stat tell
+    whether two descriptors refer to the same file, st_size is its length.
+    preadv, pwritev and locate are optional (NULL): without the first two
+    vectored transfers go one buffer at a time, locate lets the async
+    engines reach a page of a backend file that sits in one kernel file.
+*/
+typedef struct SM_Backend {
+    const char *name;
+    bool native;    // descriptors are kernel fds: mmap, preadv, O_DIRECT, fadvise and io_uring apply
+    int (*open) (const char *path, int flags, mode_t mode);
+    int (*close) (int fd);
+    ssize_t (*pread) (int fd, void *buf, size_t len, off_t offset);
+    ssize_t (*pwrite) (int fd, const void *buf, size_t len, off_t offset);
+    int (*extend) (int fd, off_t offset, off_t len);    // allocate [offset, offset + len), reads back as zeros
+    int (*punch) (int fd, off_t offset, off_t len);     // drop the bytes, keep the size; reads back as zeros
+    int (*sync) (int fd);
+    int (*stat) (int fd, struct stat *st);
+    int (*unlink) (const char *path);
+    ssize_t (*preadv) (int fd, const struct iovec *iov, int iovcnt, off_t offset);
+    ssize_t (*pwritev) (int fd, const struct iovec *iov, int iovcnt, off_t offset);
+    // kernel descriptor holding [offset, offset + len) of fd at *kernelOffset, -1 if there is none
+    int (*locate) (int fd, off_t offset, size_t len, off_t *kernelOffset);
+} SM_Backend;
+
+/* files named SM_MEM_PREFIX... are kept in memory until destroyPageFile (or exit) */
+#define SM_MEM_PREFIX "mem:"
+#define SM_MAX_BACKENDS 8
+
+extern const SM_Backend smPosixBackend;
+extern const SM_Backend smMemBackend;
+
+/* route file names starting with prefix to backend; a longer prefix wins over a shorter one */
+extern RC registerStorageBackend (const char *prefix, const SM_Backend *backend);
+extern const SM_Backend *getStorageBackend (const char *fileName);
+
+#endif
@@ -1,420 +1,3328 @@
+/* pread/pwrite and friends are POSIX, not plain C99 */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <time.h>
+#include <linux/io_uring.h>
 #include "storage_mgr.h"
+#include "storage_backend.h"
+#include "checksum.h"
+#include "compress.h"
 #include "dberror.h"
 /* Initial skeleton version */
 
-/* manipulating page files */
-void initStorageManager(void) {
-    // 
+/*
+    Where one page of a slotted file (SM_PAGE_COMPRESSED, SM_PAGE_SNAPSHOTS)
+    lives: a slot of capacity bytes at offset, of which the first length bytes
+    are used. length 0 is an all-zero page with nothing stored, length ==
+    pageSize a page kept uncompressed (it did not shrink, or the file does not
+    compress). The slot map holds one entry per page of capacity and is stored
+    in the file exactly like this.
+*/
+typedef struct SM_PageSlot {
+    int64_t offset;      // byte offset of the slot in the file, 0 = no slot yet
+    int32_t length;      // stored bytes
+    int32_t capacity;    // bytes reserved at offset
+} SM_PageSlot;
+
+/*
+    A point-in-time snapshot of a slotted file (see createSnapshot): the slot
+    map as it was when the snapshot was taken. Pages are never written into a
+    slot a live snapshot reads, so the frozen map keeps pointing at the page
+    images of that moment.
+*/
+typedef struct SM_Snapshot {
+    SM_PageSlot *slots;      // frozen slot map
+    PageNumber numSlots;     // entries in slots
+    PageNumber totalNumPages; // page count when the snapshot was taken
+    struct SM_Snapshot *next;
+} SM_Snapshot;
+
+/*
+    Cached header of one open page file, shared by every handle the process has
+    open on that file (matched by device and inode). Growing the file through
+    one handle is visible to the others right away, and the header page itself
+    is only written back on the last closePageFile, on syncPageFile, and when a
+    new extent is allocated. Entries live in openFiles, guarded by openFilesLock.
+*/
+typedef struct SM_SharedFile {
+    const SM_Backend *backend; // dev and ino are only unique within one backend
+    dev_t dev;
+    ino_t ino;
+    int refCount;        // handles open on this file
+    int pageSize;        // bytes per page (header page included), fixed when the file is created
+    bool checksums;      // every data page ends in a CRC32C trailer (SM_PAGE_CHECKSUMS)
+    bool verifyChecksums; // check the trailer on reads (setChecksumVerification)
+    bool slotted;        // pages live in slots found through the slot map (SM_PAGE_COMPRESSED, SM_PAGE_SNAPSHOTS)
+    bool compressed;     // slotted: pages are stored compressed (SM_PAGE_COMPRESSED)
+    SM_PageSlot *slots;  // slotted: slot map, capacityPages entries; NULL otherwise
+    off_t slotMapOffset; // slotted: where the slot map sits in the file
+    off_t dataEnd;       // slotted: end of the file, new slots are appended here
+    pthread_mutex_t slotLock; // slotted: guards slots, dataEnd, snapshots and movedMap
+    struct SM_Snapshot *snapshots; // slotted: live snapshots, newest first
+    unsigned char *movedMap; // slotted, while snapshots live: one bit per page that moved to a new slot
+                             // since the newest snapshot, so no snapshot reads its slot
+    bool doublewrite;    // pages go through the doublewrite file before they are written in place
+    char *dwName;        // name of the doublewrite file (file name + SM_DOUBLEWRITE_SUFFIX)
+    int dwFd;            // its descriptor, -1 until recovery or the first batch opens it
+    bool dwPending;      // pages of the last batch may not be durable in place yet
+    pthread_mutex_t dwLock; // held from writing a batch to the doublewrite file until its pages are in place
+    SM_SyncPolicy syncPolicy; // when written pages are forced to stable storage
+    int syncPages;       // SM_SYNC_GROUP: sync once this many pages are pending (0 = no page limit)
+    int syncMillis;      // SM_SYNC_GROUP: sync once the oldest pending write is this old (0 = no time limit)
+    int unsyncedPages;   // pages written since the last fdatasync (atomic)
+    long long lastSyncMs; // CLOCK_MONOTONIC time of the last fdatasync
+    PageNumber totalNumPages; // logical pages, authoritative over fHandle->totalNumPages
+    PageNumber capacityPages; // data pages physically allocated in the file (>= totalNumPages)
+    int extentPages;     // how many pages the file grows by at a time
+    bool headerDirty;    // cached header is newer than the one on disk
+    bool markedUnclean;  // header on disk carries the unclean mark
+    PageNumber freeTrunk; // first free-list trunk page (valid while freeCount > 0)
+    PageNumber freeCount; // free pages, trunks included
+    unsigned char *freeMap; // one bit per page, built on first isPageFree; NULL until then
+    PageNumber freeMapPages; // pages covered by freeMap
+    struct SM_SharedFile *next;
+} SM_SharedFile;
+
+static SM_SharedFile *openFiles = NULL;
+static pthread_mutex_t openFilesLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* a mapping window the file outgrew; it stays mapped until close, for the page pointers into it */
+typedef struct SM_OldMap {
+    char *map;
+    size_t reserved;
+    struct SM_OldMap *next;
+} SM_OldMap;
+
+/*
+    Per-handle bookkeeping, hung off SM_FileHandle->mgmtInfo.
+    All page I/O goes through the raw descriptor with the backend's pread/pwrite
+    (see storage_backend.h), so there is no shared stream position and no stdio
+    buffering between us and the kernel (or the in-memory file).
+    Several readers can use the same handle at once; the only shared state they
+    touch is curPagePos, which is informational.
+*/
+typedef struct SM_FileMgmt {
+    const SM_Backend *backend; // where the file lives, picked by its name
+    int fd;              // descriptor returned by backend->open()
+    SM_SharedFile *shared; // header state shared with other handles on the file
+    bool direct;         // opened with O_DIRECT: transfers need SM_IO_ALIGNMENT-aligned buffers
+    char *map;           // base of the shared mapping (header page included), NULL if not mapped
+    size_t mapLen;       // bytes of the file currently mapped
+    size_t mapReserved;  // bytes of address space reserved for the mapping
+    SM_OldMap *oldMaps;  // windows the mapping moved out of, unmapped by closePageFile
+    PageNumber raLast;   // read-ahead: last page read through the handle
+    PageNumber raNext;   // read-ahead: first page not advised yet
+    int raWindow;        // read-ahead: pages advised last time, 0 = not sequential
+    SM_Snapshot *snapshot; // snapshot handle: pages are read through its frozen map, never written; NULL otherwise
+} SM_FileMgmt;
+
+/*
+    Address space reserved up front for a mapped file. The file is mapped into
+    the start of this window and remapped in place as it grows. A file that
+    outgrows the window is mapped again in a larger one, but the old window
+    stays mapped until the file is closed, so pointers handed out by
+    getPagePtr (and a mapped pool's frames) stay valid all along. Both
+    mappings are MAP_SHARED views of the same file and see the same bytes.
+*/
+#define SM_MAP_RESERVE_BYTES ((size_t) 1 << 30)
+
+/*
+    Fixed fields at the start of the header page (the rest of page 0 is zero).
+    Page numbers are 64-bit; the header starts with a magic number and a
+    format version so the older all-int layout can still be told apart.
+
+    Since the header is written lazily, the page count on disk may lag behind.
+    Before the first such lag the header is stamped unclean, and a clean close
+    or sync clears the stamp. Opening an unclean file recovers the page count
+    from the file size: every allocated page counts as in use. Pages past the
+    real end are zero-filled, which callers already treat as empty pages.
+*/
+#define SM_HEADER_MAGIC 0x46504d53      // "SMPF" on disk
+#define SM_FORMAT_VERSION 2
+
+typedef struct SM_FileHeader {
+    int32_t magic;              // SM_HEADER_MAGIC
+    int32_t version;            // SM_FORMAT_VERSION
+    int64_t totalNumPages;      // logical pages handed out to callers
+    int64_t capacityPages;      // data pages allocated on disk, the tail is zero-filled
+    int64_t freeTrunk;          // first trunk page of the free list (see deallocatePage)
+    int64_t freeCount;          // pages on the free list, 0 = empty list
+    int32_t extentPages;        // growth step in pages
+    int32_t unclean;            // 1 while the page count on disk may be stale
+    int32_t pageSize;           // bytes per page, 0 in files from before it was stored (PAGE_SIZE)
+    int32_t features;           // SM_PAGE_* bits, 0 in older files
+    int32_t syncPolicy;         // SM_SyncPolicy, 0 (SM_SYNC_NONE) in older files
+    int32_t syncPages;          // SM_SYNC_GROUP limits
+    int32_t syncMillis;
+    int64_t slotMap;            // SM_PAGE_COMPRESSED: byte offset of the slot map
+} SM_FileHeader;
+
+/*
+    Version 1 header: the same fields as plain ints, no magic number (its first
+    int is the page count, which can never reach SM_HEADER_MAGIC in a file
+    limited to 2 GB). Files written before extents existed only carry
+    totalNumPages; their zero capacity/extent fields are filled in from the
+    file size and the default. Such files are read as they are and get a
+    version 2 header with their next header write.
+*/
+typedef struct SM_FileHeaderV1 {
+    int32_t totalNumPages;
+    int32_t capacityPages;
+    int32_t extentPages;
+    int32_t unclean;
+    int32_t freeTrunk;
+    int32_t freeCount;
+} SM_FileHeaderV1;
+
+// physical offset of a data page (+1 because page 0 is the header, which is one page long too)
+#define PAGE_OFFSET(pageNum, pageSize) ((off_t) ((pageNum) + 1) * (pageSize))
+
+// page sizes a file may use: a power of two, and whole O_DIRECT blocks
+#define IS_VALID_PAGE_SIZE(size) ((size) >= SM_MIN_PAGE_SIZE && (size) <= SM_MAX_PAGE_SIZE \
+                                  && ((size) & ((size) - 1)) == 0 && (size) % SM_IO_ALIGNMENT == 0)
+
+// O_DIRECT transfers need buffer, offset and length aligned to the device block size
+#define IS_IO_ALIGNED(ptr) (((uintptr_t) (ptr) & (SM_IO_ALIGNMENT - 1)) == 0)
+
+/*
+    Page checksums. In a file created with SM_PAGE_CHECKSUMS the last
+    SM_PAGE_TRAILER_SIZE bytes of every data page hold the CRC32C of the bytes
+    before them: stamped into the caller's buffer on every write, checked on
+    every read while verification is on. A page the file grew by but nobody
+    wrote yet is all zeros, trailer included, and counts as intact.
+    The header page carries no trailer.
+*/
+#define PAGE_DATA_SIZE(shared) ((shared)->pageSize - ((shared)->checksums ? SM_PAGE_TRAILER_SIZE : 0))
+#define VERIFY_READS(shared) ((shared)->checksums && (shared)->verifyChecksums)
+
+static void stampPage(SM_SharedFile *shared, SM_PageHandle page) {
+    if (!shared->checksums) {
+        return;
+    }
+    int dataSize = PAGE_DATA_SIZE(shared);
+    uint32_t crc = crc32c(0, page, (size_t) dataSize);
+    memcpy(page + dataSize, &crc, sizeof(crc));
 }
 
+static bool pageChecksumOk(const char *page, int pageSize) {
+    int dataSize = pageSize - SM_PAGE_TRAILER_SIZE;
+    uint32_t stored;
+    memcpy(&stored, page + dataSize, sizeof(stored));
+    if (crc32c(0, page, (size_t) dataSize) == stored) {
+        return true;
+    }
+    if (stored != 0) {
+        return false;
+    }
+    for (int i = 0; i < dataSize; i++) {
+        if (page[i] != 0) return false;
+    }
+    return true;
+}
 
-/* create a file */
-RC createPageFile(char *fileName) {
-    // write a new file
-    FILE *file = fopen(fileName, "wb+");
+/* read exactly len bytes at offset, retrying on short reads and EINTR */
+static RC preadFully(const SM_Backend *backend, int fd, void *buf, size_t len, off_t offset) {
+    char *p = (char *) buf;
+    while (len > 0) {
+        ssize_t n = backend->pread(fd, p, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return RC_READ_NON_EXISTING_PAGE;
+        }
+        if (n == 0) {
+            return RC_READ_NON_EXISTING_PAGE;   // hit EOF before a full page
+        }
+        p += n;
+        len -= (size_t) n;
+        offset += n;
+    }
+    return RC_OK;
+}
 
-    // failed to open file
-    if (file == NULL) { 
-        //printf("fopen failed: %s\n", strerror(errno));
-        return RC_FILE_NOT_FOUND;   
+/* write exactly len bytes at offset, retrying on short writes and EINTR */
+static RC pwriteFully(const SM_Backend *backend, int fd, const void *buf, size_t len, off_t offset) {
+    const char *p = (const char *) buf;
+    while (len > 0) {
+        ssize_t n = backend->pwrite(fd, p, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return RC_WRITE_FAILED;
+        }
+        p += n;
+        len -= (size_t) n;
+        offset += n;
+    }
+    return RC_OK;
+}
+
+/*
+    Page transfer for O_DIRECT handles whose caller buffer is not aligned:
+    go through an aligned bounce page instead.
+*/
+static RC bounceTransfer(const SM_Backend *backend, int fd, SM_PageHandle memPage, int pageSize, off_t offset, bool isWrite) {
+    SM_PageHandle bounce = allocPageBufferSized(pageSize);
+    if (bounce == NULL) {
+        return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+    }
+    RC rc;
+    if (isWrite) {
+        memcpy(bounce, memPage, pageSize);
+        rc = pwriteFully(backend, fd, bounce, pageSize, offset);
+    } else {
+        rc = preadFully(backend, fd, bounce, pageSize, offset);
+        if (rc == RC_OK) memcpy(memPage, bounce, pageSize);
+    }
+    freePageBuffer(bounce);
+    return rc;
+}
+
+/* one full-page transfer, bounced when O_DIRECT cannot use the caller's buffer */
+static RC transferPage(SM_FileMgmt *mgmt, SM_PageHandle memPage, off_t offset, bool isWrite) {
+    int pageSize = mgmt->shared->pageSize;
+    if (mgmt->direct && !IS_IO_ALIGNED(memPage)) {
+        return bounceTransfer(mgmt->backend, mgmt->fd, memPage, pageSize, offset, isWrite);
+    }
+    return isWrite ? pwriteFully(mgmt->backend, mgmt->fd, memPage, pageSize, offset)
+                   : preadFully(mgmt->backend, mgmt->fd, memPage, pageSize, offset);
+}
+
+/*
+    Hole punching. Pages nobody will read back (free-list leaves, dead space
+    in compressed files) have their blocks handed back to the file system with
+    FALLOC_FL_PUNCH_HOLE. The file keeps its size and the range reads back as
+    zeros without touching the device; zeros pass the checksum check too.
+    Where the file system cannot punch holes the bytes just stay allocated.
+*/
+static bool punchRange(const SM_Backend *backend, int fd, off_t offset, off_t len) {
+    return len > 0 && backend->punch(fd, offset, len) == 0;
+}
+
+/*
+    Slotted files (SM_PAGE_COMPRESSED, SM_PAGE_SNAPSHOTS). The header page is
+    followed by variable-sized slots, one per written page, and the slot map
+    saying where each page's slot is; PAGE_OFFSET means nothing for these
+    files. A write compresses the page with lzCompress (in a compressed file)
+    and puts it back into its slot if it still fits, otherwise into a new slot
+    appended at the end of the file (with an eighth spare, rounded to
+    SM_SLOT_ALIGN), leaving the old slot as dead space. While a snapshot is
+    live, a page that did not move since the newest snapshot moves on its next
+    write, whether it fits or not: its slot may be what a snapshot reads.
+    The slot's map entry goes out right after the data, so the map on disk
+    never points at a slot that was not written. The map itself has room
+    for capacityPages pages; when the file needs more it is rewritten, at
+    least twice as large, at the end of the file and the header is pointed at
+    the new copy. Checksums are stamped and checked on the uncompressed page,
+    as for any other file. Byte-sized slots rule out mapping and O_DIRECT.
+*/
+#define SM_SLOT_ALIGN 64
+
+static bool isZeroPage(const char *page, int pageSize) {
+    for (int i = 0; i < pageSize; i++) {
+        if (page[i] != 0) return false;
+    }
+    return true;
+}
+
+#define IS_SNAPSHOT(fHandle) (((SM_FileMgmt *) (fHandle)->mgmtInfo)->snapshot != NULL)
+#define PAGE_MOVED(shared, pageNum) (((shared)->movedMap[(pageNum) / 8] >> ((pageNum) % 8)) & 1)
+
+static RC readSlottedPage(SM_FileMgmt *mgmt, PageNumber pageNum, SM_PageHandle memPage) {
+    SM_SharedFile *shared = mgmt->shared;
+    int pageSize = shared->pageSize;
+    SM_PageSlot slot;
+    if (mgmt->snapshot != NULL) {
+        slot = mgmt->snapshot->slots[pageNum];      // frozen, nobody writes it
+    } else {
+        pthread_mutex_lock(&shared->slotLock);
+        slot = shared->slots[pageNum];
+        pthread_mutex_unlock(&shared->slotLock);
+    }
+
+    if (slot.length == 0) {
+        memset(memPage, 0, pageSize);       // never written, or written as zeros
+        return RC_OK;
+    }
+    if (slot.length == pageSize) {
+        return preadFully(mgmt->backend, mgmt->fd, memPage, pageSize, slot.offset);
+    }
+    char *packed = (char *) malloc(slot.length);
+    if (packed == NULL) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    RC rc = preadFully(mgmt->backend, mgmt->fd, packed, slot.length, slot.offset);
+    if (rc == RC_OK && lzDecompress(packed, slot.length, memPage, pageSize) != 0) {
+        rc = RC_SM_CHECKSUM_MISMATCH;       // a slot that does not decode is as corrupt as a bad trailer
     }
+    free(packed);
+    return rc;
+}
 
-    // allocate a page-sized (4096) buffer for the header page
-    SM_PageHandle header = (SM_PageHandle) malloc(PAGE_SIZE);
-    if (header == NULL) {
-        fclose(file);
+static RC writeSlottedPage(SM_FileMgmt *mgmt, PageNumber pageNum, SM_PageHandle memPage) {
+    SM_SharedFile *shared = mgmt->shared;
+    int pageSize = shared->pageSize;
+    char *packed = (char *) malloc(pageSize);
+    if (packed == NULL) {
         return RC_WRITE_FAILED;
     }
+    int length = 0;
+    if (!isZeroPage(memPage, pageSize)) {
+        length = shared->compressed ? lzCompress(memPage, pageSize, packed, pageSize - 1) : 0;
+        if (length == 0) {
+            memcpy(packed, memPage, pageSize);      // incompressible (or not compressed), keep it as it is
+            length = pageSize;
+        }
+    }
 
-    // initialize header with zero bytes
-    for (int i = 0; i < PAGE_SIZE; i++) {
-        header[i] = '\0';
+    RC rc = RC_OK;
+    pthread_mutex_lock(&shared->slotLock);
+    SM_PageSlot slot = shared->slots[pageNum];
+    int writeLen = length;
+    bool frozen = shared->snapshots != NULL && slot.offset != 0 && !PAGE_MOVED(shared, pageNum);
+    if (length > slot.capacity || (frozen && length > 0)) {
+        int capacity = (length + length / 8 + SM_SLOT_ALIGN - 1) / SM_SLOT_ALIGN * SM_SLOT_ALIGN;
+        if (capacity > pageSize) capacity = pageSize;
+        // the whole slot goes out, so the file always ends at dataEnd
+        memset(packed + length, 0, capacity - length);
+        slot.offset = shared->dataEnd;
+        slot.capacity = capacity;
+        shared->dataEnd += capacity;
+        writeLen = capacity;
+        if (shared->snapshots != NULL) {
+            shared->movedMap[pageNum / 8] |= (unsigned char) (1 << (pageNum % 8));
+        }
     }
+    slot.length = length;
+    if (writeLen > 0) {
+        rc = pwriteFully(mgmt->backend, mgmt->fd, packed, writeLen, slot.offset);
+    }
+    if (rc == RC_OK && memcmp(&slot, &shared->slots[pageNum], sizeof(SM_PageSlot)) != 0) {
+        rc = pwriteFully(mgmt->backend, mgmt->fd, &slot, sizeof(SM_PageSlot),
+                         shared->slotMapOffset + (off_t) pageNum * (off_t) sizeof(SM_PageSlot));
+        if (rc == RC_OK) shared->slots[pageNum] = slot;
+    }
+    pthread_mutex_unlock(&shared->slotLock);
+    free(packed);
+    return rc;
+}
 
-    // store total number of pages in header page
-    int totalPages = 1;
-    memcpy(header, &totalPages, sizeof(int)); 
-    // header is like | 01 00 00 00 | 00 00 00 00 | ...all are 0... |
-
-    // write header page to the file
-    size_t headerWritten = fwrite(header, sizeof(char), PAGE_SIZE, file);
-    free(header);
-    if (headerWritten != PAGE_SIZE) {
-        fclose(file);
+/*
+    Empty a page of a slotted file: it reads as zeros from now on and the
+    bytes of its slot are punched, unless a snapshot may still read them.
+    The slot stays reserved for the page.
+*/
+static RC releaseSlottedPage(SM_FileMgmt *mgmt, PageNumber pageNum) {
+    SM_SharedFile *shared = mgmt->shared;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&shared->slotLock);
+    SM_PageSlot slot = shared->slots[pageNum];
+    if (slot.length != 0) {
+        slot.length = 0;
+        rc = pwriteFully(mgmt->backend, mgmt->fd, &slot, sizeof(SM_PageSlot),
+                         shared->slotMapOffset + (off_t) pageNum * (off_t) sizeof(SM_PageSlot));
+        if (rc == RC_OK) shared->slots[pageNum] = slot;
+    }
+    if (rc == RC_OK && (shared->snapshots == NULL || PAGE_MOVED(shared, pageNum))) {
+        punchRange(mgmt->backend, mgmt->fd, slot.offset, slot.capacity);
+    }
+    pthread_mutex_unlock(&shared->slotLock);
+    return rc;
+}
+
+static int compareOffsets(const void *a, const void *b) {
+    off_t x = *(const off_t *) a;
+    off_t y = *(const off_t *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+    Punch everything in a slotted file that no page uses any more: slots
+    left behind by pages that moved, old copies of the slot map, unused slot
+    tails and emptied slots. Slots a live snapshot reads count as used.
+    Only whole SM_IO_ALIGNMENT blocks are punched, punching part of a block
+    would only write zeros into it.
+*/
+static RC punchDeadSpace(SM_FileMgmt *mgmt) {
+    SM_SharedFile *shared = mgmt->shared;
+    pthread_mutex_lock(&shared->slotLock);
+    // live ranges as (start, end) pairs: the slot map and every used slot
+    PageNumber maxRanges = shared->capacityPages + 1;
+    for (SM_Snapshot *snap = shared->snapshots; snap != NULL; snap = snap->next) {
+        maxRanges += snap->numSlots;
+    }
+    off_t *ranges = (off_t *) malloc((size_t) maxRanges * 2 * sizeof(off_t));
+    if (ranges == NULL) {
+        pthread_mutex_unlock(&shared->slotLock);
         return RC_WRITE_FAILED;
     }
-    
-    
-    // allocate one page-sized memory buffer for file operations
-    // if malloc fails (out of memory), close the file and return an error 
-    SM_PageHandle buffer = (SM_PageHandle) malloc(PAGE_SIZE);
-    if (buffer == NULL) {
-        fclose(file);
-        return RC_WRITE_FAILED; 
+    PageNumber count = 0;
+    ranges[2 * count] = shared->slotMapOffset;
+    ranges[2 * count + 1] = shared->slotMapOffset + (off_t) shared->capacityPages * (off_t) sizeof(SM_PageSlot);
+    count++;
+    for (PageNumber p = 0; p < shared->capacityPages; p++) {
+        if (shared->slots[p].length > 0) {
+            ranges[2 * count] = shared->slots[p].offset;
+            ranges[2 * count + 1] = shared->slots[p].offset + shared->slots[p].length;
+            count++;
+        }
+    }
+    for (SM_Snapshot *snap = shared->snapshots; snap != NULL; snap = snap->next) {
+        for (PageNumber p = 0; p < snap->numSlots; p++) {
+            if (snap->slots[p].length > 0) {
+                ranges[2 * count] = snap->slots[p].offset;
+                ranges[2 * count + 1] = snap->slots[p].offset + snap->slots[p].length;
+                count++;
+            }
+        }
+    }
+    qsort(ranges, (size_t) count, 2 * sizeof(off_t), compareOffsets);
+
+    off_t deadStart = shared->pageSize;     // the header page is always live
+    for (PageNumber i = 0; i <= count; i++) {
+        off_t deadEnd = i < count ? ranges[2 * i] : shared->dataEnd;
+        off_t from = (deadStart + SM_IO_ALIGNMENT - 1) / SM_IO_ALIGNMENT * SM_IO_ALIGNMENT;
+        off_t to = deadEnd / SM_IO_ALIGNMENT * SM_IO_ALIGNMENT;
+        if (to > from) {
+            punchRange(mgmt->backend, mgmt->fd, from, to - from);
+        }
+        if (i < count && ranges[2 * i + 1] > deadStart) {
+            deadStart = ranges[2 * i + 1];
+        }
+    }
+    free(ranges);
+    pthread_mutex_unlock(&shared->slotLock);
+    return RC_OK;
+}
+
+/*
+    Give the slot map of a slotted file room for at least numberOfPages
+    pages, writing the grown map to the end of the file (openFilesLock held).
+    The caller points the header at it.
+*/
+static RC growSlotMap(SM_FileMgmt *mgmt, PageNumber numberOfPages) {
+    SM_SharedFile *shared = mgmt->shared;
+    PageNumber newCapacity = 2 * shared->capacityPages;
+    if (newCapacity < numberOfPages) newCapacity = numberOfPages;
+
+    pthread_mutex_lock(&shared->slotLock);
+    RC rc = RC_WRITE_FAILED;
+    SM_PageSlot *slots = (SM_PageSlot *) realloc(shared->slots, (size_t) newCapacity * sizeof(SM_PageSlot));
+    if (slots != NULL && shared->movedMap != NULL) {
+        unsigned char *moved = (unsigned char *) realloc(shared->movedMap, (size_t) (newCapacity + 7) / 8);
+        if (moved == NULL) {
+            shared->slots = slots;      // the larger map is fine, the entries past capacityPages unused
+            pthread_mutex_unlock(&shared->slotLock);
+            return RC_WRITE_FAILED;
+        }
+        memset(moved + (shared->capacityPages + 7) / 8, 0,
+               (size_t) ((newCapacity + 7) / 8 - (shared->capacityPages + 7) / 8));
+        shared->movedMap = moved;
+    }
+    if (slots != NULL) {
+        shared->slots = slots;
+        memset(slots + shared->capacityPages, 0, (size_t) (newCapacity - shared->capacityPages) * sizeof(SM_PageSlot));
+        off_t offset = shared->dataEnd;
+        rc = pwriteFully(mgmt->backend, mgmt->fd, slots, (size_t) newCapacity * sizeof(SM_PageSlot), offset);
+        if (rc == RC_OK) {
+            shared->dataEnd += (off_t) newCapacity * (off_t) sizeof(SM_PageSlot);
+            shared->slotMapOffset = offset;
+            shared->capacityPages = newCapacity;
+        }
+    }
+    pthread_mutex_unlock(&shared->slotLock);
+    return rc;
+}
+
+/*
+    Forget the snapshot a handle reads through and punch the page images
+    only it still kept alive. Called when the snapshot handle closes.
+*/
+static void releaseSnapshot(SM_FileMgmt *mgmt) {
+    SM_SharedFile *shared = mgmt->shared;
+    SM_Snapshot *snap = mgmt->snapshot;
+    pthread_mutex_lock(&shared->slotLock);
+    SM_Snapshot **link = &shared->snapshots;
+    while (*link != snap) {
+        link = &(*link)->next;
+    }
+    *link = snap->next;
+    if (shared->snapshots == NULL) {
+        free(shared->movedMap);     // pages may be rewritten in place again
+        shared->movedMap = NULL;
+    }
+    pthread_mutex_unlock(&shared->slotLock);
+    mgmt->snapshot = NULL;
+    free(snap->slots);
+    free(snap);
+    punchDeadSpace(mgmt);
+}
+
+/* give a page's blocks back to the file system; true if it reads as zeros now */
+static bool punchPage(SM_FileMgmt *mgmt, PageNumber pageNum) {
+    if (mgmt->shared->slotted) {
+        return releaseSlottedPage(mgmt, pageNum) == RC_OK;
+    }
+    return punchRange(mgmt->backend, mgmt->fd, PAGE_OFFSET(pageNum, mgmt->shared->pageSize), mgmt->shared->pageSize);
+}
+
+/* one page to or from its place in the file, whatever the file's layout */
+static RC transferOne(SM_FileMgmt *mgmt, PageNumber pageNum, SM_PageHandle memPage, bool isWrite) {
+    if (isWrite && mgmt->snapshot != NULL) {
+        return RC_SM_READ_ONLY;
+    }
+    if (mgmt->shared->slotted) {
+        return isWrite ? writeSlottedPage(mgmt, pageNum, memPage)
+                       : readSlottedPage(mgmt, pageNum, memPage);
+    }
+    return transferPage(mgmt, memPage, PAGE_OFFSET(pageNum, mgmt->shared->pageSize), isWrite);
+}
+
+/*
+    (Re)map the header page plus every data page of a mapped file.
+    The first call reserves an address window; later calls map the grown file
+    over the same window with MAP_FIXED, so existing page pointers stay put.
+    Only if the file outgrows the window is a larger window reserved elsewhere;
+    the old one is kept (oldMaps), pointers into it stay usable.
+*/
+static RC remapFile(SM_FileHandle *fHandle) {
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    size_t needed = (size_t) (fHandle->totalNumPages + 1) * mgmt->shared->pageSize;
+
+    if (mgmt->map != NULL && needed == mgmt->mapLen) {
+        return RC_OK;       // nothing new to map
+    }
+
+    if (mgmt->map == NULL || needed > mgmt->mapReserved) {
+        size_t reserve = SM_MAP_RESERVE_BYTES;
+        while (reserve < 2 * needed) {
+            reserve *= 2;
+        }
+        // PROT_NONE placeholder: costs address space only, no memory
+        void *window = mmap(NULL, reserve, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (window == MAP_FAILED) {
+            return RC_SM_MAP_FAILED;
+        }
+        if (mgmt->map != NULL) {
+            SM_OldMap *old = (SM_OldMap *) malloc(sizeof(SM_OldMap));
+            if (old == NULL) {
+                munmap(window, reserve);
+                return RC_SM_MAP_FAILED;
+            }
+            old->map = mgmt->map;
+            old->reserved = mgmt->mapReserved;
+            old->next = mgmt->oldMaps;
+            mgmt->oldMaps = old;
+        }
+        mgmt->map = (char *) window;
+        mgmt->mapReserved = reserve;
+        mgmt->mapLen = 0;
     }
 
-    for (int i = 0; i < PAGE_SIZE; i += 2) {
-        buffer[i] = '\0';
-        if (i + 1 < PAGE_SIZE) buffer[i + 1] = '\0';
+    void *mapped = mmap(mgmt->map, needed, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_FIXED, mgmt->fd, 0);
+    if (mapped == MAP_FAILED) {
+        return RC_SM_MAP_FAILED;
     }
+    mgmt->mapLen = needed;
+    return RC_OK;
+}
+
+// most iovecs a single preadv/pwritev accepts
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/*
+    preadv/pwritev the whole iovec array at offset. A short transfer is resumed
+    from where it stopped, so the caller always gets all bytes or an error.
+    The iovec array is consumed (modified) in the process.
+*/
+static RC pvFully(const SM_Backend *backend, int fd, struct iovec *iov, int iovcnt, off_t offset, bool isWrite) {
+    ssize_t (*vectored) (int, const struct iovec *, int, off_t) = isWrite ? backend->pwritev : backend->preadv;
+    if (vectored == NULL) {
+        // a backend without vectored calls: one transfer per buffer
+        for (int i = 0; i < iovcnt; i++) {
+            RC rc = isWrite ? pwriteFully(backend, fd, iov[i].iov_base, iov[i].iov_len, offset)
+                            : preadFully(backend, fd, iov[i].iov_base, iov[i].iov_len, offset);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            offset += (off_t) iov[i].iov_len;
+        }
+        return RC_OK;
+    }
+    while (iovcnt > 0) {
+        ssize_t n = vectored(fd, iov, iovcnt, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        }
+        if (n == 0) {
+            return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        }
+        offset += n;
+
+        // drop the fully transferred buffers, trim the partially transferred one
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= (ssize_t) iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= (size_t) n;
+        }
+    }
+    return RC_OK;
+}
 
-    // write PAGE_SIZE bytes to the file
-    size_t written = fwrite(buffer, sizeof(char), PAGE_SIZE, file);
-    free(buffer);
-    if (written != PAGE_SIZE) {
-        fclose(file);
+/*
+    Write the cached header of an open file in one small pwrite
+    (openFilesLock held). unclean says whether the page count may run ahead
+    of what is written now. O_DIRECT handles cannot write a few bytes, they
+    rewrite the first PAGE_SIZE bytes of the header page from an aligned
+    buffer (the rest of the header page is zero anyway).
+*/
+static RC writeHeader(SM_FileHandle *fHandle, bool unclean) {
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    SM_SharedFile *shared = mgmt->shared;
+    SM_FileHeader header;
+    memset(&header, 0, sizeof(SM_FileHeader));
+    header.magic = SM_HEADER_MAGIC;
+    header.version = SM_FORMAT_VERSION;
+    header.totalNumPages = shared->totalNumPages;
+    header.capacityPages = shared->capacityPages;
+    header.extentPages = shared->extentPages;
+    header.unclean = unclean ? 1 : 0;
+    header.freeTrunk = shared->freeTrunk;
+    header.freeCount = shared->freeCount;
+    header.pageSize = shared->pageSize;
+    header.features = (shared->checksums ? SM_PAGE_CHECKSUMS : 0) | (shared->compressed ? SM_PAGE_COMPRESSED : 0)
+                      | (shared->slotted && !shared->compressed ? SM_PAGE_SNAPSHOTS : 0)
+                      | (shared->doublewrite ? SM_PAGE_DOUBLEWRITE : 0);
+    header.syncPolicy = shared->syncPolicy;
+    header.syncPages = shared->syncPages;
+    header.syncMillis = shared->syncMillis;
+    header.slotMap = shared->slotMapOffset;
+
+    RC rc;
+    if (!mgmt->direct) {
+        rc = pwriteFully(mgmt->backend, mgmt->fd, &header, sizeof(SM_FileHeader), 0);
+    } else {
+        SM_PageHandle page = allocPageBuffer();
+        if (page == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        memset(page, 0, PAGE_SIZE);
+        memcpy(page, &header, sizeof(SM_FileHeader));
+        rc = pwriteFully(mgmt->backend, mgmt->fd, page, PAGE_SIZE, 0);
+        freePageBuffer(page);
+    }
+    if (rc != RC_OK) {
         return RC_WRITE_FAILED;
     }
-   
-    // close the file
-    fclose(file);
+
+    shared->headerDirty = false;
+    shared->markedUnclean = unclean;
     return RC_OK;
 }
 
+/*
+    Pick up what other handles on the same file did: take over the shared page
+    count, and extend this handle's mapping if the file grew underneath it.
+*/
+static RC refreshHandle(SM_FileHandle *fHandle) {
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    if (mgmt->snapshot != NULL) {
+        fHandle->totalNumPages = mgmt->snapshot->totalNumPages;     // a snapshot does not grow
+        return RC_OK;
+    }
+    fHandle->totalNumPages = __atomic_load_n(&mgmt->shared->totalNumPages, __ATOMIC_ACQUIRE);
+    if (mgmt->map != NULL && (size_t) (fHandle->totalNumPages + 1) * mgmt->shared->pageSize > mgmt->mapLen) {
+        return remapFile(fHandle);
+    }
+    return RC_OK;
+}
 
-RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
-    /* 
-        Open an existing page file. 
-        If the file does not exist, return "RC_FILE_NOT_FOUND".
-        The second input parameter is the file handle to be filled.
-        IF succeed, initialize all fields of the file handle with the file's info.   
-    */
-    FILE *file = fopen(fileName, "rb+");
-    if (file == NULL) {
-        return RC_FILE_NOT_FOUND;
+/*
+    Sync policy. Every page write through a handle ends in notePagesWritten,
+    which issues the fdatasync the file's policy asks for: after every write
+    (SM_SYNC_STRICT), once enough pages or time piled up (SM_SYNC_GROUP), or
+    not at all. Pages still pending when the last handle closes are synced
+    then, unless the policy is SM_SYNC_NONE. Asynchronous writes count towards
+    the pending pages as well, except under SM_SYNC_STRICT: there the engine
+    issues the fdatasync itself, and a write request is only done after it.
+*/
+static long long syncCount = 0;     // fdatasync calls issued so far (atomic)
+
+static long long monotonicMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* force everything written through the handle (and its mapping) to stable storage */
+static RC syncData(SM_FileMgmt *mgmt) {
+    SM_SharedFile *shared = mgmt->shared;
+    if (mgmt->map != NULL && msync(mgmt->map, mgmt->mapLen, MS_SYNC) != 0) {
+        return RC_WRITE_FAILED;
+    }
+    if (mgmt->backend->sync(mgmt->fd) != 0) {
+        return RC_WRITE_FAILED;
     }
+    __atomic_add_fetch(&syncCount, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->unsyncedPages, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->lastSyncMs, monotonicMs(), __ATOMIC_RELAXED);
+    return RC_OK;
+}
 
-    // allocate a page for reading header page
-    SM_PageHandle header = (SM_PageHandle) malloc(PAGE_SIZE);
-    if (header == NULL) {
-        fclose(file);
-        return RC_WRITE_FAILED; 
-    } 
+static RC notePagesWritten(SM_FileMgmt *mgmt, int pages) {
+    SM_SharedFile *shared = mgmt->shared;
+    int pending = __atomic_add_fetch(&shared->unsyncedPages, pages, __ATOMIC_RELAXED);
+    switch (shared->syncPolicy) {
+    case SM_SYNC_STRICT:
+        return syncData(mgmt);
+    case SM_SYNC_GROUP:
+        if ((shared->syncPages > 0 && pending >= shared->syncPages)
+            || (shared->syncMillis > 0
+                && monotonicMs() - __atomic_load_n(&shared->lastSyncMs, __ATOMIC_RELAXED) >= shared->syncMillis)) {
+            return syncData(mgmt);
+        }
+        return RC_OK;
+    default:
+        return RC_OK;
+    }
+}
 
-    size_t readBytes = fread(header, sizeof(char), PAGE_SIZE, file);  // read a whole page (4096 bytes) of data from the file and put it into the header buffer
-    if (readBytes != PAGE_SIZE) {
-        free(header);
-        fclose(file);
-        return RC_READ_NON_EXISTING_PAGE;
+/*
+    Doublewrite (SM_PAGE_DOUBLEWRITE). A page write the system crashes in the
+    middle of leaves a torn page, half old and half new, that neither the old
+    nor the new contents can be recovered from. So before the pages of a write
+    go out in place, the batch (up to SM_DOUBLEWRITE_PAGES pages) is written
+    sequentially to the doublewrite file, behind a header page listing where
+    each image belongs, and synced there once. The in-place copies are only
+    synced right before the next batch overwrites the doublewrite file (or
+    when the last handle closes), so a batch costs one sequential sync instead
+    of one random sync per page. Opening the file puts back every page of the
+    last batch whose in-place copy fails its checksum; the checksum is how a
+    torn page is told apart, so doublewrite needs SM_PAGE_CHECKSUMS. A
+    slotted file never overwrites a page in place and does not take it.
+*/
+#define SM_DOUBLEWRITE_MAGIC 0x57444d53     // "SMDW" on disk
+
+typedef struct SM_DoublewriteHeader {
+    int32_t magic;              // SM_DOUBLEWRITE_MAGIC
+    int32_t pageSize;           // size of the images, the page file's page size
+    int32_t count;              // images following the header page
+    uint32_t crc;               // CRC32C of the header page, taken with this field zero
+    int64_t pageNums[SM_DOUBLEWRITE_PAGES]; // page each image belongs to
+} SM_DoublewriteHeader;
+
+static long long dwRepairs = 0;     // pages put back from doublewrite files so far (atomic)
+
+/* the doublewrite file's name for a page file, malloc'ed; NULL when out of memory */
+static char *doublewriteName(const char *fileName) {
+    char *dwName = (char *) malloc(strlen(fileName) + sizeof(SM_DOUBLEWRITE_SUFFIX));
+    if (dwName != NULL) {
+        strcat(strcpy(dwName, fileName), SM_DOUBLEWRITE_SUFFIX);
     }
+    return dwName;
+}
 
-    int totalPages;
-    // when initializing, we stored total number of pages in the first int of header;
-    // now we read it back into totalPages
-    memcpy(&totalPages, header, sizeof(int)); 
-    free(header);   
+/*
+    Copy count pages to the doublewrite file and sync it: pages[i] belongs to
+    page pageNums[i], or to startPage + i when pageNums is NULL. On success
+    dwLock stays held, the caller writes the pages in place and then calls
+    doublewriteEnd; nobody may overwrite the batch before they are in place.
+*/
+static RC doublewriteBegin(SM_FileMgmt *mgmt, const PageNumber *pageNums, PageNumber startPage,
+                           SM_PageHandle *pages, int count) {
+    SM_SharedFile *shared = mgmt->shared;
+    int pageSize = shared->pageSize;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&shared->dwLock);
 
-    // initial SM_FileHandle
-    fHandle->fileName = fileName;
-    fHandle->totalNumPages = totalPages;
-    fHandle->curPagePos = 0;       //  Defualt is header page (number 0)
-    fHandle->mgmtInfo = file;      //  FILE* pointer
-    
+    // the last batch is about to be overwritten: its pages have to be durable in place by now
+    if (shared->dwPending) {
+        rc = syncData(mgmt);
+        if (rc != RC_OK) goto failed;
+        shared->dwPending = false;
+    }
+    if (shared->dwFd < 0) {
+        shared->dwFd = mgmt->backend->open(shared->dwName, O_RDWR | O_CREAT, 0644);
+        if (shared->dwFd < 0) {
+            rc = RC_WRITE_FAILED;
+            goto failed;
+        }
+    }
+
+    char *batch = (char *) calloc((size_t) count + 1, (size_t) pageSize);
+    if (batch == NULL) {
+        rc = RC_WRITE_FAILED;
+        goto failed;
+    }
+    SM_DoublewriteHeader *header = (SM_DoublewriteHeader *) batch;
+    header->magic = SM_DOUBLEWRITE_MAGIC;
+    header->pageSize = pageSize;
+    header->count = count;
+    for (int i = 0; i < count; i++) {
+        char *image = batch + (size_t) (i + 1) * pageSize;
+        header->pageNums[i] = pageNums != NULL ? pageNums[i] : startPage + i;
+        memcpy(image, pages[i], pageSize);
+        stampPage(shared, image);
+    }
+    header->crc = crc32c(0, batch, (size_t) pageSize);
+    rc = pwriteFully(mgmt->backend, shared->dwFd, batch, (size_t) (count + 1) * pageSize, 0);
+    free(batch);
+    if (rc == RC_OK && mgmt->backend->sync(shared->dwFd) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc != RC_OK) goto failed;
+    __atomic_add_fetch(&syncCount, 1, __ATOMIC_RELAXED);
+    return RC_OK;
+
+failed:
+    pthread_mutex_unlock(&shared->dwLock);
+    return RC_WRITE_FAILED;
+}
+
+static void doublewriteEnd(SM_FileMgmt *mgmt) {
+    mgmt->shared->dwPending = true;
+    pthread_mutex_unlock(&mgmt->shared->dwLock);
+}
+
+/*
+    Put back torn pages from the doublewrite file of a file nobody has open
+    (openFilesLock held). A page is only replaced when its in-place copy fails
+    its checksum and the image passes; pages past the end of the file were
+    never written in place and are skipped, and so is a batch whose header
+    does not check out (it tore itself, so its pages never left).
+*/
+static void recoverDoublewrite(const SM_Backend *backend, int fd, SM_SharedFile *shared) {
+    int dwFd = backend->open(shared->dwName, O_RDWR, 0);
+    if (dwFd < 0) {
+        return;     // no batch was ever written
+    }
+    shared->dwFd = dwFd;
+
+    int pageSize = shared->pageSize;
+    SM_PageHandle headerPage = allocPageBufferSized(pageSize);
+    SM_PageHandle image = allocPageBufferSized(pageSize);
+    SM_PageHandle inPlace = allocPageBufferSized(pageSize);
+    if (headerPage == NULL || image == NULL || inPlace == NULL
+        || preadFully(backend, dwFd, headerPage, pageSize, 0) != RC_OK) {
+        goto finally;
+    }
+    SM_DoublewriteHeader *header = (SM_DoublewriteHeader *) headerPage;
+    uint32_t crc = header->crc;
+    header->crc = 0;
+    if (header->magic != SM_DOUBLEWRITE_MAGIC || header->pageSize != pageSize || header->count <= 0
+        || header->count > SM_DOUBLEWRITE_PAGES || crc32c(0, headerPage, (size_t) pageSize) != crc) {
+        goto finally;
+    }
+
+    int repaired = 0;
+    for (int i = 0; i < header->count; i++) {
+        off_t offset = PAGE_OFFSET(header->pageNums[i], pageSize);
+        if (header->pageNums[i] < 0
+            || preadFully(backend, dwFd, image, pageSize, (off_t) (i + 1) * pageSize) != RC_OK
+            || !pageChecksumOk(image, pageSize)
+            || preadFully(backend, fd, inPlace, pageSize, offset) != RC_OK
+            || pageChecksumOk(inPlace, pageSize)) {
+            continue;
+        }
+        if (pwriteFully(backend, fd, image, pageSize, offset) == RC_OK) {
+            repaired++;
+        }
+    }
+    if (repaired > 0 && backend->sync(fd) == 0) {
+        __atomic_add_fetch(&syncCount, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&dwRepairs, repaired, __ATOMIC_RELAXED);
+
+finally:
+    freePageBuffer(headerPage);
+    freePageBuffer(image);
+    freePageBuffer(inPlace);
+}
+
+/*
+    Make room for at least numberOfPages data pages on disk.
+    Capacity grows in whole extents with one backend extend call (fallocate, or
+    ftruncate where the file system cannot preallocate); either way the new
+    pages read back as zeros.
+    The caller updates the header.
+*/
+static RC growCapacity(PageNumber numberOfPages, SM_FileHandle *fHandle) {
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    SM_SharedFile *shared = mgmt->shared;
+    if (numberOfPages <= shared->capacityPages) {
+        return RC_OK;
+    }
+    if (shared->slotted) {
+        return growSlotMap(mgmt, numberOfPages);    // pages take no space until written
+    }
+
+    PageNumber missing = numberOfPages - shared->capacityPages;
+    PageNumber extents = (missing + shared->extentPages - 1) / shared->extentPages;
+    PageNumber newCapacity = shared->capacityPages + extents * shared->extentPages;
+
+    off_t oldEnd = PAGE_OFFSET(shared->capacityPages, shared->pageSize);
+    off_t newEnd = PAGE_OFFSET(newCapacity, shared->pageSize);
+    if (mgmt->backend->extend(mgmt->fd, oldEnd, newEnd - oldEnd) != 0) {
+        return RC_WRITE_FAILED;
+    }
+
+    shared->capacityPages = newCapacity;
     return RC_OK;
 }
 
+/* manipulating page files */
+void initStorageManager(void) {
+    // 
+}
+
+
+/* create a file */
+RC createPageFile(char *fileName) {
+    // a new file with the default page size
+    return createPageFileWithPageSize(fileName, PAGE_SIZE);
+}
+
+RC createPageFileWithPageSize(char *fileName, int pageSize) {
+    /*
+        Create a page file whose pages (header page included) are pageSize bytes.
+        The size is stored in the header and used by every handle on the file;
+        it has to be a power of two between SM_MIN_PAGE_SIZE and SM_MAX_PAGE_SIZE.
+    */
+    return createPageFileWithOptions(fileName, pageSize, 0);
+}
+
+RC createPageFileWithOptions(char *fileName, int pageSize, int options) {
+    /*
+        Same, with SM_PAGE_CHECKSUMS in options for a file whose pages end in a
+        CRC32C trailer. Callers of such a file own only the first
+        getPageDataSize bytes of a page. SM_PAGE_COMPRESSED stores every page
+        compressed, taking only as much disk as it compresses to; such a file
+        cannot be mapped, and O_DIRECT handles on it do buffered I/O.
+        SM_PAGE_SNAPSHOTS keeps the pages uncompressed in the same slots, so
+        that createSnapshot can freeze them; SM_PAGE_COMPRESSED files take
+        snapshots as well. SM_PAGE_DOUBLEWRITE (with SM_PAGE_CHECKSUMS, on a
+        file with neither) protects the pages against torn writes, see
+        setDoublewrite.
+    */
+    if (!IS_VALID_PAGE_SIZE(pageSize)) {
+        return RC_SM_INVALID_PAGE_SIZE;
+    }
+    bool checksums = (options & SM_PAGE_CHECKSUMS) != 0;
+    bool compressed = (options & SM_PAGE_COMPRESSED) != 0;
+    bool slotted = compressed || (options & SM_PAGE_SNAPSHOTS) != 0;
+    bool doublewrite = (options & SM_PAGE_DOUBLEWRITE) != 0;
+    if (doublewrite && (!checksums || slotted)) {
+        return RC_SM_UNSUPPORTED_FORMAT;
+    }
+
+    // write a new file; a doublewrite file left by an older file of that name
+    // would put the old pages back into the new one
+    const SM_Backend *backend = getStorageBackend(fileName);
+    char *dwName = doublewriteName(fileName);
+    if (dwName == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    backend->unlink(dwName);
+    free(dwName);
+    int fd = backend->open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    // failed to open file
+    if (fd < 0) { 
+        //printf("open failed: %s\n", strerror(errno));
+        return RC_FILE_NOT_FOUND;   
+    }
+
+    // allocate the header page and the first (empty) data page in one buffer,
+    // so the new file goes out with a single write; a slotted file has no
+    // slot for the empty page yet, only an empty slot map for one extent
+    size_t fileLen = slotted ? pageSize + SM_DEFAULT_EXTENT_PAGES * sizeof(SM_PageSlot) : 2 * (size_t) pageSize;
+    SM_PageHandle pages = (SM_PageHandle) calloc(1, fileLen);
+    if (pages == NULL) {
+        backend->close(fd);
+        return RC_WRITE_FAILED;
+    }
+
+    // store total number of pages in header page
+    SM_FileHeader header;
+    memset(&header, 0, sizeof(SM_FileHeader));
+    header.magic = SM_HEADER_MAGIC;
+    header.version = SM_FORMAT_VERSION;
+    header.totalNumPages = 1;
+    header.capacityPages = slotted ? SM_DEFAULT_EXTENT_PAGES : 1;
+    header.extentPages = SM_DEFAULT_EXTENT_PAGES;
+    header.unclean = 0;
+    header.freeTrunk = 0;
+    header.freeCount = 0;
+    header.pageSize = pageSize;
+    header.features = (checksums ? SM_PAGE_CHECKSUMS : 0) | (compressed ? SM_PAGE_COMPRESSED : 0)
+                      | (slotted && !compressed ? SM_PAGE_SNAPSHOTS : 0) | (doublewrite ? SM_PAGE_DOUBLEWRITE : 0);
+    header.slotMap = slotted ? pageSize : 0;
+    memcpy(pages, &header, sizeof(SM_FileHeader)); 
+    // header is like | "SMPF" | 02 00 00 00 | 01 00 .. 00 (8 bytes) | 01 00 .. 00 | 00 .. | 00 .. | 40 00 00 00 | 00 00 00 00 | 00 10 00 00 | ...all are 0... |
+
+    if (checksums && !slotted) {
+        // page 0 goes out with a valid trailer like every later write
+        uint32_t crc = crc32c(0, pages + pageSize, (size_t) (pageSize - SM_PAGE_TRAILER_SIZE));
+        memcpy(pages + 2 * pageSize - SM_PAGE_TRAILER_SIZE, &crc, sizeof(crc));
+    }
+
+    // write header page + page 0 to the file
+    RC rc = pwriteFully(backend, fd, pages, fileLen, 0);
+    free(pages);
+    if (rc != RC_OK) {
+        backend->close(fd);
+        return RC_WRITE_FAILED;
+    }
+
+    // O_TRUNC kept the inode: handles still open on the old contents see the new header
+    struct stat st;
+    if (backend->stat(fd, &st) == 0) {
+        pthread_mutex_lock(&openFilesLock);
+        for (SM_SharedFile *f = openFiles; f != NULL; f = f->next) {
+            if (f->backend == backend && f->dev == st.st_dev && f->ino == st.st_ino) {
+                f->pageSize = pageSize;
+                f->checksums = checksums;
+                f->verifyChecksums = true;
+                pthread_mutex_lock(&f->slotLock);
+                free(f->slots);
+                f->slotted = slotted;
+                f->compressed = compressed;
+                f->slots = slotted ? (SM_PageSlot *) calloc(header.capacityPages, sizeof(SM_PageSlot)) : NULL;
+                f->slotMapOffset = header.slotMap;
+                f->dataEnd = (off_t) fileLen;
+                pthread_mutex_unlock(&f->slotLock);
+                pthread_mutex_lock(&f->dwLock);
+                f->doublewrite = doublewrite;
+                if (f->dwFd >= 0) backend->close(f->dwFd);
+                f->dwFd = -1;
+                f->dwPending = false;
+                pthread_mutex_unlock(&f->dwLock);
+                f->syncPolicy = SM_SYNC_NONE;
+                f->syncPages = 0;
+                f->syncMillis = 0;
+                f->totalNumPages = header.totalNumPages;
+                f->capacityPages = header.capacityPages;
+                f->extentPages = header.extentPages;
+                f->headerDirty = false;
+                f->markedUnclean = false;
+                f->freeTrunk = 0;
+                f->freeCount = 0;
+                free(f->freeMap);
+                f->freeMap = NULL;
+                f->freeMapPages = 0;
+            }
+        }
+        pthread_mutex_unlock(&openFilesLock);
+    }
+   
+    // close the file
+    if (backend->close(fd) != 0) {
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+
+/*
+    Read the header of a file nobody in this process has open yet, converting
+    a version 1 header on the way (*version tells which one was found).
+    The fields sit in the first PAGE_SIZE bytes whatever the file's page size.
+    O_DIRECT descriptors read the whole header page into an aligned buffer; a
+    file system that accepts O_DIRECT at open time but rejects the transfer
+    (EINVAL) gets the flag cleared again, the handle then does buffered I/O.
+*/
+static RC readHeader(const SM_Backend *backend, int fd, int *oflags, SM_FileHeader *header, int *version) {
+    RC rc;
+    if (!(*oflags & O_DIRECT)) {
+        rc = preadFully(backend, fd, header, sizeof(SM_FileHeader), 0);
+    } else {
+        SM_PageHandle headerPage = allocPageBuffer();
+        if (headerPage == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        rc = preadFully(backend, fd, headerPage, PAGE_SIZE, 0);
+        if (rc != RC_OK && errno == EINVAL) {
+            *oflags &= ~O_DIRECT;
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            rc = preadFully(backend, fd, headerPage, PAGE_SIZE, 0);
+        }
+        memcpy(header, headerPage, sizeof(SM_FileHeader));
+        freePageBuffer(headerPage);
+    }
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    if (header->magic == SM_HEADER_MAGIC) {
+        *version = header->version;
+        return header->version <= SM_FORMAT_VERSION ? RC_OK : RC_SM_UNSUPPORTED_FORMAT;
+    }
+
+    // no magic: a version 1 file, its ints sit where the new header starts
+    SM_FileHeaderV1 old;
+    memcpy(&old, header, sizeof(SM_FileHeaderV1));
+    header->totalNumPages = old.totalNumPages;
+    header->capacityPages = old.capacityPages;
+    header->extentPages = old.extentPages;
+    header->unclean = old.unclean;
+    header->freeTrunk = old.freeTrunk;
+    header->freeCount = old.freeCount;
+    header->pageSize = 0;
+    header->features = 0;
+    header->syncPolicy = SM_SYNC_NONE;
+    header->syncPages = 0;
+    header->syncMillis = 0;
+    header->slotMap = 0;
+    *version = 1;
+    return RC_OK;
+}
+
+static RC upgradeFreeList(SM_FileHandle *fHandle);
+
+/*
+    Page count of a file that was not closed cleanly. The header on disk was
+    written when the last extent was allocated, so only pages of that extent
+    (from .. to-1) can be missing from its count. An extent's spare pages read
+    back as zeros until they are written: the last page that does not ends the
+    file. A page that cannot be read is taken as written.
+*/
+static PageNumber lastWrittenPage(const SM_Backend *backend, int fd, int pageSize,
+                                  PageNumber from, PageNumber to) {
+    SM_PageHandle page = allocPageBufferSized(pageSize);
+    if (page == NULL) {
+        return to;
+    }
+    PageNumber last = from;
+    for (PageNumber p = to - 1; p >= from; p--) {
+        if (preadFully(backend, fd, page, (size_t) pageSize, PAGE_OFFSET(p, pageSize)) != RC_OK
+            || !isZeroPage(page, pageSize)) {
+            last = p + 1;
+            break;
+        }
+    }
+    freePageBuffer(page);
+    return last;
+}
+
+/*
+    Open the file with the given open(2) flags and attach it to the shared
+    header cache. Only the first handle on a file reads the header from disk;
+    later ones take the cached copy, which may be ahead of the disk.
+    Only kernel files know O_DIRECT; other backends open buffered.
+*/
+static RC openWithFlags(char *fileName, SM_FileHandle *fHandle, int oflags) {
+    const SM_Backend *backend = getStorageBackend(fileName);
+    if (!backend->native) {
+        oflags &= ~O_DIRECT;
+    }
+    int fd = backend->open(fileName, oflags, 0);
+    if (fd < 0 && errno == EINVAL && (oflags & O_DIRECT)) {
+        oflags &= ~O_DIRECT;        // no O_DIRECT support at all (e.g. older tmpfs)
+        fd = backend->open(fileName, oflags, 0);
+    }
+    if (fd < 0) {
+        return RC_FILE_NOT_FOUND;
+    }
+
+    struct stat st;
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) malloc(sizeof(SM_FileMgmt));
+    if (mgmt == NULL || backend->stat(fd, &st) != 0) {
+        free(mgmt);
+        backend->close(fd);
+        return RC_WRITE_FAILED; 
+    }
+
+    RC rc = RC_OK;
+    int version = SM_FORMAT_VERSION;
+    pthread_mutex_lock(&openFilesLock);
+    SM_SharedFile *shared = openFiles;
+    while (shared != NULL && !(shared->backend == backend && shared->dev == st.st_dev && shared->ino == st.st_ino)) {
+        shared = shared->next;
+    }
+
+    if (shared == NULL) {
+        // when initializing, we stored the page counts in the first ints of the header;
+        // only those are needed, so read them back directly
+        SM_FileHeader header;
+        shared = (SM_SharedFile *) malloc(sizeof(SM_SharedFile));
+        char *dwName = doublewriteName(fileName);
+        if (shared == NULL || dwName == NULL) {
+            free(shared);
+            free(dwName);
+            rc = RC_WRITE_FAILED;
+            goto finally;
+        }
+        rc = readHeader(backend, fd, &oflags, &header, &version);
+        if (rc != RC_OK) {
+            free(dwName);
+            free(shared);
+            if (rc != RC_SM_UNSUPPORTED_FORMAT) {
+                rc = RC_READ_NON_EXISTING_PAGE;
+            }
+            goto finally;
+        }
+
+        // files from before the page size was stored use the default one
+        int pageSize = header.pageSize > 0 ? header.pageSize : PAGE_SIZE;
+        if (!IS_VALID_PAGE_SIZE(pageSize)
+            || (header.features & ~(SM_PAGE_CHECKSUMS | SM_PAGE_COMPRESSED | SM_PAGE_SNAPSHOTS | SM_PAGE_DOUBLEWRITE)) != 0
+            || header.syncPolicy < SM_SYNC_NONE || header.syncPolicy > SM_SYNC_STRICT) {
+            free(dwName);
+            free(shared);
+            rc = RC_SM_UNSUPPORTED_FORMAT;
+            goto finally;
+        }
+
+        bool compressed = (header.features & SM_PAGE_COMPRESSED) != 0;
+        bool slotted = (header.features & (SM_PAGE_COMPRESSED | SM_PAGE_SNAPSHOTS)) != 0;
+        SM_PageSlot *slots = NULL;
+        if (slotted) {
+            if (oflags & O_DIRECT) {
+                oflags &= ~O_DIRECT;        // slots are not block aligned
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            }
+            // the slot map says which pages exist: an unclean file trusts it over the page count
+            slots = (SM_PageSlot *) malloc((size_t) header.capacityPages * sizeof(SM_PageSlot));
+            if (slots == NULL || header.capacityPages < header.totalNumPages
+                || preadFully(backend, fd, slots, (size_t) header.capacityPages * sizeof(SM_PageSlot), header.slotMap) != RC_OK) {
+                free(slots);
+                free(dwName);
+                free(shared);
+                rc = RC_READ_NON_EXISTING_PAGE;
+                goto finally;
+            }
+            for (PageNumber p = header.capacityPages - 1; header.unclean && p >= header.totalNumPages; p--) {
+                if (slots[p].offset != 0) {
+                    header.totalNumPages = p + 1;
+                    break;
+                }
+            }
+        }
+
+        // older files have no capacity/extent fields yet
+        PageNumber allocated = slotted ? 0 : (PageNumber) (st.st_size / pageSize) - 1;
+        bool noExtents = header.capacityPages < header.totalNumPages;
+        if (noExtents) {
+            header.capacityPages = allocated;
+            if (header.capacityPages < header.totalNumPages) {
+                header.capacityPages = header.totalNumPages;
+            }
+        }
+        if (header.extentPages <= 0) {
+            header.extentPages = SM_DEFAULT_EXTENT_PAGES;
+        }
+        // not closed cleanly: the page count on disk may be stale. A file
+        // without extents grew page by page, its size is the count; otherwise
+        // the size includes the extent's spare pages, look for the last written
+        if (header.unclean && allocated > header.totalNumPages) {
+            header.totalNumPages = noExtents ? allocated
+                                 : lastWrittenPage(backend, fd, pageSize, header.totalNumPages, allocated);
+            if (header.capacityPages < allocated) {
+                header.capacityPages = allocated;
+            }
+        }
+
+        shared->backend = backend;
+        shared->dev = st.st_dev;
+        shared->ino = st.st_ino;
+        shared->refCount = 0;
+        shared->pageSize = pageSize;
+        shared->checksums = (header.features & SM_PAGE_CHECKSUMS) != 0;
+        shared->verifyChecksums = true;
+        shared->slotted = slotted;
+        shared->compressed = compressed;
+        shared->slots = slots;
+        shared->snapshots = NULL;
+        shared->movedMap = NULL;
+        shared->slotMapOffset = header.slotMap;
+        shared->dataEnd = st.st_size;
+        pthread_mutex_init(&shared->slotLock, NULL);
+        shared->doublewrite = (header.features & SM_PAGE_DOUBLEWRITE) != 0;
+        shared->dwName = dwName;
+        shared->dwFd = -1;
+        shared->dwPending = false;
+        pthread_mutex_init(&shared->dwLock, NULL);
+        if (shared->doublewrite) {
+            recoverDoublewrite(backend, fd, shared);
+        }
+        shared->syncPolicy = (SM_SyncPolicy) header.syncPolicy;
+        shared->syncPages = header.syncPages;
+        shared->syncMillis = header.syncMillis;
+        shared->unsyncedPages = 0;
+        shared->lastSyncMs = monotonicMs();
+        shared->totalNumPages = header.totalNumPages;
+        shared->capacityPages = header.capacityPages;
+        shared->extentPages = header.extentPages;
+        shared->headerDirty = version < SM_FORMAT_VERSION;  // old format: upgraded on close
+        shared->markedUnclean = header.unclean != 0;     // rewritten clean on close
+        shared->freeTrunk = header.freeTrunk;
+        shared->freeCount = header.freeCount > 0 ? header.freeCount : 0;
+        shared->freeMap = NULL;
+        shared->freeMapPages = 0;
+        shared->next = openFiles;
+        openFiles = shared;
+    } else if (oflags & O_DIRECT) {
+        // the header comes from the cache, but the O_DIRECT probe still has to happen
+        SM_FileHeader ignored;
+        int ignoredVersion;
+        readHeader(backend, fd, &oflags, &ignored, &ignoredVersion);
+    }
+    if (shared->slotted && (oflags & O_DIRECT)) {
+        oflags &= ~O_DIRECT;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    }
+    shared->refCount++;
+
+    mgmt->backend = backend;
+    mgmt->fd = fd;
+    mgmt->shared = shared;
+    mgmt->direct = (oflags & O_DIRECT) != 0;
+    mgmt->map = NULL;
+    mgmt->mapLen = 0;
+    mgmt->mapReserved = 0;
+    mgmt->oldMaps = NULL;
+    mgmt->raLast = -1;
+    mgmt->raNext = 0;
+    mgmt->raWindow = 0;
+    mgmt->snapshot = NULL;
+
+    // initial SM_FileHandle
+    fHandle->fileName = fileName;
+    fHandle->totalNumPages = shared->totalNumPages;
+    fHandle->curPagePos = 0;       //  Defualt is header page (number 0)
+    fHandle->mgmtInfo = mgmt;      //  SM_FileMgmt holding the descriptor
+
+finally:
+    pthread_mutex_unlock(&openFilesLock);
+    if (rc != RC_OK) {
+        free(mgmt);
+        backend->close(fd);
+        return rc;
+    }
+    // a version 1 free list uses 32-bit trunks; rewrite it before anyone reads it
+    if (version < SM_FORMAT_VERSION && shared->freeCount > 0) {
+        rc = upgradeFreeList(fHandle);
+        if (rc != RC_OK) {
+            closePageFile(fHandle);
+        }
+    }
+    return rc;
+}
+
+RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
+    /* 
+        Open an existing page file. 
+        If the file does not exist, return "RC_FILE_NOT_FOUND".
+        The second input parameter is the file handle to be filled.
+        IF succeed, initialize all fields of the file handle with the file's info.   
+    */
+    return openWithFlags(fileName, fHandle, O_RDWR);
+}
+
+RC openPageFileDirect(char *fileName, SM_FileHandle *fHandle) {
+    /*
+        Open a page file with O_DIRECT, so page transfers bypass the kernel page
+        cache and the buffer pool is the only cache. Buffers from allocPageBuffer
+        go straight to the device; any other buffer is copied through an aligned
+        bounce page. Where the file system has no O_DIRECT the handle quietly
+        falls back to buffered I/O (see isPageFileDirect).
+    */
+    return openWithFlags(fileName, fHandle, O_RDWR | O_DIRECT);
+}
+
+bool isPageFileDirect(SM_FileHandle *fHandle) {
+    // true if the handle really bypasses the page cache
+    return fHandle != NULL && fHandle->mgmtInfo != NULL && ((SM_FileMgmt *) fHandle->mgmtInfo)->direct;
+}
+
+SM_PageHandle allocPageBuffer(void) {
+    /*
+        A PAGE_SIZE buffer aligned to SM_IO_ALIGNMENT, usable for O_DIRECT
+        transfers. Release it with freePageBuffer (plain free works too).
+    */
+    return allocPageBufferSized(PAGE_SIZE);
+}
+
+SM_PageHandle allocPageBufferSized(int pageSize) {
+    // same, for files with another page size (see getPageSize)
+    void *page = NULL;
+    if (pageSize <= 0 || posix_memalign(&page, SM_IO_ALIGNMENT, (size_t) pageSize) != 0) {
+        return NULL;
+    }
+    return (SM_PageHandle) page;
+}
+
+int getPageSize(SM_FileHandle *fHandle) {
+    // bytes per page of the open file, -1 for a handle that is not open
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return -1;
+    }
+    return ((SM_FileMgmt *) fHandle->mgmtInfo)->shared->pageSize;
+}
+
+int getPageDataSize(SM_FileHandle *fHandle) {
+    // bytes per page the caller may use: the page size minus the checksum trailer, if any
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return -1;
+    }
+    return PAGE_DATA_SIZE(((SM_FileMgmt *) fHandle->mgmtInfo)->shared);
+}
+
+RC setChecksumVerification(SM_FileHandle *fHandle, bool verify) {
+    /*
+        Switch trailer checks on reads on or off for the file (every handle on
+        it). Writes keep stamping the trailer either way, so verification can
+        be switched back on at any time. No effect on files without checksums.
+    */
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    pthread_mutex_lock(&openFilesLock);
+    shared->verifyChecksums = verify;
+    pthread_mutex_unlock(&openFilesLock);
+    return RC_OK;
+}
+
+void freePageBuffer(SM_PageHandle page) {
+    free(page);
+}
+
+
+RC openPageFileMapped(char *fileName, SM_FileHandle *fHandle) {
+    /*
+        Open a page file and map it into memory (MAP_SHARED).
+        Reads and writes through this handle become memcpy's against the mapping,
+        and getPagePtr hands out pointers straight into it, so the kernel page
+        cache doubles as the page buffer. Slotted files have no page
+        where a mapping could point, and files outside the kernel (memory
+        files) nothing to map; both give RC_SM_UNSUPPORTED_FORMAT.
+    */
+    RC rc = openPageFile(fileName, fHandle);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    if (mgmt->shared->slotted || !mgmt->backend->native) {
+        closePageFile(fHandle);
+        return RC_SM_UNSUPPORTED_FORMAT;
+    }
+
+    rc = remapFile(fHandle);
+    if (rc != RC_OK) {
+        closePageFile(fHandle);
+        return rc;
+    }
+    return RC_OK;
+}
+
+
+/* close a file */
+RC closePageFile(SM_FileHandle *fHandle) {
+    RC rc = RC_OK;
+
+    // validate file handle: must not be NULL and must point to an open file
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        rc = RC_FILE_HANDLE_NOT_INIT;
+        goto finally;
+    }
+
+    // the last handle on the file writes the cached header back (marked clean)
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    SM_SharedFile *shared = mgmt->shared;
+    if (mgmt->snapshot != NULL) {
+        releaseSnapshot(mgmt);
+    }
+    pthread_mutex_lock(&openFilesLock);
+    if (--shared->refCount == 0) {
+        if (shared->headerDirty || shared->markedUnclean) {
+            rc = writeHeader(fHandle, false);
+        }
+        // the sync policy's last chance for pages still pending; the last doublewrite
+        // batch is in place for good before a later open may overwrite it
+        if (((shared->syncPolicy != SM_SYNC_NONE && shared->unsyncedPages > 0) || shared->dwPending)
+            && syncData(mgmt) != RC_OK) {
+            rc = RC_WRITE_FAILED;
+        }
+        if (shared->dwFd >= 0) {
+            mgmt->backend->close(shared->dwFd);
+        }
+        SM_SharedFile **link = &openFiles;
+        while (*link != shared) {
+            link = &(*link)->next;
+        }
+        *link = shared->next;
+        free(shared->freeMap);
+        free(shared->slots);
+        pthread_mutex_destroy(&shared->slotLock);
+        free(shared->dwName);
+        pthread_mutex_destroy(&shared->dwLock);
+        free(shared);
+    }
+    pthread_mutex_unlock(&openFilesLock);
+
+    // close the underlying descriptor and release the bookkeeping
+    if (mgmt->map != NULL) {
+        munmap(mgmt->map, mgmt->mapReserved);   // dirty mapped pages stay in the page cache
+    }
+    while (mgmt->oldMaps != NULL) {
+        SM_OldMap *old = mgmt->oldMaps;
+        mgmt->oldMaps = old->next;
+        munmap(old->map, old->reserved);
+        free(old);
+    }
+    if (mgmt->backend->close(mgmt->fd) != 0) {
+        rc = RC_WRITE_FAILED;
+    }
+    free(mgmt);
+
+finally:
+    // avoid dangling pointers
+    if (fHandle != NULL) {
+        fHandle->mgmtInfo = NULL;
+    }
+
+    return rc;
+}
+
+
+/* destroya file */
+RC destroyPageFile(char *fileName) {
+
+    if (fileName == NULL) {
+        return RC_FILE_NOT_FOUND; 
+    }
+    // destroy the file, wherever it lives, and its doublewrite file if it has one
+    const SM_Backend *backend = getStorageBackend(fileName);
+    int res = backend->unlink(fileName);
+    char *dwName = doublewriteName(fileName);
+    if (dwName != NULL) {
+        backend->unlink(dwName);
+        free(dwName);
+    }
+    if (res == 0) {
+        return RC_OK;
+    } else {
+        return RC_FILE_NOT_FOUND;       // destroy failure: file is not found, file is not removable
+    }
+}
+
+
+/*
+    Read-ahead for sequential readers (readNextBlock and friends). Once a
+    handle reads two pages in a row, the next SM_READAHEAD_MIN_PAGES pages are
+    advised to the kernel (POSIX_FADV_WILLNEED, MADV_WILLNEED for a mapping),
+    which starts reading them into the page cache in the background. Each time
+    the reader enters the last advised window the next one is advised, twice
+    as large, up to SM_READAHEAD_MAX_PAGES. Any other access resets the window.
+    O_DIRECT handles bypass the page cache, compressed files have no page
+    ranges to advise and memory files no kernel to advise; all go without.
+*/
+static void adviseReadAhead(SM_FileMgmt *mgmt, PageNumber pageNum, PageNumber totalNumPages) {
+    PageNumber last = mgmt->raLast;
+    mgmt->raLast = pageNum;
+    if (mgmt->direct || mgmt->shared->slotted || !mgmt->backend->native || pageNum == last) {
+        return;
+    }
+    if (last < 0 || pageNum != last + 1) {
+        mgmt->raWindow = 0;
+        return;
+    }
+    if (mgmt->raWindow > 0 && pageNum < mgmt->raNext - mgmt->raWindow) {
+        return;     // still short of the last window
+    }
+
+    int window = mgmt->raWindow == 0 ? SM_READAHEAD_MIN_PAGES : 2 * mgmt->raWindow;
+    if (window > SM_READAHEAD_MAX_PAGES) window = SM_READAHEAD_MAX_PAGES;
+    PageNumber start = mgmt->raNext > pageNum ? mgmt->raNext : pageNum + 1;
+    PageNumber end = start + window < totalNumPages ? start + window : totalNumPages;
+    if (end > start) {
+        int pageSize = mgmt->shared->pageSize;
+        if (mgmt->map != NULL) {
+            // page offsets are multiples of the page size, so of the system page size too
+            madvise(mgmt->map + PAGE_OFFSET(start, pageSize), (size_t) (end - start) * pageSize, MADV_WILLNEED);
+        } else {
+            posix_fadvise(mgmt->fd, PAGE_OFFSET(start, pageSize), (off_t) (end - start) * pageSize, POSIX_FADV_WILLNEED);
+        }
+    }
+    mgmt->raWindow = window;
+    mgmt->raNext = start + window;
+}
+
+/* reading blocks from disc */
+RC readBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    /*
+        The method reads the block at position pageNum from a file and stores its content in the memory pointed to by the memPage page handle.
+        If the file has less than pageNum pages, the method should return RC READ NON EXISTING PAGE
+        The physical offset is pageNum + 1 because we have a header page.
+    */
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    if (mgmt->map != NULL) {
+        // mapped file: the page is already addressable, just copy it out
+        memcpy(memPage, mgmt->map + PAGE_OFFSET(pageNum, mgmt->shared->pageSize), mgmt->shared->pageSize);
+    } else {
+        // one positional read of the whole page (skip the header block);
+        // pread never moves a shared file offset, so concurrent readers are fine
+        RC rc = transferOne(mgmt, pageNum, memPage, false);
+        if (rc != RC_OK) {
+            return rc == RC_SM_CHECKSUM_MISMATCH ? rc : RC_READ_NON_EXISTING_PAGE;
+        }
+    }
+    if (VERIFY_READS(mgmt->shared) && !pageChecksumOk(memPage, mgmt->shared->pageSize)) {
+        return RC_SM_CHECKSUM_MISMATCH;     // torn or corrupted page
+    }
+    adviseReadAhead(mgmt, pageNum, fHandle->totalNumPages);
+
+    // update the current page position in the file handle
+    fHandle->curPagePos = pageNum;    
+
+    return RC_OK;
+}
+
+PageNumber getBlockPos(SM_FileHandle *fHandle) {
+    // return the current page position in a file
+
+    if (fHandle == NULL) {
+        return -1;          // file handle not initialized
+    }
+
+    return fHandle->curPagePos;
+}
+
+RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    /*
+        Read the first page in a file
+    */ 
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    // read the first data page of the file
+    return readBlock(0, fHandle, memPage);
+}
+
+RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    PageNumber target = fHandle->curPagePos - 1;   // previous boclk number = current block number -1
+    if (target < 0) {                       // there is no "previous" page to read
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    return readBlock(target, fHandle, memPage);
+
+}
+
+RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    PageNumber target = fHandle->curPagePos;
+    return readBlock(target, fHandle, memPage);
+
+}
+
+RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+
+    PageNumber target = fHandle->curPagePos + 1;
+    if (target >= fHandle->totalNumPages) {   // if the next page number goes beyond totalNumPages, it means we are already at the last page and there is no next page
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    return readBlock(target, fHandle, memPage);
+
+}
+
+RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+
+    PageNumber target = fHandle->totalNumPages - 1;    // page numbers start at 0, therefore we -1
+    return readBlock(target, fHandle, memPage);
+}
+
+/* writing blocks to a page file */
+RC writeBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    /*
+        Write a page to disk using either the current position or an absolute position
+        write memPage data to file[pageNum]
+        On success, update curPagePos
+    */
+
+    // error checks: 
+    // file handle must be valid (not NULL) 
+    // pageNum must be within the range of existing pages
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE; 
+    }
+
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    int pageSize = mgmt->shared->pageSize;
+    stampPage(mgmt->shared, memPage);
+    bool doublewrite = mgmt->shared->doublewrite;
+    if (doublewrite && doublewriteBegin(mgmt, &pageNum, 0, &memPage, 1) != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = RC_OK;
+    if (mgmt->map != NULL) {
+        // mapped file: store into the shared mapping, the kernel writes it back
+        // (skip when the caller hands us the mapped page itself)
+        if (memPage != mgmt->map + PAGE_OFFSET(pageNum, pageSize)) {
+            memcpy(mgmt->map + PAGE_OFFSET(pageNum, pageSize), memPage, pageSize);
+        }
+    } else {
+        // write one full page in a single pwrite call (+1 to skip header);
+        // no stdio buffer sits in between, so there is nothing to fflush
+        rc = transferOne(mgmt, pageNum, memPage, true);
+    }
+    if (doublewrite) {
+        doublewriteEnd(mgmt);
+    }
+    if (rc != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+
+    fHandle->curPagePos = pageNum;      // update current page position
+
+    // the file's sync policy decides whether the page has to reach the disk now
+    return notePagesWritten(mgmt, 1);
+}
+
+RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    
+    // error checks
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    PageNumber current = fHandle->curPagePos;     // get the current page number from the file handle
+    RC result = writeBlock(current, fHandle, memPage);
+
+    if (result != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+/*
+    Asynchronous page I/O engine.
+
+    One engine per process, started on first use (or explicitly by initAsyncIO).
+    It prefers io_uring, driven through the raw syscalls so no liburing is needed;
+    where the kernel has no io_uring (or it is disabled, or lacks the read and
+    write opcodes) a small pool of worker threads runs the pread/pwrite calls
+    instead. Requests belong to the caller: the engine only links them into
+    its queues and fills in done/rc, so a request and its page buffer must
+    stay untouched until it completed.
+    All engine state is guarded by asyncLock.
+*/
+static pthread_mutex_t asyncLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t asyncDone = PTHREAD_COND_INITIALIZER;    // some request completed
+static pthread_cond_t asyncWork = PTHREAD_COND_INITIALIZER;    // thread pool: queue not empty
+static SM_AsyncEngine asyncEngine = SM_ASYNC_AUTO;             // SM_ASYNC_AUTO while not started
+static int asyncInFlight = 0;
+
+// io_uring state: the ring descriptor and the three shared mappings
+static struct {
+    int fd;
+    unsigned entries;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqRing, *cqRing;
+    size_t sqRingLen, cqRingLen, sqesLen;
+} ring;
+
+// fallback thread pool: FIFO of pending requests linked through req->next
+static pthread_t asyncWorkers[SM_ASYNC_WORKERS];
+static SM_AsyncRequest *asyncQueueHead = NULL;
+static SM_AsyncRequest *asyncQueueTail = NULL;
+static bool asyncStopping = false;
+
+/* mark a request finished (asyncLock held) */
+static void completeRequest(SM_AsyncRequest *req, RC rc) {
+    if (rc == RC_OK && req->verify && !pageChecksumOk(req->memPage, req->pageSize)) {
+        rc = RC_SM_CHECKSUM_MISMATCH;
+    }
+    req->rc = rc;
+    req->done = true;
+    asyncInFlight--;
+    pthread_cond_broadcast(&asyncDone);
+}
+
+static int uringEnter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    int n;
+    do {
+        n = (int) syscall(__NR_io_uring_enter, ring.fd, toSubmit, minComplete, flags, NULL, 0);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+static RC uringSetup(unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        return RC_SM_ASYNC_UNAVAILABLE;
+    }
+
+    memset(&ring, 0, sizeof(ring));
+    ring.fd = fd;
+    ring.entries = p.sq_entries;
+    ring.sqRingLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring.cqRingLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring.sqesLen = p.sq_entries * sizeof(struct io_uring_sqe);
+    bool singleMap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap && ring.cqRingLen > ring.sqRingLen) {
+        ring.sqRingLen = ring.cqRingLen;    // both rings share one mapping
+    }
+
+    ring.sqRing = mmap(NULL, ring.sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring.cqRing = singleMap ? ring.sqRing
+                            : mmap(NULL, ring.cqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring.sqes = (struct io_uring_sqe *) mmap(NULL, ring.sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring.sqRing == MAP_FAILED || ring.cqRing == MAP_FAILED || ring.sqes == MAP_FAILED) {
+        if (ring.sqes != MAP_FAILED) munmap(ring.sqes, ring.sqesLen);
+        if (ring.cqRing != MAP_FAILED && !singleMap) munmap(ring.cqRing, ring.cqRingLen);
+        if (ring.sqRing != MAP_FAILED) munmap(ring.sqRing, ring.sqRingLen);
+        close(fd);
+        return RC_SM_ASYNC_UNAVAILABLE;
+    }
+    if (singleMap) {
+        ring.cqRingLen = 0;     // nothing extra to unmap
+    }
+
+    char *sq = (char *) ring.sqRing;
+    char *cq = (char *) ring.cqRing;
+    ring.sqHead = (unsigned *) (sq + p.sq_off.head);
+    ring.sqTail = (unsigned *) (sq + p.sq_off.tail);
+    ring.sqMask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ring.sqArray = (unsigned *) (sq + p.sq_off.array);
+    ring.cqHead = (unsigned *) (cq + p.cq_off.head);
+    ring.cqTail = (unsigned *) (cq + p.cq_off.tail);
+    ring.cqMask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    return RC_OK;
+}
+
+static void uringTeardown(void) {
+    munmap(ring.sqes, ring.sqesLen);
+    if (ring.cqRingLen > 0) munmap(ring.cqRing, ring.cqRingLen);
+    munmap(ring.sqRing, ring.sqRingLen);
+    close(ring.fd);
+}
+
+/*
+    io_uring itself is older than IORING_OP_READ/IORING_OP_WRITE (5.6), and a
+    ring on a kernel without them fails every request with -EINVAL. Ask the
+    kernel which opcodes it has (IORING_OP_FSYNC syncs SM_SYNC_STRICT writes);
+    no IORING_REGISTER_PROBE (also 5.6) means no.
+*/
+static bool uringHasReadWrite(void) {
+    unsigned nOps = 256;
+    struct io_uring_probe *probe = (struct io_uring_probe *)
+        calloc(1, sizeof(struct io_uring_probe) + nOps * sizeof(struct io_uring_probe_op));
+    if (probe == NULL) {
+        return false;
+    }
+    bool ok = syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe, nOps) == 0;
+    unsigned ops[] = { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC };
+    for (int i = 0; ok && i < 3; i++) {
+        ok = ops[i] < probe->ops_len && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    free(probe);
+    return ok;
+}
+
+/*
+    Queue the (remaining part of the) request as one read/write SQE, or the
+    fdatasync of a synced write whose page is out, and hand it to the kernel. The caller keeps asyncInFlight <= ring.entries, so there is
+    always a free slot. Returns false if the kernel refused the submission; the
+    SQE is taken back then, the next enter must not submit it for a request
+    the caller already failed.
+*/
+static bool uringPush(SM_AsyncRequest *req) {
+    unsigned tail = *ring.sqTail;       // only we move the SQ tail
+    unsigned idx = tail & *ring.sqMask;
+    struct io_uring_sqe *sqe = &ring.sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = req->fd;
+    sqe->user_data = (unsigned long) req;
+    if (req->transferred >= req->pageSize) {
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    } else {
+        sqe->opcode = req->isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->addr = (unsigned long) (req->memPage + req->transferred);
+        sqe->len = req->pageSize - req->transferred;
+        sqe->off = req->offset + req->transferred;
+    }
+    ring.sqArray[idx] = idx;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    if (uringEnter(1, 0, 0) == 1) {
+        return true;
+    }
+    // without SQPOLL only our enter consumes SQEs, so the head says whether it did
+    if (__atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE) != tail) {
+        return true;    // taken after all: its CQE completes the request
+    }
+    __atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+    return false;
+}
+
+/* take every completion off the CQ ring (asyncLock held) */
+static void uringReap(void) {
+    unsigned head = *ring.cqHead;
+    unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+        SM_AsyncRequest *req = (SM_AsyncRequest *) (unsigned long) cqe->user_data;
+        int res = cqe->res;
+        head++;
+
+        RC failed = req->isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        bool syncing = req->transferred >= req->pageSize;  // the page is out, this was its fdatasync
+        if (res == -EINTR || res == -EAGAIN) {
+            if (!uringPush(req)) completeRequest(req, failed);
+        } else if (res < 0 || (res == 0 && !syncing)) {
+            completeRequest(req, failed);   // error, or EOF before a full page
+        } else if (syncing) {
+            __atomic_add_fetch(&syncCount, 1, __ATOMIC_RELAXED);
+            completeRequest(req, RC_OK);
+        } else {
+            // short transfers are resubmitted for the rest of the page,
+            // a synced write then for its fdatasync
+            req->transferred += res;
+            if (req->transferred >= req->pageSize && !req->sync) {
+                completeRequest(req, RC_OK);
+            } else if (!uringPush(req)) {
+                completeRequest(req, failed);
+            }
+        }
+    }
+    __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+}
+
+static void *asyncWorker(void *arg) {
+    (void) arg;
+    pthread_mutex_lock(&asyncLock);
+    for (;;) {
+        while (asyncQueueHead == NULL && !asyncStopping) {
+            pthread_cond_wait(&asyncWork, &asyncLock);
+        }
+        if (asyncQueueHead == NULL) {
+            break;      // stopping and nothing left to do
+        }
+        SM_AsyncRequest *req = asyncQueueHead;
+        asyncQueueHead = req->next;
+        if (asyncQueueHead == NULL) asyncQueueTail = NULL;
+
+        // the transfer itself runs unlocked, so the workers overlap their I/O
+        pthread_mutex_unlock(&asyncLock);
+        RC rc = req->isWrite ? pwriteFully(&smPosixBackend, req->fd, req->memPage, req->pageSize, req->offset)
+                             : preadFully(&smPosixBackend, req->fd, req->memPage, req->pageSize, req->offset);
+        if (rc == RC_OK && req->sync) {
+            rc = smPosixBackend.sync(req->fd) == 0 ? RC_OK : RC_WRITE_FAILED;
+            if (rc == RC_OK) __atomic_add_fetch(&syncCount, 1, __ATOMIC_RELAXED);
+        }
+        if (rc != RC_OK) {
+            rc = req->isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        }
+        pthread_mutex_lock(&asyncLock);
+        completeRequest(req, rc);
+    }
+    pthread_mutex_unlock(&asyncLock);
+    return NULL;
+}
+
+/* start the engine (asyncLock held); SM_ASYNC_AUTO tries io_uring first */
+static RC startAsyncEngine(SM_AsyncEngine engine, int queueDepth) {
+    if (engine != SM_ASYNC_THREADS) {
+        if (uringSetup((unsigned) queueDepth) == RC_OK) {
+            if (uringHasReadWrite()) {
+                asyncEngine = SM_ASYNC_URING;
+                return RC_OK;
+            }
+            uringTeardown();
+        }
+        if (engine == SM_ASYNC_URING) {
+            return RC_SM_ASYNC_UNAVAILABLE;
+        }
+    }
+
+    asyncStopping = false;
+    for (int i = 0; i < SM_ASYNC_WORKERS; i++) {
+        if (pthread_create(&asyncWorkers[i], NULL, asyncWorker, NULL) != 0) {
+            // stop the workers that did start
+            asyncStopping = true;
+            pthread_cond_broadcast(&asyncWork);
+            pthread_mutex_unlock(&asyncLock);
+            for (int j = 0; j < i; j++) pthread_join(asyncWorkers[j], NULL);
+            pthread_mutex_lock(&asyncLock);
+            return RC_SM_ASYNC_UNAVAILABLE;
+        }
+    }
+    asyncEngine = SM_ASYNC_THREADS;
+    return RC_OK;
+}
+
+/* wait for everything in flight, then release the engine (asyncLock held) */
+static void stopAsyncEngine(void) {
+    while (asyncInFlight > 0) {
+        if (asyncEngine == SM_ASYNC_URING) {
+            uringReap();
+            if (asyncInFlight > 0) uringEnter(0, 1, IORING_ENTER_GETEVENTS);
+        } else {
+            pthread_cond_wait(&asyncDone, &asyncLock);
+        }
+    }
+
+    if (asyncEngine == SM_ASYNC_URING) {
+        uringTeardown();
+    } else if (asyncEngine == SM_ASYNC_THREADS) {
+        asyncStopping = true;
+        pthread_cond_broadcast(&asyncWork);
+        pthread_mutex_unlock(&asyncLock);
+        for (int i = 0; i < SM_ASYNC_WORKERS; i++) pthread_join(asyncWorkers[i], NULL);
+        pthread_mutex_lock(&asyncLock);
+    }
+    asyncEngine = SM_ASYNC_AUTO;
+}
+
+static RC submitBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage,
+                      SM_AsyncRequest *req, bool isWrite) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+    if (req == NULL || memPage == NULL || pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    req->pageNum = pageNum;
+    req->memPage = memPage;
+    req->isWrite = isWrite;
+    req->fd = mgmt->fd;
+    req->offset = PAGE_OFFSET(pageNum, mgmt->shared->pageSize);
+    req->pageSize = mgmt->shared->pageSize;
+    req->verify = !isWrite && VERIFY_READS(mgmt->shared);
+    req->transferred = 0;
+    req->sync = false;
+    req->next = NULL;
+
+    if (isWrite) {
+        stampPage(mgmt->shared, memPage);
+    }
+
+    // a file outside the kernel can go to the engines if its backend knows
+    // the kernel file the page sits in (a stripe of a striped file)
+    if (!mgmt->backend->native) {
+        off_t offset = req->offset;
+        req->fd = mgmt->backend->locate != NULL && !mgmt->shared->slotted
+                  ? mgmt->backend->locate(mgmt->fd, offset, (size_t) req->pageSize, &offset) : -1;
+        req->offset = offset;
+    }
+
+    // O_DIRECT with an unaligned buffer needs a bounce page, a compressed
+    // page a slot lookup and the codec, a file outside the kernel its
+    // backend's calls, which neither engine can issue, and a doublewrite
+    // file its batch first: do those synchronously
+    bool doublewrite = isWrite && mgmt->shared->doublewrite;
+    if ((mgmt->direct && !IS_IO_ALIGNED(memPage)) || mgmt->shared->slotted || req->fd < 0
+        || doublewrite) {
+        if (doublewrite && doublewriteBegin(mgmt, &pageNum, 0, &memPage, 1) != RC_OK) {
+            req->rc = RC_WRITE_FAILED;
+        } else {
+            req->rc = transferOne(mgmt, pageNum, memPage, isWrite);
+            if (doublewrite) doublewriteEnd(mgmt);
+        }
+        if (req->rc != RC_OK && req->rc != RC_SM_CHECKSUM_MISMATCH) {
+            req->rc = isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        } else if (req->verify && !pageChecksumOk(memPage, req->pageSize)) {
+            req->rc = RC_SM_CHECKSUM_MISMATCH;
+        } else if (isWrite) {
+            req->rc = notePagesWritten(mgmt, 1);
+        }
+        req->done = true;
+        return RC_OK;
+    }
+
+    // a mapped file is only a memcpy away, finish on the spot
+    if (mgmt->map != NULL) {
+        char *mapped = mgmt->map + PAGE_OFFSET(pageNum, req->pageSize);
+        if (isWrite) {
+            if (memPage != mapped) memcpy(mapped, memPage, req->pageSize);
+            req->rc = notePagesWritten(mgmt, 1);
+        } else {
+            memcpy(memPage, mapped, req->pageSize);
+            req->rc = (req->verify && !pageChecksumOk(memPage, req->pageSize)) ? RC_SM_CHECKSUM_MISMATCH : RC_OK;
+        }
+        req->done = true;
+        return RC_OK;
+    }
+
+    // the engines sync a strict write themselves, other writes wait for the next sync
+    if (isWrite && mgmt->shared->syncPolicy == SM_SYNC_STRICT) {
+        req->sync = true;
+    } else if (isWrite) {
+        __atomic_add_fetch(&mgmt->shared->unsyncedPages, 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_lock(&asyncLock);
+    RC rc = RC_OK;
+    if (asyncEngine == SM_ASYNC_AUTO) {
+        rc = startAsyncEngine(SM_ASYNC_AUTO, SM_ASYNC_QUEUE_DEPTH);
+        if (rc != RC_OK) goto finally;
+    }
+    req->done = false;
+    req->rc = RC_OK;
+
+    if (asyncEngine == SM_ASYNC_URING) {
+        // never have more in flight than the SQ holds, so completions cannot overflow
+        while (asyncInFlight >= (int) ring.entries) {
+            uringReap();
+            if (asyncInFlight >= (int) ring.entries) uringEnter(0, 1, IORING_ENTER_GETEVENTS);
+        }
+        asyncInFlight++;
+        if (!uringPush(req)) {
+            asyncInFlight--;
+            req->done = true;
+            rc = req->rc = isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        }
+    } else {
+        asyncInFlight++;
+        if (asyncQueueTail != NULL) asyncQueueTail->next = req;
+        else asyncQueueHead = req;
+        asyncQueueTail = req;
+        pthread_cond_signal(&asyncWork);
+    }
+
+finally:
+    pthread_mutex_unlock(&asyncLock);
+    return rc;
+}
+
+/* asynchronous page I/O */
+RC initAsyncIO(SM_AsyncEngine engine, int queueDepth) {
+    /*
+        (Re)start the async engine. SM_ASYNC_AUTO picks io_uring when the kernel
+        allows it and the thread pool otherwise; SM_ASYNC_URING fails with
+        RC_SM_ASYNC_UNAVAILABLE instead of falling back. Calling it is optional,
+        the first submit starts an SM_ASYNC_AUTO engine by itself.
+        A running engine is drained and replaced.
+    */
+    if (queueDepth <= 0) {
+        queueDepth = SM_ASYNC_QUEUE_DEPTH;
+    }
+
+    pthread_mutex_lock(&asyncLock);
+    if (asyncEngine != SM_ASYNC_AUTO) {
+        stopAsyncEngine();
+    }
+    RC rc = startAsyncEngine(engine, queueDepth);
+    pthread_mutex_unlock(&asyncLock);
+    return rc;
+}
+
+RC shutdownAsyncIO(void) {
+    // wait for the requests still in flight, then stop the engine
+    pthread_mutex_lock(&asyncLock);
+    if (asyncEngine != SM_ASYNC_AUTO) {
+        stopAsyncEngine();
+    }
+    pthread_mutex_unlock(&asyncLock);
+    return RC_OK;
+}
+
+SM_AsyncEngine getAsyncEngine(void) {
+    // engine in use, SM_ASYNC_AUTO if none is running yet
+    pthread_mutex_lock(&asyncLock);
+    SM_AsyncEngine engine = asyncEngine;
+    pthread_mutex_unlock(&asyncLock);
+    return engine;
+}
+
+RC submitReadBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncRequest *req) {
+    /*
+        Start reading page pageNum into memPage and return right away.
+        The handle must stay open until the request is done; curPagePos is not touched.
+    */
+    return submitBlock(pageNum, fHandle, memPage, req, false);
+}
+
+RC submitWriteBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncRequest *req) {
+    // start writing memPage to page pageNum, same rules as submitReadBlock
+    return submitBlock(pageNum, fHandle, memPage, req, true);
+}
+
+bool pollAsyncIO(SM_AsyncRequest *req) {
+    // collect finished requests without blocking; true once req is done
+    pthread_mutex_lock(&asyncLock);
+    if (!req->done && asyncEngine == SM_ASYNC_URING) {
+        uringReap();
+    }
+    bool done = req->done;
+    pthread_mutex_unlock(&asyncLock);
+    return done;
+}
+
+RC waitAsyncIO(SM_AsyncRequest *req) {
+    // block until req is done and return its result
+    pthread_mutex_lock(&asyncLock);
+    while (!req->done) {
+        if (asyncEngine == SM_ASYNC_URING) {
+            uringReap();
+            if (!req->done) uringEnter(0, 1, IORING_ENTER_GETEVENTS);
+        } else {
+            pthread_cond_wait(&asyncDone, &asyncLock);
+        }
+    }
+    RC rc = req->rc;
+    pthread_mutex_unlock(&asyncLock);
+    return rc;
+}
+
+RC waitAllAsyncIO(SM_AsyncRequest *reqs, int count) {
+    // wait for a whole batch; the first failure is returned, all requests are finished
+    RC rc = RC_OK;
+    for (int i = 0; i < count; i++) {
+        RC one = waitAsyncIO(&reqs[i]);
+        if (one != RC_OK && rc == RC_OK) {
+            rc = one;
+        }
+    }
+    return rc;
+}
+
+RC appendEmptyBlock(SM_FileHandle *fHandle) {
+    /*
+        Add one zero-filled page at the end of the file.
+        While there is spare capacity this only bumps the page count;
+        otherwise the file grows by a whole extent first.
+    */
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+    return ensureCapacity(fHandle->totalNumPages + 1, fHandle);
+}
+
+RC ensureCapacity(PageNumber numberOfPages, SM_FileHandle *fHandle) {
+    /*
+        Make the file hold at least numberOfPages pages.
+        Instead of appending page by page, the allocation grows by whole extents
+        (one fallocate). totalNumPages is the logical page count, capacity may
+        run ahead of it. Growing inside the allocated capacity only touches the
+        cached header; the header page is written when a new extent is
+        allocated, or once to stamp it unclean before it first falls behind.
+    */
+
+    // error checks    
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    SM_SharedFile *shared = mgmt->shared;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&openFilesLock);
+    if (shared->totalNumPages < numberOfPages) {
+        PageNumber oldCapacity = shared->capacityPages;
+        rc = growCapacity(numberOfPages, fHandle);
+        if (rc != RC_OK) {
+            goto finally;
+        }
+
+        // the pages between the old and new count are already zero on disk
+        PageNumber oldTotal = shared->totalNumPages;
+        __atomic_store_n(&shared->totalNumPages, numberOfPages, __ATOMIC_RELEASE);
+        shared->headerDirty = true;
+        if (shared->capacityPages != oldCapacity || !shared->markedUnclean) {
+            rc = writeHeader(fHandle, true);
+            if (rc != RC_OK) {
+                __atomic_store_n(&shared->totalNumPages, oldTotal, __ATOMIC_RELEASE);
+                goto finally;
+            }
+            // written now, but later growth inside the extent will not be
+            shared->headerDirty = false;
+        }
+    }
+
+finally:
+    pthread_mutex_unlock(&openFilesLock);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    // take over the new count (a mapped file has to see the new pages as well)
+    return refreshHandle(fHandle);
+}
+
+RC setExtentSize(int extentPages, SM_FileHandle *fHandle) {
+    /*
+        Choose how many pages the file grows by when it runs out of capacity.
+        Kept in the header, so it sticks with the file.
+    */
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+    if (extentPages < 1 || extentPages > SM_MAX_EXTENT_PAGES) {
+        return RC_SM_INVALID_EXTENT;
+    }
+
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    pthread_mutex_lock(&openFilesLock);
+    shared->extentPages = extentPages;
+    RC rc = writeHeader(fHandle, shared->markedUnclean);
+    pthread_mutex_unlock(&openFilesLock);
+    return rc;
+}
+
+PageNumber getAllocatedPages(SM_FileHandle *fHandle) {
+    // number of data pages allocated on disk (logical pages + preallocated tail)
+    // (for a compressed file: the pages its slot map has room for)
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return -1;
+    }
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    pthread_mutex_lock(&openFilesLock);
+    PageNumber capacity = shared->capacityPages;
+    pthread_mutex_unlock(&openFilesLock);
+    return capacity;
+}
+
+RC syncPageFile(SM_FileHandle *fHandle) {
+    /*
+        Write the cached header back (marked clean) and flush the file to stable
+        storage, so everything written through any handle so far survives a crash.
+    */
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&openFilesLock);
+    if (mgmt->shared->headerDirty || mgmt->shared->markedUnclean) {
+        rc = writeHeader(fHandle, false);
+    }
+    pthread_mutex_unlock(&openFilesLock);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    return syncData(mgmt);
+}
+
+RC setSyncPolicy(SM_FileHandle *fHandle, SM_SyncPolicy policy, int groupPages, int groupMillis) {
+    /*
+        Choose when writes to the file are forced to stable storage (see
+        SM_SyncPolicy). groupPages and groupMillis only matter for
+        SM_SYNC_GROUP, which needs at least one of them. Kept in the header,
+        so it sticks with the file for every handle and every later open.
+        Under SM_SYNC_STRICT an asynchronous write is done only once it is
+        synced; under the others it waits for the next sync like any write.
+    */
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+    if (policy < SM_SYNC_NONE || policy > SM_SYNC_STRICT || groupPages < 0 || groupMillis < 0
+        || (policy == SM_SYNC_GROUP && groupPages == 0 && groupMillis == 0)) {
+        return RC_SM_INVALID_SYNC_POLICY;
+    }
+
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    pthread_mutex_lock(&openFilesLock);
+    shared->syncPolicy = policy;
+    shared->syncPages = policy == SM_SYNC_GROUP ? groupPages : 0;
+    shared->syncMillis = policy == SM_SYNC_GROUP ? groupMillis : 0;
+    RC rc = writeHeader(fHandle, shared->markedUnclean);
+    pthread_mutex_unlock(&openFilesLock);
+    return rc;
+}
+
+SM_SyncPolicy getSyncPolicy(SM_FileHandle *fHandle) {
+    // the file's sync policy, SM_SYNC_NONE for a handle that is not open
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return SM_SYNC_NONE;
+    }
+    return ((SM_FileMgmt *) fHandle->mgmtInfo)->shared->syncPolicy;
+}
+
+RC setDoublewrite(SM_FileHandle *fHandle, bool enable) {
+    /*
+        Switch the doublewrite file on or off for the file (kept in the
+        header, like SM_PAGE_DOUBLEWRITE at creation). Only files with
+        SM_PAGE_CHECKSUMS and without compression can have it, others get
+        RC_SM_UNSUPPORTED_FORMAT. Switching it off makes the last batch
+        durable in place first.
+    */
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    SM_SharedFile *shared = mgmt->shared;
+    if (enable && (!shared->checksums || shared->slotted)) {
+        return RC_SM_UNSUPPORTED_FORMAT;
+    }
+
+    RC rc = RC_OK;
+    pthread_mutex_lock(&openFilesLock);
+    pthread_mutex_lock(&shared->dwLock);
+    if (!enable && shared->dwPending) {
+        rc = syncData(mgmt);
+        shared->dwPending = rc != RC_OK;
+    }
+    if (rc == RC_OK && shared->doublewrite != enable) {
+        shared->doublewrite = enable;
+        rc = writeHeader(fHandle, shared->markedUnclean);
+    }
+    pthread_mutex_unlock(&shared->dwLock);
+    pthread_mutex_unlock(&openFilesLock);
+    return rc;
+}
+
+bool isDoublewriteEnabled(SM_FileHandle *fHandle) {
+    return fHandle != NULL && fHandle->mgmtInfo != NULL && ((SM_FileMgmt *) fHandle->mgmtInfo)->shared->doublewrite;
+}
 
-/* close a file */
-RC closePageFile(SM_FileHandle *fHandle) {
-    RC rc = RC_OK;
+long long getDoublewriteRepairs(void) {
+    // torn pages put back from doublewrite files when they were opened, over all files
+    return __atomic_load_n(&dwRepairs, __ATOMIC_RELAXED);
+}
 
-    // validate file handle: must not be NULL and must point to an open file
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        rc = RC_FILE_HANDLE_NOT_INIT;
-        goto finally;
+/*
+    Snapshots of slotted files. A snapshot is a read-only handle on the file
+    as it was when it was taken: it reads through a copy of the slot map made
+    then, while the file's own handles go on writing. The first write to a
+    page after a snapshot moves the page to a new slot (see writeSlottedPage),
+    so the old slot keeps the image the snapshot reads; pages never written
+    since cost nothing. Dropping the snapshot punches every page image no
+    other snapshot reads any more. Snapshots live in the process that took
+    them: after a crash their page images are dead space, which
+    compactPageFile gives back.
+*/
+RC createSnapshot(char *fileName, SM_FileHandle *snapshot) {
+    /*
+        Open a snapshot of fileName in *snapshot. It sees the pages written
+        to the file so far (flush buffer pools first), and its page count
+        stays what it was. Reads work as on any handle; writes, growing and
+        page allocation give RC_SM_READ_ONLY. Files without slots (neither
+        SM_PAGE_SNAPSHOTS nor SM_PAGE_COMPRESSED) give
+        RC_SM_UNSUPPORTED_FORMAT. Close it with dropSnapshot.
+    */
+    if (fileName == NULL || snapshot == NULL) {
+        return RC_FILE_NOT_FOUND;
     }
-
-    // close  the underlying FILE* 
-    if (fclose((FILE *) fHandle->mgmtInfo) != 0) {
-        rc = RC_WRITE_FAILED;
-        goto finally;
+    RC rc = openPageFile(fileName, snapshot);
+    if (rc != RC_OK) {
+        return rc;
     }
-
-finally:
-    // avoid dangling pointers
-    if (fHandle != NULL) {
-        fHandle->mgmtInfo = NULL;
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) snapshot->mgmtInfo;
+    SM_SharedFile *shared = mgmt->shared;
+    if (!shared->slotted) {
+        closePageFile(snapshot);
+        return RC_SM_UNSUPPORTED_FORMAT;
     }
 
+    SM_Snapshot *snap = (SM_Snapshot *) malloc(sizeof(SM_Snapshot));
+    rc = snap != NULL ? RC_OK : RC_WRITE_FAILED;
+    pthread_mutex_lock(&openFilesLock);     // holds the page count steady
+    pthread_mutex_lock(&shared->slotLock);
+    if (rc == RC_OK) {
+        snap->totalNumPages = shared->totalNumPages;
+        snap->numSlots = shared->totalNumPages;
+        snap->slots = (SM_PageSlot *) malloc((size_t) snap->numSlots * sizeof(SM_PageSlot));
+        // from now on every page moves on its next write, even if it moved since an older snapshot
+        size_t movedLen = (size_t) (shared->capacityPages + 7) / 8;
+        unsigned char *moved = shared->movedMap != NULL ? shared->movedMap : (unsigned char *) malloc(movedLen);
+        if (snap->slots == NULL || moved == NULL) {
+            if (moved != shared->movedMap) free(moved);
+            free(snap->slots);
+            free(snap);
+            rc = RC_WRITE_FAILED;
+        } else {
+            memcpy(snap->slots, shared->slots, (size_t) snap->numSlots * sizeof(SM_PageSlot));
+            memset(moved, 0, movedLen);
+            shared->movedMap = moved;
+            snap->next = shared->snapshots;
+            shared->snapshots = snap;
+            mgmt->snapshot = snap;
+            snapshot->totalNumPages = snap->totalNumPages;
+        }
+    }
+    pthread_mutex_unlock(&shared->slotLock);
+    pthread_mutex_unlock(&openFilesLock);
+    if (rc != RC_OK) {
+        closePageFile(snapshot);
+    }
     return rc;
 }
 
-
-/* destroya file */
-RC destroyPageFile(char *fileName) {
-
-    if (fileName == NULL) {
-        return RC_FILE_NOT_FOUND; 
+RC dropSnapshot(SM_FileHandle *snapshot) {
+    // close a snapshot and reclaim the page images only it kept alive
+    if (snapshot == NULL || snapshot->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
     }
-    // destroy the file
-    int res = remove(fileName);
-    if (res == 0) {
-        return RC_OK;
-    } else {
-        return RC_FILE_NOT_FOUND;       // destroy failure: file is not found, file is not removable
+    if (!IS_SNAPSHOT(snapshot)) {
+        return RC_SM_UNSUPPORTED_FORMAT;
     }
+    return closePageFile(snapshot);
 }
 
+bool isSnapshot(SM_FileHandle *fHandle) {
+    return fHandle != NULL && fHandle->mgmtInfo != NULL && IS_SNAPSHOT(fHandle);
+}
 
-/* reading blocks from disc */
-RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+long long getSyncCount(void) {
+    // fdatasync calls the storage manager issued so far, over all files
+    return __atomic_load_n(&syncCount, __ATOMIC_RELAXED);
+}
+
+/* memory-mapped access */
+RC getPagePtr(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle *pagePtr) {
     /*
-        The method reads the block at position pageNum from a file and stores its content in the memory pointed to by the memPage page handle.
-        If the file has less than pageNum pages, the method should return RC READ NON EXISTING PAGE
-        The physical offset is pageNum + 1 because we have a header page.
+        Zero-copy access for handles opened with openPageFileMapped:
+        *pagePtr points straight at page pageNum inside the mapping.
+        Writes through the pointer go to the file (via the page cache) without
+        any writeBlock call. The pointer stays valid until the handle is closed,
+        unless the file grows past its reserved mapping window.
     */
-
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || pagePtr == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
+
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    if (mgmt->map == NULL) {
+        return RC_SM_NOT_MAPPED;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
     if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
         return RC_READ_NON_EXISTING_PAGE;
     }
 
-    // move the file pointer to the right physical location (skip the header block)
-    FILE *file = (FILE *) fHandle->mgmtInfo;
-    long offset = (pageNum + 1) * PAGE_SIZE;                // +1 because page 0 is the header
-    int successfulMove = fseek(file, offset, SEEK_SET);     // fseek() return 0 if the move worked
+    *pagePtr = mgmt->map + PAGE_OFFSET(pageNum, mgmt->shared->pageSize);
+    fHandle->curPagePos = pageNum;
+    return RC_OK;
+}
 
-    if (successfulMove == 0) { 
-        
-        // successfully, read the page content into memory
-        size_t bytesRead = fread(memPage, sizeof(char), PAGE_SIZE, file);
-        if (bytesRead != PAGE_SIZE) {
-            return RC_READ_NON_EXISTING_PAGE;
+/* multi-page (vectored) I/O */
+
+/*
+    Move count consecutive pages starting at startPage between the file and the
+    page buffers pages[0..count-1]. The buffers need not be adjacent in memory:
+    one preadv/pwritev covers up to IOV_MAX pages. No checksum handling here,
+    see transferRun.
+*/
+static RC rawTransferRun(PageNumber startPage, int count, SM_FileHandle *fHandle,
+                         SM_PageHandle *pages, bool isWrite) {
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    int pageSize = mgmt->shared->pageSize;
+
+    if (mgmt->shared->slotted) {
+        // every page sits in a slot of its own, there is no run to vectorise
+        for (int i = 0; i < count; i++) {
+            RC rc = transferOne(mgmt, startPage + i, pages[i], isWrite);
+            if (rc != RC_OK) {
+                return rc;
+            }
         }
-        
-        // we already moved the file pointer with fseek,
-        // update the current page position in the file handle
-        fHandle->curPagePos = pageNum;    
+        return RC_OK;
+    }
 
+    if (mgmt->map != NULL) {
+        // mapped file: plain copies against the mapping
+        for (int i = 0; i < count; i++) {
+            char *mapped = mgmt->map + PAGE_OFFSET(startPage + i, pageSize);
+            if (isWrite) {
+                if (pages[i] != mapped) memcpy(mapped, pages[i], pageSize);
+            } else {
+                memcpy(pages[i], mapped, pageSize);
+            }
+        }
         return RC_OK;
+    }
 
-    } else {
-        return RC_READ_NON_EXISTING_PAGE;
+    if (mgmt->direct) {
+        // O_DIRECT: unaligned buffers cannot join the iovec, move those pages one by one
+        for (int i = 0; i < count; i++) {
+            if (!IS_IO_ALIGNED(pages[i])) {
+                for (int j = 0; j < count; j++) {
+                    RC rc = transferOne(mgmt, startPage + j, pages[j], isWrite);
+                    if (rc != RC_OK) {
+                        return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+                    }
+                }
+                return RC_OK;
+            }
+        }
     }
 
+    struct iovec iov[IOV_MAX];
+    int done = 0;
+    while (done < count) {
+        int batch = count - done;
+        if (batch > IOV_MAX) batch = IOV_MAX;
+        for (int i = 0; i < batch; i++) {
+            iov[i].iov_base = pages[done + i];
+            iov[i].iov_len = pageSize;
+        }
+        RC rc = pvFully(mgmt->backend, mgmt->fd, iov, batch, PAGE_OFFSET(startPage + done, pageSize), isWrite);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        done += batch;
+    }
+    return RC_OK;
 }
 
-int getBlockPos(SM_FileHandle *fHandle) {
-    // return the current page position in a file
-
-    if (fHandle == NULL) {
-        return -1;          // file handle not initialized
+/* rawTransferRun with the page trailers stamped before a write and checked after a read */
+static RC transferRun(PageNumber startPage, int count, SM_FileHandle *fHandle,
+                      SM_PageHandle *pages, bool isWrite) {
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    if (isWrite) {
+        for (int i = 0; i < count; i++) stampPage(shared, pages[i]);
     }
-
-    return fHandle->curPagePos;
+    RC rc = rawTransferRun(startPage, count, fHandle, pages, isWrite);
+    if (rc == RC_OK && !isWrite && VERIFY_READS(shared)) {
+        for (int i = 0; i < count; i++) {
+            if (!pageChecksumOk(pages[i], shared->pageSize)) return RC_SM_CHECKSUM_MISMATCH;
+        }
+    }
+    return rc;
 }
 
-RC readFirstBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
+RC readBlocks(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *pages) {
     /*
-        Read the first page in a file
-    */ 
+        Read pages startPage .. startPage+count-1 into pages[0..count-1]
+        with as few preadv calls as possible (one per IOV_MAX pages).
+        On success curPagePos is the last page read.
+    */
     if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
+    if (count <= 0) {
+        return RC_OK;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+    if (startPage < 0 || startPage + count > fHandle->totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
 
-    // read the first data page of the file
-    return readBlock(0, fHandle, memPage);
+    RC rc = transferRun(startPage, count, fHandle, pages, false);
+    if (rc != RC_OK) {
+        return rc == RC_SM_CHECKSUM_MISMATCH ? rc : RC_READ_NON_EXISTING_PAGE;
+    }
+    fHandle->curPagePos = startPage + count - 1;
+    return RC_OK;
 }
 
-RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-
-
+/* writeBlocks without the doublewrite batch (the caller took care of it) */
+static RC writeRun(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *pages) {
     if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
-
-    int target = fHandle->curPagePos - 1;   // previous boclk number = current block number -1
-    if (target < 0) {                       // there is no "previous" page to read
+    if (count <= 0) {
+        return RC_OK;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+    if (startPage < 0 || startPage + count > fHandle->totalNumPages) {
         return RC_READ_NON_EXISTING_PAGE;
     }
 
-    return readBlock(target, fHandle, memPage);
-
+    RC rc = transferRun(startPage, count, fHandle, pages, true);
+    if (rc != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    fHandle->curPagePos = startPage + count - 1;
+    return notePagesWritten((SM_FileMgmt *) fHandle->mgmtInfo, count);
 }
 
-RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-
+RC writeBlocks(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *pages) {
+    /*
+        Write pages[0..count-1] to pages startPage .. startPage+count-1
+        with as few pwritev calls as possible.
+        On success curPagePos is the last page written.
+        A doublewrite file takes the pages in batches of SM_DOUBLEWRITE_PAGES.
+    */
     if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
-
-    int target = fHandle->curPagePos;
-    return readBlock(target, fHandle, memPage);
-
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    if (!mgmt->shared->doublewrite) {
+        return writeRun(startPage, count, fHandle, pages);
+    }
+    RC rc = RC_OK;
+    for (int done = 0; done < count && rc == RC_OK; done += SM_DOUBLEWRITE_PAGES) {
+        int batch = count - done < SM_DOUBLEWRITE_PAGES ? count - done : SM_DOUBLEWRITE_PAGES;
+        rc = doublewriteBegin(mgmt, NULL, startPage + done, pages + done, batch);
+        if (rc == RC_OK) {
+            rc = writeRun(startPage + done, batch, fHandle, pages + done);
+            doublewriteEnd(mgmt);
+        }
+    }
+    return rc;
 }
 
-RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-
+/*
+    Batch I/O for an arbitrary set of pages: the pages are sorted by page
+    number and every run of consecutive page numbers goes out as one
+    readBlocks/writeBlocks.
+*/
+static RC transferList(PageNumber *pageNums, int count, SM_FileHandle *fHandle,
+                       SM_PageHandle *pages, bool isWrite) {
     if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
+    if (count <= 0) {
+        return RC_OK;
+    }
 
-    int target = fHandle->curPagePos + 1;
-    if (target >= fHandle->totalNumPages) {   // if the next page number goes beyond totalNumPages, it means we are already at the last page and there is no next page
-        return RC_READ_NON_EXISTING_PAGE;
+    // sort (page number, buffer) pairs by page number; insertion sort is fine,
+    // callers usually hand us nearly sorted lists
+    PageNumber *sortedNums = (PageNumber *) malloc(sizeof(PageNumber) * count);
+    SM_PageHandle *sortedPages = (SM_PageHandle *) malloc(sizeof(SM_PageHandle) * count);
+    if (sortedNums == NULL || sortedPages == NULL) {
+        free(sortedNums);
+        free(sortedPages);
+        return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+    }
+    for (int i = 0; i < count; i++) {
+        int j = i - 1;
+        while (j >= 0 && sortedNums[j] > pageNums[i]) {
+            sortedNums[j + 1] = sortedNums[j];
+            sortedPages[j + 1] = sortedPages[j];
+            j--;
+        }
+        sortedNums[j + 1] = pageNums[i];
+        sortedPages[j + 1] = pages[i];
     }
 
-    return readBlock(target, fHandle, memPage);
+    // a doublewrite file takes the list in batches, each copied to the doublewrite file as a whole
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    bool doublewrite = isWrite && mgmt->shared->doublewrite;
+    int batch = doublewrite && count > SM_DOUBLEWRITE_PAGES ? SM_DOUBLEWRITE_PAGES : count;
+    RC rc = RC_OK;
+    for (int first = 0; first < count && rc == RC_OK; first += batch) {
+        int end = count - first < batch ? count : first + batch;
+        if (doublewrite) {
+            rc = doublewriteBegin(mgmt, sortedNums + first, 0, sortedPages + first, end - first);
+            if (rc != RC_OK) break;
+        }
+        int runStart = first;
+        for (int i = first + 1; i <= end && rc == RC_OK; i++) {
+            // a run ends at the end of the batch or where the page numbers stop being consecutive
+            if (i == end || sortedNums[i] != sortedNums[i - 1] + 1) {
+                if (isWrite) {
+                    rc = writeRun(sortedNums[runStart], i - runStart, fHandle, sortedPages + runStart);
+                } else {
+                    rc = readBlocks(sortedNums[runStart], i - runStart, fHandle, sortedPages + runStart);
+                }
+                runStart = i;
+            }
+        }
+        if (doublewrite) {
+            doublewriteEnd(mgmt);
+        }
+    }
 
+    free(sortedNums);
+    free(sortedPages);
+    return rc;
 }
 
-RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_HANDLE_NOT_INIT;
-    }
+RC readBlockList(PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *pages) {
+    // read page pageNums[i] into pages[i] for every i, one preadv per consecutive run
+    return transferList(pageNums, count, fHandle, pages, false);
+}
 
-    int target = fHandle->totalNumPages - 1;    // page numbers start at 0, therefore we -1
-    return readBlock(target, fHandle, memPage);
+RC writeBlockList(PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *pages) {
+    // write pages[i] to page pageNums[i] for every i, one pwritev per consecutive run
+    return transferList(pageNums, count, fHandle, pages, true);
 }
 
-/* writing blocks to a page file */
-RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    /*
-        Write a page to disk using either the current position or an absolute position
-        write memPage data to file[pageNum]
-        On success, update curPagePos
-    */
+/* free-page management */
 
-    // error checks: 
-    // file handle must be valid (not NULL) 
-    // pageNum must be within the range of existing pages
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_HANDLE_NOT_INIT;
+/*
+    Freed pages are kept in a free list of trunk pages, like SQLite's freelist:
+    the header points at the first trunk, every trunk holds the number of the
+    next trunk and up to SM_TRUNK_CAPACITY(dataSize) free "leaf" page numbers,
+    so larger pages hold longer trunks (the checksum trailer stays clear). A
+    trunk is a free page itself and is handed out last, once its leaves are
+    used up. Every change costs one trunk write plus one header write; the
+    header goes out eagerly here, a stale free list after a crash could hand
+    out a page twice.
+*/
+#define SM_TRUNK_CAPACITY(dataSize) ((int) ((dataSize) / sizeof(int64_t)) - 2)
+
+typedef struct SM_FreeTrunk {
+    int64_t nextTrunk;                  // -1 for the last trunk
+    int64_t count;                      // valid entries in leaves
+    int64_t leaves[];                   // SM_TRUNK_CAPACITY(PAGE_DATA_SIZE) of them
+} SM_FreeTrunk;
+
+/* version 1 files keep 32-bit trunks (always PAGE_SIZE pages), converted by upgradeFreeList */
+#define SM_TRUNK_CAPACITY_V1 ((int) (PAGE_SIZE / sizeof(int32_t)) - 2)
+
+typedef struct SM_FreeTrunkV1 {
+    int32_t nextTrunk;
+    int32_t count;
+    int32_t leaves[SM_TRUNK_CAPACITY_V1];
+} SM_FreeTrunkV1;
+
+/*
+    read/write one page without touching curPagePos (mapped and O_DIRECT aware);
+    a write takes the doublewrite file and the sync policy like writeBlock
+*/
+static RC trunkIO(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle page, bool isWrite) {
+    if (!isWrite) {
+        return transferRun(pageNum, 1, fHandle, &page, false);
     }
-    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
-        return RC_READ_NON_EXISTING_PAGE; 
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    bool doublewrite = mgmt->shared->doublewrite;
+    if (doublewrite && doublewriteBegin(mgmt, &pageNum, 0, &page, 1) != RC_OK) {
+        return RC_WRITE_FAILED;
     }
+    RC rc = transferRun(pageNum, 1, fHandle, &page, true);
+    if (doublewrite) {
+        doublewriteEnd(mgmt);
+    }
+    if (rc != RC_OK) {
+        return RC_WRITE_FAILED;
+    }
+    return notePagesWritten(mgmt, 1);
+}
 
-    FILE *file = (FILE *) fHandle->mgmtInfo;
-    long offset = (pageNum + 1) * PAGE_SIZE; // +1 to skip header
-    int successfulMove = fseek(file, offset, SEEK_SET);
-    
-    if ( successfulMove != 0) {
+static void setFreeBit(SM_SharedFile *shared, PageNumber pageNum, bool isFree) {
+    if (shared->freeMap == NULL) {
+        return;     // not built yet, buildFreeMap will see the list as it is then
+    }
+    if (pageNum >= shared->freeMapPages) {
+        PageNumber pages = shared->freeMapPages;
+        while (pages <= pageNum) pages *= 2;
+        unsigned char *grown = (unsigned char *) realloc(shared->freeMap, (size_t) (pages + 7) / 8);
+        if (grown == NULL) {
+            free(shared->freeMap);          // rebuilt on the next lookup
+            shared->freeMap = NULL;
+            return;
+        }
+        memset(grown + (shared->freeMapPages + 7) / 8, 0, (size_t) (pages + 7) / 8 - (shared->freeMapPages + 7) / 8);
+        shared->freeMap = grown;
+        shared->freeMapPages = pages;
+    }
+    if (isFree) shared->freeMap[pageNum / 8] |= (unsigned char) (1 << (pageNum % 8));
+    else shared->freeMap[pageNum / 8] &= (unsigned char) ~(1 << (pageNum % 8));
+}
 
+/* walk the trunk chain once and remember every free page in a bitmap (openFilesLock held) */
+static RC buildFreeMap(SM_FileHandle *fHandle, SM_SharedFile *shared) {
+    PageNumber pages = shared->totalNumPages > 8 ? shared->totalNumPages : 8;
+    shared->freeMap = (unsigned char *) calloc((size_t) (pages + 7) / 8, 1);
+    if (shared->freeMap == NULL) {
         return RC_WRITE_FAILED;
+    }
+    shared->freeMapPages = pages;
 
-    } else{
+    SM_FreeTrunk *trunk = (SM_FreeTrunk *) allocPageBufferSized(shared->pageSize);
+    if (trunk == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = RC_OK;
+    int seen = 0;
+    PageNumber t = shared->freeCount > 0 ? shared->freeTrunk : -1;
+    while (t >= 0 && seen < shared->freeCount) {
+        rc = trunkIO(t, fHandle, (SM_PageHandle) trunk, false);
+        if (rc != RC_OK) break;
+        setFreeBit(shared, t, true);
+        seen++;
+        for (int i = 0; i < trunk->count && i < SM_TRUNK_CAPACITY(PAGE_DATA_SIZE(shared)); i++) {
+            setFreeBit(shared, trunk->leaves[i], true);
+            seen++;
+        }
+        t = trunk->nextTrunk;
+    }
+    freePageBuffer((SM_PageHandle) trunk);
+    if (rc != RC_OK) {
+        free(shared->freeMap);
+        shared->freeMap = NULL;
+    }
+    return rc;
+}
 
-        // write one full page in a single fwrite call
-        size_t written = fwrite(memPage, sizeof(char), PAGE_SIZE, file);
+/* free-bit lookup (openFilesLock held) */
+static bool pageIsFree(SM_FileHandle *fHandle, SM_SharedFile *shared, PageNumber pageNum) {
+    if (shared->freeCount == 0) {
+        return false;       // nothing on the free list, no need for the bitmap
+    }
+    if (shared->freeMap == NULL && buildFreeMap(fHandle, shared) != RC_OK) {
+        return false;
+    }
+    if (pageNum >= shared->freeMapPages) {
+        return false;
+    }
+    return (shared->freeMap[pageNum / 8] & (1 << (pageNum % 8))) != 0;
+}
 
-        if (written != PAGE_SIZE) {
-            return RC_WRITE_FAILED;
+/*
+    Convert the free list of a version 1 file: collect the page numbers from
+    its 32-bit trunks, empty the list and free every page again, which builds
+    64-bit trunks and writes a version 2 header.
+*/
+static RC upgradeFreeList(SM_FileHandle *fHandle) {
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    PageNumber count = shared->freeCount;
+    PageNumber *freed = (PageNumber *) malloc(sizeof(PageNumber) * count);
+    SM_FreeTrunkV1 *trunk = (SM_FreeTrunkV1 *) allocPageBuffer();
+    RC rc = (freed == NULL || trunk == NULL) ? RC_WRITE_FAILED : RC_OK;
+
+    PageNumber seen = 0;
+    PageNumber t = shared->freeTrunk;
+    while (rc == RC_OK && t >= 0 && seen < count) {
+        rc = trunkIO(t, fHandle, (SM_PageHandle) trunk, false);
+        if (rc != RC_OK) break;
+        freed[seen++] = t;
+        for (int i = 0; i < trunk->count && i < SM_TRUNK_CAPACITY_V1 && seen < count; i++) {
+            freed[seen++] = trunk->leaves[i];
         }
+        t = trunk->nextTrunk;
+    }
 
-        fflush(file);                        // flush buffer to disk
-        fHandle->curPagePos = pageNum;      // update current page position
-
-        return RC_OK;        
+    if (rc == RC_OK) {
+        pthread_mutex_lock(&openFilesLock);
+        shared->freeCount = 0;
+        shared->freeTrunk = 0;
+        pthread_mutex_unlock(&openFilesLock);
+        for (PageNumber i = 0; i < seen && rc == RC_OK; i++) {
+            rc = deallocatePage(freed[i], fHandle);
+        }
     }
+    free(freed);
+    freePageBuffer((SM_PageHandle) trunk);
+    return rc;
 }
 
-RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
-    
-    // error checks
+RC allocatePage(SM_FileHandle *fHandle, PageNumber *pageNum) {
+    /*
+        Hand out a zero-filled page: the most recently freed page if the free
+        list has one, otherwise a new page at the end of the file.
+    */
     if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+    if (pageNum == NULL) {
+        return RC_READ_NON_EXISTING_PAGE;
+    }
 
-    int current = fHandle->curPagePos;     // get the current page number from the file handle
-    RC result = writeBlock(current, fHandle, memPage);
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    pthread_mutex_lock(&openFilesLock);
+    if (shared->freeCount == 0) {
+        // nothing to reuse: grow the file by one page
+        PageNumber newTotal = shared->totalNumPages + 1;
+        pthread_mutex_unlock(&openFilesLock);
+        RC rc = ensureCapacity(newTotal, fHandle);
+        if (rc == RC_OK) {
+            *pageNum = newTotal - 1;
+        }
+        return rc;
+    }
 
-    if (result != RC_OK) {
-        return RC_WRITE_FAILED;
+    SM_PageHandle page = allocPageBufferSized(shared->pageSize);
+    RC rc = (page == NULL) ? RC_WRITE_FAILED : trunkIO(shared->freeTrunk, fHandle, page, false);
+    if (rc != RC_OK) {
+        goto finally;
     }
-    return RC_OK;
-}
 
-RC appendEmptyBlock(SM_FileHandle *fHandle) {
+    // take the last leaf of the first trunk, or the trunk itself once it is empty
+    SM_FreeTrunk *trunk = (SM_FreeTrunk *) page;
+    PageNumber taken;
+    PageNumber oldTrunk = shared->freeTrunk;
+    if (trunk->count > 0) {
+        taken = trunk->leaves[--trunk->count];
+        rc = trunkIO(shared->freeTrunk, fHandle, page, true);
+    } else {
+        taken = shared->freeTrunk;
+        shared->freeTrunk = trunk->nextTrunk;
+    }
+    if (rc != RC_OK) {
+        goto finally;
+    }
+    shared->freeCount--;
+    rc = writeHeader(fHandle, shared->markedUnclean);
+    if (rc != RC_OK) {
+        // undo the in-memory change, the trunk on disk simply lost a leaf
+        shared->freeCount++;
+        shared->freeTrunk = oldTrunk;
+        goto finally;
+    }
+    setFreeBit(shared, taken, false);
 
-    // error checks
-    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
-        return RC_FILE_HANDLE_NOT_INIT;
+    // reused pages come back empty, like freshly appended ones:
+    // punched if the file system can, written over with zeros if not
+    if (!punchPage((SM_FileMgmt *) fHandle->mgmtInfo, taken)) {
+        memset(page, 0, shared->pageSize);
+        rc = trunkIO(taken, fHandle, page, true);
+    }
+    if (rc == RC_OK) {
+        *pageNum = taken;
     }
 
-    FILE *file = (FILE *) fHandle->mgmtInfo;
+finally:
+    pthread_mutex_unlock(&openFilesLock);
+    freePageBuffer(page);
+    return rc;
+}
 
-    // allocate one page of memory initialized with zeros
-    SM_PageHandle emptyPage = (SM_PageHandle) calloc(PAGE_SIZE, sizeof(char));
-    if (emptyPage == NULL) {
-        return RC_WRITE_FAILED;
+RC deallocatePage(PageNumber pageNum, SM_FileHandle *fHandle) {
+    /*
+        Put a page on the free list so allocatePage can hand it out again.
+        The page keeps its number (the file does not shrink); its content is
+        gone, it may be overwritten with free-list bookkeeping at any time.
+        A page recorded as a leaf is punched right away (see punchRange).
+    */
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
     }
-
-    // move file pointer to the end of the file
-    int successfulMove = fseek(file, 0, SEEK_END);
-    if (successfulMove != 0) {
-        free(emptyPage);
-        return RC_WRITE_FAILED;
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+    if (refreshHandle(fHandle) != RC_OK) {
+        return RC_SM_MAP_FAILED;
+    }
+    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) {
+        return RC_READ_NON_EXISTING_PAGE;
     }
 
-    // write the empty page to the end of the file
-    size_t written = fwrite(emptyPage, sizeof(char), PAGE_SIZE, file);
-    free(emptyPage);
-
-    if (written != PAGE_SIZE) {
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    SM_PageHandle page = allocPageBufferSized(shared->pageSize);
+    if (page == NULL) {
         return RC_WRITE_FAILED;
     }
-                  
-    fHandle->totalNumPages += 1;        // update the total number of pages in the file
-
-    // remaining part is to update the total page number in header page
-    if (fseek(file, 0, SEEK_SET) != 0) return RC_WRITE_FAILED;
-    SM_PageHandle header = (SM_PageHandle) malloc(PAGE_SIZE);
-    if (header == NULL) return RC_WRITE_FAILED;
+    SM_FreeTrunk *trunk = (SM_FreeTrunk *) page;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&openFilesLock);
+    if (pageIsFree(fHandle, shared, pageNum)) {
+        rc = RC_SM_PAGE_ALREADY_FREE;
+        goto finally;
+    }
 
-    size_t readBytes = fread(header, sizeof(char), PAGE_SIZE, file);
-    if (readBytes != PAGE_SIZE) {
-        free(header);
-        return RC_READ_NON_EXISTING_PAGE;
+    PageNumber oldTrunk = shared->freeTrunk;
+    bool added = false;
+    if (shared->freeCount > 0) {
+        // room left in the first trunk: record the page as a leaf
+        rc = trunkIO(shared->freeTrunk, fHandle, page, false);
+        if (rc != RC_OK) goto finally;
+        if (trunk->count < SM_TRUNK_CAPACITY(PAGE_DATA_SIZE(shared))) {
+            trunk->leaves[trunk->count++] = pageNum;
+            rc = trunkIO(shared->freeTrunk, fHandle, page, true);
+            if (rc != RC_OK) goto finally;
+            added = true;
+        }
+    }
+    if (!added) {
+        // no trunk yet, or the first one is full: the page becomes the new first trunk
+        memset(page, 0, shared->pageSize);
+        trunk->nextTrunk = shared->freeCount > 0 ? shared->freeTrunk : -1;
+        trunk->count = 0;
+        rc = trunkIO(pageNum, fHandle, page, true);
+        if (rc != RC_OK) goto finally;
+        shared->freeTrunk = pageNum;
     }
 
-    // check consistency
-    int headerTotalPages;
-    memcpy(&headerTotalPages, header, sizeof(int));
-    if (headerTotalPages != fHandle->totalNumPages - 1) {
-        free(header);
-        return RC_WRITE_FAILED; // inconsistent state
+    shared->freeCount++;
+    rc = writeHeader(fHandle, shared->markedUnclean);
+    if (rc != RC_OK) {
+        shared->freeCount--;
+        shared->freeTrunk = oldTrunk;
+        goto finally;
+    }
+    setFreeBit(shared, pageNum, true);
+    if (added) {
+        punchPage((SM_FileMgmt *) fHandle->mgmtInfo, pageNum);
     }
 
-    // update header totalPages
-    memcpy(header, &fHandle->totalNumPages, sizeof(int));
+finally:
+    pthread_mutex_unlock(&openFilesLock);
+    freePageBuffer(page);
+    return rc;
+}
 
-    // write header back to page 0
-    if (fseek(file, 0, SEEK_SET) != 0) {
-        free(header);
-        return RC_WRITE_FAILED;
+bool isPageFree(PageNumber pageNum, SM_FileHandle *fHandle) {
+    // true if the page is on the free list (answered from an in-memory bitmap)
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL || pageNum < 0) {
+        return false;
     }
-    size_t headerWritten = fwrite(header, sizeof(char), PAGE_SIZE, file);
-    free(header);
-    if (headerWritten != PAGE_SIZE) return RC_WRITE_FAILED;
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    pthread_mutex_lock(&openFilesLock);
+    bool isFree = pageIsFree(fHandle, shared, pageNum);
+    pthread_mutex_unlock(&openFilesLock);
+    return isFree;
+}
 
-    fflush(file);                  // make sure data is flushed to disk
-    return RC_OK;
+PageNumber getFreePageCount(SM_FileHandle *fHandle) {
+    // pages waiting on the free list
+    if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
+        return -1;
+    }
+    SM_SharedFile *shared = ((SM_FileMgmt *) fHandle->mgmtInfo)->shared;
+    pthread_mutex_lock(&openFilesLock);
+    PageNumber count = shared->freeCount;
+    pthread_mutex_unlock(&openFilesLock);
+    return count;
 }
 
-RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
+static int comparePageNumbers(const void *a, const void *b) {
+    PageNumber x = *(const PageNumber *) a;
+    PageNumber y = *(const PageNumber *) b;
+    return (x > y) - (x < y);
+}
 
-    // error checks    
+RC compactPageFile(SM_FileHandle *fHandle) {
+    /*
+        Punch every free-list leaf in one pass, one fallocate per run of
+        adjacent pages; trunks hold the list and keep their blocks. Catches
+        pages freed while punching was not possible (or by an older version),
+        and in a compressed file also the dead space left behind by pages
+        whose slot moved. Page numbers and the file size stay as they are.
+    */
     if (fHandle == NULL || fHandle->mgmtInfo == NULL) {
         return RC_FILE_HANDLE_NOT_INIT;
     }
-
-    while (fHandle->totalNumPages < numberOfPages) {
-        // keep appending empty pages until the file has at least numberOfPages pages
-        RC rc = appendEmptyBlock(fHandle);
-        if (rc != RC_OK) {
-            return rc; // if appending fails, return the error immediately
+    if (IS_SNAPSHOT(fHandle)) {
+        return RC_SM_READ_ONLY;
+    }
+    SM_FileMgmt *mgmt = (SM_FileMgmt *) fHandle->mgmtInfo;
+    SM_SharedFile *shared = mgmt->shared;
+    pthread_mutex_lock(&openFilesLock);
+    PageNumber *leaves = (PageNumber *) malloc(sizeof(PageNumber) * (size_t) (shared->freeCount + 1));
+    SM_FreeTrunk *trunk = (SM_FreeTrunk *) allocPageBufferSized(shared->pageSize);
+    RC rc = (leaves == NULL || trunk == NULL) ? RC_WRITE_FAILED : RC_OK;
+
+    PageNumber count = 0;
+    PageNumber seen = 0;
+    PageNumber t = shared->freeCount > 0 ? shared->freeTrunk : -1;
+    while (rc == RC_OK && t >= 0 && seen < shared->freeCount) {
+        rc = trunkIO(t, fHandle, (SM_PageHandle) trunk, false);
+        if (rc != RC_OK) break;
+        seen++;
+        for (int i = 0; i < trunk->count && i < SM_TRUNK_CAPACITY(PAGE_DATA_SIZE(shared)) && seen < shared->freeCount; i++) {
+            leaves[count++] = trunk->leaves[i];
+            seen++;
         }
+        t = trunk->nextTrunk;
     }
 
-    return RC_OK;
+    if (rc == RC_OK && shared->slotted) {
+        for (PageNumber i = 0; i < count && rc == RC_OK; i++) {
+            rc = releaseSlottedPage(mgmt, leaves[i]);
+        }
+        if (rc == RC_OK) {
+            rc = punchDeadSpace(mgmt);
+        }
+    } else if (rc == RC_OK) {
+        qsort(leaves, (size_t) count, sizeof(PageNumber), comparePageNumbers);
+        PageNumber runStart = 0;
+        for (PageNumber i = 1; i <= count; i++) {
+            if (i == count || leaves[i] != leaves[i - 1] + 1) {
+                punchRange(mgmt->backend, mgmt->fd, PAGE_OFFSET(leaves[runStart], shared->pageSize),
+                           (off_t) (i - runStart) * shared->pageSize);
+                runStart = i;
+            }
+        }
+    }
+    pthread_mutex_unlock(&openFilesLock);
+    free(leaves);
+    freePageBuffer((SM_PageHandle) trunk);
+    return rc;
 }
 
 /*
@@ -2,32 +2,101 @@
 #define STORAGE_MGR_H
 
 #include "dberror.h"
+#include "dt.h"
+
+/* files grow by whole extents of this many pages (see setExtentSize) */
+#define SM_DEFAULT_EXTENT_PAGES 64
+#define SM_MAX_EXTENT_PAGES 1024
+
+/* buffers handed to O_DIRECT handles are aligned to this (see allocPageBuffer) */
+#define SM_IO_ALIGNMENT 4096
+
+/* page sizes accepted by createPageFileWithPageSize (powers of two); PAGE_SIZE is the default */
+#define SM_MIN_PAGE_SIZE 4096
+#define SM_MAX_PAGE_SIZE 65536
+
+/* createPageFileWithOptions: every data page ends in a CRC32C of the rest of the page */
+#define SM_PAGE_CHECKSUMS 0x1
+#define SM_PAGE_TRAILER_SIZE 4
+/* createPageFileWithOptions: pages are stored compressed, in slots of the size they compress to */
+#define SM_PAGE_COMPRESSED 0x2
+/* createPageFileWithOptions: page writes go through a doublewrite file first, torn pages are repaired on open */
+#define SM_PAGE_DOUBLEWRITE 0x4
+#define SM_DOUBLEWRITE_SUFFIX ".dw"     // the doublewrite file is the page file's name plus this
+#define SM_DOUBLEWRITE_PAGES 64         // most pages per doublewrite batch
+/* createPageFileWithOptions: pages are stored uncompressed in slots, so the file can take snapshots */
+#define SM_PAGE_SNAPSHOTS 0x8
+
+/* read-ahead window for sequential readers, in pages: starts small, doubles up to the maximum */
+#define SM_READAHEAD_MIN_PAGES 4
+#define SM_READAHEAD_MAX_PAGES 256
+
+/* when page writes are forced to stable storage (see setSyncPolicy) */
+typedef enum SM_SyncPolicy {
+	SM_SYNC_NONE = 0,       // never, the kernel writes back when it likes (default)
+	SM_SYNC_ON_CLOSE = 1,   // once, when the last handle on the file closes
+	SM_SYNC_GROUP = 2,      // after N pending pages or N ms, and on close
+	SM_SYNC_STRICT = 3      // after every write call
+} SM_SyncPolicy;
 
 /************************************************************
  *                    handle data structures                *
  ************************************************************/
 typedef struct SM_FileHandle {
 	char *fileName;
-	int totalNumPages;
-	int curPagePos;
+	PageNumber totalNumPages;
+	PageNumber curPagePos;
 	void *mgmtInfo;
 } SM_FileHandle;
 
 typedef char* SM_PageHandle;
 
+/* asynchronous page I/O */
+#define SM_ASYNC_QUEUE_DEPTH 64     // default io_uring submission queue size
+#define SM_ASYNC_WORKERS 4          // threads used when io_uring is unavailable
+
+typedef enum SM_AsyncEngine {
+	SM_ASYNC_AUTO = 0,      // io_uring if the kernel allows it, thread pool otherwise
+	SM_ASYNC_URING = 1,
+	SM_ASYNC_THREADS = 2
+} SM_AsyncEngine;
+
+typedef struct SM_AsyncRequest {
+	PageNumber pageNum;
+	SM_PageHandle memPage;
+	bool isWrite;
+	bool done;              // set by the engine once the transfer finished
+	RC rc;                  // result of the transfer, valid when done
+	// engine bookkeeping
+	int fd;                 // a kernel descriptor, for some backends not the handle's own
+	long long offset;       // where the page starts in fd
+	int pageSize;
+	bool verify;
+	int transferred;
+	bool sync;              // a write to an SM_SYNC_STRICT file: done after its fdatasync
+	struct SM_AsyncRequest *next;
+} SM_AsyncRequest;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
-/* manipulating page files */
+/* manipulating page files; a name starting with "mem:" is a file in memory (see storage_backend.h) */
 extern void initStorageManager (void);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithPageSize (char *fileName, int pageSize);
+extern RC createPageFileWithOptions (char *fileName, int pageSize, int options);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
+extern int getPageSize (SM_FileHandle *fHandle);
+extern int getPageDataSize (SM_FileHandle *fHandle);
+
+/* page checksums (files created with SM_PAGE_CHECKSUMS) */
+extern RC setChecksumVerification (SM_FileHandle *fHandle, bool verify);
 
 /* reading blocks from disc */
-extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
-extern int getBlockPos (SM_FileHandle *fHandle);
+extern RC readBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern PageNumber getBlockPos (SM_FileHandle *fHandle);
 extern RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
@@ -35,9 +104,65 @@ extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 
 /* writing blocks to a page file */
-extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
-extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC ensureCapacity (PageNumber numberOfPages, SM_FileHandle *fHandle);
+
+/* extent allocation: totalNumPages is the logical size, capacity may run ahead */
+extern RC setExtentSize (int extentPages, SM_FileHandle *fHandle);
+extern PageNumber getAllocatedPages (SM_FileHandle *fHandle);
+
+/* the header is cached per file and written on close, on sync and per extent */
+extern RC syncPageFile (SM_FileHandle *fHandle);
+
+/* durability: per-file sync policy, kept in the header */
+extern RC setSyncPolicy (SM_FileHandle *fHandle, SM_SyncPolicy policy, int groupPages, int groupMillis);
+extern SM_SyncPolicy getSyncPolicy (SM_FileHandle *fHandle);
+extern long long getSyncCount (void);
+
+/* torn-page protection (files with SM_PAGE_CHECKSUMS): writes are copied to the doublewrite file first */
+extern RC setDoublewrite (SM_FileHandle *fHandle, bool enable);
+extern bool isDoublewriteEnabled (SM_FileHandle *fHandle);
+extern long long getDoublewriteRepairs (void);
+
+/* copy-on-write snapshots of slotted files (SM_PAGE_SNAPSHOTS, SM_PAGE_COMPRESSED): read-only handles */
+extern RC createSnapshot (char *fileName, SM_FileHandle *snapshot);
+extern RC dropSnapshot (SM_FileHandle *snapshot);
+extern bool isSnapshot (SM_FileHandle *fHandle);
+
+/* free-page management: freed pages are reused before the file grows, their blocks are punched */
+extern RC allocatePage (SM_FileHandle *fHandle, PageNumber *pageNum);
+extern RC deallocatePage (PageNumber pageNum, SM_FileHandle *fHandle);
+extern bool isPageFree (PageNumber pageNum, SM_FileHandle *fHandle);
+extern PageNumber getFreePageCount (SM_FileHandle *fHandle);
+extern RC compactPageFile (SM_FileHandle *fHandle);
+
+/* moving several pages per call (preadv/pwritev) */
+extern RC readBlocks (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *pages);
+extern RC writeBlocks (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *pages);
+extern RC readBlockList (PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *pages);
+extern RC writeBlockList (PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *pages);
+
+/* asynchronous page I/O: many reads/writes in flight, completion polled or awaited */
+extern RC initAsyncIO (SM_AsyncEngine engine, int queueDepth);
+extern RC shutdownAsyncIO (void);
+extern SM_AsyncEngine getAsyncEngine (void);
+extern RC submitReadBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncRequest *req);
+extern RC submitWriteBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, SM_AsyncRequest *req);
+extern bool pollAsyncIO (SM_AsyncRequest *req);
+extern RC waitAsyncIO (SM_AsyncRequest *req);
+extern RC waitAllAsyncIO (SM_AsyncRequest *reqs, int count);
+
+/* direct I/O (O_DIRECT): bypass the page cache, the buffer pool is the only cache */
+extern RC openPageFileDirect (char *fileName, SM_FileHandle *fHandle);
+extern bool isPageFileDirect (SM_FileHandle *fHandle);
+extern SM_PageHandle allocPageBuffer (void);
+extern SM_PageHandle allocPageBufferSized (int pageSize);
+extern void freePageBuffer (SM_PageHandle page);
+
+/* memory-mapped page files (zero-copy access) */
+extern RC openPageFileMapped (char *fileName, SM_FileHandle *fHandle);
+extern RC getPagePtr (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle *pagePtr);
 
 #endif
@@ -0,0 +1,664 @@
+/* preadv/pwritev and fallocate are POSIX/Linux, not plain C99 */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "stripe.h"
+#include "storage_mgr.h"
+
+/*
+    The stripe set file is text, so members can be moved to other disks by
+    editing it:
+
+        SMSTRIPE 1 <stripe unit> <members>
+        <member path>
+        ...
+
+    Byte offset o of the page file is in stripe s = o / unit, which lives in
+    member s % members at (s / members) * unit + o % unit. A long run of the
+    page file is one contiguous run in every member, so a multi-page
+    transfer becomes one preadv/pwritev per member, issued by that member's
+    thread while the caller does the first member's share itself.
+*/
+#define SM_STRIPE_MAGIC "SMSTRIPE"
+#define SM_STRIPE_VERSION 1
+#define STRIPE_IOV 64       // buffers per member call
+
+/* one buffer's share of a transfer that falls into one member */
+typedef struct StripePiece {
+    char *buf;
+    size_t len;
+    off_t offset;       // in the member file
+} StripePiece;
+
+/* the pieces one member thread transfers for a caller */
+typedef struct StripeJob {
+    StripePiece *pieces;
+    int count;
+    bool isWrite;
+    bool done;
+    int result;         // 0, or -1 with err set
+    int err;
+    struct StripeJob *next;
+} StripeJob;
+
+typedef struct StripeMember {
+    char *path;
+    int fd;
+    off_t size;                 // length of the member file
+    struct StripeSet *set;
+    pthread_t thread;           // only with more than one member
+    StripeJob *head, *tail;     // jobs waiting for the thread
+    pthread_cond_t work;
+} StripeMember;
+
+/*
+    An open stripe set, shared by every descriptor on its page file.
+    stripeLock guards the list, refCount and the descriptor table; lock
+    the job queues, the sizes and stopping.
+*/
+typedef struct StripeSet {
+    char *name;
+    struct stat st;             // the stripe set file's identity
+    off_t unit;
+    int numMembers;
+    StripeMember members[SM_STRIPE_MAX_MEMBERS];
+    off_t size;                 // length of the page file
+    int refCount;
+    bool listed;                // false once its page file was destroyed
+    bool stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    struct StripeSet *next;
+} StripeSet;
+
+static StripeSet *stripeSets = NULL;
+static StripeSet **stripeFds = NULL;
+static int stripeFdCount = 0;
+static pthread_mutex_t stripeLock = PTHREAD_MUTEX_INITIALIZER;
+static long long parallelIOs = 0;
+
+/* read the stripe set file name into set; -1 with errno set if it is none */
+static int readStripeSet(const char *name, StripeSet *set) {
+    FILE *f = fopen(name, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    char magic[16];
+    int version, numMembers;
+    long long unit;
+    if (fscanf(f, "%15s %d %lld %d ", magic, &version, &unit, &numMembers) != 4
+        || strcmp(magic, SM_STRIPE_MAGIC) != 0 || version != SM_STRIPE_VERSION
+        || unit <= 0 || unit % SM_MAX_PAGE_SIZE != 0 || numMembers < 1 || numMembers > SM_STRIPE_MAX_MEMBERS) {
+        fclose(f);
+        errno = EINVAL;
+        return -1;
+    }
+    set->unit = (off_t) unit;
+    set->numMembers = numMembers;
+    char path[4096];
+    for (int m = 0; m < numMembers; m++) {
+        if (fgets(path, sizeof(path), f) == NULL) {
+            while (m > 0) free(set->members[--m].path);
+            fclose(f);
+            errno = EINVAL;
+            return -1;
+        }
+        path[strcspn(path, "\n")] = '\0';
+        set->members[m].path = strdup(path);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* the member holding byte offset of the page file, and where in it */
+static int memberOf(StripeSet *set, off_t offset, off_t *memberOffset) {
+    off_t stripe = offset / set->unit;
+    *memberOffset = (stripe / set->numMembers) * set->unit + offset % set->unit;
+    return (int) (stripe % set->numMembers);
+}
+
+/* one vectored call's worth, repeated until done; a read past the member's end is a hole */
+static int transferRun(int fd, struct iovec *iov, int iovcnt, off_t offset, bool isWrite) {
+    while (iovcnt > 0) {
+        ssize_t n = isWrite ? pwritev(fd, iov, iovcnt, offset) : preadv(fd, iov, iovcnt, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            if (isWrite) {
+                errno = EIO;
+                return -1;
+            }
+            for (int i = 0; i < iovcnt; i++) memset(iov[i].iov_base, 0, iov[i].iov_len);
+            return 0;
+        }
+        offset += n;
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= (ssize_t) iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= (size_t) n;
+        }
+    }
+    return 0;
+}
+
+/* transfer a member's pieces, adjacent ones in one call */
+static int memberIO(StripeMember *member, StripePiece *pieces, int count, bool isWrite) {
+    struct iovec iov[STRIPE_IOV];
+    int i = 0;
+    while (i < count) {
+        off_t offset = pieces[i].offset;
+        off_t end = offset;
+        int n = 0;
+        while (i + n < count && n < STRIPE_IOV && pieces[i + n].offset == end) {
+            iov[n].iov_base = pieces[i + n].buf;
+            iov[n].iov_len = pieces[i + n].len;
+            end += (off_t) pieces[i + n].len;
+            n++;
+        }
+        if (transferRun(member->fd, iov, n, offset, isWrite) != 0) {
+            return -1;
+        }
+        i += n;
+    }
+    return 0;
+}
+
+static void *memberWorker(void *arg) {
+    StripeMember *member = (StripeMember *) arg;
+    StripeSet *set = member->set;
+    pthread_mutex_lock(&set->lock);
+    for (;;) {
+        while (member->head == NULL && !set->stopping) {
+            pthread_cond_wait(&member->work, &set->lock);
+        }
+        if (member->head == NULL) {
+            break;
+        }
+        StripeJob *job = member->head;
+        member->head = job->next;
+        if (member->head == NULL) member->tail = NULL;
+
+        pthread_mutex_unlock(&set->lock);
+        int result = memberIO(member, job->pieces, job->count, job->isWrite);
+        int err = errno;
+        pthread_mutex_lock(&set->lock);
+        job->result = result;
+        job->err = err;
+        job->done = true;
+        pthread_cond_broadcast(&set->done);
+    }
+    pthread_mutex_unlock(&set->lock);
+    return NULL;
+}
+
+/*
+    Move the buffers iov[0..iovcnt-1] to or from the page file at offset:
+    split them at stripe boundaries, group the pieces by member and run
+    every member's group at the same time. Reads stop at the end of the
+    page file.
+*/
+static ssize_t stripeTransfer(StripeSet *set, const struct iovec *iov, int iovcnt, off_t offset, bool isWrite) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+    if (!isWrite) {
+        pthread_mutex_lock(&set->lock);
+        off_t size = set->size;
+        pthread_mutex_unlock(&set->lock);
+        if (offset >= size) {
+            return 0;
+        }
+        if ((off_t) len > size - offset) len = (size_t) (size - offset);
+    }
+
+    // pieces in page file order, then grouped by member (keeping that order)
+    int bound = iovcnt + (int) (len / (size_t) set->unit) + 2;
+    StripePiece *pieces = (StripePiece *) malloc(2 * (size_t) bound * sizeof(StripePiece));
+    int *owner = (int *) malloc((size_t) bound * sizeof(int));
+    if (pieces == NULL || owner == NULL) {
+        free(pieces);
+        free(owner);
+        errno = ENOMEM;
+        return -1;
+    }
+    int count = 0;
+    size_t done = 0;
+    for (int i = 0; i < iovcnt && done < len; i++) {
+        size_t used = 0;
+        while (used < iov[i].iov_len && done < len) {
+            off_t pos = offset + (off_t) done;
+            size_t piece = (size_t) (set->unit - pos % set->unit);
+            if (piece > iov[i].iov_len - used) piece = iov[i].iov_len - used;
+            if (piece > len - done) piece = len - done;
+            owner[count] = memberOf(set, pos, &pieces[count].offset);
+            pieces[count].buf = (char *) iov[i].iov_base + used;
+            pieces[count].len = piece;
+            count++;
+            used += piece;
+            done += piece;
+        }
+    }
+    StripePiece *grouped = pieces + bound;
+    int first[SM_STRIPE_MAX_MEMBERS + 1] = { 0 };
+    for (int p = 0; p < count; p++) first[owner[p] + 1]++;
+    for (int m = 0; m < set->numMembers; m++) first[m + 1] += first[m];
+    int fill[SM_STRIPE_MAX_MEMBERS];
+    memcpy(fill, first, sizeof(fill));
+    for (int p = 0; p < count; p++) grouped[fill[owner[p]]++] = pieces[p];
+
+    // the other members' threads take their share, this thread the first member's
+    StripeJob jobs[SM_STRIPE_MAX_MEMBERS];
+    int inline_ = -1, queued = 0;
+    pthread_mutex_lock(&set->lock);
+    for (int m = 0; m < set->numMembers; m++) {
+        if (first[m + 1] == first[m]) continue;
+        if (inline_ < 0) {
+            inline_ = m;
+            continue;
+        }
+        StripeJob *job = &jobs[m];
+        job->pieces = grouped + first[m];
+        job->count = first[m + 1] - first[m];
+        job->isWrite = isWrite;
+        job->done = false;
+        job->next = NULL;
+        StripeMember *member = &set->members[m];
+        if (member->tail != NULL) member->tail->next = job;
+        else member->head = job;
+        member->tail = job;
+        pthread_cond_signal(&member->work);
+        queued++;
+    }
+    pthread_mutex_unlock(&set->lock);
+    if (queued > 0) {
+        __atomic_add_fetch(&parallelIOs, 1, __ATOMIC_RELAXED);
+    }
+
+    int result = 0, err = 0;
+    if (inline_ >= 0 && memberIO(&set->members[inline_], grouped + first[inline_],
+                                 first[inline_ + 1] - first[inline_], isWrite) != 0) {
+        result = -1;
+        err = errno;
+    }
+    pthread_mutex_lock(&set->lock);
+    for (int m = inline_ + 1; m < set->numMembers; m++) {
+        if (inline_ < 0 || first[m + 1] == first[m]) continue;
+        while (!jobs[m].done) pthread_cond_wait(&set->done, &set->lock);
+        if (jobs[m].result != 0 && result == 0) {
+            result = -1;
+            err = jobs[m].err;
+        }
+    }
+    if (result == 0 && isWrite) {
+        for (int p = 0; p < count; p++) {
+            StripeMember *member = &set->members[owner[p]];
+            if (pieces[p].offset + (off_t) pieces[p].len > member->size) {
+                member->size = pieces[p].offset + (off_t) pieces[p].len;
+            }
+        }
+        if (offset + (off_t) len > set->size) set->size = offset + (off_t) len;
+    }
+    pthread_mutex_unlock(&set->lock);
+    free(pieces);
+    free(owner);
+    if (result != 0) {
+        errno = err;
+        return -1;
+    }
+    return (ssize_t) len;
+}
+
+/* the page file's length, from the members' lengths */
+static off_t stripeLength(StripeSet *set) {
+    off_t size = 0;
+    for (int m = 0; m < set->numMembers; m++) {
+        off_t last = set->members[m].size - 1;
+        if (last < 0) continue;
+        off_t end = ((last / set->unit) * set->numMembers + m) * set->unit + last % set->unit + 1;
+        if (end > size) size = end;
+    }
+    return size;
+}
+
+/* stop the member threads and close the members (stripeLock held, set unlisted) */
+static void closeStripeSet(StripeSet *set) {
+    if (set->numMembers > 1) {
+        pthread_mutex_lock(&set->lock);
+        set->stopping = true;
+        for (int m = 0; m < set->numMembers; m++) pthread_cond_signal(&set->members[m].work);
+        pthread_mutex_unlock(&set->lock);
+        for (int m = 0; m < set->numMembers; m++) {
+            if (set->members[m].thread != 0) pthread_join(set->members[m].thread, NULL);
+        }
+    }
+    for (int m = 0; m < set->numMembers; m++) {
+        if (set->members[m].fd >= 0) close(set->members[m].fd);
+        pthread_cond_destroy(&set->members[m].work);
+        free(set->members[m].path);
+    }
+    pthread_cond_destroy(&set->done);
+    pthread_mutex_destroy(&set->lock);
+    free(set->name);
+    free(set);
+}
+
+/* open the stripe set name with its members (stripeLock held) */
+static StripeSet *openStripeSet(const char *name, int flags, mode_t mode) {
+    StripeSet *set = (StripeSet *) calloc(1, sizeof(StripeSet));
+    if (set == NULL || (set->name = strdup(name)) == NULL) {
+        free(set);
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (readStripeSet(name, set) != 0 || stat(name, &set->st) != 0) {
+        int err = errno;
+        for (int m = 0; m < set->numMembers; m++) free(set->members[m].path);
+        free(set->name);
+        free(set);
+        errno = err;
+        return NULL;
+    }
+    pthread_mutex_init(&set->lock, NULL);
+    pthread_cond_init(&set->done, NULL);
+    int err = 0;
+    for (int m = 0; m < set->numMembers; m++) {
+        StripeMember *member = &set->members[m];
+        struct stat st;
+        member->set = set;
+        pthread_cond_init(&member->work, NULL);
+        member->fd = member->path != NULL ? open(member->path, O_RDWR | (flags & (O_CREAT | O_TRUNC)), mode) : -1;
+        if (member->fd < 0 || fstat(member->fd, &st) != 0) {
+            err = member->path != NULL ? errno : ENOMEM;
+        } else {
+            member->size = st.st_size;
+        }
+    }
+    for (int m = 0; err == 0 && set->numMembers > 1 && m < set->numMembers; m++) {
+        if (pthread_create(&set->members[m].thread, NULL, memberWorker, &set->members[m]) != 0) {
+            err = EAGAIN;
+        }
+    }
+    if (err != 0) {
+        closeStripeSet(set);
+        errno = err;
+        return NULL;
+    }
+    set->size = stripeLength(set);
+    set->listed = true;
+    set->next = stripeSets;
+    stripeSets = set;
+    return set;
+}
+
+static void unlistStripeSet(StripeSet *set) {
+    StripeSet **link = &stripeSets;
+    while (*link != NULL && *link != set) link = &(*link)->next;
+    if (*link != NULL) *link = set->next;
+    set->listed = false;
+}
+
+static StripeSet *stripeFile(int fd) {
+    StripeSet *set = NULL;
+    pthread_mutex_lock(&stripeLock);
+    if (fd >= 0 && fd < stripeFdCount) {
+        set = stripeFds[fd];
+    }
+    pthread_mutex_unlock(&stripeLock);
+    if (set == NULL) {
+        errno = EBADF;
+    }
+    return set;
+}
+
+/************************************************************
+ *                    backend calls                         *
+ ************************************************************/
+static int stripeOpen(const char *path, int flags, mode_t mode) {
+    const char *name = path + strlen(SM_STRIPE_PREFIX);
+    pthread_mutex_lock(&stripeLock);
+    StripeSet *set = stripeSets;
+    while (set != NULL && strcmp(set->name, name) != 0) set = set->next;
+    if (set != NULL && (flags & O_TRUNC)) {
+        pthread_mutex_lock(&set->lock);
+        for (int m = 0; m < set->numMembers; m++) {
+            if (ftruncate(set->members[m].fd, 0) == 0) set->members[m].size = 0;
+        }
+        set->size = stripeLength(set);
+        pthread_mutex_unlock(&set->lock);
+    } else if (set == NULL && (set = openStripeSet(name, flags, mode)) == NULL) {
+        pthread_mutex_unlock(&stripeLock);
+        return -1;
+    }
+
+    int fd = 0;
+    while (fd < stripeFdCount && stripeFds[fd] != NULL) {
+        fd++;
+    }
+    if (fd == stripeFdCount) {
+        int count = stripeFdCount > 0 ? 2 * stripeFdCount : 16;
+        StripeSet **fds = (StripeSet **) realloc(stripeFds, count * sizeof(StripeSet *));
+        if (fds == NULL) {
+            if (set->refCount == 0) {
+                unlistStripeSet(set);
+                closeStripeSet(set);
+            }
+            pthread_mutex_unlock(&stripeLock);
+            errno = EMFILE;
+            return -1;
+        }
+        memset(fds + stripeFdCount, 0, (count - stripeFdCount) * sizeof(StripeSet *));
+        stripeFds = fds;
+        stripeFdCount = count;
+    }
+    stripeFds[fd] = set;
+    set->refCount++;
+    pthread_mutex_unlock(&stripeLock);
+    return fd;
+}
+
+static int stripeClose(int fd) {
+    pthread_mutex_lock(&stripeLock);
+    if (fd < 0 || fd >= stripeFdCount || stripeFds[fd] == NULL) {
+        pthread_mutex_unlock(&stripeLock);
+        errno = EBADF;
+        return -1;
+    }
+    StripeSet *set = stripeFds[fd];
+    stripeFds[fd] = NULL;
+    if (--set->refCount == 0) {
+        if (set->listed) unlistStripeSet(set);
+        closeStripeSet(set);
+    }
+    pthread_mutex_unlock(&stripeLock);
+    return 0;
+}
+
+static ssize_t stripePread(int fd, void *buf, size_t len, off_t offset) {
+    StripeSet *set = stripeFile(fd);
+    struct iovec iov = { buf, len };
+    return set != NULL ? stripeTransfer(set, &iov, 1, offset, false) : -1;
+}
+
+static ssize_t stripePwrite(int fd, const void *buf, size_t len, off_t offset) {
+    StripeSet *set = stripeFile(fd);
+    struct iovec iov = { (void *) buf, len };
+    return set != NULL ? stripeTransfer(set, &iov, 1, offset, true) : -1;
+}
+
+static ssize_t stripePreadv(int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+    StripeSet *set = stripeFile(fd);
+    return set != NULL ? stripeTransfer(set, iov, iovcnt, offset, false) : -1;
+}
+
+static ssize_t stripePwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+    StripeSet *set = stripeFile(fd);
+    return set != NULL ? stripeTransfer(set, iov, iovcnt, offset, true) : -1;
+}
+
+/* apply a per-member call to every member's share of [offset, offset + len) */
+static int forEachPiece(StripeSet *set, off_t offset, off_t len, int (*call) (int, off_t, off_t), bool grow) {
+    off_t end = offset + len;
+    while (offset < end) {
+        off_t memberOffset;
+        int m = memberOf(set, offset, &memberOffset);
+        off_t piece = set->unit - offset % set->unit;
+        if (piece > end - offset) piece = end - offset;
+        if (call(set->members[m].fd, memberOffset, piece) != 0) {
+            return -1;
+        }
+        if (grow) {
+            pthread_mutex_lock(&set->lock);
+            if (memberOffset + piece > set->members[m].size) set->members[m].size = memberOffset + piece;
+            pthread_mutex_unlock(&set->lock);
+        }
+        offset += piece;
+    }
+    return 0;
+}
+
+static int stripeExtend(int fd, off_t offset, off_t len) {
+    StripeSet *set = stripeFile(fd);
+    if (set == NULL || forEachPiece(set, offset, len, smPosixBackend.extend, true) != 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&set->lock);
+    if (offset + len > set->size) set->size = offset + len;
+    pthread_mutex_unlock(&set->lock);
+    return 0;
+}
+
+static int stripePunch(int fd, off_t offset, off_t len) {
+    StripeSet *set = stripeFile(fd);
+    return set != NULL ? forEachPiece(set, offset, len, smPosixBackend.punch, false) : -1;
+}
+
+static int stripeSync(int fd) {
+    StripeSet *set = stripeFile(fd);
+    if (set == NULL) {
+        return -1;
+    }
+    int res = 0;
+    for (int m = 0; m < set->numMembers; m++) {
+        if (fdatasync(set->members[m].fd) != 0) res = -1;
+    }
+    return res;
+}
+
+static int stripeStat(int fd, struct stat *st) {
+    StripeSet *set = stripeFile(fd);
+    if (set == NULL) {
+        return -1;
+    }
+    // the stripe set file stands for the page file; its blocks are the members'
+    *st = set->st;
+    st->st_blocks = 0;
+    for (int m = 0; m < set->numMembers; m++) {
+        struct stat member;
+        if (fstat(set->members[m].fd, &member) == 0) st->st_blocks += member.st_blocks;
+    }
+    pthread_mutex_lock(&set->lock);
+    st->st_size = set->size;
+    pthread_mutex_unlock(&set->lock);
+    st->st_nlink = set->listed ? 1 : 0;
+    return 0;
+}
+
+static int stripeUnlink(const char *path) {
+    const char *name = path + strlen(SM_STRIPE_PREFIX);
+    StripeSet layout;
+    memset(&layout, 0, sizeof(layout));
+    if (readStripeSet(name, &layout) != 0) {
+        return -1;
+    }
+    // open handles keep the members they have, a later open makes new ones
+    pthread_mutex_lock(&stripeLock);
+    StripeSet *set = stripeSets;
+    while (set != NULL && strcmp(set->name, name) != 0) set = set->next;
+    if (set != NULL) unlistStripeSet(set);
+    pthread_mutex_unlock(&stripeLock);
+
+    int res = 0, err = 0;
+    for (int m = 0; m < layout.numMembers; m++) {
+        if (layout.members[m].path == NULL || unlink(layout.members[m].path) != 0) {
+            if (res == 0) err = layout.members[m].path != NULL ? errno : ENOMEM;
+            res = -1;
+        }
+        free(layout.members[m].path);
+    }
+    errno = err;
+    return res;
+}
+
+static int stripeLocate(int fd, off_t offset, size_t len, off_t *kernelOffset) {
+    StripeSet *set = stripeFile(fd);
+    if (set == NULL || offset % set->unit + (off_t) len > set->unit) {
+        return -1;
+    }
+    // only bytes the member already has: a read past its end would come back short
+    int m = memberOf(set, offset, kernelOffset);
+    pthread_mutex_lock(&set->lock);
+    bool inside = *kernelOffset + (off_t) len <= set->members[m].size;
+    pthread_mutex_unlock(&set->lock);
+    return inside ? set->members[m].fd : -1;
+}
+
+const SM_Backend smStripeBackend = {
+    "stripe", false,
+    stripeOpen, stripeClose, stripePread, stripePwrite, stripeExtend, stripePunch, stripeSync, stripeStat, stripeUnlink,
+    stripePreadv, stripePwritev, stripeLocate
+};
+
+/************************************************************
+ *                    stripe sets                           *
+ ************************************************************/
+RC createStripeSet(char *fileName, char **members, int numMembers, int stripeUnit) {
+    if (fileName == NULL || members == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    if (stripeUnit == 0) {
+        stripeUnit = SM_STRIPE_DEFAULT_UNIT;
+    }
+    if (numMembers < 1 || numMembers > SM_STRIPE_MAX_MEMBERS || stripeUnit < 0 || stripeUnit % SM_MAX_PAGE_SIZE != 0) {
+        return RC_SM_UNSUPPORTED_FORMAT;
+    }
+    for (int m = 0; m < numMembers; m++) {
+        if (members[m] == NULL || members[m][0] == '\0' || strchr(members[m], '\n') != NULL) {
+            return RC_SM_UNSUPPORTED_FORMAT;
+        }
+    }
+    // a stripe set in use keeps the layout it was opened with
+    pthread_mutex_lock(&stripeLock);
+    StripeSet *set = stripeSets;
+    while (set != NULL && strcmp(set->name, fileName) != 0) set = set->next;
+    pthread_mutex_unlock(&stripeLock);
+    if (set != NULL) {
+        return RC_WRITE_FAILED;
+    }
+
+    FILE *f = fopen(fileName, "w");
+    if (f == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    fprintf(f, "%s %d %d %d\n", SM_STRIPE_MAGIC, SM_STRIPE_VERSION, stripeUnit, numMembers);
+    for (int m = 0; m < numMembers; m++) {
+        fprintf(f, "%s\n", members[m]);
+    }
+    return fclose(f) == 0 ? RC_OK : RC_WRITE_FAILED;
+}
+
+long long getStripeParallelIOs(void) {
+    return __atomic_load_n(&parallelIOs, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,32 @@
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include "storage_backend.h"
+
+/*
+    Striped page files: a page file split round-robin, one stripe unit at a
+    time, across several member files, typically one per disk. A stripe set
+    is a small text file naming the members and the stripe unit, made with
+    createStripeSet; the page file itself is named "stripe:<stripe set>".
+    Multi-page transfers (readBlocks, readBlockList, the buffer pool's
+    read-ahead) move every member's share at once, one thread per member,
+    and async requests go straight to the member file holding the page.
+    The stripe unit is a multiple of SM_MAX_PAGE_SIZE, so no page is split.
+*/
+#define SM_STRIPE_PREFIX "stripe:"
+#define SM_STRIPE_DEFAULT_UNIT (256 * 1024)
+#define SM_STRIPE_MAX_MEMBERS 16
+
+extern const SM_Backend smStripeBackend;
+
+/*
+    Write the stripe set fileName over members[0..numMembers-1]; stripeUnit
+    bytes per stripe, 0 for SM_STRIPE_DEFAULT_UNIT. The member files are
+    made by createPageFile("stripe:<fileName>") and removed again by
+    destroyPageFile on that name; the stripe set is a plain file.
+*/
+extern RC createStripeSet (char *fileName, char **members, int numMembers, int stripeUnit);
+/* transfers that went to more than one member at the same time, over all stripe sets */
+extern long long getStripeParallelIOs (void);
+
+#endif
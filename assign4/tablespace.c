@@ -0,0 +1,668 @@
+/* pread/pwrite and fallocate flags are POSIX/Linux, not plain C99 */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "tablespace.h"
+
+/*
+    On disk:
+
+        [0, SM_TS_HEADER_BYTES)     SM_TsHeader
+        directory                   SM_TS_MAX_SEGMENTS entries of SM_TsDirEntry
+        extent map                  SM_TS_MAX_EXTENTS int32: per extent the next extent
+                                    of its segment, SM_TS_LAST_EXTENT at the end of a
+                                    chain, SM_TS_FREE_EXTENT if no segment owns it
+        extents                     SM_TS_EXTENT_BYTES each, from TS_DATA_OFFSET
+
+    A new extent is the lowest free one, so segments stay near the start of
+    the file and extents freed by a dropped segment are used again first.
+    The file only grows as far as its highest extent in use. Directory and
+    extent map entries are written as soon as they change: map entries
+    before the directory entry that points at them.
+*/
+#define SM_TS_MAGIC 0x53544d53      // "SMTS" on disk
+#define SM_TS_VERSION 1
+#define SM_TS_HEADER_BYTES 4096
+#define SM_TS_LAST_EXTENT (-1)
+#define SM_TS_FREE_EXTENT (-2)
+
+typedef struct SM_TsHeader {
+    int32_t magic;
+    int32_t version;
+    int32_t extentBytes;
+    int32_t maxSegments;
+    int32_t maxExtents;
+} SM_TsHeader;
+
+typedef struct SM_TsDirEntry {
+    char name[SM_TS_NAME_LEN];  // "" for an unused entry
+    int64_t size;               // length of the segment's page file in bytes
+    int32_t firstExtent;        // SM_TS_LAST_EXTENT while it has none
+    int32_t numExtents;
+} SM_TsDirEntry;
+
+#define TS_DIR_OFFSET ((off_t) SM_TS_HEADER_BYTES)
+#define TS_MAP_OFFSET (TS_DIR_OFFSET + (off_t) SM_TS_MAX_SEGMENTS * (off_t) sizeof(SM_TsDirEntry))
+#define TS_DATA_OFFSET (TS_MAP_OFFSET + (off_t) SM_TS_MAX_EXTENTS * (off_t) sizeof(int32_t))
+#define TS_EXTENT_OFFSET(extent) (TS_DATA_OFFSET + (off_t) (extent) * SM_TS_EXTENT_BYTES)
+
+/* a segment in memory: its extent chain as an array, for translating offsets */
+typedef struct TsSegment {
+    int32_t *extents;
+    int capExtents;
+    int openCount;      // descriptors on it
+    bool unlinked;      // directory entry gone, extents freed on the last close
+} TsSegment;
+
+/*
+    An open tablespace, shared by every descriptor on one of its segments,
+    like SM_SharedFile for page files. tsLock guards the list, refCount,
+    openCount and the descriptor table; lock guards the directory and the
+    extents: I/O through a segment shares it, allocating or freeing extents
+    and changing a segment's length take it exclusively.
+*/
+typedef struct Tablespace {
+    char *name;
+    const SM_Backend *backend;  // where the tablespace file lives
+    int fd;
+    struct stat st;             // the file's identity, for the segments' stat
+    int refCount;
+    SM_TsDirEntry dir[SM_TS_MAX_SEGMENTS];
+    TsSegment segs[SM_TS_MAX_SEGMENTS];
+    int32_t *map;               // SM_TS_MAX_EXTENTS entries
+    pthread_rwlock_t lock;
+    struct Tablespace *next;
+} Tablespace;
+
+typedef struct TsFd {
+    Tablespace *ts;     // NULL for a free descriptor
+    int seg;
+} TsFd;
+
+static Tablespace *tablespaces = NULL;
+static TsFd *tsFds = NULL;
+static int tsFdCount = 0;
+static pthread_mutex_t tsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+    Split "ts:<space>#<object>" into the tablespace file name (malloc'ed)
+    and the object name; NULL with errno set if path is no segment name.
+*/
+static char *splitName(const char *path, const char **object) {
+    size_t prefixLen = strlen(SM_TABLESPACE_PREFIX);
+    const char *sep = strrchr(path, SM_TABLESPACE_SEP);
+    if (strncmp(path, SM_TABLESPACE_PREFIX, prefixLen) != 0 || sep == NULL
+        || sep == path + prefixLen || sep[1] == '\0') {
+        errno = ENOENT;
+        return NULL;
+    }
+    if (strlen(sep + 1) >= SM_TS_NAME_LEN) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    size_t len = (size_t) (sep - path) - prefixLen;
+    char *space = (char *) malloc(len + 1);
+    if (space == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memcpy(space, path + prefixLen, len);
+    space[len] = '\0';
+    *object = sep + 1;
+    return space;
+}
+
+/* read or write all of len bytes at offset of a tablespace file */
+static int tsIO(const SM_Backend *backend, int fd, void *buf, size_t len, off_t offset, bool isWrite) {
+    char *p = (char *) buf;
+    while (len > 0) {
+        ssize_t n = isWrite ? backend->pwrite(fd, p, len, offset)
+                            : backend->pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            if (isWrite) {
+                errno = EIO;
+                return -1;
+            }
+            memset(p, 0, len);      // past the last extent in use
+            return 0;
+        }
+        p += n;
+        len -= (size_t) n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int writeDirEntry(Tablespace *ts, int seg) {
+    return tsIO(ts->backend, ts->fd, &ts->dir[seg], sizeof(SM_TsDirEntry), TS_DIR_OFFSET + (off_t) seg * (off_t) sizeof(SM_TsDirEntry), true);
+}
+
+static int writeMapEntry(Tablespace *ts, int32_t extent) {
+    return tsIO(ts->backend, ts->fd, &ts->map[extent], sizeof(int32_t), TS_MAP_OFFSET + (off_t) extent * (off_t) sizeof(int32_t), true);
+}
+
+/*
+    Find the open tablespace called name or open it (tsLock held); the
+    caller holds a reference on it. Every segment's chain is walked once
+    here, after that offsets are translated through TsSegment.extents.
+*/
+static Tablespace *tsAcquire(const char *name) {
+    for (Tablespace *ts = tablespaces; ts != NULL; ts = ts->next) {
+        if (strcmp(ts->name, name) == 0) {
+            ts->refCount++;
+            return ts;
+        }
+    }
+    const SM_Backend *backend = getStorageBackend(name);
+    if (backend == &smTablespaceBackend) {
+        errno = EINVAL;     // no tablespaces inside tablespaces
+        return NULL;
+    }
+    Tablespace *ts = (Tablespace *) calloc(1, sizeof(Tablespace));
+    if (ts == NULL || (ts->name = strdup(name)) == NULL
+        || (ts->map = (int32_t *) malloc(SM_TS_MAX_EXTENTS * sizeof(int32_t))) == NULL) {
+        if (ts != NULL) free(ts->name);
+        free(ts);
+        errno = ENOMEM;
+        return NULL;
+    }
+    ts->backend = backend;
+    ts->fd = backend->open(name, O_RDWR, 0);
+
+    SM_TsHeader header;
+    int err = ts->fd < 0 ? errno : 0;
+    if (err == 0 && (backend->stat(ts->fd, &ts->st) != 0
+                     || tsIO(backend, ts->fd, &header, sizeof(header), 0, false) != 0
+                     || tsIO(backend, ts->fd, ts->dir, sizeof(ts->dir), TS_DIR_OFFSET, false) != 0
+                     || tsIO(backend, ts->fd, ts->map, SM_TS_MAX_EXTENTS * sizeof(int32_t), TS_MAP_OFFSET, false) != 0)) {
+        err = EIO;
+    }
+    if (err == 0 && (header.magic != SM_TS_MAGIC || header.version != SM_TS_VERSION
+                     || header.extentBytes != SM_TS_EXTENT_BYTES || header.maxSegments != SM_TS_MAX_SEGMENTS
+                     || header.maxExtents != SM_TS_MAX_EXTENTS)) {
+        err = EINVAL;       // not a tablespace, or one laid out differently
+    }
+    for (int s = 0; err == 0 && s < SM_TS_MAX_SEGMENTS; s++) {
+        TsSegment *seg = &ts->segs[s];
+        if (ts->dir[s].name[0] == '\0' || ts->dir[s].numExtents == 0) {
+            continue;
+        }
+        seg->capExtents = ts->dir[s].numExtents;
+        seg->extents = (int32_t *) malloc((size_t) seg->capExtents * sizeof(int32_t));
+        if (seg->extents == NULL) {
+            err = ENOMEM;
+            break;
+        }
+        int32_t e = ts->dir[s].firstExtent;
+        for (int i = 0; i < ts->dir[s].numExtents; i++) {
+            if (e < 0 || e >= SM_TS_MAX_EXTENTS) {
+                err = EINVAL;   // broken chain
+                break;
+            }
+            seg->extents[i] = e;
+            e = ts->map[e];
+        }
+    }
+    if (err != 0) {
+        for (int s = 0; s < SM_TS_MAX_SEGMENTS; s++) free(ts->segs[s].extents);
+        if (ts->fd >= 0) backend->close(ts->fd);
+        free(ts->map);
+        free(ts->name);
+        free(ts);
+        errno = err;
+        return NULL;
+    }
+    pthread_rwlock_init(&ts->lock, NULL);
+    ts->refCount = 1;
+    ts->next = tablespaces;
+    tablespaces = ts;
+    return ts;
+}
+
+/* drop a reference (tsLock held); the last one closes the tablespace */
+static void tsRelease(Tablespace *ts) {
+    if (--ts->refCount > 0) {
+        return;
+    }
+    Tablespace **link = &tablespaces;
+    while (*link != ts) {
+        link = &(*link)->next;
+    }
+    *link = ts->next;
+    ts->backend->close(ts->fd);
+    for (int s = 0; s < SM_TS_MAX_SEGMENTS; s++) free(ts->segs[s].extents);
+    pthread_rwlock_destroy(&ts->lock);
+    free(ts->map);
+    free(ts->name);
+    free(ts);
+}
+
+/* give every extent of a segment back to the tablespace (write lock held) */
+static int freeExtents(Tablespace *ts, int s) {
+    TsSegment *seg = &ts->segs[s];
+    int res = 0;
+    for (int i = 0; i < ts->dir[s].numExtents; i++) {
+        int32_t e = seg->extents[i];
+        ts->map[e] = SM_TS_FREE_EXTENT;
+        if (writeMapEntry(ts, e) != 0) res = -1;
+        ts->backend->punch(ts->fd, TS_EXTENT_OFFSET(e), SM_TS_EXTENT_BYTES);
+    }
+    ts->dir[s].size = 0;
+    ts->dir[s].firstExtent = SM_TS_LAST_EXTENT;
+    ts->dir[s].numExtents = 0;
+    return res;
+}
+
+/*
+    Make segment s at least size bytes long (write lock held): new extents
+    are zeroed, chained to the segment's last one and recorded in the map
+    before the directory entry.
+*/
+static int growSegment(Tablespace *ts, int s, off_t size) {
+    SM_TsDirEntry *entry = &ts->dir[s];
+    TsSegment *seg = &ts->segs[s];
+    if (size <= entry->size) {
+        return 0;
+    }
+    int needed = (int) ((size + SM_TS_EXTENT_BYTES - 1) / SM_TS_EXTENT_BYTES);
+    if (needed > seg->capExtents) {
+        int cap = seg->capExtents > 0 ? seg->capExtents : 4;
+        while (cap < needed) cap *= 2;
+        int32_t *extents = (int32_t *) realloc(seg->extents, (size_t) cap * sizeof(int32_t));
+        if (extents == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        seg->extents = extents;
+        seg->capExtents = cap;
+    }
+    int32_t e = 0;
+    while (entry->numExtents < needed) {
+        while (e < SM_TS_MAX_EXTENTS && ts->map[e] != SM_TS_FREE_EXTENT) e++;
+        if (e == SM_TS_MAX_EXTENTS) {
+            errno = ENOSPC;
+            return -1;
+        }
+        // a reused extent may hold a dropped segment's bytes
+        ts->backend->punch(ts->fd, TS_EXTENT_OFFSET(e), SM_TS_EXTENT_BYTES);
+        if (ts->backend->extend(ts->fd, TS_EXTENT_OFFSET(e), SM_TS_EXTENT_BYTES) != 0) {
+            return -1;
+        }
+        ts->map[e] = SM_TS_LAST_EXTENT;
+        if (writeMapEntry(ts, e) != 0) {
+            return -1;
+        }
+        if (entry->numExtents == 0) {
+            entry->firstExtent = e;
+        } else {
+            int32_t last = seg->extents[entry->numExtents - 1];
+            ts->map[last] = e;
+            if (writeMapEntry(ts, last) != 0) {
+                return -1;
+            }
+        }
+        seg->extents[entry->numExtents++] = e;
+    }
+    entry->size = size;
+    return writeDirEntry(ts, s);
+}
+
+/* the tablespace and segment behind a descriptor, NULL with errno set if there is none */
+static Tablespace *tsFile(int fd, int *seg) {
+    Tablespace *ts = NULL;
+    pthread_mutex_lock(&tsLock);
+    if (fd >= 0 && fd < tsFdCount) {
+        ts = tsFds[fd].ts;
+        *seg = tsFds[fd].seg;
+    }
+    pthread_mutex_unlock(&tsLock);
+    if (ts == NULL) {
+        errno = EBADF;
+    }
+    return ts;
+}
+
+/*
+    Move len bytes between buf and the segment at offset, one piece per
+    extent touched (read lock held). Reads stop at the segment's end.
+*/
+static ssize_t segmentIO(Tablespace *ts, int s, void *buf, size_t len, off_t offset, bool isWrite) {
+    int64_t size = ts->dir[s].size;
+    if (offset >= size) {
+        return 0;
+    }
+    if ((int64_t) len > size - offset) {
+        len = (size_t) (size - offset);
+    }
+    char *p = (char *) buf;
+    size_t done = 0;
+    while (done < len) {
+        off_t pos = offset + (off_t) done;
+        off_t within = pos % SM_TS_EXTENT_BYTES;
+        size_t piece = (size_t) (SM_TS_EXTENT_BYTES - within) < len - done ? (size_t) (SM_TS_EXTENT_BYTES - within) : len - done;
+        int32_t e = ts->segs[s].extents[pos / SM_TS_EXTENT_BYTES];
+        if (tsIO(ts->backend, ts->fd, p + done, piece, TS_EXTENT_OFFSET(e) + within, isWrite) != 0) {
+            return done > 0 ? (ssize_t) done : -1;
+        }
+        done += piece;
+    }
+    return (ssize_t) done;
+}
+
+/************************************************************
+ *                    backend calls                         *
+ ************************************************************/
+static int tsOpen(const char *path, int flags, mode_t mode) {
+    (void) mode;
+    const char *object;
+    char *space = splitName(path, &object);
+    if (space == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&tsLock);
+    Tablespace *ts = tsAcquire(space);
+    free(space);
+    if (ts == NULL) {
+        pthread_mutex_unlock(&tsLock);
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&ts->lock);
+    int s = 0;
+    while (s < SM_TS_MAX_SEGMENTS && strcmp(ts->dir[s].name, object) != 0) s++;
+    int err = 0;
+    if (s == SM_TS_MAX_SEGMENTS) {
+        // a new segment takes the first entry nobody uses, not even an unlinked open segment
+        s = 0;
+        while (s < SM_TS_MAX_SEGMENTS && (ts->dir[s].name[0] != '\0' || ts->segs[s].openCount > 0)) s++;
+        if (!(flags & O_CREAT)) {
+            err = ENOENT;
+        } else if (s == SM_TS_MAX_SEGMENTS) {
+            err = ENOSPC;
+        } else {
+            memset(&ts->dir[s], 0, sizeof(SM_TsDirEntry));
+            strcpy(ts->dir[s].name, object);
+            ts->dir[s].firstExtent = SM_TS_LAST_EXTENT;
+            ts->segs[s].unlinked = false;
+            if (writeDirEntry(ts, s) != 0) err = EIO;
+        }
+    } else if (flags & O_TRUNC) {
+        if (freeExtents(ts, s) != 0 || writeDirEntry(ts, s) != 0) err = EIO;
+    }
+    pthread_rwlock_unlock(&ts->lock);
+
+    int fd = 0;
+    while (err == 0 && fd < tsFdCount && tsFds[fd].ts != NULL) {
+        fd++;
+    }
+    if (err == 0 && fd == tsFdCount) {
+        int count = tsFdCount > 0 ? 2 * tsFdCount : 16;
+        TsFd *fds = (TsFd *) realloc(tsFds, count * sizeof(TsFd));
+        if (fds == NULL) {
+            err = EMFILE;
+        } else {
+            memset(fds + tsFdCount, 0, (count - tsFdCount) * sizeof(TsFd));
+            tsFds = fds;
+            tsFdCount = count;
+        }
+    }
+    if (err != 0) {
+        tsRelease(ts);
+        pthread_mutex_unlock(&tsLock);
+        errno = err;
+        return -1;
+    }
+    tsFds[fd].ts = ts;
+    tsFds[fd].seg = s;
+    ts->segs[s].openCount++;
+    pthread_mutex_unlock(&tsLock);
+    return fd;
+}
+
+static int tsClose(int fd) {
+    pthread_mutex_lock(&tsLock);
+    if (fd < 0 || fd >= tsFdCount || tsFds[fd].ts == NULL) {
+        pthread_mutex_unlock(&tsLock);
+        errno = EBADF;
+        return -1;
+    }
+    Tablespace *ts = tsFds[fd].ts;
+    int s = tsFds[fd].seg;
+    tsFds[fd].ts = NULL;
+    int res = 0;
+    if (--ts->segs[s].openCount == 0 && ts->segs[s].unlinked) {
+        pthread_rwlock_wrlock(&ts->lock);
+        res = freeExtents(ts, s);
+        ts->segs[s].unlinked = false;
+        pthread_rwlock_unlock(&ts->lock);
+    }
+    tsRelease(ts);
+    pthread_mutex_unlock(&tsLock);
+    return res;
+}
+
+static ssize_t tsPread(int fd, void *buf, size_t len, off_t offset) {
+    int s;
+    Tablespace *ts = tsFile(fd, &s);
+    if (ts == NULL) {
+        return -1;
+    }
+    pthread_rwlock_rdlock(&ts->lock);
+    ssize_t n = segmentIO(ts, s, buf, len, offset, false);
+    pthread_rwlock_unlock(&ts->lock);
+    return n;
+}
+
+static ssize_t tsPwrite(int fd, const void *buf, size_t len, off_t offset) {
+    int s;
+    Tablespace *ts = tsFile(fd, &s);
+    if (ts == NULL) {
+        return -1;
+    }
+    pthread_rwlock_rdlock(&ts->lock);
+    while (offset + (off_t) len > ts->dir[s].size) {
+        // writing past the end: grow the segment first, exclusively
+        pthread_rwlock_unlock(&ts->lock);
+        pthread_rwlock_wrlock(&ts->lock);
+        int res = growSegment(ts, s, offset + (off_t) len);
+        pthread_rwlock_unlock(&ts->lock);
+        if (res != 0) {
+            return -1;
+        }
+        pthread_rwlock_rdlock(&ts->lock);
+    }
+    ssize_t n = segmentIO(ts, s, (void *) buf, len, offset, true);
+    pthread_rwlock_unlock(&ts->lock);
+    return n;
+}
+
+static int tsExtend(int fd, off_t offset, off_t len) {
+    int s;
+    Tablespace *ts = tsFile(fd, &s);
+    if (ts == NULL) {
+        return -1;
+    }
+    pthread_rwlock_wrlock(&ts->lock);
+    int res = growSegment(ts, s, offset + len);
+    pthread_rwlock_unlock(&ts->lock);
+    return res;
+}
+
+static int tsPunch(int fd, off_t offset, off_t len) {
+    int s;
+    Tablespace *ts = tsFile(fd, &s);
+    if (ts == NULL) {
+        return -1;
+    }
+    pthread_rwlock_rdlock(&ts->lock);
+    off_t end = offset + len < ts->dir[s].size ? offset + len : ts->dir[s].size;
+    int res = 0;
+    while (offset < end && res == 0) {
+        off_t within = offset % SM_TS_EXTENT_BYTES;
+        off_t piece = SM_TS_EXTENT_BYTES - within < end - offset ? SM_TS_EXTENT_BYTES - within : end - offset;
+        int32_t e = ts->segs[s].extents[offset / SM_TS_EXTENT_BYTES];
+        res = ts->backend->punch(ts->fd, TS_EXTENT_OFFSET(e) + within, piece);
+        offset += piece;
+    }
+    pthread_rwlock_unlock(&ts->lock);
+    return res;
+}
+
+static int tsSync(int fd) {
+    int s;
+    Tablespace *ts = tsFile(fd, &s);
+    return ts != NULL ? ts->backend->sync(ts->fd) : -1;
+}
+
+static int tsStat(int fd, struct stat *st) {
+    int s;
+    Tablespace *ts = tsFile(fd, &s);
+    if (ts == NULL) {
+        return -1;
+    }
+    // a segment is told apart from the tablespace's other segments by its directory entry
+    memset(st, 0, sizeof(struct stat));
+    pthread_rwlock_rdlock(&ts->lock);
+    st->st_dev = ts->st.st_dev;
+    st->st_ino = ts->st.st_ino * SM_TS_MAX_SEGMENTS + (ino_t) s + 1;
+    st->st_mode = S_IFREG | 0644;
+    st->st_nlink = ts->segs[s].unlinked ? 0 : 1;
+    st->st_size = (off_t) ts->dir[s].size;
+    st->st_blocks = (blkcnt_t) ts->dir[s].numExtents * (SM_TS_EXTENT_BYTES / 512);
+    pthread_rwlock_unlock(&ts->lock);
+    return 0;
+}
+
+static int tsUnlink(const char *path) {
+    const char *object;
+    char *space = splitName(path, &object);
+    if (space == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&tsLock);
+    Tablespace *ts = tsAcquire(space);
+    free(space);
+    if (ts == NULL) {
+        pthread_mutex_unlock(&tsLock);
+        return -1;
+    }
+    pthread_rwlock_wrlock(&ts->lock);
+    int s = 0;
+    while (s < SM_TS_MAX_SEGMENTS && strcmp(ts->dir[s].name, object) != 0) s++;
+    int res = 0;
+    if (s == SM_TS_MAX_SEGMENTS) {
+        errno = ENOENT;
+        res = -1;
+    } else {
+        // an open segment lives on without its name until its last close
+        ts->dir[s].name[0] = '\0';
+        if (ts->segs[s].openCount > 0) {
+            ts->segs[s].unlinked = true;
+        } else {
+            freeExtents(ts, s);
+        }
+        res = writeDirEntry(ts, s);
+    }
+    pthread_rwlock_unlock(&ts->lock);
+    tsRelease(ts);
+    pthread_mutex_unlock(&tsLock);
+    return res;
+}
+
+const SM_Backend smTablespaceBackend = {
+    "tablespace", false,
+    tsOpen, tsClose, tsPread, tsPwrite, tsExtend, tsPunch, tsSync, tsStat, tsUnlink, NULL, NULL, NULL
+};
+
+/************************************************************
+ *                    tablespace files                      *
+ ************************************************************/
+RC createTablespace(char *fileName) {
+    /*
+        Write an empty tablespace: the header, an empty directory and an
+        extent map with every extent free. An existing file of that name is
+        overwritten; a tablespace with segments open cannot be.
+    */
+    if (fileName == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    const SM_Backend *backend = getStorageBackend(fileName);
+    if (backend == &smTablespaceBackend) {
+        return RC_SM_INVALID_BACKEND;
+    }
+    pthread_mutex_lock(&tsLock);
+    for (Tablespace *ts = tablespaces; ts != NULL; ts = ts->next) {
+        if (strcmp(ts->name, fileName) == 0) {
+            pthread_mutex_unlock(&tsLock);
+            return RC_WRITE_FAILED;
+        }
+    }
+    pthread_mutex_unlock(&tsLock);
+
+    size_t len = (size_t) TS_DATA_OFFSET;
+    char *meta = (char *) calloc(1, len);
+    if (meta == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    SM_TsHeader header = { SM_TS_MAGIC, SM_TS_VERSION, SM_TS_EXTENT_BYTES, SM_TS_MAX_SEGMENTS, SM_TS_MAX_EXTENTS };
+    memcpy(meta, &header, sizeof(header));
+    SM_TsDirEntry *dir = (SM_TsDirEntry *) (meta + TS_DIR_OFFSET);
+    for (int s = 0; s < SM_TS_MAX_SEGMENTS; s++) {
+        dir[s].firstExtent = SM_TS_LAST_EXTENT;
+    }
+    int32_t *map = (int32_t *) (meta + TS_MAP_OFFSET);
+    for (int e = 0; e < SM_TS_MAX_EXTENTS; e++) {
+        map[e] = SM_TS_FREE_EXTENT;
+    }
+
+    int fd = backend->open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(meta);
+        return RC_FILE_NOT_FOUND;
+    }
+    RC rc = tsIO(backend, fd, meta, len, 0, true) == 0 && backend->sync(fd) == 0 ? RC_OK : RC_WRITE_FAILED;
+    free(meta);
+    backend->close(fd);
+    return rc;
+}
+
+/* count directory entries in use (segments) or extents owned by one */
+static int countTablespace(char *fileName, bool extents) {
+    if (fileName == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&tsLock);
+    Tablespace *ts = tsAcquire(fileName);
+    if (ts == NULL) {
+        pthread_mutex_unlock(&tsLock);
+        return -1;
+    }
+    int count = 0;
+    pthread_rwlock_rdlock(&ts->lock);
+    for (int i = 0; i < (extents ? SM_TS_MAX_EXTENTS : SM_TS_MAX_SEGMENTS); i++) {
+        if (extents ? ts->map[i] != SM_TS_FREE_EXTENT : ts->dir[i].name[0] != '\0') count++;
+    }
+    pthread_rwlock_unlock(&ts->lock);
+    tsRelease(ts);
+    pthread_mutex_unlock(&tsLock);
+    return count;
+}
+
+int getTablespaceSegments(char *fileName) {
+    return countTablespace(fileName, false);
+}
+
+int getTablespaceExtents(char *fileName) {
+    return countTablespace(fileName, true);
+}
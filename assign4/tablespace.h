@@ -0,0 +1,32 @@
+#ifndef TABLESPACE_H
+#define TABLESPACE_H
+
+#include "storage_backend.h"
+
+/*
+    Tablespaces: one file holding many page files ("segments"), so a schema
+    with hundreds of tables and indexes needs one descriptor and keeps its
+    pages together. A segment is named "ts:<tablespace file>#<object>" and
+    is a page file like any other: createTable("ts:shop.ts#orders", ...)
+    or createBtree("ts:shop.ts#orders_pk", ...) put the object into the
+    tablespace shop.ts, which createTablespace made before. The file starts
+    with a header, the segment directory (object name, length and first
+    extent per segment) and the extent map, which chains the extents of each
+    segment; segments grow by whole extents of SM_TS_EXTENT_BYTES.
+*/
+#define SM_TABLESPACE_PREFIX "ts:"
+#define SM_TABLESPACE_SEP '#'           // between the tablespace file and the object name
+#define SM_TS_EXTENT_BYTES (256 * 1024) // 64 default pages, a multiple of every page size
+#define SM_TS_MAX_SEGMENTS 256
+#define SM_TS_MAX_EXTENTS 16384         // 4 GB of segments per tablespace
+#define SM_TS_NAME_LEN 48               // object names are shorter than this
+
+extern const SM_Backend smTablespaceBackend;
+
+/* make an empty tablespace file; it is destroyed like a page file (destroyPageFile) */
+extern RC createTablespace (char *fileName);
+/* segments in the tablespace and extents they use, -1 if it cannot be read */
+extern int getTablespaceSegments (char *fileName);
+extern int getTablespaceExtents (char *fileName);
+
+#endif
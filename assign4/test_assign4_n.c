@@ -0,0 +1,2726 @@
+#define _POSIX_C_SOURCE 200809L   // fseeko/off_t for the large-file test
+
+#include "storage_mgr.h"
+#include "storage_backend.h"
+#include "tablespace.h"
+#include "stripe.h"
+#include "checksum.h"
+#include "compress.h"
+#include "buffer_mgr_stat.h"
+#include "buffer_mgr.h"
+#include "record_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// var to store the current test's name
+char *testName;
+
+#define TESTPF "test_pagefile_n.bin"
+#define TESTPF_COPY "test_pagefile_n_copy.bin"
+
+// test methods
+static void testPositionalIO (void);
+static void testMappedFrames (void);
+static void testVectoredIO (void);
+static void testExtentGrowth (void);
+static void testAsyncIO (void);
+static void runAsyncBatch (SM_AsyncEngine engine);
+static void testDirectIO (void);
+static void testLazyHeader (void);
+static void testFreePages (void);
+static void testLargeFile (void);
+static void testLegacyHeader (void);
+static void testPageSizes (void);
+static void testChecksums (void);
+static void testSyncPolicy (void);
+static void testCompression (void);
+static void testHolePunching (void);
+static void testReadAhead (void);
+static void testMemoryBackend (void);
+static void testDoublewrite (void);
+static void testSnapshots (void);
+static void testTablespace (void);
+static void testStriping (void);
+static void testPageTable (void);
+static void testPoolFileHandle (void);
+static void testReplacementOrder (void);
+static void testArcReplacement (void);
+static void testAccessRing (void);
+static void corruptByte (char *fileName, long long offset);
+static void readRawHeader (char *fileName, long long *header);
+static void copyFile (char *from, char *to);
+static long long fileSize (char *fileName);
+static long long diskUsage (char *fileName);
+static bool inPool (BM_BufferPool *bm, PageNumber pageNum);
+static void pinTimes (BM_BufferPool *bm, BM_PageHandle *h, PageNumber pageNum, int times);
+static ssize_t flakyPwrite (int fd, const void *buf, size_t len, off_t offset);
+static int flakySync (int fd);
+static bool flakyFail = false;
+
+int
+main (void)
+{
+    initStorageManager();
+    testName = "";
+
+    testPositionalIO();
+    testMappedFrames();
+    testVectoredIO();
+    testExtentGrowth();
+    testAsyncIO();
+    testDirectIO();
+    testLazyHeader();
+    testFreePages();
+    testLargeFile();
+    testLegacyHeader();
+    testPageSizes();
+    testChecksums();
+    testSyncPolicy();
+    testCompression();
+    testHolePunching();
+    testReadAhead();
+    testMemoryBackend();
+    testDoublewrite();
+    testSnapshots();
+    testTablespace();
+    testStriping();
+    testPageTable();
+    testPoolFileHandle();
+    testReplacementOrder();
+    testArcReplacement();
+    testAccessRing();
+
+    return 0;
+}
+
+// ====================================================
+// Write pages with absolute positions, then walk them
+// with the relative read functions (curPagePos)
+// ====================================================
+static void
+testPositionalIO (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    testName = "Testing positional page I/O";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(5, &fh));
+    ASSERT_EQUALS_INT(5, fh.totalNumPages, "file grown to 5 pages");
+
+    // write pages out of order
+    for (int i = 4; i >= 0; i--) {
+        memset(ph, 'a' + i, PAGE_SIZE);
+        TEST_CHECK(writeBlock(i, &fh, ph));
+    }
+    TEST_CHECK(closePageFile(&fh));
+
+    // reopen: the header must have the new page count
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(5, fh.totalNumPages, "page count persisted in header");
+
+    TEST_CHECK(readFirstBlock(&fh, ph));
+    ASSERT_TRUE(ph[0] == 'a' && ph[PAGE_SIZE - 1] == 'a', "first block");
+    for (int i = 1; i < 5; i++) {
+        TEST_CHECK(readNextBlock(&fh, ph));
+        ASSERT_TRUE(ph[0] == 'a' + i && ph[PAGE_SIZE - 1] == 'a' + i, "next block");
+        ASSERT_EQUALS_INT(i, getBlockPos(&fh), "curPagePos follows reads");
+    }
+    ASSERT_ERROR(readNextBlock(&fh, ph), "no block after the last one");
+
+    TEST_CHECK(readPreviousBlock(&fh, ph));
+    ASSERT_TRUE(ph[0] == 'd', "previous block");
+    TEST_CHECK(readCurrentBlock(&fh, ph));
+    ASSERT_TRUE(ph[0] == 'd', "current block");
+
+    memset(ph, 'z', PAGE_SIZE);
+    TEST_CHECK(writeCurrentBlock(&fh, ph));
+    TEST_CHECK(readBlock(3, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'z', "writeCurrentBlock hit page 3");
+    ASSERT_ERROR(readBlock(5, &fh, ph), "reading past the end");
+
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Mapped page file: zero-copy pointers, growth, and a
+// buffer pool running in "mapped frames" mode
+// ====================================================
+static void
+testMappedFrames (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ptr;
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing mapped page file and mapped frames";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFileMapped(TESTPF, &fh));
+    TEST_CHECK(getPagePtr(0, &fh, &ptr));
+    memset(ptr, 'm', PAGE_SIZE);
+
+    // growing the file must keep earlier pointers valid and map the new pages
+    TEST_CHECK(ensureCapacity(20, &fh));
+    ASSERT_TRUE(ptr[0] == 'm', "page 0 pointer survives growth");
+    TEST_CHECK(getPagePtr(19, &fh, &ptr));
+    ASSERT_TRUE(ptr[0] == 0, "new page is zeroed");
+    memset(ph, 'w', PAGE_SIZE);
+    TEST_CHECK(writeBlock(19, &fh, ph));
+    ASSERT_TRUE(ptr[PAGE_SIZE - 1] == 'w', "writeBlock lands in the mapping");
+    TEST_CHECK(closePageFile(&fh));
+
+    // a plain handle sees the bytes stored through the mapping
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(20, fh.totalNumPages, "grown page count");
+    TEST_CHECK(readBlock(0, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'm', "pointer store reached the file");
+    ASSERT_ERROR(getPagePtr(0, &fh, &ptr), "plain handle has no mapping");
+    TEST_CHECK(closePageFile(&fh));
+
+    // mapped frames: dirty pages go out through the mapping
+    TEST_CHECK(initBufferPoolMapped(bm, TESTPF, 3, RS_LRU, NULL));
+    for (int i = 0; i < 25; i++) {
+        TEST_CHECK(pinPage(bm, h, i));
+        sprintf(h->data, "%s-%lld", "Page", h->pageNum);
+        TEST_CHECK(markDirty(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(25, fh.totalNumPages, "pool extended the file");
+    for (int i = 0; i < 25; i++) {
+        char expected[32];
+        sprintf(expected, "%s-%i", "Page", i);
+        TEST_CHECK(readBlock(i, &fh, ph));
+        ASSERT_EQUALS_STRING(expected, ph, "page written through mapped frame");
+    }
+    TEST_CHECK(closePageFile(&fh));
+
+    // growing past the reserved window (1 GB) maps the file elsewhere;
+    // a page pinned before keeps a valid pointer into the old window
+    PageNumber farPage = (1LL << 30) / PAGE_SIZE + 8;
+    BM_PageHandle *first = MAKE_PAGE_HANDLE();
+    TEST_CHECK(initBufferPoolMapped(bm, TESTPF, 3, RS_LRU, NULL));
+    TEST_CHECK(pinPage(bm, first, 1));
+    TEST_CHECK(pinPage(bm, h, farPage));
+    sprintf(h->data, "%s", "far page");
+    TEST_CHECK(markDirty(bm, h));
+    TEST_CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_STRING("Page-1", first->data, "pinned page readable after the remap");
+    sprintf(first->data, "%s", "written after the remap");
+    TEST_CHECK(markDirty(bm, first));
+    TEST_CHECK(unpinPage(bm, first));
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_TRUE(fh.totalNumPages == farPage + 1, "pool grew the file past the window");
+    TEST_CHECK(readBlock(1, &fh, ph));
+    ASSERT_EQUALS_STRING("written after the remap", ph, "old window still maps the file");
+    TEST_CHECK(readBlock(farPage, &fh, ph));
+    ASSERT_EQUALS_STRING("far page", ph, "new window maps the file");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(ph);
+    free(bm);
+    free(h);
+    free(first);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// readBlocks/writeBlocks, the list variants, and the
+// buffer pool's batched prefetch and flush
+// ====================================================
+static void
+testVectoredIO (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle pages[10];
+    PageNumber order[] = { 7, 2, 3, 9, 8 };
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing vectored page I/O";
+
+    for (int i = 0; i < 10; i++) {
+        pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+        memset(pages[i], '0' + i, PAGE_SIZE);
+    }
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(10, &fh));
+    TEST_CHECK(writeBlocks(0, 10, &fh, pages));
+    ASSERT_EQUALS_INT(9, getBlockPos(&fh), "curPagePos at last written page");
+    ASSERT_ERROR(writeBlocks(5, 6, &fh, pages), "run past the end of the file");
+
+    for (int i = 0; i < 10; i++) memset(pages[i], 0, PAGE_SIZE);
+    TEST_CHECK(readBlocks(0, 10, &fh, pages));
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(pages[i][0] == '0' + i && pages[i][PAGE_SIZE - 1] == '0' + i, "readBlocks content");
+    }
+
+    // unsorted list with two runs: 2-3 and 7-9
+    for (int i = 0; i < 5; i++) memset(pages[i], 'A' + i, PAGE_SIZE);
+    TEST_CHECK(writeBlockList(order, 5, &fh, pages));
+    for (int i = 0; i < 5; i++) memset(pages[i], 0, PAGE_SIZE);
+    TEST_CHECK(readBlockList(order, 5, &fh, pages));
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(pages[i][0] == 'A' + i, "list I/O keeps page/buffer pairing");
+    }
+    TEST_CHECK(readBlock(7, &fh, pages[0]));
+    ASSERT_TRUE(pages[0][0] == 'A', "page 7 written from first list entry");
+    TEST_CHECK(closePageFile(&fh));
+
+    // prefetch fills the pool with one batch; the pins that follow are hits
+    TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_LRU, NULL));
+    TEST_CHECK(prefetchPages(bm, 0, 4));
+    ASSERT_EQUALS_INT(4, getNumReadIO(bm), "prefetched 4 pages");
+    for (int i = 0; i < 4; i++) {
+        TEST_CHECK(pinPage(bm, h, i));
+        sprintf(h->data, "%s-%lld", "Page", h->pageNum);
+        TEST_CHECK(markDirty(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(4, getNumReadIO(bm), "pins after prefetch hit the pool");
+
+    // prefetch beyond the end of the file is clipped
+    TEST_CHECK(prefetchPages(bm, 8, 10));
+    ASSERT_EQUALS_INT(6, getNumReadIO(bm), "only pages 8 and 9 exist");
+    ASSERT_EQUALS_INT(2, getNumWriteIO(bm), "two dirty victims written back");
+
+    TEST_CHECK(forceFlushPool(bm));
+    ASSERT_EQUALS_INT(4, getNumWriteIO(bm), "remaining dirty pages flushed");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    for (int i = 0; i < 4; i++) {
+        char expected[32];
+        sprintf(expected, "%s-%i", "Page", i);
+        TEST_CHECK(readBlock(i, &fh, pages[0]));
+        ASSERT_EQUALS_STRING(expected, pages[0], "page flushed by the pool");
+    }
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    for (int i = 0; i < 10; i++) free(pages[i]);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Grow a file in extents: capacity runs ahead of the
+// logical page count and survives a reopen
+// ====================================================
+static void
+testExtentGrowth (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    testName = "Testing extent based file growth";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(1, getAllocatedPages(&fh), "new file has one allocated page");
+    ASSERT_ERROR(setExtentSize(0, &fh), "extent size must be positive");
+    TEST_CHECK(setExtentSize(16, &fh));
+
+    // first append allocates a whole extent
+    TEST_CHECK(appendEmptyBlock(&fh));
+    ASSERT_EQUALS_INT(2, fh.totalNumPages, "logical size grew by one");
+    ASSERT_EQUALS_INT(17, getAllocatedPages(&fh), "capacity grew by one extent");
+
+    // growing inside the extent only moves the logical size
+    TEST_CHECK(ensureCapacity(17, &fh));
+    ASSERT_EQUALS_INT(17, getAllocatedPages(&fh), "no new extent needed");
+    TEST_CHECK(ensureCapacity(40, &fh));
+    ASSERT_EQUALS_INT(40, fh.totalNumPages, "logical size follows the request");
+    ASSERT_EQUALS_INT(49, getAllocatedPages(&fh), "capacity rounded up to extents");
+
+    memset(ph, 'x', PAGE_SIZE);
+    TEST_CHECK(readBlock(39, &fh, ph));
+    ASSERT_TRUE(ph[0] == 0 && ph[PAGE_SIZE - 1] == 0, "preallocated page reads as zeros");
+    ASSERT_ERROR(readBlock(40, &fh, ph), "capacity beyond the logical size is not readable");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(40, fh.totalNumPages, "logical size persisted");
+    ASSERT_EQUALS_INT(49, getAllocatedPages(&fh), "capacity persisted");
+    TEST_CHECK(appendEmptyBlock(&fh));
+    ASSERT_EQUALS_INT(49, getAllocatedPages(&fh), "append uses spare capacity");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Keep a batch of async writes and reads in flight,
+// once on the default engine and once on the thread pool
+// ====================================================
+static void
+testAsyncIO (void)
+{
+    testName = "Testing asynchronous page I/O";
+
+    // SM_ASYNC_AUTO picks io_uring where the kernel offers it
+    TEST_CHECK(initAsyncIO(SM_ASYNC_AUTO, 8));
+    ASSERT_TRUE(getAsyncEngine() != SM_ASYNC_AUTO, "an engine is running");
+    runAsyncBatch(getAsyncEngine());
+
+    TEST_CHECK(initAsyncIO(SM_ASYNC_THREADS, 8));
+    ASSERT_EQUALS_INT(SM_ASYNC_THREADS, getAsyncEngine(), "thread pool fallback");
+    runAsyncBatch(SM_ASYNC_THREADS);
+
+    TEST_CHECK(shutdownAsyncIO());
+    ASSERT_EQUALS_INT(SM_ASYNC_AUTO, getAsyncEngine(), "engine stopped");
+
+    TEST_DONE();
+}
+
+static void
+runAsyncBatch (SM_AsyncEngine engine)
+{
+    SM_FileHandle fh;
+    SM_AsyncRequest reqs[20];
+    SM_PageHandle pages[20];
+    SM_AsyncRequest bad;
+
+    for (int i = 0; i < 20; i++) {
+        pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+        memset(pages[i], 'a' + i, PAGE_SIZE);
+    }
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(20, &fh));
+
+    // more requests than the queue depth, the engine has to recycle slots
+    for (int i = 0; i < 20; i++) {
+        TEST_CHECK(submitWriteBlock(19 - i, &fh, pages[i], &reqs[i]));
+    }
+    TEST_CHECK(waitAllAsyncIO(reqs, 20));
+    ASSERT_ERROR(submitReadBlock(20, &fh, pages[0], &bad), "async read past the end of the file");
+
+    for (int i = 0; i < 20; i++) {
+        memset(pages[i], 0, PAGE_SIZE);
+        TEST_CHECK(submitReadBlock(19 - i, &fh, pages[i], &reqs[i]));
+    }
+    for (int i = 0; i < 20; i++) {
+        TEST_CHECK(waitAsyncIO(&reqs[i]));
+        ASSERT_TRUE(pollAsyncIO(&reqs[i]), "finished request polls as done");
+        ASSERT_TRUE(pages[i][0] == 'a' + i && pages[i][PAGE_SIZE - 1] == 'a' + i, "async read content");
+    }
+    TEST_CHECK(readBlock(0, &fh, pages[0]));
+    ASSERT_TRUE(pages[0][0] == 'a' + 19, "async write visible to readBlock");
+    ASSERT_EQUALS_INT(engine, getAsyncEngine(), "engine unchanged by the batch");
+
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(destroyPageFile(TESTPF));
+    for (int i = 0; i < 20; i++) free(pages[i]);
+}
+
+// ====================================================
+// O_DIRECT handles: aligned buffers go straight to disk,
+// unaligned ones are bounced; a direct pool works as usual
+// ====================================================
+static void
+testDirectIO (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle aligned = allocPageBuffer();
+    char *raw = (char *) malloc(PAGE_SIZE + 1);
+    SM_PageHandle unaligned = raw + 1;
+    SM_PageHandle pages[3];
+    SM_AsyncRequest req;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing O_DIRECT page I/O";
+
+    ASSERT_TRUE(aligned != NULL && ((unsigned long) aligned % SM_IO_ALIGNMENT) == 0, "allocPageBuffer is aligned");
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFileDirect(TESTPF, &fh));
+    printf("O_DIRECT %s on this file system\n", isPageFileDirect(&fh) ? "active" : "unavailable, buffered fallback");
+    TEST_CHECK(ensureCapacity(3, &fh));
+
+    memset(aligned, 'd', PAGE_SIZE);
+    TEST_CHECK(writeBlock(0, &fh, aligned));
+    memset(unaligned, 'u', PAGE_SIZE);
+    TEST_CHECK(writeBlock(1, &fh, unaligned));
+
+    memset(unaligned, 0, PAGE_SIZE);
+    TEST_CHECK(readBlock(0, &fh, unaligned));
+    ASSERT_TRUE(unaligned[0] == 'd' && unaligned[PAGE_SIZE - 1] == 'd', "bounced read of an aligned write");
+    memset(aligned, 0, PAGE_SIZE);
+    TEST_CHECK(readBlock(1, &fh, aligned));
+    ASSERT_TRUE(aligned[0] == 'u' && aligned[PAGE_SIZE - 1] == 'u', "aligned read of a bounced write");
+
+    // vectored and async paths with a mix of buffers
+    pages[0] = aligned;
+    pages[1] = unaligned;
+    pages[2] = aligned;
+    TEST_CHECK(readBlocks(0, 2, &fh, pages));
+    ASSERT_TRUE(aligned[0] == 'd' && unaligned[0] == 'u', "readBlocks with an unaligned buffer");
+    TEST_CHECK(submitReadBlock(1, &fh, aligned, &req));
+    TEST_CHECK(waitAsyncIO(&req));
+    ASSERT_TRUE(aligned[0] == 'u', "async read on a direct handle");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(3, fh.totalNumPages, "header written by the direct handle");
+    TEST_CHECK(closePageFile(&fh));
+
+    // direct pool: pages survive a round trip through write-back and re-read
+    TEST_CHECK(initBufferPoolDirect(bm, TESTPF, 2, RS_FIFO, NULL));
+    for (int i = 0; i < 5; i++) {
+        TEST_CHECK(pinPage(bm, h, i));
+        sprintf(h->data, "%s-%lld", "Page", h->pageNum);
+        TEST_CHECK(markDirty(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    for (int i = 0; i < 5; i++) {
+        char expected[32];
+        sprintf(expected, "%s-%i", "Page", i);
+        TEST_CHECK(pinPage(bm, h, i));
+        ASSERT_EQUALS_STRING(expected, h->data, "page read back through the direct pool");
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(aligned);
+    free(raw);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// The header is cached and shared between handles; the
+// copy on disk lags until close/sync, and an unclean
+// file recovers its page count from the pages written
+// ====================================================
+static void
+testLazyHeader (void)
+{
+    SM_FileHandle a, b, c;
+    SM_PageHandle ph = allocPageBuffer();
+    long long header[5];
+    testName = "Testing lazy header maintenance";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &a));
+    TEST_CHECK(openPageFile(TESTPF, &b));
+    TEST_CHECK(setExtentSize(8, &a));
+
+    // allocating an extent writes the header (stamped unclean)
+    TEST_CHECK(ensureCapacity(5, &a));
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(5, header[0], "header written with the new extent");
+    ASSERT_EQUALS_INT(9, header[1], "capacity on disk");
+    ASSERT_EQUALS_INT(1, header[3], "header stamped unclean");
+
+    // growth inside the extent stays in memory, but other handles see it
+    TEST_CHECK(appendEmptyBlock(&a));
+    TEST_CHECK(appendEmptyBlock(&a));
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(5, header[0], "no header write inside the extent");
+    TEST_CHECK(readBlock(6, &b, ph));
+    ASSERT_EQUALS_INT(7, b.totalNumPages, "second handle picked up the growth");
+    TEST_CHECK(closePageFile(&a));
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(5, header[0], "header still cached while a handle is open");
+
+    TEST_CHECK(syncPageFile(&b));
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(7, header[0], "sync writes the page count");
+    ASSERT_EQUALS_INT(0, header[3], "sync leaves the header clean");
+
+    // "crash" right after an append: the first growth past a clean header
+    // stamps it unclean with the new count; the extent's spare page is no page
+    TEST_CHECK(appendEmptyBlock(&b));
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(8, header[0], "header stamped with the appended page");
+    copyFile(TESTPF, TESTPF_COPY);
+    TEST_CHECK(openPageFile(TESTPF_COPY, &c));
+    ASSERT_EQUALS_INT(8, c.totalNumPages, "spare capacity not counted");
+    TEST_CHECK(closePageFile(&c));
+    TEST_CHECK(destroyPageFile(TESTPF_COPY));
+
+    // "crash" with a stale header: a page appended inside the extent and
+    // written is recovered, the header on disk lags behind it
+    TEST_CHECK(appendEmptyBlock(&b));
+    memset(ph, 'u', PAGE_SIZE);
+    TEST_CHECK(writeBlock(8, &b, ph));
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(8, header[0], "header lags the append");
+    copyFile(TESTPF, TESTPF_COPY);
+    TEST_CHECK(openPageFile(TESTPF_COPY, &c));
+    ASSERT_EQUALS_INT(9, c.totalNumPages, "unclean file recovers up to the last written page");
+    TEST_CHECK(readBlock(8, &c, ph));
+    ASSERT_TRUE(ph[0] == 'u', "written page kept");
+    TEST_CHECK(closePageFile(&c));
+    readRawHeader(TESTPF_COPY, header);
+    ASSERT_EQUALS_INT(0, header[3], "recovered file closed clean");
+    TEST_CHECK(destroyPageFile(TESTPF_COPY));
+
+    TEST_CHECK(closePageFile(&b));
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(9, header[0], "last close writes the page count");
+    ASSERT_EQUALS_INT(0, header[3], "closed clean");
+    TEST_CHECK(openPageFile(TESTPF, &a));
+    ASSERT_EQUALS_INT(9, a.totalNumPages, "clean file keeps its logical count");
+    TEST_CHECK(closePageFile(&a));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Freed pages go on a persistent free list and are
+// handed out again (last freed first, zero-filled)
+// before the file grows
+// ====================================================
+static void
+testFreePages (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ph = allocPageBuffer();
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    int manyPages = (PAGE_SIZE / sizeof(int)) + 8;     // more than one trunk page holds
+    char *seen = (char *) calloc(manyPages + 2, 1);
+    PageNumber pageNum;
+    testName = "Testing free-page management";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(10, &fh));
+    memset(ph, 'x', PAGE_SIZE);
+    TEST_CHECK(writeBlock(7, &fh, ph));
+
+    TEST_CHECK(deallocatePage(3, &fh));
+    TEST_CHECK(deallocatePage(5, &fh));
+    TEST_CHECK(deallocatePage(7, &fh));
+    ASSERT_EQUALS_INT(3, getFreePageCount(&fh), "three pages on the free list");
+    ASSERT_TRUE(isPageFree(5, &fh) && !isPageFree(4, &fh), "isPageFree");
+    ASSERT_EQUALS_INT(RC_SM_PAGE_ALREADY_FREE, deallocatePage(5, &fh), "double free is refused");
+    ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, deallocatePage(10, &fh), "page beyond the end");
+    TEST_CHECK(closePageFile(&fh));
+
+    // the free list lives in the file
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(3, getFreePageCount(&fh), "free count survives reopen");
+    ASSERT_TRUE(isPageFree(3, &fh) && isPageFree(7, &fh), "free pages survive reopen");
+
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(7, pageNum, "last freed page comes back first");
+    TEST_CHECK(readBlock(7, &fh, ph));
+    ASSERT_TRUE(ph[0] == 0 && ph[PAGE_SIZE - 1] == 0, "reused page is zero-filled");
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(5, pageNum, "then the one before it");
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(3, pageNum, "the trunk page goes last");
+    ASSERT_EQUALS_INT(0, getFreePageCount(&fh), "free list drained");
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(10, pageNum, "empty free list grows the file");
+    ASSERT_EQUALS_INT(11, fh.totalNumPages, "file grew by one page");
+
+    // a free list spanning several trunk pages
+    TEST_CHECK(ensureCapacity(manyPages + 1, &fh));
+    for (int i = 1; i <= manyPages; i++) {
+        TEST_CHECK(deallocatePage(i, &fh));
+    }
+    ASSERT_EQUALS_INT(manyPages, getFreePageCount(&fh), "every freed page counted");
+    for (int i = 1; i <= manyPages; i++) {
+        TEST_CHECK(allocatePage(&fh, &pageNum));
+        ASSERT_TRUE(pageNum >= 1 && pageNum <= manyPages && !seen[pageNum], "each free page handed out once");
+        seen[pageNum] = 1;
+    }
+    ASSERT_EQUALS_INT(0, getFreePageCount(&fh), "all trunks consumed");
+    ASSERT_EQUALS_INT(manyPages + 1, fh.totalNumPages, "no growth while pages were free");
+    TEST_CHECK(closePageFile(&fh));
+
+    // the pool drops its frame of a freed page and hands the page out again
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU, NULL));
+    TEST_CHECK(pinPage(bm, h, 2));
+    sprintf(h->data, "%s", "stale");
+    TEST_CHECK(markDirty(bm, h));
+    ASSERT_TRUE(freePoolPage(bm, 2) != RC_OK, "pinned page cannot be freed");
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(freePoolPage(bm, 2));
+    ASSERT_TRUE(isPoolPageFree(bm, 2), "isPoolPageFree");
+    TEST_CHECK(allocPoolPage(bm, &pageNum));
+    ASSERT_EQUALS_INT(2, pageNum, "pool reuses the freed page");
+    ASSERT_TRUE(!isPoolPageFree(bm, 2), "page in use again");
+    TEST_CHECK(pinPage(bm, h, 2));
+    ASSERT_TRUE(h->data[0] == 0, "dirty content of the freed page is gone");
+    TEST_CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_INT(manyPages + 1, getPoolFileSize(bm), "pool file size");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(ph);
+    free(seen);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Page numbers and offsets are 64-bit: a page past the
+// 2 GB mark is written and read back at the right spot
+// ====================================================
+static void
+testLargeFile (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ph = allocPageBuffer();
+    PageNumber farPage = (3LL << 30) / PAGE_SIZE;        // data starts at 3 GB
+    FILE *f;
+    char probe;
+    testName = "Testing page files beyond 2 GB";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(setExtentSize(SM_MAX_EXTENT_PAGES, &fh));
+    TEST_CHECK(ensureCapacity(farPage + 1, &fh));
+    ASSERT_TRUE(fh.totalNumPages == farPage + 1, "page count above 2^19 pages");
+
+    memset(ph, 'L', PAGE_SIZE);
+    TEST_CHECK(writeBlock(farPage, &fh, ph));
+    ASSERT_TRUE(getBlockPos(&fh) == farPage, "curPagePos is 64-bit");
+    memset(ph, 0, PAGE_SIZE);
+    TEST_CHECK(readBlock(farPage, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'L' && ph[PAGE_SIZE - 1] == 'L', "read back past 2 GB");
+    TEST_CHECK(closePageFile(&fh));
+
+    // the page sits at its physical offset, not at a wrapped-around one
+    f = fopen(TESTPF, "rb");
+    ASSERT_TRUE(f != NULL && fseeko(f, (off_t) (farPage + 1) * PAGE_SIZE, SEEK_SET) == 0, "seek past 2 GB");
+    ASSERT_TRUE(fread(&probe, 1, 1, f) == 1 && probe == 'L', "page at its 64-bit offset");
+    fclose(f);
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_TRUE(fh.totalNumPages == farPage + 1, "64-bit page count survives reopen");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Files with the old all-int header (and 32-bit free
+// list trunks) open as before and are upgraded
+// ====================================================
+static void
+testLegacyHeader (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ph = allocPageBuffer();
+    char *page = (char *) calloc(1, PAGE_SIZE);
+    int *ints = (int *) page;
+    long long header[5];
+    FILE *f;
+    testName = "Testing version 1 headers";
+
+    // header page: total 6, capacity 8, extent 4, clean, free list trunk 2 holding 4 and 5
+    f = fopen(TESTPF, "wb");
+    ints[0] = 6; ints[1] = 8; ints[2] = 4; ints[3] = 0; ints[4] = 2; ints[5] = 3;
+    fwrite(page, 1, PAGE_SIZE, f);
+    for (int i = 0; i < 8; i++) {
+        memset(page, 0, PAGE_SIZE);
+        if (i == 2) {
+            ints[0] = -1; ints[1] = 2; ints[2] = 4; ints[3] = 5;
+        } else {
+            memset(page, '0' + i, PAGE_SIZE);
+        }
+        fwrite(page, 1, PAGE_SIZE, f);
+    }
+    fclose(f);
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(6, fh.totalNumPages, "old page count");
+    ASSERT_EQUALS_INT(8, getAllocatedPages(&fh), "old capacity");
+    ASSERT_EQUALS_INT(3, getFreePageCount(&fh), "old free count");
+    ASSERT_TRUE(isPageFree(2, &fh) && isPageFree(4, &fh) && isPageFree(5, &fh), "old free list carried over");
+    ASSERT_TRUE(!isPageFree(3, &fh), "pages in use stay in use");
+    TEST_CHECK(readBlock(3, &fh, ph));
+    ASSERT_TRUE(ph[0] == '3', "data pages untouched");
+    TEST_CHECK(closePageFile(&fh));
+
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(6, header[0], "upgraded header keeps the page count");
+    ASSERT_EQUALS_INT(8, header[1], "upgraded header keeps the capacity");
+    ASSERT_EQUALS_INT(4, header[2], "upgraded header keeps the extent size");
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(3, getFreePageCount(&fh), "free list after the upgrade");
+    ASSERT_TRUE(isPageFree(2, &fh) && isPageFree(4, &fh) && isPageFree(5, &fh), "same free pages after the upgrade");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(ph);
+    free(page);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Page size chosen per file: 64 KB pages through the
+// storage manager (plain, mapped, O_DIRECT, free list)
+// and through a buffer pool with 64 KB frames
+// ====================================================
+static void
+testPageSizes (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    int size = SM_MAX_PAGE_SIZE;
+    SM_PageHandle ph = allocPageBufferSized(size);
+    SM_PageHandle pages[3];
+    SM_PageHandle mapped;
+    PageNumber pageNum;
+    long long header[5];
+    FILE *f;
+    char probe;
+    testName = "Testing per-file page sizes";
+
+    ASSERT_EQUALS_INT(RC_SM_INVALID_PAGE_SIZE, createPageFileWithPageSize(TESTPF, 2048), "below the minimum");
+    ASSERT_EQUALS_INT(RC_SM_INVALID_PAGE_SIZE, createPageFileWithPageSize(TESTPF, 12288), "not a power of two");
+    ASSERT_EQUALS_INT(RC_SM_INVALID_PAGE_SIZE, createPageFileWithPageSize(TESTPF, 2 * SM_MAX_PAGE_SIZE), "above the maximum");
+
+    TEST_CHECK(createPageFileWithPageSize(TESTPF, size));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(size, getPageSize(&fh), "page size taken from the header");
+    ASSERT_EQUALS_INT(1, fh.totalNumPages, "one empty page");
+    TEST_CHECK(ensureCapacity(4, &fh));
+    for (int i = 0; i < 4; i++) {
+        memset(ph, 'A' + i, size);
+        TEST_CHECK(writeBlock(i, &fh, ph));
+    }
+    memset(ph, 0, size);
+    TEST_CHECK(readBlock(2, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'C' && ph[size - 1] == 'C', "whole 64 KB page read back");
+
+    // vectored reads move whole 64 KB pages as well
+    for (int i = 0; i < 3; i++) pages[i] = allocPageBufferSized(size);
+    TEST_CHECK(readBlocks(1, 3, &fh, pages));
+    ASSERT_TRUE(pages[0][size - 1] == 'B' && pages[2][0] == 'D', "vectored read of 64 KB pages");
+    for (int i = 0; i < 3; i++) freePageBuffer(pages[i]);
+
+    // the free list keeps working with larger trunks; reused pages come back zeroed
+    TEST_CHECK(deallocatePage(1, &fh));
+    ASSERT_TRUE(isPageFree(1, &fh), "page 1 freed");
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(1, pageNum, "freed page reused");
+    TEST_CHECK(readBlock(1, &fh, ph));
+    ASSERT_TRUE(ph[0] == 0 && ph[size - 1] == 0, "reused 64 KB page is empty");
+    TEST_CHECK(closePageFile(&fh));
+
+    // page 2 sits at (2 + 1) * 64 KB in the file, the header stores the size
+    f = fopen(TESTPF, "rb");
+    ASSERT_TRUE(f != NULL && fseeko(f, (off_t) 3 * size + size - 1, SEEK_SET) == 0, "seek to the end of page 2");
+    ASSERT_TRUE(fread(&probe, 1, 1, f) == 1 && probe == 'C', "page at its 64 KB offset");
+    fclose(f);
+    readRawHeader(TESTPF, header);
+    ASSERT_EQUALS_INT(size, header[4], "page size in the header");
+
+    // mapped and O_DIRECT handles use the same size
+    TEST_CHECK(openPageFileMapped(TESTPF, &fh));
+    TEST_CHECK(getPagePtr(3, &fh, &mapped));
+    ASSERT_TRUE(mapped[0] == 'D' && mapped[size - 1] == 'D', "mapped 64 KB page");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(openPageFileDirect(TESTPF, &fh));
+    TEST_CHECK(readBlock(2, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'C' && ph[size - 1] == 'C', "O_DIRECT 64 KB page");
+    TEST_CHECK(closePageFile(&fh));
+
+    // a pool on the file gets 64 KB frames
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU, NULL));
+    ASSERT_EQUALS_INT(size, getPoolPageSize(bm), "pool page size");
+    TEST_CHECK(pinPage(bm, h, 3));
+    ASSERT_TRUE(h->data[size - 1] == 'D', "frame holds the whole page");
+    h->data[size - 1] = 'z';
+    TEST_CHECK(markDirty(bm, h));
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(readBlock(3, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'D' && ph[size - 1] == 'z', "frame written back in full");
+    TEST_CHECK(closePageFile(&fh));
+
+    // default files keep PAGE_SIZE pages
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(PAGE_SIZE, getPageSize(&fh), "default page size");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(ph);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// CRC32C page trailers: stamped on write, checked on
+// read, corruption reported until verification is off
+// ====================================================
+static void
+testChecksums (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_PageHandle ph = allocPageBuffer();
+    SM_PageHandle pages[2];
+    SM_AsyncRequest req;
+    PageNumber pageNum;
+    char buf[1000];
+    uint32_t crc;
+    testName = "Testing page checksums";
+
+    // the hardware and the table implementation agree, on any length and alignment
+    ASSERT_TRUE(crc32c(0, "123456789", 9) == 0xE3069283u, "CRC32C check value");
+    for (int i = 0; i < (int) sizeof(buf); i++) buf[i] = (char) (i * 7 + 3);
+    for (int off = 0; off < 8; off++) {
+        for (int len = 0; len < 200; len += 13) {
+            ASSERT_TRUE(crc32c(0, buf + off, len) == crc32cPortable(0, buf + off, len), crc32cImplementation());
+        }
+    }
+    ASSERT_TRUE(crc32c(crc32c(0, buf, 123), buf + 123, 877) == crc32c(0, buf, 1000), "CRC continues across calls");
+
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_CHECKSUMS));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(PAGE_SIZE - SM_PAGE_TRAILER_SIZE, getPageDataSize(&fh), "trailer taken off the page");
+    TEST_CHECK(readBlock(0, &fh, ph));
+    TEST_CHECK(ensureCapacity(4, &fh));
+    TEST_CHECK(readBlock(3, &fh, ph));      // grown but never written: zeros pass
+    for (int i = 0; i < 4; i++) {
+        memset(ph, 'a' + i, PAGE_SIZE);
+        TEST_CHECK(writeBlock(i, &fh, ph));
+    }
+    memcpy(&crc, ph + PAGE_SIZE - SM_PAGE_TRAILER_SIZE, sizeof(crc));
+    ASSERT_TRUE(crc == crc32c(0, ph, PAGE_SIZE - SM_PAGE_TRAILER_SIZE), "trailer stamped into the written page");
+    TEST_CHECK(readBlock(2, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'c' && ph[PAGE_SIZE - SM_PAGE_TRAILER_SIZE - 1] == 'c', "page data intact");
+
+    // flip one byte of page 2 behind the storage manager's back
+    corruptByte(TESTPF, 3LL * PAGE_SIZE + 100);
+    ASSERT_EQUALS_INT(RC_SM_CHECKSUM_MISMATCH, readBlock(2, &fh, ph), "corrupted page detected");
+    pages[0] = allocPageBuffer();
+    pages[1] = allocPageBuffer();
+    ASSERT_EQUALS_INT(RC_SM_CHECKSUM_MISMATCH, readBlocks(1, 2, &fh, pages), "vectored read detects it");
+    TEST_CHECK(submitReadBlock(2, &fh, pages[0], &req));
+    ASSERT_EQUALS_INT(RC_SM_CHECKSUM_MISMATCH, waitAsyncIO(&req), "async read detects it");
+    TEST_CHECK(readBlock(1, &fh, ph));
+
+    // verification off: the page reads as it is; back on: detected again
+    TEST_CHECK(setChecksumVerification(&fh, false));
+    TEST_CHECK(readBlock(2, &fh, ph));
+    ASSERT_TRUE(ph[100] != 'c', "corrupt byte read back");
+    TEST_CHECK(setChecksumVerification(&fh, true));
+    ASSERT_ERROR(readBlock(2, &fh, ph), "verification switched back on");
+
+    // rewriting the page repairs it
+    memset(ph, 'c', PAGE_SIZE);
+    TEST_CHECK(writeBlock(2, &fh, ph));
+    TEST_CHECK(readBlocks(1, 2, &fh, pages));
+    ASSERT_TRUE(pages[1][100] == 'c', "rewritten page reads clean");
+
+    // free-list trunks are checksummed pages as well
+    TEST_CHECK(deallocatePage(1, &fh));
+    TEST_CHECK(deallocatePage(3, &fh));
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(3, pageNum, "leaf reused from the trunk");
+    TEST_CHECK(readBlock(3, &fh, ph));
+    TEST_CHECK(closePageFile(&fh));
+
+    // the pool hands out the data size and reports corruption on pinPage
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_FIFO, NULL));
+    ASSERT_EQUALS_INT(PAGE_SIZE - SM_PAGE_TRAILER_SIZE, getPoolPageDataSize(bm), "pool data size");
+    TEST_CHECK(pinPage(bm, h, 2));
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(shutdownBufferPool(bm));
+    corruptByte(TESTPF, 3LL * PAGE_SIZE + 5);
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_FIFO, NULL));
+    ASSERT_EQUALS_INT(RC_SM_CHECKSUM_MISMATCH, pinPage(bm, h, 2), "pinPage reports the corrupt page");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // files created without the option have no trailer
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(PAGE_SIZE, getPageDataSize(&fh), "no trailer by default");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(pages[0]);
+    freePageBuffer(pages[1]);
+    freePageBuffer(ph);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Sync policies: the number of fdatasync calls follows
+// the policy, which sticks with the file
+// ====================================================
+static void
+testSyncPolicy (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_PageHandle ph = allocPageBuffer();
+    SM_PageHandle pages[3];
+    PageNumber pageNum;
+    SM_AsyncRequest reqs[2];
+    SM_AsyncEngine engines[] = { SM_ASYNC_AUTO, SM_ASYNC_THREADS };
+    struct timespec pause = { 0, 60 * 1000000 };
+    long long syncs;
+    testName = "Testing sync policies";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(10, &fh));
+    memset(ph, 's', PAGE_SIZE);
+    ASSERT_EQUALS_INT(SM_SYNC_NONE, getSyncPolicy(&fh), "no syncing by default");
+    ASSERT_EQUALS_INT(RC_SM_INVALID_SYNC_POLICY, setSyncPolicy(&fh, SM_SYNC_GROUP, 0, 0), "group sync needs a limit");
+    ASSERT_EQUALS_INT(RC_SM_INVALID_SYNC_POLICY, setSyncPolicy(&fh, (SM_SyncPolicy) 9, 0, 0), "unknown policy");
+
+    // none: writes never sync
+    syncs = getSyncCount();
+    for (int i = 0; i < 5; i++) TEST_CHECK(writeBlock(i, &fh, ph));
+    ASSERT_EQUALS_INT(syncs, getSyncCount(), "no sync without a policy");
+
+    // strict: one sync per write call, a vectored write is one call
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_STRICT, 0, 0));
+    syncs = getSyncCount();
+    for (int i = 0; i < 3; i++) TEST_CHECK(writeBlock(i, &fh, ph));
+    ASSERT_EQUALS_INT(syncs + 3, getSyncCount(), "strict: every writeBlock syncs");
+    for (int i = 0; i < 3; i++) pages[i] = ph;
+    TEST_CHECK(writeBlocks(3, 3, &fh, pages));
+    ASSERT_EQUALS_INT(syncs + 4, getSyncCount(), "strict: one sync per writeBlocks");
+    // free-list trunks are page writes too
+    TEST_CHECK(deallocatePage(8, &fh));
+    ASSERT_EQUALS_INT(syncs + 5, getSyncCount(), "strict: the new trunk syncs");
+    TEST_CHECK(deallocatePage(9, &fh));
+    ASSERT_EQUALS_INT(syncs + 6, getSyncCount(), "strict: the trunk's new leaf syncs");
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    // asynchronous writes as well, on either engine: a request is done once synced
+    for (int e = 0; e < 2; e++) {
+        TEST_CHECK(initAsyncIO(engines[e], 0));
+        syncs = getSyncCount();
+        for (int i = 0; i < 2; i++) TEST_CHECK(submitWriteBlock(i, &fh, ph, &reqs[i]));
+        TEST_CHECK(waitAllAsyncIO(reqs, 2));
+        ASSERT_EQUALS_INT(syncs + 2, getSyncCount(), "strict: every async write syncs");
+    }
+    TEST_CHECK(shutdownAsyncIO());
+
+    // group by pages: every 4th page syncs, the rest is synced on close
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_GROUP, 4, 0));
+    syncs = getSyncCount();
+    for (int i = 0; i < 10; i++) TEST_CHECK(writeBlock(i, &fh, ph));
+    ASSERT_EQUALS_INT(syncs + 2, getSyncCount(), "group: one sync per 4 pages");
+    TEST_CHECK(closePageFile(&fh));
+    ASSERT_EQUALS_INT(syncs + 3, getSyncCount(), "group: pending pages synced on close");
+
+    // the policy is kept in the header
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(SM_SYNC_GROUP, getSyncPolicy(&fh), "policy persisted");
+
+    // group by time: the first write after the interval syncs
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_GROUP, 0, 50));
+    TEST_CHECK(syncPageFile(&fh));
+    syncs = getSyncCount();
+    TEST_CHECK(writeBlock(0, &fh, ph));
+    ASSERT_EQUALS_INT(syncs, getSyncCount(), "group: interval not over yet");
+    nanosleep(&pause, NULL);
+    TEST_CHECK(writeBlock(1, &fh, ph));
+    ASSERT_EQUALS_INT(syncs + 1, getSyncCount(), "group: interval over");
+
+    // on close: nothing until the last handle goes, and only if something was written
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_ON_CLOSE, 0, 0));
+    syncs = getSyncCount();
+    for (int i = 0; i < 5; i++) TEST_CHECK(writeBlock(i, &fh, ph));
+    ASSERT_EQUALS_INT(syncs, getSyncCount(), "on close: writes do not sync");
+    TEST_CHECK(closePageFile(&fh));
+    ASSERT_EQUALS_INT(syncs + 1, getSyncCount(), "on close: one sync");
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(closePageFile(&fh));
+    ASSERT_EQUALS_INT(syncs + 1, getSyncCount(), "on close: nothing written, nothing synced");
+
+    // the pool follows the file's policy and counts the syncs it caused
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_STRICT, 0, 0));
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_FIFO, NULL));
+    for (int i = 0; i < 3; i++) {
+        TEST_CHECK(pinPage(bm, h, i));
+        h->data[0] = 'p';
+        TEST_CHECK(markDirty(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(0, getNumSyncIO(bm), "nothing written yet");
+    TEST_CHECK(forceFlushPool(bm));
+    ASSERT_EQUALS_INT(1, getNumSyncIO(bm), "one vectored flush, one sync");
+    TEST_CHECK(pinPage(bm, h, 0));
+    h->data[0] = 'q';
+    TEST_CHECK(markDirty(bm, h));
+    TEST_CHECK(forcePage(bm, h));
+    TEST_CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_INT(2, getNumSyncIO(bm), "forcePage syncs under the strict policy");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    freePageBuffer(ph);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Compressed page files: the codec, slots that grow and
+// move, the slot map growing, and the pool on top
+// ====================================================
+static void
+testCompression (void)
+{
+    SM_FileHandle fh, mapped;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    SM_PageHandle check = (SM_PageHandle) malloc(PAGE_SIZE);
+    char packed[LZ_BOUND(PAGE_SIZE)];
+    PageNumber pageNum;
+    long long size;
+    int len;
+    testName = "Testing compressed page files";
+
+    // codec round trips: zeros, text with zero padding, noise, short input
+    memset(ph, 0, PAGE_SIZE);
+    len = lzCompress(ph, PAGE_SIZE, packed, sizeof(packed));
+    ASSERT_TRUE(len > 0 && len < 64, "zero page shrinks to a few bytes");
+    ASSERT_TRUE(lzDecompress(packed, len, check, PAGE_SIZE) == 0 && memcmp(ph, check, PAGE_SIZE) == 0, "zero page round trip");
+    for (int i = 0; i < PAGE_SIZE; i += 200) sprintf(ph + i, "record %d name-%d", i, i * 31);
+    len = lzCompress(ph, PAGE_SIZE, packed, sizeof(packed));
+    ASSERT_TRUE(len > 0 && len < PAGE_SIZE / 3, "padded records compress well");
+    ASSERT_TRUE(lzDecompress(packed, len, check, PAGE_SIZE) == 0 && memcmp(ph, check, PAGE_SIZE) == 0, "records round trip");
+    ASSERT_TRUE(lzDecompress(packed, len / 2, check, PAGE_SIZE) != 0, "truncated input rejected");
+    ASSERT_TRUE(lzDecompress(packed, len, check, PAGE_SIZE - 1) != 0, "wrong output size rejected");
+    srand(525);
+    for (int i = 0; i < PAGE_SIZE; i++) ph[i] = (char) rand();
+    ASSERT_EQUALS_INT(0, lzCompress(ph, PAGE_SIZE, packed, PAGE_SIZE - 1), "noise does not fit in less than a page");
+    len = lzCompress(ph, PAGE_SIZE, packed, sizeof(packed));
+    ASSERT_TRUE(len > 0 && lzDecompress(packed, len, check, PAGE_SIZE) == 0 && memcmp(ph, check, PAGE_SIZE) == 0, "noise round trip");
+    len = lzCompress("abc", 3, packed, sizeof(packed));
+    ASSERT_TRUE(lzDecompress(packed, len, check, 3) == 0 && memcmp(check, "abc", 3) == 0, "input shorter than a match");
+
+    // 64 record-like pages take a fraction of their logical size
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_COMPRESSED));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(64, &fh));
+    for (int p = 0; p < 64; p++) {
+        memset(ph, 0, PAGE_SIZE);
+        for (int i = 0; i < PAGE_SIZE; i += 200) sprintf(ph + i, "page %d record %d", p, i);
+        TEST_CHECK(writeBlock(p, &fh, ph));
+    }
+    TEST_CHECK(closePageFile(&fh));
+    size = fileSize(TESTPF);
+    ASSERT_TRUE(size < 64LL * PAGE_SIZE / 3, "compressed file is at least 3x smaller");
+
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(64, fh.totalNumPages, "page count after reopen");
+    for (int p = 0; p < 64; p += 9) {
+        memset(check, 0, PAGE_SIZE);
+        for (int i = 0; i < PAGE_SIZE; i += 200) sprintf(check + i, "page %d record %d", p, i);
+        TEST_CHECK(readBlock(p, &fh, ph));
+        ASSERT_TRUE(memcmp(ph, check, PAGE_SIZE) == 0, "page decompressed on read");
+    }
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, openPageFileMapped(TESTPF, &mapped), "compressed files cannot be mapped");
+
+    // a page that outgrows its slot moves to the end, one that shrinks stays put
+    for (int i = 0; i < PAGE_SIZE; i++) ph[i] = (char) rand();
+    TEST_CHECK(writeBlock(5, &fh, ph));
+    ASSERT_TRUE(fileSize(TESTPF) >= size + PAGE_SIZE, "grown page appended");
+    TEST_CHECK(readBlock(5, &fh, check));
+    ASSERT_TRUE(memcmp(ph, check, PAGE_SIZE) == 0, "incompressible page stored as it is");
+    size = fileSize(TESTPF);
+    memset(ph, 'x', 100);
+    TEST_CHECK(writeBlock(5, &fh, ph));
+    memset(ph, 0, PAGE_SIZE);
+    TEST_CHECK(writeBlock(6, &fh, ph));
+    ASSERT_EQUALS_INT(size, fileSize(TESTPF), "rewrites that fit need no new space");
+    TEST_CHECK(readBlock(6, &fh, check));
+    ASSERT_TRUE(memcmp(ph, check, PAGE_SIZE) == 0, "zero page reads back");
+
+    // growing past the slot map moves the map; new pages read as zeros
+    TEST_CHECK(ensureCapacity(300, &fh));
+    ASSERT_TRUE(getAllocatedPages(&fh) >= 300, "slot map grown");
+    memset(ph, 'z', PAGE_SIZE);
+    TEST_CHECK(writeBlock(299, &fh, ph));
+    TEST_CHECK(readBlock(200, &fh, check));
+    ASSERT_TRUE(check[0] == 0 && check[PAGE_SIZE - 1] == 0, "unwritten page is zero");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(300, fh.totalNumPages, "page count kept");
+    TEST_CHECK(readBlock(299, &fh, check));
+    ASSERT_TRUE(check[0] == 'z' && check[PAGE_SIZE - 1] == 'z', "page behind the moved map");
+    TEST_CHECK(readBlock(5, &fh, check));
+    ASSERT_TRUE(check[0] == 'x' && check[100] != 'x', "shrunk page read back");
+    TEST_CHECK(closePageFile(&fh));
+
+    // checksums on top, the free list, and the buffer pool
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_COMPRESSED | SM_PAGE_CHECKSUMS));
+    TEST_CHECK(openPageFileDirect(TESTPF, &fh));
+    ASSERT_TRUE(!isPageFileDirect(&fh), "compressed files do buffered I/O");
+    TEST_CHECK(ensureCapacity(4, &fh));
+    TEST_CHECK(readBlock(3, &fh, ph));
+    TEST_CHECK(deallocatePage(1, &fh));
+    TEST_CHECK(deallocatePage(2, &fh));
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(2, pageNum, "leaf reused from a compressed trunk");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(initBufferPool(bm, TESTPF, 2, RS_LRU, NULL));
+    for (int p = 0; p < 4; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        sprintf(h->data, "pooled page %d", p);
+        TEST_CHECK(markDirty(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(shutdownBufferPool(bm));
+    TEST_CHECK(initBufferPool(bm, TESTPF, 2, RS_LRU, NULL));
+    TEST_CHECK(pinPage(bm, h, 3));
+    ASSERT_EQUALS_STRING("pooled page 3", h->data, "page written through the pool");
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(ph);
+    free(check);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Freed pages give their blocks back (hole punching),
+// compactPageFile catches the rest
+// ====================================================
+static void
+testHolePunching (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    PageNumber pageNum;
+    long long used, size;
+    testName = "Testing hole punching";
+
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_CHECKSUMS));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(64, &fh));
+    for (int p = 0; p < 64; p++) {
+        memset(ph, 'a' + p % 26, PAGE_SIZE);
+        TEST_CHECK(writeBlock(p, &fh, ph));
+    }
+    TEST_CHECK(syncPageFile(&fh));
+    used = diskUsage(TESTPF);
+    size = fileSize(TESTPF);
+
+    // page 10 becomes the trunk, 11..29 are leaves and lose their blocks
+    for (int p = 10; p < 30; p++) {
+        TEST_CHECK(deallocatePage(p, &fh));
+    }
+    ASSERT_TRUE(diskUsage(TESTPF) <= used - 19LL * PAGE_SIZE, "freed leaves punched");
+    ASSERT_EQUALS_INT(size, fileSize(TESTPF), "file size kept");
+    TEST_CHECK(readBlock(20, &fh, ph));
+    ASSERT_TRUE(ph[0] == 0 && ph[PAGE_SIZE - 1] == 0, "punched page reads as zeros");
+    TEST_CHECK(readBlock(30, &fh, ph));
+    ASSERT_TRUE(ph[0] == 'a' + 30 % 26, "neighbour untouched");
+
+    // a reused leaf comes back empty
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(29, pageNum, "last freed leaf reused");
+    TEST_CHECK(readBlock(pageNum, &fh, ph));
+    ASSERT_TRUE(ph[0] == 0, "reused page is empty");
+
+    // compaction punches leaves that still have blocks, trunks keep theirs
+    memset(ph, 'q', PAGE_SIZE);
+    TEST_CHECK(writeBlock(15, &fh, ph));    // a free page written behind the free list's back
+    used = diskUsage(TESTPF);
+    TEST_CHECK(compactPageFile(&fh));
+    ASSERT_TRUE(diskUsage(TESTPF) <= used - PAGE_SIZE, "leaf punched by compaction");
+    TEST_CHECK(readBlock(15, &fh, ph));
+    ASSERT_TRUE(ph[0] == 0, "compacted leaf reads as zeros");
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(28, pageNum, "free list intact after compaction");
+    TEST_CHECK(closePageFile(&fh));
+
+    // compressed file: moved slots leave dead space that compaction reclaims
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_COMPRESSED));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(32, &fh));
+    srand(14);
+    for (int round = 0; round < 2; round++) {
+        for (int p = 0; p < 32; p++) {
+            memset(ph, 0, PAGE_SIZE);
+            for (int i = 0; i < (round + 1) * PAGE_SIZE / 4; i++) ph[i] = (char) rand();
+            TEST_CHECK(writeBlock(p, &fh, ph));
+        }
+    }
+    TEST_CHECK(deallocatePage(3, &fh));
+    TEST_CHECK(deallocatePage(4, &fh));
+    TEST_CHECK(syncPageFile(&fh));
+    used = diskUsage(TESTPF);
+    TEST_CHECK(compactPageFile(&fh));
+    ASSERT_TRUE(diskUsage(TESTPF) <= used - 32LL * PAGE_SIZE / 4, "dead slots punched");
+    srand(14);
+    for (int p = 0; p < 32; p++) {
+        for (int i = 0; i < PAGE_SIZE / 4; i++) rand();
+    }
+    for (int p = 0; p < 32; p++) {
+        SM_PageHandle expect = (SM_PageHandle) calloc(1, PAGE_SIZE);
+        for (int i = 0; i < PAGE_SIZE / 2; i++) expect[i] = (char) rand();
+        if (p == 4) memset(expect, 0, PAGE_SIZE);   // leaf; page 3 is the trunk
+        if (p != 3) {
+            TEST_CHECK(readBlock(p, &fh, ph));
+            ASSERT_TRUE(memcmp(ph, expect, PAGE_SIZE) == 0, "live page survives compaction");
+        }
+        free(expect);
+    }
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Sequential pins make the pool read ahead in growing
+// windows; random ones do not
+// ====================================================
+static void
+testReadAhead (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    PageNumber scattered[] = {40, 3, 17, 50, 9, 33};
+    testName = "Testing adaptive read-ahead";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(64, &fh));
+    for (int p = 0; p < 64; p++) {
+        memset(ph, 0, PAGE_SIZE);
+        sprintf(ph, "page %d", p);
+        TEST_CHECK(writeBlock(p, &fh, ph));
+    }
+    // readNextBlock walks (and advises read-ahead) the same as before
+    TEST_CHECK(readFirstBlock(&fh, ph));
+    for (int p = 1; p < 64; p++) {
+        TEST_CHECK(readNextBlock(&fh, ph));
+        ASSERT_TRUE(atoi(ph + 5) == p, "sequential read");
+    }
+    TEST_CHECK(closePageFile(&fh));
+
+    // off by default: the pool only holds what was pinned
+    TEST_CHECK(initBufferPool(bm, TESTPF, 32, RS_LRU, NULL));
+    for (int p = 0; p < 10; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(0, getNumReadAheadIO(bm), "no read-ahead unless asked for");
+    ASSERT_EQUALS_INT(10, getNumReadIO(bm), "one read per pin");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // a full sequential walk: two synchronous misses, everything else read ahead
+    TEST_CHECK(initBufferPool(bm, TESTPF, 32, RS_LRU, NULL));
+    TEST_CHECK(setPoolReadAhead(bm, 16));
+    for (int p = 0; p < 64; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        ASSERT_TRUE(atoi(h->data + 5) == p, "read-ahead page content");
+        TEST_CHECK(pinPage(bm, h, p));      // a second pin of the same page keeps the sequence
+        TEST_CHECK(unpinPage(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(64, getNumReadIO(bm), "every page read once");
+    ASSERT_EQUALS_INT(62, getNumReadAheadIO(bm), "all but the first two pages read ahead");
+    ASSERT_EQUALS_INT(62, getNumReadAheadHits(bm), "every read-ahead page used");
+    ASSERT_EQUALS_INT(0, getNumReadAheadWasted(bm), "nothing wasted");
+
+    // random pins do not trigger it
+    int before = getNumReadAheadIO(bm);
+    for (int i = 0; i < (int) (sizeof(scattered) / sizeof(scattered[0])); i++) {
+        TEST_CHECK(pinPage(bm, h, scattered[i]));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(before, getNumReadAheadIO(bm), "random access reads no more");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // the pin that starts a window does not wait for it: the window's frames are
+    // in the pool, unpinned, while their reads are in flight; a pin waits for
+    // its own page only, flush and shutdown for whatever is left
+    TEST_CHECK(initBufferPool(bm, TESTPF, 32, RS_LRU, NULL));
+    TEST_CHECK(setPoolReadAhead(bm, 16));
+    for (int p = 0; p < 2; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_TRUE(inPool(bm, 2) && inPool(bm, 5), "window in the pool at once");
+    int *fixCounts = getFixCounts(bm);
+    int pinned = 0;
+    for (int i = 0; i < 32; i++) pinned += fixCounts[i];
+    free(fixCounts);
+    ASSERT_EQUALS_INT(0, pinned, "read-ahead frames are not pinned");
+    TEST_CHECK(pinPage(bm, h, 4));
+    ASSERT_TRUE(atoi(h->data + 5) == 4, "page pinned out of order from the window");
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(forceFlushPool(bm));
+    TEST_CHECK(pinPage(bm, h, 3));
+    ASSERT_TRUE(atoi(h->data + 5) == 3, "page collected by the flush");
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(pinPage(bm, h, 4));
+    TEST_CHECK(pinPage(bm, h, 5));      // starts the next window, left in flight
+    TEST_CHECK(unpinPage(bm, h));
+    h->pageNum = 4;
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // a sequence that stops early leaves its window unused
+    TEST_CHECK(initBufferPool(bm, TESTPF, 8, RS_FIFO, NULL));
+    TEST_CHECK(setPoolReadAhead(bm, 16));
+    for (int p = 0; p < 4; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    for (int i = 0; i < (int) (sizeof(scattered) / sizeof(scattered[0])); i++) {
+        TEST_CHECK(pinPage(bm, h, scattered[i]));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_TRUE(getNumReadAheadWasted(bm) > 0, "evicted read-ahead pages counted as waste");
+    ASSERT_TRUE(getNumReadAheadHits(bm) + getNumReadAheadWasted(bm) <= getNumReadAheadIO(bm), "hits and waste add up");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(ph);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// "mem:" files: the whole storage stack, nothing on disk
+// ====================================================
+static void
+testMemoryBackend (void)
+{
+    SM_FileHandle fh, other;
+    SM_AsyncRequest req;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    SM_PageHandle pages[8];
+    PageNumber freed;
+    struct stat st;
+    char *memPF = "mem:test_pagefile";
+    testName = "Testing the in-memory storage backend";
+
+    ASSERT_TRUE(getStorageBackend(memPF) == &smMemBackend, "mem: prefix picks the memory backend");
+    ASSERT_TRUE(getStorageBackend(TESTPF) == &smPosixBackend, "plain names stay on disk");
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, openPageFile(memPF, &fh), "no such memory file yet");
+
+    TEST_CHECK(createPageFile(memPF));
+    ASSERT_TRUE(stat(memPF, &st) != 0, "nothing created on disk");
+    TEST_CHECK(openPageFile(memPF, &fh));
+    TEST_CHECK(ensureCapacity(100, &fh));
+    for (int p = 0; p < 100; p++) {
+        memset(ph, 0, PAGE_SIZE);
+        sprintf(ph, "page %d", p);
+        TEST_CHECK(writeBlock(p, &fh, ph));
+    }
+    // a second handle shares the header, vectored calls fall back to one call per page
+    TEST_CHECK(openPageFile(memPF, &other));
+    ASSERT_EQUALS_INT(100, other.totalNumPages, "second handle sees the growth");
+    for (int i = 0; i < 8; i++) pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+    TEST_CHECK(readBlocks(40, 8, &other, pages));
+    for (int i = 0; i < 8; i++) {
+        ASSERT_TRUE(atoi(pages[i] + 5) == 40 + i, "vectored read");
+    }
+    TEST_CHECK(submitReadBlock(99, &other, ph, &req));
+    TEST_CHECK(waitAsyncIO(&req));
+    ASSERT_TRUE(atoi(ph + 5) == 99, "async read");
+    TEST_CHECK(closePageFile(&other));
+
+    // free list and sync policy only need the backend calls
+    TEST_CHECK(deallocatePage(10, &fh));
+    TEST_CHECK(allocatePage(&fh, &freed));
+    ASSERT_EQUALS_INT(10, (int) freed, "freed page reused");
+    memset(ph, 0, PAGE_SIZE);
+    TEST_CHECK(readBlock(10, &fh, ph));
+    ASSERT_TRUE(ph[0] == 0, "reused page reads back zeroed");
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_STRICT, 0, 0));
+    long long syncs = getSyncCount();
+    TEST_CHECK(writeBlock(11, &fh, pages[0]));
+    ASSERT_TRUE(getSyncCount() == syncs + 1, "strict sync counted");
+    TEST_CHECK(closePageFile(&fh));
+
+    // the file outlives its handles until it is destroyed
+    TEST_CHECK(openPageFile(memPF, &fh));
+    ASSERT_EQUALS_INT(100, fh.totalNumPages, "page count kept after close");
+    TEST_CHECK(readBlock(42, &fh, ph));
+    ASSERT_TRUE(atoi(ph + 5) == 42, "content kept after close");
+    ASSERT_TRUE(!isPageFileDirect(&fh), "no O_DIRECT in memory");
+    TEST_CHECK(closePageFile(&fh));
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, openPageFileMapped(memPF, &fh), "nothing to map");
+    TEST_CHECK(openPageFileDirect(memPF, &fh));
+    ASSERT_TRUE(!isPageFileDirect(&fh), "direct open falls back to buffered");
+    TEST_CHECK(closePageFile(&fh));
+
+    // the buffer pool on top of it
+    TEST_CHECK(initBufferPool(bm, memPF, 4, RS_LRU, NULL));
+    TEST_CHECK(pinPage(bm, h, 7));
+    ASSERT_TRUE(atoi(h->data + 5) == 7, "pool reads the memory file");
+    sprintf(h->data, "page X");
+    TEST_CHECK(markDirty(bm, h));
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(shutdownBufferPool(bm));
+    TEST_CHECK(openPageFile(memPF, &fh));
+    TEST_CHECK(readBlock(7, &fh, ph));
+    ASSERT_EQUALS_STRING("page X", ph, "pool wrote back to the memory file");
+    TEST_CHECK(closePageFile(&fh));
+
+    // compressed, checksummed memory files
+    TEST_CHECK(createPageFileWithOptions(memPF, PAGE_SIZE, SM_PAGE_CHECKSUMS | SM_PAGE_COMPRESSED));
+    TEST_CHECK(openPageFile(memPF, &fh));
+    ASSERT_EQUALS_INT(1, fh.totalNumPages, "recreated from scratch");
+    TEST_CHECK(ensureCapacity(300, &fh));
+    memset(ph, 0, PAGE_SIZE);
+    for (int p = 0; p < 300; p++) {
+        sprintf(ph, "page %d", p);
+        TEST_CHECK(writeBlock(p, &fh, ph));
+    }
+    TEST_CHECK(readBlock(250, &fh, ph));
+    ASSERT_TRUE(atoi(ph + 5) == 250, "compressed page read back");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(memPF));
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, openPageFile(memPF, &fh), "destroyed");
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, destroyPageFile(memPF), "destroyed once only");
+
+    // a temporary table lives entirely in memory
+    {
+        RM_TableData *rel = (RM_TableData *) malloc(sizeof(RM_TableData));
+        RM_ScanHandle *scan = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+        char *names[] = {"a"};
+        DataType types[] = {DT_INT};
+        int lengths[] = {0};
+        int keys[] = {0};
+        Schema *schema = createSchema(1, names, types, lengths, 1, keys);
+        Record *r;
+        Value *v;
+        int count = 0;
+        long long sum = 0;
+
+        TEST_CHECK(initRecordManager(NULL));
+        TEST_CHECK(createTable("mem:temp_table", schema));
+        TEST_CHECK(openTable(rel, "mem:temp_table"));
+        TEST_CHECK(createRecord(&r, schema));
+        for (int i = 0; i < 2000; i++) {
+            MAKE_VALUE(v, DT_INT, i);
+            TEST_CHECK(setAttr(r, schema, 0, v));
+            freeVal(v);
+            TEST_CHECK(insertRecord(rel, r));
+        }
+        ASSERT_EQUALS_INT(2000, getNumTuples(rel), "tuples in the temp table");
+        TEST_CHECK(startScan(rel, scan, NULL));
+        while (next(scan, r) == RC_OK) {
+            TEST_CHECK(getAttr(r, schema, 0, &v));
+            sum += v->v.intV;
+            count++;
+            freeVal(v);
+        }
+        TEST_CHECK(closeScan(scan));
+        ASSERT_EQUALS_INT(2000, count, "scan sees every tuple");
+        ASSERT_TRUE(sum == 1999LL * 2000 / 2, "scan sees the right tuples");
+        TEST_CHECK(closeTable(rel));
+        ASSERT_TRUE(stat("mem:temp_table", &st) != 0, "temp table never hit the disk");
+        TEST_CHECK(deleteTable("mem:temp_table"));
+        TEST_CHECK(shutdownRecordManager());
+        freeRecord(r);
+        freeSchema(schema);
+        free(rel);
+        free(scan);
+    }
+
+    // more prefixes can be routed to a backend
+    ASSERT_EQUALS_INT(RC_SM_INVALID_BACKEND, registerStorageBackend("", &smMemBackend), "empty prefix");
+    ASSERT_EQUALS_INT(RC_SM_INVALID_BACKEND, registerStorageBackend("ram:", NULL), "no backend");
+    TEST_CHECK(registerStorageBackend("ram:", &smMemBackend));
+    TEST_CHECK(createPageFile("ram:scratch"));
+    ASSERT_TRUE(stat("ram:scratch", &st) != 0, "registered prefix stays in memory");
+    TEST_CHECK(destroyPageFile("ram:scratch"));
+
+    for (int i = 0; i < 8; i++) free(pages[i]);
+    free(ph);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Doublewrite: one sync per batch, torn pages repaired on open
+// ====================================================
+static void
+testDoublewrite (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_PageHandle pages[100];
+    PageNumber nums[40], pageNum;
+    struct stat st;
+    long long syncs, repairs;
+    char *dwFile = TESTPF SM_DOUBLEWRITE_SUFFIX;
+    testName = "Testing the doublewrite buffer";
+
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_DOUBLEWRITE),
+                      "torn pages are found by their checksum");
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT,
+                      createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_CHECKSUMS | SM_PAGE_COMPRESSED | SM_PAGE_DOUBLEWRITE),
+                      "compressed pages are never overwritten in place");
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_CHECKSUMS | SM_PAGE_DOUBLEWRITE));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_TRUE(isDoublewriteEnabled(&fh), "doublewrite from the header");
+    TEST_CHECK(ensureCapacity(100, &fh));
+    for (int i = 0; i < 100; i++) {
+        pages[i] = (SM_PageHandle) calloc(1, PAGE_SIZE);
+        sprintf(pages[i], "page %d", i);
+    }
+
+    // a scattered batch: one sync, the doublewrite file's
+    for (int i = 0; i < 40; i++) nums[i] = 2 * i;
+    syncs = getSyncCount();
+    TEST_CHECK(writeBlockList(nums, 40, &fh, pages));
+    ASSERT_TRUE(getSyncCount() == syncs + 1, "one sync for 40 scattered pages");
+    ASSERT_TRUE(stat(dwFile, &st) == 0 && st.st_size == 41 * PAGE_SIZE, "header page and 40 images");
+    // the next batch first makes the last one durable in place
+    syncs = getSyncCount();
+    TEST_CHECK(writeBlockList(nums, 40, &fh, pages + 40));
+    ASSERT_TRUE(getSyncCount() == syncs + 2, "in-place sync plus doublewrite sync");
+    // larger writes go in batches of SM_DOUBLEWRITE_PAGES
+    syncs = getSyncCount();
+    TEST_CHECK(writeBlocks(0, 100, &fh, pages));
+    ASSERT_TRUE(getSyncCount() == syncs + 4, "two batches for 100 pages");
+    TEST_CHECK(closePageFile(&fh));
+
+    // tear a page of the last batch (64..99) and one written before it
+    repairs = getDoublewriteRepairs();
+    corruptByte(TESTPF, 71LL * PAGE_SIZE + 100);
+    corruptByte(TESTPF, 6LL * PAGE_SIZE + 100);
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_TRUE(getDoublewriteRepairs() == repairs + 1, "one page repaired");
+    TEST_CHECK(readBlock(70, &fh, pages[0]));
+    ASSERT_EQUALS_STRING("page 70", pages[0], "torn page put back");
+    ASSERT_EQUALS_INT(RC_SM_CHECKSUM_MISMATCH, readBlock(5, &fh, pages[0]), "older batches are gone");
+    TEST_CHECK(writeBlock(5, &fh, pages[5]));
+    TEST_CHECK(closePageFile(&fh));
+
+    // a doublewrite file that tore itself is ignored
+    corruptByte(TESTPF, 6LL * PAGE_SIZE + 100);
+    corruptByte(dwFile, 20);
+    repairs = getDoublewriteRepairs();
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_TRUE(getDoublewriteRepairs() == repairs, "nothing repaired from a torn batch");
+    ASSERT_EQUALS_INT(RC_SM_CHECKSUM_MISMATCH, readBlock(5, &fh, pages[0]), "page stays torn");
+    TEST_CHECK(writeBlock(5, &fh, pages[5]));
+    TEST_CHECK(closePageFile(&fh));
+
+    // a free-list trunk goes through the doublewrite file as well
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    syncs = getSyncCount();
+    TEST_CHECK(deallocatePage(30, &fh));
+    ASSERT_TRUE(getSyncCount() == syncs + 1, "trunk written to the doublewrite file first");
+    TEST_CHECK(closePageFile(&fh));
+    corruptByte(TESTPF, 31LL * PAGE_SIZE + 100);
+    repairs = getDoublewriteRepairs();
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_TRUE(getDoublewriteRepairs() == repairs + 1, "torn trunk repaired");
+    TEST_CHECK(allocatePage(&fh, &pageNum));
+    ASSERT_EQUALS_INT(30, pageNum, "trunk page handed out again");
+    TEST_CHECK(closePageFile(&fh));
+
+    // the pool writes evicted pages back in batches
+    TEST_CHECK(initBufferPool(bm, TESTPF, 8, RS_LRU, NULL));
+    syncs = getSyncCount();
+    for (int p = 0; p < 24; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        sprintf(h->data, "pool %d", p);
+        TEST_CHECK(markDirty(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(shutdownBufferPool(bm));
+    ASSERT_TRUE(getSyncCount() - syncs <= 7, "a few batches, not one sync per page");
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    for (int p = 0; p < 24; p++) {
+        TEST_CHECK(readBlock(p, &fh, pages[0]));
+        ASSERT_TRUE(atoi(pages[0] + 5) == p && strncmp(pages[0], "pool", 4) == 0, "pool page written");
+    }
+
+    // switched off, and kept that way in the header
+    TEST_CHECK(setDoublewrite(&fh, false));
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_TRUE(!isDoublewriteEnabled(&fh), "doublewrite off after reopen");
+    syncs = getSyncCount();
+    TEST_CHECK(writeBlockList(nums, 40, &fh, pages));
+    ASSERT_TRUE(getSyncCount() == syncs, "no doublewrite syncs");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(destroyPageFile(TESTPF));
+    ASSERT_TRUE(stat(dwFile, &st) != 0, "doublewrite file destroyed with the page file");
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, setDoublewrite(&fh, true), "no checksums, no doublewrite");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(destroyPageFile(TESTPF));
+
+    for (int i = 0; i < 100; i++) free(pages[i]);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Snapshots: frozen page images, copy on write, reclaimed on drop
+// ====================================================
+static void
+testSnapshots (void)
+{
+    SM_FileHandle fh, snap, older;
+    SM_PageHandle ph = (SM_PageHandle) calloc(1, PAGE_SIZE);
+    long long used, size;
+    testName = "Testing copy-on-write snapshots";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, createSnapshot(TESTPF, &snap), "in-place files take no snapshots");
+    TEST_CHECK(destroyPageFile(TESTPF));
+
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_SNAPSHOTS));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(50, &fh));
+    for (int i = 0; i < 50; i++) {
+        memset(ph, 'a' + i % 26, PAGE_SIZE);
+        sprintf(ph, "v1 %d", i);
+        TEST_CHECK(writeBlock(i, &fh, ph));
+    }
+    // without a snapshot pages are rewritten in their slots
+    size = fileSize(TESTPF);
+    TEST_CHECK(writeBlock(49, &fh, ph));
+    ASSERT_TRUE(fileSize(TESTPF) == size, "rewritten in place");
+
+    TEST_CHECK(createSnapshot(TESTPF, &snap));
+    ASSERT_TRUE(isSnapshot(&snap) && !isSnapshot(&fh), "snapshot handle");
+    for (int i = 0; i < 50; i++) {
+        memset(ph, 'A' + i % 26, PAGE_SIZE);
+        sprintf(ph, "v2 %d", i);
+        TEST_CHECK(writeBlock(i, &fh, ph));
+    }
+    TEST_CHECK(ensureCapacity(60, &fh));
+    TEST_CHECK(writeBlock(55, &fh, ph));
+    ASSERT_TRUE(fileSize(TESTPF) >= size + 50LL * PAGE_SIZE, "rewritten pages moved");
+    // the second write since the snapshot goes into the page's new slot
+    size = fileSize(TESTPF);
+    TEST_CHECK(writeBlock(3, &fh, ph));
+    ASSERT_TRUE(fileSize(TESTPF) == size, "moved page rewritten in place");
+
+    ASSERT_EQUALS_INT(50, snap.totalNumPages, "snapshot keeps its page count");
+    for (int i = 0; i < 50; i++) {
+        TEST_CHECK(readBlock(i, &snap, ph));
+        ASSERT_TRUE(atoi(ph + 3) == i && strncmp(ph, "v1", 2) == 0 && ph[PAGE_SIZE - 1] == 'a' + i % 26,
+                    "snapshot sees the old page");
+        TEST_CHECK(readBlock(i, &fh, ph));
+        ASSERT_TRUE(strncmp(ph, "v2", 2) == 0, "file sees the new page");
+    }
+    ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, readBlock(55, &snap, ph), "pages added later are not in the snapshot");
+    ASSERT_EQUALS_INT(RC_SM_READ_ONLY, writeBlock(1, &snap, ph), "snapshots are read-only");
+    ASSERT_EQUALS_INT(RC_SM_READ_ONLY, appendEmptyBlock(&snap), "snapshots do not grow");
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, dropSnapshot(&fh), "only snapshots are dropped");
+
+    // a second snapshot: emptying a page keeps both old images readable
+    TEST_CHECK(createSnapshot(TESTPF, &older));
+    TEST_CHECK(deallocatePage(7, &fh));
+    TEST_CHECK(readBlock(7, &older, ph));
+    ASSERT_EQUALS_STRING("v2 7", ph, "newer snapshot keeps the freed page");
+    TEST_CHECK(readBlock(7, &snap, ph));
+    ASSERT_EQUALS_STRING("v1 7", ph, "older snapshot keeps its image");
+    TEST_CHECK(dropSnapshot(&older));
+    TEST_CHECK(readBlock(8, &snap, ph));
+    ASSERT_EQUALS_STRING("v1 8", ph, "other snapshots live on");
+
+    // dropping the last snapshot punches the superseded images
+    used = diskUsage(TESTPF);
+    TEST_CHECK(dropSnapshot(&snap));
+    ASSERT_TRUE(snap.mgmtInfo == NULL, "snapshot closed");
+    ASSERT_TRUE(diskUsage(TESTPF) <= used - 40LL * PAGE_SIZE, "old images reclaimed");
+    size = fileSize(TESTPF);
+    TEST_CHECK(writeBlock(10, &fh, ph));
+    ASSERT_TRUE(fileSize(TESTPF) == size, "in place again after the drop");
+    TEST_CHECK(closePageFile(&fh));
+
+    // the layout is kept in the header
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(readBlock(20, &fh, ph));
+    ASSERT_EQUALS_STRING("v2 20", ph, "page after reopen");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(createSnapshot(TESTPF, &snap));
+    TEST_CHECK(dropSnapshot(&snap));
+    TEST_CHECK(destroyPageFile(TESTPF));
+
+    // compressed files take snapshots too
+    TEST_CHECK(createPageFileWithOptions(TESTPF, PAGE_SIZE, SM_PAGE_CHECKSUMS | SM_PAGE_COMPRESSED));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(20, &fh));
+    memset(ph, 0, PAGE_SIZE);
+    for (int i = 0; i < 20; i++) {
+        sprintf(ph, "old %d", i);
+        TEST_CHECK(writeBlock(i, &fh, ph));
+    }
+    TEST_CHECK(createSnapshot(TESTPF, &snap));
+    for (int i = 0; i < 20; i++) {
+        sprintf(ph, "new %d", i);
+        TEST_CHECK(writeBlock(i, &fh, ph));
+    }
+    for (int i = 0; i < 20; i++) {
+        TEST_CHECK(readBlock(i, &snap, ph));
+        ASSERT_TRUE(strncmp(ph, "old", 3) == 0 && atoi(ph + 4) == i, "compressed snapshot page");
+    }
+    TEST_CHECK(dropSnapshot(&snap));
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(destroyPageFile(TESTPF));
+
+    free(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// Tablespaces: many page files in one file
+// ====================================================
+static void
+testTablespace (void)
+{
+    SM_FileHandle a, b, fh;
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    struct stat st;
+    char *space = "test_space_n.ts";
+    char *segA = "ts:test_space_n.ts#seg_a";
+    char *segB = "ts:test_space_n.ts#seg_b";
+    char *table = "ts:test_space_n.ts#orders";
+    testName = "Testing tablespaces";
+
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, createPageFile(segA), "no tablespace yet");
+    TEST_CHECK(createTablespace(space));
+    ASSERT_TRUE(getStorageBackend(segA) == &smTablespaceBackend, "ts: prefix picks the tablespace backend");
+    ASSERT_EQUALS_INT(0, getTablespaceSegments(space), "empty directory");
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, openPageFile(segA, &a), "no such segment yet");
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, createPageFile("ts:test_space_n.ts#"), "segments need a name");
+
+    // two segments growing side by side keep their own pages
+    TEST_CHECK(createPageFile(segA));
+    TEST_CHECK(createPageFile(segB));
+    ASSERT_EQUALS_INT(2, getTablespaceSegments(space), "two segments");
+    TEST_CHECK(openPageFile(segA, &a));
+    TEST_CHECK(openPageFile(segB, &b));
+    TEST_CHECK(setExtentSize(16, &a));
+    TEST_CHECK(setExtentSize(16, &b));
+    for (int p = 0; p < 200; p++) {
+        TEST_CHECK(ensureCapacity(p + 1, &a));
+        TEST_CHECK(ensureCapacity(p + 1, &b));
+        memset(ph, 0, PAGE_SIZE);
+        sprintf(ph, "a %d", p);
+        TEST_CHECK(writeBlock(p, &a, ph));
+        sprintf(ph, "b %d", p);
+        TEST_CHECK(writeBlock(p, &b, ph));
+    }
+    TEST_CHECK(closePageFile(&a));
+    TEST_CHECK(closePageFile(&b));
+    ASSERT_TRUE(stat("seg_a", &st) != 0 && stat("test_space_n.ts#seg_a", &st) != 0, "no file per segment");
+
+    TEST_CHECK(openPageFile(segA, &a));
+    TEST_CHECK(openPageFile(segB, &b));
+    ASSERT_EQUALS_INT(200, a.totalNumPages, "page count of a kept");
+    for (int p = 0; p < 200; p += 7) {
+        TEST_CHECK(readBlock(p, &a, ph));
+        ASSERT_TRUE(ph[0] == 'a' && atoi(ph + 2) == p, "page of a");
+        TEST_CHECK(readBlock(p, &b, ph));
+        ASSERT_TRUE(ph[0] == 'b' && atoi(ph + 2) == p, "page of b");
+    }
+    TEST_CHECK(closePageFile(&b));
+
+    // dropping a segment frees its extents for the next one
+    int extents = getTablespaceExtents(space);
+    TEST_CHECK(destroyPageFile(segB));
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, openPageFile(segB, &b), "segment destroyed");
+    ASSERT_TRUE(getTablespaceExtents(space) < extents, "extents freed");
+    TEST_CHECK(stat(space, &st) == 0 ? RC_OK : RC_FILE_NOT_FOUND);
+    long long size = st.st_size;
+
+    // a table in the tablespace, on the extents b left behind
+    {
+        RM_TableData *rel = (RM_TableData *) malloc(sizeof(RM_TableData));
+        char *names[] = {"id", "qty"};
+        DataType types[] = {DT_INT, DT_INT};
+        int lengths[] = {0, 0};
+        int keys[] = {0};
+        Schema *schema = createSchema(2, names, types, lengths, 1, keys);
+        RM_ScanHandle *scan = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+        Record *r;
+        Value *v;
+        int count = 0;
+        long long sum = 0;
+
+        TEST_CHECK(initRecordManager(NULL));
+        TEST_CHECK(createTable(table, schema));
+        TEST_CHECK(openTable(rel, table));
+        TEST_CHECK(createRecord(&r, schema));
+        for (int i = 0; i < 3000; i++) {
+            MAKE_VALUE(v, DT_INT, i);
+            TEST_CHECK(setAttr(r, schema, 0, v));
+            freeVal(v);
+            MAKE_VALUE(v, DT_INT, i % 7);
+            TEST_CHECK(setAttr(r, schema, 1, v));
+            freeVal(v);
+            TEST_CHECK(insertRecord(rel, r));
+        }
+        TEST_CHECK(closeTable(rel));
+        TEST_CHECK(openTable(rel, table));
+        TEST_CHECK(startScan(rel, scan, NULL));
+        while (next(scan, r) == RC_OK) {
+            TEST_CHECK(getAttr(r, schema, 0, &v));
+            sum += v->v.intV;
+            count++;
+            freeVal(v);
+        }
+        TEST_CHECK(closeScan(scan));
+        ASSERT_EQUALS_INT(3000, count, "tuples in the tablespace table");
+        ASSERT_TRUE(sum == 2999LL * 3000 / 2, "tuples read back");
+        TEST_CHECK(closeTable(rel));
+        ASSERT_TRUE(stat(space, &st) == 0 && st.st_size == size, "table fits into the freed extents");
+        ASSERT_EQUALS_INT(2, getTablespaceSegments(space), "table is a segment");
+        TEST_CHECK(deleteTable(table));
+        TEST_CHECK(shutdownRecordManager());
+        freeRecord(r);
+        freeSchema(schema);
+        free(rel);
+        free(scan);
+    }
+
+    // a segment destroyed while open lives on until it is closed
+    TEST_CHECK(openPageFile(segA, &fh));
+    TEST_CHECK(destroyPageFile(segA));
+    ASSERT_EQUALS_INT(0, getTablespaceSegments(space), "name gone at once");
+    TEST_CHECK(readBlock(150, &fh, ph));
+    ASSERT_TRUE(atoi(ph + 2) == 150, "still readable through open handles");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(closePageFile(&a));
+    ASSERT_EQUALS_INT(0, getTablespaceExtents(space), "extents freed on the last close");
+
+    // a tablespace in memory
+    TEST_CHECK(createTablespace("mem:test_space"));
+    TEST_CHECK(createPageFileWithOptions("ts:mem:test_space#c", PAGE_SIZE, SM_PAGE_CHECKSUMS | SM_PAGE_COMPRESSED));
+    TEST_CHECK(openPageFile("ts:mem:test_space#c", &fh));
+    TEST_CHECK(ensureCapacity(10, &fh));
+    memset(ph, 0, PAGE_SIZE);
+    sprintf(ph, "compressed");
+    TEST_CHECK(writeBlock(9, &fh, ph));
+    TEST_CHECK(readBlock(9, &fh, ph));
+    ASSERT_EQUALS_STRING("compressed", ph, "compressed segment in a memory tablespace");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(destroyPageFile("mem:test_space"));
+
+    TEST_CHECK(destroyPageFile(space));
+    free(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// striped page files: pages round-robin over member files,
+// multi-page and async transfers reach every member at once
+// ====================================================
+static void
+testStriping (void)
+{
+    SM_FileHandle fh;
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    SM_PageHandle pages[48];
+    SM_AsyncRequest reqs[48];
+    struct stat st;
+    char *members[] = {"test_stripe_n.0", "test_stripe_n.1", "test_stripe_n.2"};
+    char *set = "test_stripe_n.set";
+    char *name = "stripe:test_stripe_n.set";
+    testName = "Testing striped page files";
+
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, createStripeSet(set, members, 3, 4096), "unit splits pages");
+    ASSERT_EQUALS_INT(RC_SM_UNSUPPORTED_FORMAT, createStripeSet(set, members, 0, 0), "no members");
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, createPageFile(name), "no stripe set yet");
+    TEST_CHECK(createStripeSet(set, members, 3, 64 * 1024));
+    ASSERT_TRUE(getStorageBackend(name) == &smStripeBackend, "stripe: prefix picks the stripe backend");
+
+    TEST_CHECK(createPageFile(name));
+    TEST_CHECK(openPageFile(name, &fh));
+    TEST_CHECK(ensureCapacity(200, &fh));
+    for (int p = 0; p < 200; p++) {
+        memset(ph, 0, PAGE_SIZE);
+        sprintf(ph, "p %d", p);
+        TEST_CHECK(writeBlock(p, &fh, ph));
+    }
+    TEST_CHECK(closePageFile(&fh));
+
+    // page 20 starts 86016 bytes in: second 64K stripe, so member 1 at 20480
+    {
+        char raw[16] = {0};
+        FILE *f = fopen(members[1], "rb");
+        ASSERT_TRUE(f != NULL && fseek(f, 20480, SEEK_SET) == 0 && fread(raw, 1, sizeof(raw) - 1, f) > 0,
+                    "member file readable");
+        ASSERT_EQUALS_STRING("p 20", raw, "page in its member at its stripe offset");
+        if (f != NULL) fclose(f);
+    }
+    long long total = 0;
+    for (int m = 0; m < 3; m++) {
+        ASSERT_TRUE(stat(members[m], &st) == 0 && st.st_size > 0, "every member holds stripes");
+        total += st.st_size;
+    }
+    ASSERT_TRUE(total >= 201LL * PAGE_SIZE, "members add up to the file");
+
+    TEST_CHECK(openPageFile(name, &fh));
+    ASSERT_EQUALS_INT(200, fh.totalNumPages, "page count kept");
+    for (int p = 0; p < 200; p += 13) {
+        TEST_CHECK(readBlock(p, &fh, ph));
+        ASSERT_TRUE(atoi(ph + 2) == p, "page read back");
+    }
+
+    // 48 pages span three stripes and go to all three members together
+    for (int i = 0; i < 48; i++) pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+    long long parallel = getStripeParallelIOs();
+    TEST_CHECK(readBlocks(100, 48, &fh, pages));
+    ASSERT_TRUE(getStripeParallelIOs() > parallel, "vectored read split over the members");
+    for (int i = 0; i < 48; i++) {
+        ASSERT_TRUE(atoi(pages[i] + 2) == 100 + i, "vectored read content");
+        memset(pages[i], 0, PAGE_SIZE);
+        sprintf(pages[i], "p %d", 1000 + i);
+    }
+    TEST_CHECK(writeBlocks(100, 48, &fh, pages));
+    TEST_CHECK(readBlock(147, &fh, ph));
+    ASSERT_TRUE(atoi(ph + 2) == 1047, "vectored write content");
+
+    // async requests go straight to the members
+    TEST_CHECK(initAsyncIO(SM_ASYNC_AUTO, 8));
+    for (int i = 0; i < 48; i++) {
+        memset(pages[i], 0, PAGE_SIZE);
+        sprintf(pages[i], "async %d", i);
+        TEST_CHECK(submitWriteBlock(i * 4, &fh, pages[i], &reqs[i]));
+    }
+    TEST_CHECK(waitAllAsyncIO(reqs, 48));
+    for (int i = 0; i < 48; i++) {
+        memset(pages[i], 0, PAGE_SIZE);
+        TEST_CHECK(submitReadBlock(i * 4, &fh, pages[i], &reqs[i]));
+    }
+    TEST_CHECK(waitAllAsyncIO(reqs, 48));
+    for (int i = 0; i < 48; i++) {
+        ASSERT_TRUE(strncmp(pages[i], "async ", 6) == 0 && atoi(pages[i] + 6) == i, "async content");
+    }
+    TEST_CHECK(shutdownAsyncIO());
+    TEST_CHECK(readBlock(8, &fh, ph));
+    ASSERT_EQUALS_STRING("async 2", ph, "async write visible to readBlock");
+
+    // growing past the members' ends
+    TEST_CHECK(ensureCapacity(400, &fh));
+    memset(ph, 0, PAGE_SIZE);
+    sprintf(ph, "p %d", 399);
+    TEST_CHECK(writeBlock(399, &fh, ph));
+    TEST_CHECK(readBlock(398, &fh, ph));
+    ASSERT_TRUE(ph[0] == '\0', "new pages are empty");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(openPageFile(name, &fh));
+    ASSERT_EQUALS_INT(400, fh.totalNumPages, "grown page count kept");
+    TEST_CHECK(readBlock(399, &fh, ph));
+    ASSERT_TRUE(atoi(ph + 2) == 399, "last page");
+    TEST_CHECK(closePageFile(&fh));
+
+    TEST_CHECK(destroyPageFile(name));
+    for (int m = 0; m < 3; m++) {
+        ASSERT_TRUE(stat(members[m], &st) != 0, "members removed");
+    }
+    ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, openPageFile(name, &fh), "page file destroyed");
+    TEST_CHECK(stat(set, &st) == 0 ? RC_OK : RC_FILE_NOT_FOUND);
+    remove(set);
+
+    for (int i = 0; i < 48; i++) free(pages[i]);
+    free(ph);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// the pool finds pages through its page table: big pools,
+// stale handles and frames emptied by freePoolPage
+// ====================================================
+static void
+testPageTable (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PageHandle copy;
+    SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+    PageNumber *contents;
+    int numPages = 3000;
+    testName = "Testing the buffer pool page table";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(numPages, &fh));
+    for (int p = 0; p < numPages; p++) {
+        memset(ph, 0, PAGE_SIZE);
+        sprintf(ph, "page %d", p);
+        TEST_CHECK(writeBlock(p, &fh, ph));
+    }
+    TEST_CHECK(closePageFile(&fh));
+
+    // every page of the file in a big pool, in scattered order; the second round only hits
+    TEST_CHECK(initBufferPool(bm, TESTPF, 4096, RS_FIFO, NULL));
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < numPages; i++) {
+            int p = (i * 7) % numPages;
+            TEST_CHECK(pinPage(bm, h, p));
+            ASSERT_TRUE(atoi(h->data + 5) == p, "page content");
+            TEST_CHECK(unpinPage(bm, h));
+        }
+    }
+    ASSERT_EQUALS_INT(numPages, getNumReadIO(bm), "one read per page");
+    contents = getFrameContents(bm);
+    TEST_CHECK(pinPage(bm, h, 1234));
+    ASSERT_TRUE(h->frame >= 0 && h->frame < 4096 && contents[h->frame] == 1234, "handle knows its frame");
+    free(contents);
+
+    // a handle whose frame is off still finds its page
+    copy = *h;
+    copy.frame = -1;
+    TEST_CHECK(markDirty(bm, &copy));
+    TEST_CHECK(forcePage(bm, &copy));
+    ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "forced through the lookup");
+    TEST_CHECK(unpinPage(bm, &copy));
+    ASSERT_ERROR(unpinPage(bm, h), "unpinned once only");
+    h->pageNum = 4000;
+    ASSERT_ERROR(markDirty(bm, h), "page not in the pool");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // a small pool replacing pages all the time keeps the table right
+    TEST_CHECK(initBufferPool(bm, TESTPF, 5, RS_LRU, NULL));
+    for (int i = 0; i < 500; i++) {
+        int p = (i * 1024 + i / 3) % numPages;
+        TEST_CHECK(pinPage(bm, h, p));
+        ASSERT_TRUE(atoi(h->data + 5) == p, "page content after evictions");
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // a frame emptied by freePoolPage is used before any victim
+    TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_FIFO, NULL));
+    for (int p = 0; p < 4; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(freePoolPage(bm, 2));
+    TEST_CHECK(pinPage(bm, h, 10));
+    contents = getFrameContents(bm);
+    ASSERT_TRUE(contents[0] == 0 && contents[2] == 10, "empty frame taken, page 0 kept");
+    ASSERT_EQUALS_INT(2, h->frame, "frame of the new page");
+    free(contents);
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(ph);
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// a pool keeps its page file open from init to shutdown
+// ====================================================
+static void
+testPoolFileHandle (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing the pool's page file handle";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_ON_CLOSE, 0, 0));
+    TEST_CHECK(closePageFile(&fh));
+
+    // sync on close: with a handle per I/O every write-back would sync
+    long long syncs = getSyncCount();
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_FIFO, NULL));
+    for (int p = 0; p < 20; p++) {
+        TEST_CHECK(pinPage(bm, h, p));
+        sprintf(h->data, "page %d", p);
+        TEST_CHECK(markDirty(bm, h));
+        if (p % 5 == 0) TEST_CHECK(forcePage(bm, h));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(forceFlushPool(bm));
+    ASSERT_EQUALS_INT(20, getPoolFileSize(bm), "pool grew the file");
+    ASSERT_EQUALS_INT(0, getNumSyncIO(bm), "file never closed while the pool is up");
+    ASSERT_TRUE(getSyncCount() == syncs, "no sync before shutdown");
+
+    // other handles share the pool's view of the file
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    ASSERT_EQUALS_INT(20, fh.totalNumPages, "page count seen by another handle");
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(shutdownBufferPool(bm));
+    ASSERT_TRUE(getSyncCount() == syncs + 1, "one sync when the pool lets go of the file");
+
+    TEST_CHECK(initBufferPoolDirect(bm, TESTPF, 3, RS_LRU, NULL));
+    for (int p = 19; p >= 0; p -= 3) {
+        TEST_CHECK(pinPage(bm, h, p));
+        ASSERT_TRUE(atoi(h->data + 5) == p, "pages written through the pool");
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    TEST_CHECK(shutdownBufferPool(bm));
+    ASSERT_ERROR(initBufferPool(bm, "test_no_such_file_n.bin", 3, RS_FIFO, NULL), "no page file, no pool");
+
+    // shutdown reports a failed write-back and a failed sync on close
+    static SM_Backend flaky;
+    flaky = smMemBackend;
+    flaky.name = "flaky";
+    flaky.pwrite = flakyPwrite;
+    flaky.pwritev = NULL;
+    flaky.sync = flakySync;
+    TEST_CHECK(registerStorageBackend("flaky:", &flaky));
+    TEST_CHECK(createPageFile("flaky:pool"));
+    TEST_CHECK(openPageFile("flaky:pool", &fh));
+    TEST_CHECK(setSyncPolicy(&fh, SM_SYNC_ON_CLOSE, 0, 0));
+    TEST_CHECK(closePageFile(&fh));
+    TEST_CHECK(initBufferPool(bm, "flaky:pool", 3, RS_FIFO, NULL));
+    TEST_CHECK(pinPage(bm, h, 0));
+    sprintf(h->data, "lost");
+    TEST_CHECK(markDirty(bm, h));
+    TEST_CHECK(unpinPage(bm, h));
+    flakyFail = true;
+    ASSERT_EQUALS_INT(RC_WRITE_FAILED, shutdownBufferPool(bm), "failed write-back returned");
+    flakyFail = false;
+    TEST_CHECK(initBufferPool(bm, "flaky:pool", 3, RS_FIFO, NULL));
+    TEST_CHECK(pinPage(bm, h, 0));
+    ASSERT_TRUE(strcmp(h->data, "lost") != 0, "page never written");
+    sprintf(h->data, "kept");
+    TEST_CHECK(markDirty(bm, h));
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(forceFlushPool(bm));
+    flakyFail = true;
+    ASSERT_EQUALS_INT(RC_WRITE_FAILED, shutdownBufferPool(bm), "failed sync on close returned");
+    flakyFail = false;
+    TEST_CHECK(destroyPageFile("flaky:pool"));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// LRU, LFU and LRU-K pick their victims from ordered
+// structures: recency, aged counts, K-th access
+// ====================================================
+static void
+testReplacementOrder (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PageHandle *held = MAKE_PAGE_HANDLE();
+    int k = 3;
+    testName = "Testing replacement order";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(10, &fh));
+    TEST_CHECK(closePageFile(&fh));
+
+    // LRU: a hit moves the page to the end, pinned pages are stepped over
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU, NULL));
+    TEST_CHECK(pinPage(bm, held, 0));       // least recently used, but pinned
+    pinTimes(bm, h, 1, 1);
+    pinTimes(bm, h, 2, 1);
+    pinTimes(bm, h, 1, 1);
+    pinTimes(bm, h, 3, 1);
+    ASSERT_TRUE(inPool(bm, 0) && inPool(bm, 1) && !inPool(bm, 2), "LRU: oldest unpinned page evicted");
+    pinTimes(bm, h, 4, 1);
+    ASSERT_TRUE(inPool(bm, 0) && !inPool(bm, 1), "LRU: then the next oldest");
+    TEST_CHECK(pinPage(bm, h, 3));
+    TEST_CHECK(pinPage(bm, h, 4));
+    ASSERT_ERROR(pinPage(bm, h, 5), "LRU: all pinned");
+    TEST_CHECK(unpinPage(bm, held));
+    pinTimes(bm, held, 5, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && inPool(bm, 5), "LRU: unpinned page evicted");
+    TEST_CHECK(unpinPage(bm, h));
+    h->pageNum = 3;
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // LFU: fewest accesses first, the least recently counted of those
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LFU, NULL));
+    pinTimes(bm, h, 0, 3);
+    pinTimes(bm, h, 1, 2);
+    pinTimes(bm, h, 2, 2);
+    pinTimes(bm, h, 3, 1);
+    ASSERT_TRUE(inPool(bm, 0) && !inPool(bm, 1) && inPool(bm, 2), "LFU: least counted of the least used");
+    pinTimes(bm, h, 4, 1);
+    ASSERT_TRUE(!inPool(bm, 3) && inPool(bm, 4), "LFU: new page with one access goes first");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // LFU ages: a page hot long ago loses against pages used now
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LFU, NULL));
+    for (int p = 0; p < 3; p++) pinTimes(bm, h, p, 1);
+    pinTimes(bm, h, 0, 20);
+    for (int i = 0; i < 15; i++) {
+        pinTimes(bm, h, 1, 1);
+        pinTimes(bm, h, 2, 1);
+    }
+    pinTimes(bm, h, 3, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && inPool(bm, 1) && inPool(bm, 2), "LFU: old count aged away");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // LRU-K (K = 2 by default): pages seen K times go first, least recently used first
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU_K, NULL));
+    pinTimes(bm, h, 0, 2);
+    pinTimes(bm, h, 1, 1);
+    pinTimes(bm, h, 2, 2);
+    pinTimes(bm, h, 3, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && inPool(bm, 1) && inPool(bm, 2), "LRU-K: oldest page seen K times");
+    pinTimes(bm, h, 4, 1);
+    ASSERT_TRUE(!inPool(bm, 2) && inPool(bm, 1) && inPool(bm, 3), "LRU-K: pages seen once are kept");
+    pinTimes(bm, h, 5, 1);
+    ASSERT_TRUE(!inPool(bm, 1) && inPool(bm, 3) && inPool(bm, 4), "LRU-K: then least recently used");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // LRU-K goes by the K-th most recent access, not the last one
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU_K, NULL));
+    pinTimes(bm, h, 0, 1);
+    pinTimes(bm, h, 1, 2);
+    pinTimes(bm, h, 0, 1);
+    pinTimes(bm, h, 2, 2);
+    pinTimes(bm, h, 3, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && inPool(bm, 1) && inPool(bm, 2), "LRU-K: oldest second-to-last access, not oldest last");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // K from stratData: with K = 3, two accesses are not enough
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_LRU_K, &k));
+    pinTimes(bm, h, 1, 2);
+    pinTimes(bm, h, 0, 3);
+    pinTimes(bm, h, 2, 3);
+    pinTimes(bm, h, 3, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && inPool(bm, 1) && inPool(bm, 2), "LRU-K: K = 3 from stratData");
+    TEST_CHECK(pinPage(bm, held, 2));
+    TEST_CHECK(pinPage(bm, h, 1));
+    pinTimes(bm, h, 4, 1);
+    ASSERT_TRUE(!inPool(bm, 3) && inPool(bm, 1) && inPool(bm, 2), "LRU-K: pinned pages stay");
+    TEST_CHECK(unpinPage(bm, held));
+    held->pageNum = 1;
+    TEST_CHECK(unpinPage(bm, held));
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    free(bm);
+    free(h);
+    free(held);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// ARC: a scan goes through T1 and leaves the pages used
+// twice (T2) alone; ghost hits move the T1/T2 split
+// ====================================================
+static void
+testArcReplacement (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PageHandle *held[4];
+    testName = "Testing ARC replacement";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(30, &fh));
+    TEST_CHECK(closePageFile(&fh));
+
+    // LRU loses its working set to a scan
+    TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_LRU, NULL));
+    pinTimes(bm, h, 0, 2);
+    pinTimes(bm, h, 1, 2);
+    for (int p = 2; p <= 20; p++) pinTimes(bm, h, p, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && !inPool(bm, 1), "LRU: scan evicts the working set");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // ARC keeps it: pages 0 and 1 are in T2, the scan cycles through T1
+    TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_ARC, NULL));
+    pinTimes(bm, h, 0, 2);
+    pinTimes(bm, h, 1, 2);
+    for (int p = 2; p <= 20; p++) pinTimes(bm, h, p, 1);
+    ASSERT_TRUE(inPool(bm, 0) && inPool(bm, 1), "ARC: scan leaves the working set");
+    ASSERT_TRUE(inPool(bm, 19) && inPool(bm, 20) && !inPool(bm, 18), "ARC: scan recycles T1");
+
+    // 18 is a ghost in B1: T1 was too small, it gets one frame more and 18 goes to T2
+    pinTimes(bm, h, 18, 1);
+    ASSERT_TRUE(inPool(bm, 18) && !inPool(bm, 19) && inPool(bm, 0) && inPool(bm, 1), "ARC: B1 hit evicts from T1");
+    pinTimes(bm, h, 21, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && inPool(bm, 20) && inPool(bm, 21), "ARC: T1 may now take from T2");
+
+    // 0 is a ghost in B2: the split moves back towards T2
+    pinTimes(bm, h, 0, 1);
+    ASSERT_TRUE(inPool(bm, 0) && !inPool(bm, 20) && inPool(bm, 21) && inPool(bm, 1), "ARC: B2 hit evicts from T1");
+
+    // pinned frames are never victims
+    PageNumber resident[4] = {0, 1, 18, 21};
+    for (int i = 0; i < 4; i++) {
+        held[i] = MAKE_PAGE_HANDLE();
+        TEST_CHECK(pinPage(bm, held[i], resident[i]));
+    }
+    ASSERT_ERROR(pinPage(bm, h, 22), "ARC: all pinned");
+    TEST_CHECK(unpinPage(bm, held[3]));
+    pinTimes(bm, h, 22, 1);
+    ASSERT_TRUE(inPool(bm, 22) && !inPool(bm, 21), "ARC: only unpinned page evicted");
+    for (int i = 0; i < 3; i++) {
+        TEST_CHECK(unpinPage(bm, held[i]));
+    }
+
+    // long runs keep the directory in bounds (ASan watches the ghost arrays)
+    for (int round = 0; round < 5; round++) {
+        for (int p = 0; p < 30; p += round + 1) pinTimes(bm, h, p, 1 + p % 3);
+    }
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    TEST_CHECK(destroyPageFile(TESTPF));
+    for (int i = 0; i < 4; i++) {
+        free(held[i]);
+    }
+    free(bm);
+    free(h);
+
+    TEST_DONE();
+}
+
+// ====================================================
+// A scan through an access ring recycles a few frames
+// and leaves the rest of the pool alone
+// ====================================================
+static void
+testAccessRing (void)
+{
+    SM_FileHandle fh;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_Ring *ring;
+    PageNumber *contents;
+    int inRing;
+    testName = "Testing access rings";
+
+    TEST_CHECK(createPageFile(TESTPF));
+    TEST_CHECK(openPageFile(TESTPF, &fh));
+    TEST_CHECK(ensureCapacity(40, &fh));
+    TEST_CHECK(closePageFile(&fh));
+
+    // working set 0..5 in a pool of 8; the ring gets a quarter of it, 2 frames
+    TEST_CHECK(initBufferPool(bm, TESTPF, 8, RS_LRU, NULL));
+    for (int p = 0; p < 6; p++) pinTimes(bm, h, p, 1);
+    TEST_CHECK(openPoolRing(bm, 16, &ring));
+    for (int p = 10; p < 40; p++) {
+        TEST_CHECK(pinPageRing(bm, h, p, ring));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    contents = getFrameContents(bm);
+    inRing = 0;
+    for (int i = 0; i < 8; i++) {
+        if (contents[i] >= 10) inRing++;
+    }
+    free(contents);
+    ASSERT_EQUALS_INT(2, inRing, "scan pages only in the ring's frames");
+    for (int p = 0; p < 6; p++) {
+        ASSERT_TRUE(inPool(bm, p), "working set stays");
+    }
+    ASSERT_TRUE(inPool(bm, 38) && inPool(bm, 39), "ring holds the last pages");
+
+    // a hit through the ring is no use: page 0 is still the least recently used
+    TEST_CHECK(pinPageRing(bm, h, 0, ring));
+    TEST_CHECK(unpinPage(bm, h));
+    pinTimes(bm, h, 6, 1);
+    ASSERT_TRUE(!inPool(bm, 0) && inPool(bm, 1), "ring hit does not count");
+    ASSERT_TRUE(inPool(bm, 38) && inPool(bm, 39), "ring frames are no victims");
+
+    // a dirty ring page is written back when the ring closes, and the frames emptied
+    TEST_CHECK(pinPageRing(bm, h, 39, ring));
+    TEST_CHECK(markDirty(bm, h));
+    TEST_CHECK(unpinPage(bm, h));
+    int writes = getNumWriteIO(bm);
+    TEST_CHECK(closePoolRing(bm, ring));
+    ASSERT_EQUALS_INT(writes + 1, getNumWriteIO(bm), "dirty ring page written back");
+    ASSERT_TRUE(!inPool(bm, 38) && !inPool(bm, 39), "ring frames emptied");
+    ASSERT_TRUE(inPool(bm, 1) && inPool(bm, 6), "working set untouched");
+
+    // a regular pin takes the page out of the ring, it outlives the ring
+    TEST_CHECK(openPoolRing(bm, 16, &ring));
+    TEST_CHECK(pinPageRing(bm, h, 20, ring));
+    TEST_CHECK(unpinPage(bm, h));
+    pinTimes(bm, h, 20, 1);
+    TEST_CHECK(pinPageRing(bm, h, 21, ring));
+    TEST_CHECK(unpinPage(bm, h));
+    TEST_CHECK(closePoolRing(bm, ring));
+    ASSERT_TRUE(inPool(bm, 20) && !inPool(bm, 21), "promoted page stays");
+    TEST_CHECK(shutdownBufferPool(bm));
+
+    // small pools get a ring of one frame; when everything else is pinned the ring gives it up
+    TEST_CHECK(initBufferPool(bm, TESTPF, 3, RS_CLOCK, NULL));
+    pinTimes(bm, h, 0, 1);
+    pinTimes(bm, h, 1, 1);
+    TEST_CHECK(openPoolRing(bm, 16, &ring));
+    for (int p = 5; p < 20; p++) {
+        TEST_CHECK(pinPageRing(bm, h, p, ring));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+    ASSERT_TRUE(inPool(bm, 0) && inPool(bm, 1) && inPool(bm, 19), "one ring frame");
+    BM_PageHandle *held = MAKE_PAGE_HANDLE();
+    TEST_CHECK(pinPage(bm, held, 0));
+    TEST_CHECK(pinPage(bm, h, 1));
+    TEST_CHECK(unpinPage(bm, h));
+    pinTimes(bm, h, 2, 1);
+    ASSERT_TRUE(inPool(bm, 0) && inPool(bm, 2), "CLOCK victim outside the ring");
+    TEST_CHECK(pinPage(bm, h, 2));
+    pinTimes(bm, held, 3, 1);
+    ASSERT_TRUE(inPool(bm, 3) && !inPool(bm, 19), "ring frame taken when the rest is pinned");
+    TEST_CHECK(unpinPage(bm, h));
+    held->pageNum = 0;
+    TEST_CHECK(unpinPage(bm, held));
+    TEST_CHECK(closePoolRing(bm, ring));
+    TEST_CHECK(shutdownBufferPool(bm));
+    TEST_CHECK(destroyPageFile(TESTPF));
+
+    // the record manager scans large tables through a ring, updates during the scan included
+    {
+        RM_TableData *rel = (RM_TableData *) malloc(sizeof(RM_TableData));
+        RM_ScanHandle *scan = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+        char *names[] = {"a"};
+        DataType types[] = {DT_INT};
+        int lengths[] = {0};
+        int keys[] = {0};
+        Schema *schema = createSchema(1, names, types, lengths, 1, keys);
+        Record *r;
+        Value *v;
+        int count = 0;
+        long long sum = 0;
+
+        TEST_CHECK(initRecordManager(NULL));
+        TEST_CHECK(createTable("mem:ring_table", schema));
+        TEST_CHECK(openTable(rel, "mem:ring_table"));
+        TEST_CHECK(createRecord(&r, schema));
+        for (int i = 0; i < 5000; i++) {
+            MAKE_VALUE(v, DT_INT, i);
+            TEST_CHECK(setAttr(r, schema, 0, v));
+            freeVal(v);
+            TEST_CHECK(insertRecord(rel, r));
+        }
+        TEST_CHECK(startScan(rel, scan, NULL));
+        while (next(scan, r) == RC_OK) {
+            TEST_CHECK(getAttr(r, schema, 0, &v));
+            v->v.intV *= 2;
+            TEST_CHECK(setAttr(r, schema, 0, v));
+            freeVal(v);
+            TEST_CHECK(updateRecord(rel, r));
+        }
+        TEST_CHECK(closeScan(scan));
+        TEST_CHECK(closeTable(rel));
+
+        TEST_CHECK(openTable(rel, "mem:ring_table"));
+        TEST_CHECK(startScan(rel, scan, NULL));
+        while (next(scan, r) == RC_OK) {
+            TEST_CHECK(getAttr(r, schema, 0, &v));
+            sum += v->v.intV;
+            count++;
+            freeVal(v);
+        }
+        TEST_CHECK(closeScan(scan));
+        ASSERT_EQUALS_INT(5000, count, "scan sees every tuple");
+        ASSERT_TRUE(sum == 4999LL * 5000, "updates made during the scan kept");
+        TEST_CHECK(closeTable(rel));
+        TEST_CHECK(deleteTable("mem:ring_table"));
+        TEST_CHECK(shutdownRecordManager());
+        freeRecord(r);
+        freeSchema(schema);
+        free(rel);
+        free(scan);
+    }
+
+    free(bm);
+    free(h);
+    free(held);
+
+    TEST_DONE();
+}
+
+// flip the bits of one byte of a file
+static void
+corruptByte (char *fileName, long long offset)
+{
+    FILE *f = fopen(fileName, "r+b");
+    int c;
+    ASSERT_TRUE(f != NULL && fseeko(f, (off_t) offset, SEEK_SET) == 0 && (c = fgetc(f)) != EOF, "byte to corrupt");
+    fseeko(f, (off_t) offset, SEEK_SET);
+    fputc(~c & 0xff, f);
+    fclose(f);
+}
+
+// header fields read behind the storage manager's back: page count, capacity, extent, unclean, page size
+static void
+readRawHeader (char *fileName, long long *header)
+{
+    struct {
+        int magic, version;
+        long long totalNumPages, capacityPages, freeTrunk, freeCount;
+        int extentPages, unclean, pageSize;
+    } raw;
+    FILE *f = fopen(fileName, "rb");
+    ASSERT_TRUE(f != NULL && fread(&raw, sizeof(raw), 1, f) == 1, "raw header read");
+    ASSERT_TRUE(raw.magic == 0x46504d53 && raw.version == 2, "version 2 header");
+    fclose(f);
+    header[0] = raw.totalNumPages;
+    header[1] = raw.capacityPages;
+    header[2] = raw.extentPages;
+    header[3] = raw.unclean;
+    header[4] = raw.pageSize;
+}
+
+static void
+copyFile (char *from, char *to)
+{
+    char buf[PAGE_SIZE];
+    size_t n;
+    FILE *in = fopen(from, "rb");
+    FILE *out = fopen(to, "wb");
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        fwrite(buf, 1, n, out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+static long long
+fileSize (char *fileName)
+{
+    struct stat st;
+    ASSERT_TRUE(stat(fileName, &st) == 0, "stat");
+    return (long long) st.st_size;
+}
+
+// bytes the file really occupies on disk (holes excluded)
+static long long
+diskUsage (char *fileName)
+{
+    struct stat st;
+    ASSERT_TRUE(stat(fileName, &st) == 0, "stat");
+    return (long long) st.st_blocks * 512;
+}
+
+// is the page in one of the pool's frames
+static bool
+inPool (BM_BufferPool *bm, PageNumber pageNum)
+{
+    PageNumber *contents = getFrameContents(bm);
+    bool found = false;
+    for (int i = 0; i < bm->numPages; i++) {
+        if (contents[i] == pageNum) found = true;
+    }
+    free(contents);
+    return found;
+}
+
+// pin and unpin a page times times
+static void
+pinTimes (BM_BufferPool *bm, BM_PageHandle *h, PageNumber pageNum, int times)
+{
+    for (int i = 0; i < times; i++) {
+        TEST_CHECK(pinPage(bm, h, pageNum));
+        TEST_CHECK(unpinPage(bm, h));
+    }
+}
+
+// memory backend whose writes and syncs fail while flakyFail is set
+static ssize_t
+flakyPwrite (int fd, const void *buf, size_t len, off_t offset)
+{
+    if (flakyFail) {
+        errno = EIO;
+        return -1;
+    }
+    return smMemBackend.pwrite(fd, buf, len, offset);
+}
+
+static int
+flakySync (int fd)
+{
+    if (flakyFail) {
+        errno = EIO;
+        return -1;
+    }
+    return smMemBackend.sync(fd);
+}